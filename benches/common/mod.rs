@@ -0,0 +1,173 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! Frames shared by the benchmarks.
+//!
+//! Every benchmark runs on deterministic synthetic frames at the resolutions in [`RESOLUTIONS`], plus every
+//! frame found in `benches/corpus`. Corpus frames are named `<name>_<width>x<height>.<yuyv|mjpeg>`, the
+//! `capture-bench` example writes them with `--record`.
+
+#![allow(dead_code)]
+
+use nokhwa::{FrameFormat, Resolution};
+use std::{fs, path::Path};
+
+/// The resolutions synthetic frames are generated at.
+pub const RESOLUTIONS: [(u32, u32); 3] = [(640, 480), (1280, 720), (1920, 1080)];
+
+/// A frame to benchmark with.
+pub struct Frame {
+    pub name: String,
+    pub resolution: Resolution,
+    pub format: FrameFormat,
+    pub data: Vec<u8>,
+}
+
+impl Frame {
+    /// The size of the frame decoded to RGB888 (or RGBA8888 if `rgba`).
+    pub fn decoded_size(&self, rgba: bool) -> usize {
+        let pixel_size = if rgba { 4 } else { 3 };
+        self.resolution.width() as usize * self.resolution.height() as usize * pixel_size
+    }
+}
+
+// A moving gradient, so neighbouring frames (and JPEG blocks) are not identical.
+fn synthetic_rgb(width: u32, height: u32) -> Vec<u8> {
+    let mut rgb = Vec::with_capacity(width as usize * height as usize * 3);
+    for y in 0..height {
+        for x in 0..width {
+            rgb.push((x * 255 / width) as u8);
+            rgb.push((y * 255 / height) as u8);
+            rgb.push(((x + y) % 256) as u8);
+        }
+    }
+    rgb
+}
+
+/// Generates a YUYV frame of `width` x `height`.
+pub fn synthetic_yuyv(width: u32, height: u32) -> Vec<u8> {
+    let mut yuyv = Vec::with_capacity(width as usize * height as usize * 2);
+    for y in 0..height {
+        for x in (0..width).step_by(2) {
+            yuyv.push(((x + y) % 220 + 16) as u8);
+            yuyv.push((x * 224 / width + 16) as u8);
+            yuyv.push(((x + y + 1) % 220 + 16) as u8);
+            yuyv.push((y * 224 / height + 16) as u8);
+        }
+    }
+    yuyv
+}
+
+/// Generates a NV12 frame of `width` x `height`. Both have to be even.
+pub fn synthetic_nv12(width: u32, height: u32) -> Vec<u8> {
+    let luma = width as usize * height as usize;
+    let mut nv12 = Vec::with_capacity(luma + luma / 2);
+    for y in 0..height {
+        for x in 0..width {
+            nv12.push(((x + y) % 220 + 16) as u8);
+        }
+    }
+    for y in 0..height / 2 {
+        for x in 0..width / 2 {
+            nv12.push((x * 448 / width + 16) as u8);
+            nv12.push((y * 448 / height + 16) as u8);
+        }
+    }
+    nv12
+}
+
+/// Encodes a MJPEG frame of `width` x `height` at quality 85, which is about what webcams produce.
+#[cfg(feature = "decoding")]
+pub fn synthetic_mjpeg(width: u32, height: u32) -> Vec<u8> {
+    let mut compress = mozjpeg::Compress::new(mozjpeg::ColorSpace::JCS_RGB);
+    compress.set_size(width as usize, height as usize);
+    compress.set_quality(85.0);
+    compress.set_mem_dest();
+    compress.start_compress();
+    assert!(compress.write_scanlines(&synthetic_rgb(width, height)));
+    compress.finish_compress();
+    compress
+        .data_to_vec()
+        .expect("Failed to encode MJPEG frame")
+}
+
+fn parse_resolution(stem: &str) -> Option<Resolution> {
+    let (width, height) = stem.rsplit('_').next()?.split_once('x')?;
+    Some(Resolution::new(width.parse().ok()?, height.parse().ok()?))
+}
+
+/// Loads every frame of `format` from `benches/corpus`. Files with a bad name or size are skipped.
+pub fn corpus(format: FrameFormat) -> Vec<Frame> {
+    let extension = match format {
+        FrameFormat::MJPEG => "mjpeg",
+        FrameFormat::YUYV => "yuyv",
+        _ => return vec![],
+    };
+    let dir = Path::new(env!("CARGO_MANIFEST_DIR"))
+        .join("benches")
+        .join("corpus");
+    let entries = match fs::read_dir(dir) {
+        Ok(entries) => entries,
+        Err(_) => return vec![],
+    };
+
+    let mut frames = entries
+        .filter_map(Result::ok)
+        .map(|entry| entry.path())
+        .filter(|path| path.extension().map_or(false, |ext| ext == extension))
+        .filter_map(|path| {
+            let stem = path.file_stem()?.to_str()?.to_string();
+            let resolution = parse_resolution(&stem)?;
+            let data = fs::read(&path).ok()?;
+            let expected_size = resolution.width() as usize * resolution.height() as usize * 2;
+            if format == FrameFormat::YUYV && data.len() != expected_size {
+                return None;
+            }
+            Some(Frame {
+                name: stem,
+                resolution,
+                format,
+                data,
+            })
+        })
+        .collect::<Vec<Frame>>();
+    frames.sort_by(|a, b| a.name.cmp(&b.name));
+    frames
+}
+
+/// The synthetic frames of `format` at every resolution in [`RESOLUTIONS`], followed by the [`corpus`].
+pub fn frames(format: FrameFormat) -> Vec<Frame> {
+    let mut frames = RESOLUTIONS
+        .iter()
+        .filter_map(|&(width, height)| {
+            let data = match format {
+                FrameFormat::YUYV => synthetic_yuyv(width, height),
+                FrameFormat::NV12 => synthetic_nv12(width, height),
+                #[cfg(feature = "decoding")]
+                FrameFormat::MJPEG => synthetic_mjpeg(width, height),
+                _ => return None,
+            };
+            Some(Frame {
+                name: format!("synthetic_{}x{}", width, height),
+                resolution: Resolution::new(width, height),
+                format,
+                data,
+            })
+        })
+        .collect::<Vec<Frame>>();
+    frames.append(&mut corpus(format));
+    frames
+}
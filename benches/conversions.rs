@@ -0,0 +1,162 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+use criterion::{black_box, criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use nokhwa::{
+    buf_mjpeg_to_rgb, buf_nv12_to_rgb, buf_yuyv422_to_rgb, mjpeg_to_rgb, yuyv422_to_rgb, Buffer,
+    BufferPool, FrameFormat, MjpegDecoder, RgbFormat, RgbaFormat,
+};
+
+mod common;
+
+use common::Frame;
+
+fn throughput(frame: &Frame) -> Throughput {
+    Throughput::Bytes(frame.data.len() as u64)
+}
+
+fn bench_yuyv(c: &mut Criterion) {
+    let frames = common::frames(FrameFormat::YUYV);
+    let mut group = c.benchmark_group("yuyv422_to_rgb");
+    for frame in &frames {
+        group.throughput(throughput(frame));
+        for rgba in [false, true] {
+            let id = BenchmarkId::new(if rgba { "rgba" } else { "rgb" }, &frame.name);
+            group.bench_with_input(id, frame, |b, frame| {
+                b.iter(|| yuyv422_to_rgb(black_box(&frame.data), rgba).unwrap());
+            });
+        }
+    }
+    group.finish();
+
+    let mut group = c.benchmark_group("buf_yuyv422_to_rgb");
+    for frame in &frames {
+        group.throughput(throughput(frame));
+        for rgba in [false, true] {
+            let id = BenchmarkId::new(if rgba { "rgba" } else { "rgb" }, &frame.name);
+            let mut dest = vec![0; frame.decoded_size(rgba)];
+            group.bench_with_input(id, frame, |b, frame| {
+                b.iter(|| buf_yuyv422_to_rgb(black_box(&frame.data), &mut dest, rgba).unwrap());
+            });
+        }
+    }
+    group.finish();
+}
+
+fn bench_mjpeg(c: &mut Criterion) {
+    let frames = common::frames(FrameFormat::MJPEG);
+    let mut group = c.benchmark_group("mjpeg_to_rgb");
+    for frame in &frames {
+        group.throughput(throughput(frame));
+        group.bench_with_input(
+            BenchmarkId::from_parameter(&frame.name),
+            frame,
+            |b, frame| {
+                b.iter(|| mjpeg_to_rgb(black_box(&frame.data), false).unwrap());
+            },
+        );
+    }
+    group.finish();
+
+    let mut group = c.benchmark_group("buf_mjpeg_to_rgb");
+    for frame in &frames {
+        group.throughput(throughput(frame));
+        let mut dest = vec![0; frame.decoded_size(false)];
+        group.bench_with_input(
+            BenchmarkId::from_parameter(&frame.name),
+            frame,
+            |b, frame| {
+                b.iter(|| buf_mjpeg_to_rgb(black_box(&frame.data), &mut dest, false).unwrap());
+            },
+        );
+    }
+    group.finish();
+
+    // what a capture loop should use, for comparison with the one-shot functions above
+    let mut group = c.benchmark_group("MjpegDecoder::decode");
+    for frame in &frames {
+        group.throughput(throughput(frame));
+        let mut decoder = MjpegDecoder::new(false);
+        group.bench_with_input(
+            BenchmarkId::from_parameter(&frame.name),
+            frame,
+            |b, frame| {
+                b.iter(|| {
+                    decoder.decode(black_box(&frame.data)).unwrap();
+                });
+            },
+        );
+    }
+    group.finish();
+}
+
+fn bench_buffer(c: &mut Criterion) {
+    let frames = [
+        common::frames(FrameFormat::YUYV),
+        common::frames(FrameFormat::MJPEG),
+        common::frames(FrameFormat::NV12),
+    ];
+    let pool = BufferPool::default();
+
+    let mut group = c.benchmark_group("Buffer");
+    for frame in frames.iter().flatten() {
+        let buffer = Buffer::new(frame.resolution, frame.data.clone(), frame.format);
+        let name = format!("{}/{}", frame.format, frame.name);
+        group.throughput(throughput(frame));
+        group.bench_with_input(
+            BenchmarkId::new("decode_image::<RgbFormat>", &name),
+            &buffer,
+            |b, buffer| {
+                b.iter(|| black_box(buffer).decode_image::<RgbFormat>().unwrap());
+            },
+        );
+        group.bench_with_input(
+            BenchmarkId::new("decode_image::<RgbaFormat>", &name),
+            &buffer,
+            |b, buffer| {
+                b.iter(|| black_box(buffer).decode_image::<RgbaFormat>().unwrap());
+            },
+        );
+        group.bench_with_input(
+            BenchmarkId::new("to_pooled_buffer", &name),
+            &buffer,
+            |b, buffer| {
+                b.iter(|| pool.recycle_buffer(black_box(buffer).to_pooled_buffer(&pool)));
+            },
+        );
+    }
+    group.finish();
+
+    let mut group = c.benchmark_group("buf_nv12_to_rgb");
+    for frame in &frames[2] {
+        group.throughput(throughput(frame));
+        let mut dest = vec![0; frame.decoded_size(false)];
+        group.bench_with_input(
+            BenchmarkId::from_parameter(&frame.name),
+            frame,
+            |b, frame| {
+                b.iter(|| {
+                    buf_nv12_to_rgb(frame.resolution, black_box(&frame.data), &mut dest, false)
+                        .unwrap();
+                });
+            },
+        );
+    }
+    group.finish();
+}
+
+criterion_group!(conversions, bench_yuyv, bench_mjpeg, bench_buffer);
+criterion_main!(conversions);
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! `CallbackCamera` hands every frame to its callback, its `FrameRing` and every `FrameSubscription`. This measures
+//! what that costs per frame, without a camera: a `CallbackCamera` cannot be created without one, so this does the same
+//! steps the capture thread does (pooled copy for the callback, one `Arc` shared by every queue, evicted frames recycled).
+
+use criterion::{black_box, criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use nokhwa::{Buffer, BufferPool, FrameFormat, FrameRing, RingPolicy, DEFAULT_RING_DEPTH};
+use std::sync::Arc;
+
+mod common;
+
+const SUBSCRIBERS: [usize; 4] = [0, 1, 4, 8];
+
+struct Sinks {
+    frame_ring: FrameRing<Arc<Buffer>>,
+    subscribers: Vec<FrameRing<Arc<Buffer>>>,
+    buffer_pool: BufferPool,
+}
+
+impl Sinks {
+    fn new(subscribers: usize) -> Self {
+        Sinks {
+            frame_ring: FrameRing::new(DEFAULT_RING_DEPTH, RingPolicy::DropOldest),
+            subscribers: (0..subscribers)
+                .map(|_| FrameRing::new(DEFAULT_RING_DEPTH, RingPolicy::DropOldest))
+                .collect(),
+            buffer_pool: BufferPool::default(),
+        }
+    }
+
+    fn recycle(&self, frame: Option<Arc<Buffer>>) {
+        if let Some(frame) = frame {
+            if let Ok(buffer) = Arc::try_unwrap(frame) {
+                self.buffer_pool.recycle_buffer(buffer);
+            }
+        }
+    }
+
+    fn deliver(&self, frame: Buffer, callback: bool) {
+        if callback {
+            let copy = frame.to_pooled_buffer(&self.buffer_pool);
+            self.buffer_pool.recycle_buffer(black_box(copy));
+        }
+        let frame = Arc::new(frame);
+        self.recycle(self.frame_ring.push(frame.clone()));
+        for queue in &self.subscribers {
+            self.recycle(queue.push(frame.clone()));
+        }
+    }
+
+    // every subscriber takes its frame, the way a consumer that keeps up would
+    fn consume(&self) {
+        for queue in &self.subscribers {
+            self.recycle(queue.pop());
+        }
+    }
+}
+
+fn bench_fanout(c: &mut Criterion) {
+    for frame in common::frames(FrameFormat::YUYV) {
+        let source = Buffer::new(frame.resolution, frame.data, frame.format);
+        let mut group = c.benchmark_group(format!("fanout/{}", frame.name));
+        group.throughput(Throughput::Bytes(source.buffer().len() as u64));
+
+        for subscribers in SUBSCRIBERS {
+            for callback in [false, true] {
+                let sinks = Sinks::new(subscribers);
+                let id = BenchmarkId::new(
+                    if callback { "callback" } else { "no_callback" },
+                    subscribers,
+                );
+                group.bench_function(id, |b| {
+                    b.iter(|| {
+                        // the capture thread copies into a pooled buffer too
+                        sinks.deliver(source.to_pooled_buffer(&sinks.buffer_pool), callback);
+                        sinks.consume();
+                    });
+                });
+            }
+        }
+        group.finish();
+    }
+}
+
+criterion_group!(fanout, bench_fanout);
+criterion_main!(fanout);
@@ -0,0 +1,375 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures how a real camera performs through `CallbackCamera`, for every backend that was compiled in.
+// Build with the features of the backends you want to measure, e.g. `cargo run --release --features input-v4l -- -b V4L`.
+
+use clap::{App, Arg};
+use nokhwa::{
+    nokhwa_initialize, Buffer, CallbackCamera, CallbackCameraSettings, Camera, CameraFormat,
+    CaptureAPIBackend, FrameFormat, FrameOutputs,
+};
+use parking_lot::Mutex;
+use std::{
+    fs,
+    path::{Path, PathBuf},
+    sync::{
+        atomic::{AtomicBool, Ordering},
+        Arc,
+    },
+    time::{Duration, Instant},
+};
+
+// When each frame came out of the backend, by sequence number. The capture function is a plain `fn`, so this has to be a static.
+const TIMESTAMP_SLOTS: usize = 1024;
+static CAPTURED_AT: Mutex<Vec<Option<(u64, Instant)>>> = parking_lot::const_mutex(Vec::new());
+
+// Same as the default capture loop, but remembers when every frame was captured.
+// `FrameOutputs::submit()` hands out sequence numbers in order starting at 0, so they can be counted here.
+fn timed_capture_loop(
+    camera: &Arc<Mutex<Camera>>,
+    outputs: &Arc<FrameOutputs>,
+    die_bool: &Arc<AtomicBool>,
+) {
+    let mut sequence = 0;
+    loop {
+        let captured = camera.lock().frame_pooled(outputs.buffer_pool());
+        if let Ok(frame) = captured {
+            {
+                let mut captured_at = CAPTURED_AT.lock();
+                if captured_at.is_empty() {
+                    captured_at.resize(TIMESTAMP_SLOTS, None);
+                }
+                captured_at[sequence as usize % TIMESTAMP_SLOTS] = Some((sequence, Instant::now()));
+            }
+            sequence += 1;
+            outputs.submit(frame);
+        }
+        if die_bool.load(Ordering::SeqCst) {
+            break;
+        }
+    }
+}
+
+fn captured_at(sequence: u64) -> Option<Instant> {
+    match CAPTURED_AT.lock().get(sequence as usize % TIMESTAMP_SLOTS) {
+        Some(Some((seq, instant))) if *seq == sequence => Some(*instant),
+        _ => None,
+    }
+}
+
+#[derive(Default)]
+struct Stats {
+    first_frame: Option<Instant>,
+    last_frame: Option<Instant>,
+    frames: u64,
+    last_sequence: Option<u64>,
+    sequence_gaps: u64,
+    latencies: Vec<Duration>,
+}
+
+impl Stats {
+    fn record(&mut self, frame: &Buffer) {
+        let now = Instant::now();
+        self.first_frame.get_or_insert(now);
+        self.last_frame = Some(now);
+        self.frames += 1;
+
+        if let Some(last) = self.last_sequence {
+            self.sequence_gaps += frame.sequence().saturating_sub(last + 1);
+        }
+        self.last_sequence = Some(frame.sequence());
+
+        if let Some(captured) = captured_at(frame.sequence()) {
+            self.latencies.push(now.duration_since(captured));
+        }
+    }
+
+    fn fps(&self) -> f64 {
+        match (self.first_frame, self.last_frame) {
+            (Some(first), Some(last)) if self.frames > 1 => {
+                (self.frames - 1) as f64 / last.duration_since(first).as_secs_f64()
+            }
+            _ => 0.0,
+        }
+    }
+
+    fn percentile(&self, percentile: f64) -> Duration {
+        if self.latencies.is_empty() {
+            return Duration::ZERO;
+        }
+        let idx = ((self.latencies.len() - 1) as f64 * percentile).round() as usize;
+        self.latencies[idx]
+    }
+}
+
+fn parse_backend(name: &str) -> Option<CaptureAPIBackend> {
+    match name.trim() {
+        "AUTO" => Some(CaptureAPIBackend::Auto),
+        "V4L" => Some(CaptureAPIBackend::Video4Linux),
+        "MSMF" => Some(CaptureAPIBackend::MediaFoundation),
+        "AVF" => Some(CaptureAPIBackend::AVFoundation),
+        #[allow(deprecated)]
+        "GST" => Some(CaptureAPIBackend::GStreamer),
+        "OPENCV" => Some(CaptureAPIBackend::OpenCv),
+        _ => None,
+    }
+}
+
+fn compiled_backends() -> Vec<CaptureAPIBackend> {
+    let mut backends = vec![];
+    if cfg!(feature = "input-v4l") {
+        backends.push(CaptureAPIBackend::Video4Linux);
+    }
+    if cfg!(feature = "input-msmf") {
+        backends.push(CaptureAPIBackend::MediaFoundation);
+    }
+    if cfg!(feature = "input-avfoundation") {
+        backends.push(CaptureAPIBackend::AVFoundation);
+    }
+    if cfg!(feature = "input-gst") {
+        #[allow(deprecated)]
+        backends.push(CaptureAPIBackend::GStreamer);
+    }
+    if cfg!(feature = "input-opencv") {
+        backends.push(CaptureAPIBackend::OpenCv);
+    }
+    backends
+}
+
+fn record_frame(dir: &Path, backend: CaptureAPIBackend, frame: &Buffer) {
+    let extension = match frame.source_frame_format() {
+        FrameFormat::MJPEG => "mjpeg",
+        FrameFormat::YUYV => "yuyv",
+        _ => {
+            println!("Only MJPEG and YUYV frames can be recorded, skipping.");
+            return;
+        }
+    };
+    let resolution = frame.resolution();
+    let path = dir.join(format!(
+        "{}_{}x{}.{}",
+        backend.to_string().to_lowercase(),
+        resolution.width(),
+        resolution.height(),
+        extension
+    ));
+    match fs::write(&path, frame.buffer()) {
+        Ok(()) => println!("Recorded frame to {}", path.display()),
+        Err(why) => println!("Failed to record frame to {}: {why}", path.display()),
+    }
+}
+
+fn run(
+    backend: CaptureAPIBackend,
+    index: usize,
+    format: CameraFormat,
+    settings: CallbackCameraSettings,
+    duration: Duration,
+    record: Option<&PathBuf>,
+) {
+    CAPTURED_AT.lock().clear();
+
+    let mut camera = match CallbackCamera::customized_with_settings(
+        index,
+        Some(format),
+        backend,
+        Some(timed_capture_loop),
+        settings,
+    ) {
+        Ok(camera) => camera,
+        Err(why) => {
+            println!("{backend}: Failed to open camera: {why}");
+            return;
+        }
+    };
+
+    let stats = Arc::new(Mutex::new(Stats::default()));
+    let stats_clone = stats.clone();
+    let recorded = Arc::new(Mutex::new(None));
+    let recorded_clone = recorded.clone();
+    let buffer_pool = camera.buffer_pool();
+    let record_wanted = record.is_some();
+    if let Err(why) = camera.open_stream(move |frame| {
+        stats_clone.lock().record(&frame);
+        let mut recorded = recorded_clone.lock();
+        if record_wanted && recorded.is_none() {
+            *recorded = Some(frame);
+        } else {
+            buffer_pool.recycle_buffer(frame);
+        }
+    }) {
+        println!("{backend}: Failed to open stream: {why}");
+        return;
+    }
+
+    std::thread::sleep(duration);
+    let actual_format = camera.camera_format();
+    let driver_dropped = camera.driver_dropped_frames();
+    if let Err(why) = camera.stop_stream() {
+        println!("{backend}: Failed to stop stream: {why}");
+    }
+    // stops the capture thread
+    drop(camera);
+
+    let mut stats = stats.lock();
+    stats.latencies.sort_unstable();
+    let actual_format = actual_format.unwrap_or(format);
+    let expected = duration.as_secs_f64() * f64::from(actual_format.frame_rate());
+
+    println!("{backend} ({actual_format}):");
+    println!("  frames:           {}", stats.frames);
+    println!(
+        "  sustained fps:    {:.2} (requested {})",
+        stats.fps(),
+        actual_format.frame_rate()
+    );
+    println!(
+        "  dropped frames:   {} by the driver, {} short of the requested rate, {} lost between capture and callback",
+        driver_dropped,
+        (expected - stats.frames as f64).max(0.0).round(),
+        stats.sequence_gaps
+    );
+    println!(
+        "  latency (capture to callback): p50 {:?}, p90 {:?}, p99 {:?}, max {:?}",
+        stats.percentile(0.5),
+        stats.percentile(0.9),
+        stats.percentile(0.99),
+        stats.latencies.last().copied().unwrap_or_default(),
+    );
+
+    if let (Some(dir), Some(frame)) = (record, recorded.lock().take()) {
+        record_frame(dir, backend, &frame);
+    }
+}
+
+fn main() {
+    let matches = App::new("nokhwa-capture-bench")
+        .version("0.1.0")
+        .author("l1npengtul <l1npengtul@protonmail.com> and the Nokhwa Contributers")
+        .about("Measures sustained FPS, dropped frames and capture to callback latency of a real camera")
+        .arg(Arg::with_name("capture")
+            .short("c")
+            .long("capture")
+            .value_name("INDEX")
+            .help("The index of the device to capture from.")
+            .default_value("0")
+            .takes_value(true))
+        .arg(Arg::with_name("capture-backend")
+            .short("b")
+            .long("backend")
+            .value_name("BACKENDS")
+            .help("Comma seperated list of the backends to measure. Pass ALL for every backend that was compiled in, AUTO for automatic backend, V4L for Video4Linux, MSMF for Media Foundation, AVF for AVFoundation, GST for GStreamer, OPENCV for OpenCV.")
+            .default_value("ALL")
+            .takes_value(true))
+        .arg(Arg::with_name("width")
+            .short("w")
+            .long("width")
+            .value_name("WIDTH")
+            .help("Set width of capture.")
+            .default_value("640")
+            .takes_value(true))
+        .arg(Arg::with_name("height")
+            .short("h")
+            .long("height")
+            .value_name("HEIGHT")
+            .help("Set height of capture.")
+            .default_value("480")
+            .takes_value(true))
+        .arg(Arg::with_name("framerate")
+            .short("rate")
+            .long("framerate")
+            .value_name("FRAMES_PER_SECOND")
+            .help("Set FPS of capture.")
+            .default_value("30")
+            .takes_value(true))
+        .arg(Arg::with_name("format")
+            .short("4cc")
+            .long("format")
+            .value_name("FORMAT")
+            .help("Set format of capture. Possible values are MJPG, YUYV, NV12 and I420.")
+            .default_value("MJPG")
+            .takes_value(true))
+        .arg(Arg::with_name("duration")
+            .short("t")
+            .long("duration")
+            .value_name("SECONDS")
+            .help("How long to capture for, per backend.")
+            .default_value("10")
+            .takes_value(true))
+        .arg(Arg::with_name("decode-workers")
+            .short("j")
+            .long("decode-workers")
+            .value_name("WORKERS")
+            .help("Decode MJPEG frames on this many worker threads before they reach the callback. 0 hands them out compressed.")
+            .default_value("0")
+            .takes_value(true))
+        .arg(Arg::with_name("record")
+            .short("r")
+            .long("record")
+            .value_name("DIRECTORY")
+            .help("Save the first frame of every backend to this directory, e.g. benches/corpus to add it to the benchmark corpus. Only MJPEG and YUYV frames are saved.")
+            .takes_value(true))
+        .get_matches();
+
+    let parse = |name: &str| -> u32 {
+        matches
+            .value_of(name)
+            .unwrap()
+            .trim()
+            .parse::<u32>()
+            .unwrap_or_else(|_| panic!("{name} must be a u32!"))
+    };
+    let index = parse("capture") as usize;
+    let format = CameraFormat::new_from(
+        parse("width"),
+        parse("height"),
+        match matches.value_of("format").unwrap() {
+            "YUYV" => FrameFormat::YUYV,
+            "NV12" => FrameFormat::NV12,
+            "I420" => FrameFormat::I420,
+            _ => FrameFormat::MJPEG,
+        },
+        parse("framerate"),
+    );
+    let duration = Duration::from_secs(u64::from(parse("duration")));
+    let record = matches.value_of("record").map(PathBuf::from);
+    // recordings hold the frames as the camera gave them
+    let settings = CallbackCameraSettings {
+        decode_workers: parse("decode-workers") as usize,
+        raw_frames: record.is_some(),
+        ..CallbackCameraSettings::default()
+    };
+
+    let backends = match matches.value_of("capture-backend").unwrap() {
+        "ALL" => compiled_backends(),
+        list => list.split(',').filter_map(parse_backend).collect(),
+    };
+    if backends.is_empty() {
+        println!("No backends to measure! Enable the feature of at least one backend (e.g. --features input-v4l).");
+        return;
+    }
+
+    if backends.contains(&CaptureAPIBackend::AVFoundation) {
+        nokhwa_initialize(|granted| {
+            println!("AVFoundation permission granted: {granted}");
+        });
+    }
+
+    for backend in backends {
+        run(backend, index, format, settings, duration, record.as_ref());
+    }
+}
@@ -51,6 +51,8 @@ pub enum AVFError {
     StreamOpen(String),
     #[error("Failed to read frame: {0}")]
     ReadFrame(String),
+    #[error("Failed to decode frame: {0}")]
+    DecodeFrame(String),
     #[error("Unsupported")]
     NotSupported,
 }
@@ -123,6 +125,8 @@ pub mod core_media {
 
         pub fn CMSampleBufferGetDataBuffer(sbuf: CMSampleBufferRef) -> CMBlockBufferRef;
 
+        pub fn CMSampleBufferGetPresentationTimeStamp(sbuf: CMSampleBufferRef) -> CMTime;
+
         pub fn dispatch_queue_create(
             label: *const std::os::raw::c_char,
             attr: NSObject,
@@ -149,8 +153,51 @@ pub mod core_media {
         ) -> *mut std::os::raw::c_void;
 
         pub fn CVPixelBufferGetPixelFormatType(pixelBuffer: CVPixelBufferRef) -> OSType;
+
+        pub fn CVPixelBufferIsPlanar(pixelBuffer: CVPixelBufferRef) -> u8;
+
+        pub fn CVPixelBufferGetPlaneCount(pixelBuffer: CVPixelBufferRef) -> usize;
+
+        pub fn CVPixelBufferGetBaseAddressOfPlane(
+            pixelBuffer: CVPixelBufferRef,
+            planeIndex: usize,
+        ) -> *mut std::os::raw::c_void;
+
+        pub fn CVPixelBufferGetBytesPerRowOfPlane(
+            pixelBuffer: CVPixelBufferRef,
+            planeIndex: usize,
+        ) -> usize;
+
+        pub fn CVPixelBufferGetWidthOfPlane(
+            pixelBuffer: CVPixelBufferRef,
+            planeIndex: usize,
+        ) -> usize;
+
+        pub fn CVPixelBufferGetHeightOfPlane(
+            pixelBuffer: CVPixelBufferRef,
+            planeIndex: usize,
+        ) -> usize;
+
+        pub fn CVPixelBufferGetWidth(pixelBuffer: CVPixelBufferRef) -> usize;
+
+        pub fn CVPixelBufferGetHeight(pixelBuffer: CVPixelBufferRef) -> usize;
+
+        pub fn CVPixelBufferGetBytesPerRow(pixelBuffer: CVPixelBufferRef) -> usize;
+
+        pub fn CVPixelBufferRetain(texture: CVPixelBufferRef) -> CVPixelBufferRef;
+
+        pub fn CVPixelBufferRelease(texture: CVPixelBufferRef);
+
+        pub fn CVPixelBufferGetIOSurface(pixelBuffer: CVPixelBufferRef) -> IOSurfaceRef;
     }
 
+    // '420v', '420f': NV12
+    pub const kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange: OSType = 0x3432_3076;
+    pub const kCVPixelFormatType_420YpCbCr8BiPlanarFullRange: OSType = 0x3432_3066;
+    // 'y420', 'f420': I420
+    pub const kCVPixelFormatType_420YpCbCr8Planar: OSType = 0x7934_3230;
+    pub const kCVPixelFormatType_420YpCbCr8PlanarFullRange: OSType = 0x6634_3230;
+
     #[repr(C)]
     #[derive(Debug, Copy, Clone)]
     pub struct __CVBuffer {
@@ -161,8 +208,16 @@ pub mod core_media {
     pub type CVImageBufferRef = CVBufferRef;
     pub type CVPixelBufferRef = CVImageBufferRef;
     pub type CVPixelBufferLockFlags = u64;
+    pub const kCVPixelBufferLock_ReadOnly: CVPixelBufferLockFlags = 0x0000_0001;
     pub type CVReturn = i32;
 
+    #[repr(C)]
+    #[derive(Debug, Copy, Clone)]
+    pub struct __IOSurface {
+        _unused: [u8; 0],
+    }
+    pub type IOSurfaceRef = *mut __IOSurface;
+
     pub type OSType = FourCharCode;
     pub type AVVideoCodecType = NSString;
 
@@ -209,10 +264,18 @@ pub mod avfoundation {
     };
     use crate::{
         core_media::{
-            dispatch_queue_create, AVMediaTypeVideo, CMSampleBufferGetImageBuffer,
+            dispatch_queue_create, kCVPixelBufferLock_ReadOnly,
+            kCVPixelFormatType_420YpCbCr8BiPlanarFullRange,
+            kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange, kCVPixelFormatType_420YpCbCr8Planar,
+            kCVPixelFormatType_420YpCbCr8PlanarFullRange, AVMediaTypeVideo,
+            CMSampleBufferGetImageBuffer, CMSampleBufferGetPresentationTimeStamp,
             CMVideoFormatDescriptionGetDimensions, CVImageBufferRef, CVPixelBufferGetBaseAddress,
-            CVPixelBufferGetDataSize, CVPixelBufferLockBaseAddress, CVPixelBufferUnlockBaseAddress,
-            NSObject,
+            CVPixelBufferGetBaseAddressOfPlane, CVPixelBufferGetBytesPerRow,
+            CVPixelBufferGetBytesPerRowOfPlane, CVPixelBufferGetDataSize, CVPixelBufferGetHeight,
+            CVPixelBufferGetHeightOfPlane, CVPixelBufferGetIOSurface, CVPixelBufferGetPlaneCount,
+            CVPixelBufferGetWidth, CVPixelBufferGetWidthOfPlane, CVPixelBufferIsPlanar,
+            CVPixelBufferLockBaseAddress, CVPixelBufferRef, CVPixelBufferRelease,
+            CVPixelBufferRetain, CVPixelBufferUnlockBaseAddress, NSObject,
         },
         AVFError,
     };
@@ -221,11 +284,11 @@ pub mod avfoundation {
     use core_media_sys::{
         kCMPixelFormat_422YpCbCr8_yuvs, kCMPixelFormat_8IndexedGray_WhiteIsZero,
         kCMVideoCodecType_422YpCbCr8, kCMVideoCodecType_JPEG, kCMVideoCodecType_JPEG_OpenDML,
-        CMFormatDescriptionGetMediaSubType, CMFormatDescriptionRef, CMSampleBufferRef,
+        CMFormatDescriptionGetMediaSubType, CMFormatDescriptionRef, CMSampleBufferRef, CMTime,
         CMVideoDimensions,
     };
     use dashmap::DashMap;
-    use flume::{Receiver, Sender};
+    use flume::{Receiver, Sender, TrySendError};
     use objc::{
         declare::ClassDecl,
         runtime::{Class, Object, Protocol, Sel, BOOL, YES},
@@ -240,10 +303,246 @@ pub mod avfoundation {
             atomic::{AtomicBool, Ordering as MemOrdering},
             Arc, Mutex, TryLockError,
         },
+        task::{Context, Poll, Waker},
+        time::Duration,
     };
 
+    pub use crate::core_media::IOSurfaceRef;
+
     const UTF8_ENCODING: usize = 4;
 
+    // `CMTime` is a fraction of seconds, `value / timescale`
+    fn cmtime_to_duration(time: CMTime) -> Option<Duration> {
+        // kCMTimeFlags_Valid
+        if time.flags & 1 == 0 || time.timescale <= 0 || time.value < 0 {
+            return None;
+        }
+        let nanos = i128::from(time.value) * 1_000_000_000 / i128::from(time.timescale);
+        u64::try_from(nanos).ok().map(Duration::from_nanos)
+    }
+
+    // Copies the planes of a (locked) pixel buffer one after another, without the row padding CoreVideo adds. A packed
+    // (non planar) pixel buffer is copied like a single plane.
+    // SAFETY: `image_buffer` must be a valid, locked pixel buffer.
+    unsafe fn copy_planes(image_buffer: CVImageBufferRef, fourcc: AVFourCC) -> Vec<u8> {
+        let plane_count = CVPixelBufferGetPlaneCount(image_buffer);
+        let mut frame = vec![];
+        if plane_count == 0 {
+            let pixel_size = if fourcc == AVFourCC::YUV2 { 2 } else { 1 };
+            let row_size = CVPixelBufferGetWidth(image_buffer) * pixel_size;
+            let rows = CVPixelBufferGetHeight(image_buffer);
+            let stride = CVPixelBufferGetBytesPerRow(image_buffer);
+            let base = CVPixelBufferGetBaseAddress(image_buffer) as *const u8;
+            if base.is_null() || stride < row_size {
+                return frame;
+            }
+
+            let data = std::slice::from_raw_parts(base, stride * rows);
+            for row in data.chunks(stride) {
+                frame.extend_from_slice(&row[..row_size.min(row.len())]);
+            }
+            return frame;
+        }
+        for plane in 0..plane_count {
+            // the chroma plane of NV12 has 2 bytes (U, V) per pixel
+            let pixel_size = if fourcc == AVFourCC::NV12 && plane == 1 {
+                2
+            } else {
+                1
+            };
+            let row_size = CVPixelBufferGetWidthOfPlane(image_buffer, plane) * pixel_size;
+            let rows = CVPixelBufferGetHeightOfPlane(image_buffer, plane);
+            let stride = CVPixelBufferGetBytesPerRowOfPlane(image_buffer, plane);
+            let base = CVPixelBufferGetBaseAddressOfPlane(image_buffer, plane) as *const u8;
+            if base.is_null() || stride < row_size {
+                continue;
+            }
+
+            let plane_data = std::slice::from_raw_parts(base, stride * rows);
+            for row in plane_data.chunks(stride) {
+                frame.extend_from_slice(&row[..row_size.min(row.len())]);
+            }
+        }
+        frame
+    }
+
+    /// A `CVPixelBuffer` handed out by the sample buffer delegate. It is retained and locked (read only) for as long as this lives,
+    /// and unlocked and released once it is dropped, so frames reach the consumer without being copied.
+    ///
+    /// `AVFoundation` only keeps a small pool of pixel buffers. Holding on to many of these at once will make it drop frames.
+    pub struct AVPixelBuffer {
+        buffer: CVPixelBufferRef,
+        fourcc: AVFourCC,
+    }
+
+    // SAFETY: CoreVideo buffers are reference counted atomically, and we only ever read from it while it is locked.
+    unsafe impl Send for AVPixelBuffer {}
+    unsafe impl Sync for AVPixelBuffer {}
+
+    impl AVPixelBuffer {
+        // SAFETY: `buffer` must be a valid pixel buffer.
+        unsafe fn retain(buffer: CVPixelBufferRef, fourcc: AVFourCC) -> Option<Self> {
+            if buffer.is_null() {
+                return None;
+            }
+            CVPixelBufferRetain(buffer);
+            if CVPixelBufferLockBaseAddress(buffer, kCVPixelBufferLock_ReadOnly) != 0 {
+                CVPixelBufferRelease(buffer);
+                return None;
+            }
+            Some(AVPixelBuffer { buffer, fourcc })
+        }
+
+        /// The format of the pixels.
+        pub fn fourcc(&self) -> AVFourCC {
+            self.fourcc
+        }
+
+        pub fn width(&self) -> usize {
+            unsafe { CVPixelBufferGetWidth(self.buffer) }
+        }
+
+        pub fn height(&self) -> usize {
+            unsafe { CVPixelBufferGetHeight(self.buffer) }
+        }
+
+        pub fn is_planar(&self) -> bool {
+            unsafe { CVPixelBufferIsPlanar(self.buffer) != 0 }
+        }
+
+        /// The amount of planes. This is 0 for packed (non planar) formats.
+        pub fn plane_count(&self) -> usize {
+            unsafe { CVPixelBufferGetPlaneCount(self.buffer) }
+        }
+
+        /// The bytes of a packed (non planar) pixel buffer, including any row padding (see [`bytes_per_row()`](AVPixelBuffer::bytes_per_row)).
+        /// This is `None` for planar formats, use [`plane()`](AVPixelBuffer::plane) instead.
+        pub fn data(&self) -> Option<&[u8]> {
+            if self.is_planar() {
+                return None;
+            }
+            unsafe {
+                let base = CVPixelBufferGetBaseAddress(self.buffer) as *const u8;
+                if base.is_null() {
+                    return None;
+                }
+                let length = CVPixelBufferGetDataSize(self.buffer) as usize;
+                Some(std::slice::from_raw_parts(base, length))
+            }
+        }
+
+        /// The bytes of one plane of a planar pixel buffer, including any row padding (see [`bytes_per_row()`](AVPixelBuffer::bytes_per_row)).
+        pub fn plane(&self, plane: usize) -> Option<&[u8]> {
+            if plane >= self.plane_count() {
+                return None;
+            }
+            unsafe {
+                let base = CVPixelBufferGetBaseAddressOfPlane(self.buffer, plane) as *const u8;
+                if base.is_null() {
+                    return None;
+                }
+                let length = CVPixelBufferGetBytesPerRowOfPlane(self.buffer, plane)
+                    * CVPixelBufferGetHeightOfPlane(self.buffer, plane);
+                Some(std::slice::from_raw_parts(base, length))
+            }
+        }
+
+        /// The stride of `plane`. For packed formats, `plane` is ignored.
+        pub fn bytes_per_row(&self, plane: usize) -> usize {
+            unsafe {
+                if self.is_planar() {
+                    CVPixelBufferGetBytesPerRowOfPlane(self.buffer, plane)
+                } else {
+                    CVPixelBufferGetBytesPerRow(self.buffer)
+                }
+            }
+        }
+
+        /// The frame with its planes one after another and without row padding, the layout the rest of `nokhwa` expects.
+        ///
+        /// This borrows the pixel buffer if it already is laid out like that (which is usually the case for packed formats),
+        /// and only copies otherwise.
+        pub fn contiguous(&self) -> Cow<'_, [u8]> {
+            if !self.is_planar() {
+                let data = match self.data() {
+                    Some(data) => data,
+                    None => return Cow::Owned(vec![]),
+                };
+                let pixel_size = match self.fourcc {
+                    AVFourCC::YUV2 => 2,
+                    AVFourCC::GRAY8 => 1,
+                    // compressed, there are no rows
+                    _ => return Cow::Borrowed(data),
+                };
+                let row_size = self.width() * pixel_size;
+                let frame_size = row_size * self.height();
+                // CoreVideo pads the rows of some sizes, and the data size can include padding after the last row
+                if self.bytes_per_row(0) == row_size && data.len() >= frame_size {
+                    return Cow::Borrowed(&data[..frame_size]);
+                }
+                return Cow::Owned(unsafe { copy_planes(self.buffer, self.fourcc) });
+            }
+
+            unsafe {
+                let plane_count = self.plane_count();
+                let first = CVPixelBufferGetBaseAddressOfPlane(self.buffer, 0) as *const u8;
+                let mut end = first;
+                let mut packed = !first.is_null();
+                for plane in 0..plane_count {
+                    if !packed {
+                        break;
+                    }
+                    let pixel_size = if self.fourcc == AVFourCC::NV12 && plane == 1 {
+                        2
+                    } else {
+                        1
+                    };
+                    let row_size = CVPixelBufferGetWidthOfPlane(self.buffer, plane) * pixel_size;
+                    let stride = CVPixelBufferGetBytesPerRowOfPlane(self.buffer, plane);
+                    let base = CVPixelBufferGetBaseAddressOfPlane(self.buffer, plane) as *const u8;
+                    packed = stride == row_size && base == end;
+                    end = base.add(stride * CVPixelBufferGetHeightOfPlane(self.buffer, plane));
+                }
+
+                if packed {
+                    Cow::Borrowed(std::slice::from_raw_parts(
+                        first,
+                        end as usize - first as usize,
+                    ))
+                } else {
+                    Cow::Owned(copy_planes(self.buffer, self.fourcc))
+                }
+            }
+        }
+
+        /// The `IOSurface` backing this pixel buffer, e.g. to upload it to a Metal texture without a copy
+        /// (`newTextureWithDescriptor:iosurface:plane:`). This is `None` if the buffer is not backed by one.
+        ///
+        /// The surface is only guaranteed to live as long as this [`AVPixelBuffer`] does. Retain it yourself (`CFRetain`) to keep it around longer.
+        pub fn io_surface(&self) -> Option<IOSurfaceRef> {
+            let surface = unsafe { CVPixelBufferGetIOSurface(self.buffer) };
+            if surface.is_null() {
+                None
+            } else {
+                Some(surface)
+            }
+        }
+
+        /// The raw `CVPixelBufferRef`, valid for as long as this lives.
+        pub fn inner(&self) -> CVPixelBufferRef {
+            self.buffer
+        }
+    }
+
+    impl Drop for AVPixelBuffer {
+        fn drop(&mut self) {
+            unsafe {
+                CVPixelBufferUnlockBaseAddress(self.buffer, kCVPixelBufferLock_ReadOnly);
+                CVPixelBufferRelease(self.buffer);
+            }
+        }
+    }
+
     macro_rules! create_boilerplate_impl {
         {
             $( [$class_vis:vis $class_name:ident : $( {$field_vis:vis $field_name:ident : $field_type:ty} ),*] ),+
@@ -362,18 +661,51 @@ pub mod avfoundation {
 
     fn default_callback(_: bool) {}
 
-    pub type CompressionData<'a> = (Cow<'a, [u8]>, AVFourCC);
-    pub type DataPipe<'a> = (Sender<CompressionData<'a>>, Receiver<CompressionData<'a>>);
+    /// When a frame was captured and how many frames `AVFoundation` dropped before it.
+    #[derive(Copy, Clone, Debug, Default, Hash, PartialEq, Eq)]
+    pub struct AVFrameTiming {
+        /// The presentation time of the sample buffer, on the host time clock.
+        pub presentation_time: Option<Duration>,
+        /// The amount of sample buffers that were dropped since the last frame.
+        pub dropped: u64,
+    }
+
+    /// How many frames the delegate queues up for the consumer. Once full, the oldest frame is dropped (and counted in [`AVFrameTiming::dropped`]),
+    /// so a slow consumer can not hold on to all of `AVFoundation`'s pixel buffers or grow memory without limit.
+    pub const FRAME_QUEUE_DEPTH: usize = 2;
+
+    pub type CompressionData = (AVPixelBuffer, AVFrameTiming);
+    pub type DataPipe = (Sender<CompressionData>, Receiver<CompressionData>);
+
+    // Takes the newest frame out of the pipe. The frames skipped over count as dropped.
+    fn newest_frame(receiver: &Receiver<CompressionData>) -> Option<CompressionData> {
+        let mut newest: Option<CompressionData> = None;
+        for (pixel_buffer, timing) in receiver.drain() {
+            let skipped = newest.map_or(0, |(_, skipped)| skipped.dropped + 1);
+            newest = Some((
+                pixel_buffer,
+                AVFrameTiming {
+                    dropped: timing.dropped + skipped,
+                    ..timing
+                },
+            ));
+        }
+        newest
+    }
 
     lazy_static! {
         static ref CAMERA_AUTHORIZED: Arc<AtomicBool> = Arc::new(AtomicBool::new(false));
         static ref USER_CALLBACK_FN: Arc<Mutex<fn(bool)>> = Arc::new(Mutex::new(default_callback));
-        static ref PIPE_MAP: Arc<DashMap<usize, DataPipe<'static>>> = Arc::new(DashMap::new());
+        static ref PIPE_MAP: Arc<DashMap<usize, DataPipe>> = Arc::new(DashMap::new());
+        // tasks waiting for the next frame of a pipe, woken by the delegate once it sent one
+        static ref WAKER_MAP: Arc<DashMap<usize, Waker>> = Arc::new(DashMap::new());
         static ref CALLBACK_CLASS: &'static Class = {
             let mut decl = ClassDecl::new("MyCaptureCallback", class!(NSObject)).unwrap();
 
             // frame stack
             decl.add_ivar::<usize>("_index");
+            // sample buffers dropped since the last frame. both callbacks are called on the same serial queue, so this needs no synchronisation
+            decl.add_ivar::<u64>("_dropped");
 
             extern "C" fn my_callback_get_index(this: &Object, _: Sel) -> usize {
                 unsafe {
@@ -393,32 +725,63 @@ pub mod avfoundation {
             #[allow(non_upper_case_globals)]
             extern fn capture_out_callback(this: &mut Object, _: Sel, _: *mut Object, didOutputSampleBuffer: CMSampleBufferRef, _: *mut Object) {
                 let image_buffer: CVImageBufferRef = unsafe { CMSampleBufferGetImageBuffer(didOutputSampleBuffer) };
-                unsafe { CVPixelBufferLockBaseAddress(image_buffer, 0); };
+                if image_buffer.is_null() {
+                    return;
+                }
 
                 let buffer_codec = unsafe { CVPixelBufferGetPixelFormatType(image_buffer) };
 
                 let fourcc = match buffer_codec {
                     kCMVideoCodecType_422YpCbCr8 | kCMPixelFormat_422YpCbCr8_yuvs => AVFourCC::YUV2,
                     kCMVideoCodecType_JPEG | kCMVideoCodecType_JPEG_OpenDML => AVFourCC::MJPEG,
-                    _ => {
-                        return;
-                    }
+                    kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange | kCVPixelFormatType_420YpCbCr8BiPlanarFullRange => AVFourCC::NV12,
+                    kCVPixelFormatType_420YpCbCr8Planar | kCVPixelFormatType_420YpCbCr8PlanarFullRange => AVFourCC::I420,
+                    _ => return,
                 };
 
-                let buffer_length = unsafe { CVPixelBufferGetDataSize(image_buffer) };
-                let buffer_ptr = unsafe { CVPixelBufferGetBaseAddress(image_buffer) };
-                let buffer_as_vec = unsafe { std::slice::from_raw_parts_mut(buffer_ptr as *mut u8, buffer_length as usize).to_vec() };
+                // the pixel buffer is retained instead of copied, it goes back to AVFoundation once the consumer drops it
+                let pixel_buffer = match unsafe { AVPixelBuffer::retain(image_buffer, fourcc) } {
+                    Some(pixel_buffer) => pixel_buffer,
+                    None => return,
+                };
 
-                unsafe { CVPixelBufferUnlockBaseAddress(image_buffer, 0) };
+                let timing = unsafe {
+                    let dropped: u64 = *this.get_ivar("_dropped");
+                    this.set_ivar("_dropped", 0_u64);
+                    AVFrameTiming {
+                        presentation_time: cmtime_to_duration(CMSampleBufferGetPresentationTimeStamp(didOutputSampleBuffer)),
+                        dropped,
+                    }
+                };
                 let index: usize = unsafe { msg_send![this, index] };
                 let pipes = &PIPE_MAP.get(&index);
                 if let Some(pipe) = pipes {
-                    let _ = pipe.value().0.send((Cow::from(buffer_as_vec), fourcc));
+                    let (sender, receiver) = pipe.value();
+                    let mut frame = (pixel_buffer, timing);
+                    loop {
+                        match sender.try_send(frame) {
+                            Ok(_) | Err(TrySendError::Disconnected(_)) => break,
+                            Err(TrySendError::Full(returned)) => {
+                                frame = returned;
+                                // the consumer is too slow, make room by dropping the oldest frame
+                                if let Ok((_, evicted)) = receiver.try_recv() {
+                                    frame.1.dropped += evicted.dropped + 1;
+                                }
+                            }
+                        }
+                    }
+                }
+                if let Some((_, waker)) = WAKER_MAP.remove(&index) {
+                    waker.wake();
                 }
             }
 
             #[allow(non_snake_case)]
-            extern fn capture_drop_callback(_: &mut Object, _: Sel, _: *mut Object, _: *mut Object, _: *mut Object) {
+            extern fn capture_drop_callback(this: &mut Object, _: Sel, _: *mut Object, _: *mut Object, _: *mut Object) {
+                unsafe {
+                    let dropped: u64 = *this.get_ivar("_dropped");
+                    this.set_ivar("_dropped", dropped + 1);
+                }
             }
 
             unsafe {
@@ -509,6 +872,54 @@ pub mod avfoundation {
         status
     }
 
+    /// Calls `callback` every time a capture device is connected or disconnected
+    /// (`AVCaptureDeviceWasConnectedNotification`/`AVCaptureDeviceWasDisconnectedNotification`), until this is dropped.
+    ///
+    /// `callback` is called on the thread that posted the notification.
+    pub struct AVCaptureDeviceObserver {
+        observers: Vec<*mut Object>,
+    }
+
+    impl AVCaptureDeviceObserver {
+        pub fn new(callback: Arc<dyn Fn() + Send + Sync + 'static>) -> Self {
+            let center: *mut Object =
+                unsafe { msg_send![class!(NSNotificationCenter), defaultCenter] };
+            let observers = [
+                "AVCaptureDeviceWasConnectedNotification",
+                "AVCaptureDeviceWasDisconnectedNotification",
+            ]
+            .iter()
+            .map(|name| {
+                let callback = callback.clone();
+                let block = ConcreteBlock::new(move |_: *mut Object| callback()).copy();
+                let null: *mut Object = std::ptr::null_mut();
+                // the notification center copies the block, and keeps the returned observer alive until it is removed
+                let observer: *mut Object = unsafe {
+                    msg_send![center, addObserverForName:str_to_nsstr(name) object:null queue:null usingBlock:block]
+                };
+                observer
+            })
+            .collect();
+            AVCaptureDeviceObserver { observers }
+        }
+    }
+
+    impl Drop for AVCaptureDeviceObserver {
+        fn drop(&mut self) {
+            let center: *mut Object =
+                unsafe { msg_send![class!(NSNotificationCenter), defaultCenter] };
+            for observer in &self.observers {
+                unsafe {
+                    let _: () = msg_send![center, removeObserver:*observer];
+                }
+            }
+        }
+    }
+
+    // SAFETY: `NSNotificationCenter` is thread safe, the observers are only ever handed back to it.
+    unsafe impl Send for AVCaptureDeviceObserver {}
+    unsafe impl Sync for AVCaptureDeviceObserver {}
+
     // fuck it, use deprecated APIs
     pub fn query_avfoundation() -> Result<Vec<AVCaptureDeviceDescriptor>, AVFError> {
         Ok(AVCaptureDevice::devices_with_type(AVMediaType::Video)
@@ -669,6 +1080,8 @@ pub mod avfoundation {
         YUV2,
         MJPEG,
         GRAY8,
+        NV12,
+        I420,
     }
 
     // Localized Name
@@ -718,7 +1131,7 @@ pub mod avfoundation {
             let delegate: *mut Object = unsafe { msg_send![cls, alloc] };
             let delegate: *mut Object = unsafe { msg_send![delegate, init] };
 
-            let data_pipe: DataPipe = flume::unbounded();
+            let data_pipe: DataPipe = flume::bounded(FRAME_QUEUE_DEPTH);
             let _ = &PIPE_MAP.insert(index, data_pipe);
 
             AVCaptureVideoCallback { index, delegate }
@@ -732,13 +1145,15 @@ pub mod avfoundation {
             unsafe { msg_send![self.delegate, dataLength] }
         }
 
-        pub fn frame_to_slice<'a>(&self) -> Result<CompressionData<'a>, AVFError> {
+        /// Takes the newest frame out of the pipe, waiting for one if there is none.
+        /// The [`AVPixelBuffer`] is handed out as it is, without a copy.
+        pub fn frame_to_slice(&self) -> Result<CompressionData, AVFError> {
             let pipe_map = &PIPE_MAP.get(&self.index); // why rust
             let pipe_recv = match pipe_map {
                 Some(pipe) => &pipe.value().1,
                 None => return Err(AVFError::ReadFrame("Data Pipe None".to_string())),
             };
-            let data = match pipe_recv.drain().last() {
+            let data = match newest_frame(pipe_recv) {
                 Some(frame) => frame,
                 None => match pipe_recv.recv() {
                     Ok(f) => f,
@@ -753,13 +1168,13 @@ pub mod avfoundation {
             Ok(data)
         }
 
-        pub fn frame_to_slice_no_block<'a>(&self) -> Result<CompressionData<'a>, AVFError> {
+        pub fn frame_to_slice_no_block(&self) -> Result<CompressionData, AVFError> {
             let pipe_map = &PIPE_MAP.get(&self.index); // why rust
             let pipe_recv = match pipe_map {
                 Some(pipe) => &pipe.value().1,
                 None => return Err(AVFError::ReadFrame("Data Pipe None".to_string())),
             };
-            let data = match pipe_recv.drain().last() {
+            let data = match newest_frame(pipe_recv) {
                 Some(frame) => frame,
                 None => {
                     return Err(AVFError::ReadFrame(
@@ -770,6 +1185,26 @@ pub mod avfoundation {
             Ok(data)
         }
 
+        /// Checks if a frame is waiting in the pipe, so that [`frame_to_slice()`](AVCaptureVideoCallback::frame_to_slice) will not block.
+        /// If there is none, the task of `cx` is woken once the delegate got the next one.
+        pub fn poll_frame(&self, cx: &mut Context<'_>) -> Poll<Result<(), AVFError>> {
+            let pipe_map = &PIPE_MAP.get(&self.index);
+            let pipe_recv = match pipe_map {
+                Some(pipe) => &pipe.value().1,
+                None => return Poll::Ready(Err(AVFError::ReadFrame("Data Pipe None".to_string()))),
+            };
+            if !pipe_recv.is_empty() {
+                return Poll::Ready(Ok(()));
+            }
+            let _ = WAKER_MAP.insert(self.index, cx.waker().clone());
+            // the delegate may have sent a frame before the waker was in place
+            if pipe_recv.is_empty() {
+                Poll::Pending
+            } else {
+                Poll::Ready(Ok(()))
+            }
+        }
+
         pub fn inner(&self) -> *mut Object {
             self.delegate
         }
@@ -777,6 +1212,7 @@ pub mod avfoundation {
 
     impl Drop for AVCaptureVideoCallback {
         fn drop(&mut self) {
+            let _ = WAKER_MAP.remove(&self.index);
             unsafe {
                 let _: () = msg_send![self.delegate, autorelease];
             }
@@ -863,6 +1299,10 @@ pub mod avfoundation {
                 kCMVideoCodecType_422YpCbCr8 | kCMPixelFormat_422YpCbCr8_yuvs => AVFourCC::YUV2,
                 kCMVideoCodecType_JPEG | kCMVideoCodecType_JPEG_OpenDML => AVFourCC::MJPEG,
                 kCMPixelFormat_8IndexedGray_WhiteIsZero => AVFourCC::GRAY8,
+                kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange
+                | kCVPixelFormatType_420YpCbCr8BiPlanarFullRange => AVFourCC::NV12,
+                kCVPixelFormatType_420YpCbCr8Planar
+                | kCVPixelFormatType_420YpCbCr8PlanarFullRange => AVFourCC::I420,
                 _ => {
                     return Err(AVFError::InvalidValue {
                         found: fcc_raw.to_string(),
@@ -1258,10 +1698,74 @@ pub mod avfoundation {
 pub mod avfoundation {
     use crate::AVFError;
     use flume::{Receiver, Sender};
-    use std::borrow::Cow;
+    use std::{
+        borrow::Cow,
+        ffi::c_void,
+        sync::Arc,
+        task::{Context, Poll},
+        time::Duration,
+    };
+
+    #[derive(Copy, Clone, Debug, Default, Hash, PartialEq, Eq)]
+    pub struct AVFrameTiming {
+        pub presentation_time: Option<Duration>,
+        pub dropped: u64,
+    }
 
-    pub type CompressionData<'a> = (Cow<'a, [u8]>, AVFourCC);
-    pub type DataPipe<'a> = (Sender<CompressionData<'a>>, Receiver<CompressionData<'a>>);
+    pub type IOSurfaceRef = *mut c_void;
+
+    pub const FRAME_QUEUE_DEPTH: usize = 2;
+
+    pub struct AVPixelBuffer {}
+
+    impl AVPixelBuffer {
+        pub fn fourcc(&self) -> AVFourCC {
+            AVFourCC::MJPEG
+        }
+
+        pub fn width(&self) -> usize {
+            0
+        }
+
+        pub fn height(&self) -> usize {
+            0
+        }
+
+        pub fn is_planar(&self) -> bool {
+            false
+        }
+
+        pub fn plane_count(&self) -> usize {
+            0
+        }
+
+        pub fn data(&self) -> Option<&[u8]> {
+            None
+        }
+
+        pub fn plane(&self, _: usize) -> Option<&[u8]> {
+            None
+        }
+
+        pub fn bytes_per_row(&self, _: usize) -> usize {
+            0
+        }
+
+        pub fn contiguous(&self) -> Cow<'_, [u8]> {
+            Cow::Owned(vec![])
+        }
+
+        pub fn io_surface(&self) -> Option<IOSurfaceRef> {
+            None
+        }
+
+        pub fn inner(&self) -> *mut c_void {
+            std::ptr::null_mut()
+        }
+    }
+
+    pub type CompressionData = (AVPixelBuffer, AVFrameTiming);
+    pub type DataPipe = (Sender<CompressionData>, Receiver<CompressionData>);
 
     pub fn request_permission_with_callback(_: fn(bool)) {}
 
@@ -1269,6 +1773,14 @@ pub mod avfoundation {
         AVAuthorizationStatus::NotDetermined
     }
 
+    pub struct AVCaptureDeviceObserver {}
+
+    impl AVCaptureDeviceObserver {
+        pub fn new(_: Arc<dyn Fn() + Send + Sync + 'static>) -> Self {
+            AVCaptureDeviceObserver {}
+        }
+    }
+
     // fuck it, use deprecated APIs
     pub fn query_avfoundation() -> Result<Vec<AVCaptureDeviceDescriptor>, AVFError> {
         Err(AVFError::NotSupported)
@@ -1323,6 +1835,8 @@ pub mod avfoundation {
         YUV2,
         MJPEG,
         GRAY8,
+        NV12,
+        I420,
     }
 
     // Localized Name
@@ -1350,13 +1864,17 @@ pub mod avfoundation {
             0
         }
 
-        pub fn frame_to_slice<'a>(&self) -> Result<CompressionData<'a>, AVFError> {
+        pub fn frame_to_slice(&self) -> Result<CompressionData, AVFError> {
             Err(AVFError::NotSupported)
         }
 
-        pub fn frame_to_slice_no_block<'a>(&self) -> Result<CompressionData<'a>, AVFError> {
+        pub fn frame_to_slice_no_block(&self) -> Result<CompressionData, AVFError> {
             Err(AVFError::NotSupported)
         }
+
+        pub fn poll_frame(&self, _: &mut Context<'_>) -> Poll<Result<(), AVFError>> {
+            Poll::Ready(Err(AVFError::NotSupported))
+        }
     }
 
     pub struct AVFrameRateRange {}
@@ -1553,3 +2071,444 @@ pub mod avfoundation {
         }
     }
 }
+
+#[cfg(any(target_os = "macos", target_os = "ios"))]
+#[allow(non_snake_case)]
+#[allow(non_upper_case_globals)]
+pub mod video_toolbox {
+    // more bindgen theft
+    use crate::{
+        core_media::{
+            CVImageBufferRef, CVPixelBufferGetBaseAddress, CVPixelBufferLockBaseAddress,
+            CVPixelBufferUnlockBaseAddress, CVReturn,
+        },
+        AVFError,
+    };
+    use core_media_sys::{
+        kCMVideoCodecType_JPEG, CMBlockBufferRef, CMFormatDescriptionRef, CMSampleBufferRef, CMTime,
+    };
+    use std::{
+        ffi::c_void,
+        ptr::{null, null_mut},
+    };
+
+    pub type OSStatus = i32;
+    pub type CFTypeRef = *const c_void;
+    pub type CFAllocatorRef = *const c_void;
+    pub type CFDictionaryRef = *const c_void;
+    pub type CFStringRef = *const c_void;
+    pub type CFNumberRef = *const c_void;
+    pub type CFBooleanRef = *const c_void;
+    pub type CFIndex = isize;
+    pub type VTDecompressionSessionRef = *mut c_void;
+
+    #[repr(C)]
+    pub struct CFDictionaryCallBacks {
+        _unused: [u8; 0],
+    }
+
+    pub type VTDecompressionOutputCallback = extern "C" fn(
+        decompressionOutputRefCon: *mut c_void,
+        sourceFrameRefCon: *mut c_void,
+        status: OSStatus,
+        infoFlags: u32,
+        imageBuffer: CVImageBufferRef,
+        presentationTimeStamp: CMTime,
+        presentationDuration: CMTime,
+    );
+
+    #[repr(C)]
+    pub struct VTDecompressionOutputCallbackRecord {
+        pub decompressionOutputCallback: VTDecompressionOutputCallback,
+        pub decompressionOutputRefCon: *mut c_void,
+    }
+
+    // 'BGRA'
+    pub const kCVPixelFormatType_32BGRA: u32 = 0x4247_5241;
+    pub const kCVPixelBufferLock_ReadOnly: u64 = 0x0000_0001;
+    pub const kCFNumberSInt32Type: CFIndex = 3;
+
+    #[link(name = "CoreFoundation", kind = "framework")]
+    extern "C" {
+        pub static kCFAllocatorNull: CFAllocatorRef;
+        pub static kCFBooleanTrue: CFBooleanRef;
+        pub static kCFTypeDictionaryKeyCallBacks: CFDictionaryCallBacks;
+        pub static kCFTypeDictionaryValueCallBacks: CFDictionaryCallBacks;
+
+        pub fn CFDictionaryCreate(
+            allocator: CFAllocatorRef,
+            keys: *const *const c_void,
+            values: *const *const c_void,
+            numValues: CFIndex,
+            keyCallBacks: *const CFDictionaryCallBacks,
+            valueCallBacks: *const CFDictionaryCallBacks,
+        ) -> CFDictionaryRef;
+
+        pub fn CFNumberCreate(
+            allocator: CFAllocatorRef,
+            theType: CFIndex,
+            valuePtr: *const c_void,
+        ) -> CFNumberRef;
+
+        pub fn CFRelease(cf: CFTypeRef);
+    }
+
+    #[link(name = "CoreVideo", kind = "framework")]
+    extern "C" {
+        pub static kCVPixelBufferPixelFormatTypeKey: CFStringRef;
+
+        pub fn CVPixelBufferGetWidth(pixelBuffer: CVImageBufferRef) -> usize;
+
+        pub fn CVPixelBufferGetHeight(pixelBuffer: CVImageBufferRef) -> usize;
+
+        pub fn CVPixelBufferGetBytesPerRow(pixelBuffer: CVImageBufferRef) -> usize;
+    }
+
+    #[link(name = "CoreMedia", kind = "framework")]
+    extern "C" {
+        pub fn CMVideoFormatDescriptionCreate(
+            allocator: CFAllocatorRef,
+            codecType: u32,
+            width: i32,
+            height: i32,
+            extensions: CFDictionaryRef,
+            formatDescriptionOut: *mut CMFormatDescriptionRef,
+        ) -> OSStatus;
+
+        pub fn CMBlockBufferCreateWithMemoryBlock(
+            structureAllocator: CFAllocatorRef,
+            memoryBlock: *mut c_void,
+            blockLength: usize,
+            blockAllocator: CFAllocatorRef,
+            customBlockSource: *const c_void,
+            offsetToData: usize,
+            dataLength: usize,
+            flags: u32,
+            blockBufferOut: *mut CMBlockBufferRef,
+        ) -> OSStatus;
+
+        pub fn CMSampleBufferCreateReady(
+            allocator: CFAllocatorRef,
+            dataBuffer: CMBlockBufferRef,
+            formatDescription: CMFormatDescriptionRef,
+            numSamples: CFIndex,
+            numSampleTimingEntries: CFIndex,
+            sampleTimingArray: *const c_void,
+            numSampleSizeEntries: CFIndex,
+            sampleSizeArray: *const usize,
+            sampleBufferOut: *mut CMSampleBufferRef,
+        ) -> OSStatus;
+    }
+
+    #[link(name = "VideoToolbox", kind = "framework")]
+    extern "C" {
+        pub static kVTVideoDecoderSpecification_RequireHardwareAcceleratedVideoDecoder: CFStringRef;
+
+        pub fn VTDecompressionSessionCreate(
+            allocator: CFAllocatorRef,
+            videoFormatDescription: CMFormatDescriptionRef,
+            videoDecoderSpecification: CFDictionaryRef,
+            destinationImageBufferAttributes: CFDictionaryRef,
+            outputCallback: *const VTDecompressionOutputCallbackRecord,
+            decompressionSessionOut: *mut VTDecompressionSessionRef,
+        ) -> OSStatus;
+
+        pub fn VTDecompressionSessionDecodeFrame(
+            session: VTDecompressionSessionRef,
+            sampleBuffer: CMSampleBufferRef,
+            decodeFlags: u32,
+            sourceFrameRefCon: *mut c_void,
+            infoFlagsOut: *mut u32,
+        ) -> OSStatus;
+
+        pub fn VTDecompressionSessionWaitForAsynchronousFrames(
+            session: VTDecompressionSessionRef,
+        ) -> OSStatus;
+
+        pub fn VTDecompressionSessionInvalidate(session: VTDecompressionSessionRef);
+    }
+
+    // where the output callback puts the decoded frame
+    #[derive(Default)]
+    struct DecodedFrame {
+        status: OSStatus,
+        width: u32,
+        height: u32,
+        // B, G, R, A, rows tightly packed
+        data: Vec<u8>,
+    }
+
+    extern "C" fn decompression_output_callback(
+        decompression_output_ref_con: *mut c_void,
+        _: *mut c_void,
+        status: OSStatus,
+        _: u32,
+        image_buffer: CVImageBufferRef,
+        _: CMTime,
+        _: CMTime,
+    ) {
+        let frame = unsafe { &mut *(decompression_output_ref_con as *mut DecodedFrame) };
+        frame.status = status;
+        if status != 0 || image_buffer.is_null() {
+            if frame.status == 0 {
+                frame.status = -1;
+            }
+            return;
+        }
+
+        unsafe {
+            if CVPixelBufferLockBaseAddress(image_buffer, kCVPixelBufferLock_ReadOnly) != 0 {
+                frame.status = -1;
+                return;
+            }
+            let width = CVPixelBufferGetWidth(image_buffer);
+            let height = CVPixelBufferGetHeight(image_buffer);
+            let bytes_per_row = CVPixelBufferGetBytesPerRow(image_buffer);
+            let base_address = CVPixelBufferGetBaseAddress(image_buffer) as *const u8;
+
+            if base_address.is_null() || bytes_per_row < width * 4 {
+                frame.status = -1;
+            } else {
+                // reuses the allocation of the last frame
+                frame.data.clear();
+                for row in 0..height {
+                    frame.data.extend_from_slice(std::slice::from_raw_parts(
+                        base_address.add(row * bytes_per_row),
+                        width * 4,
+                    ));
+                }
+                frame.width = width as u32;
+                frame.height = height as u32;
+            }
+
+            let _: CVReturn =
+                CVPixelBufferUnlockBaseAddress(image_buffer, kCVPixelBufferLock_ReadOnly);
+        }
+    }
+
+    /// A `MJPEG` decoder that uses the hardware JPEG decoder through `VideoToolbox`, decoding to BGRA.
+    pub struct VideoToolboxMjpegDecoder {
+        session: VTDecompressionSessionRef,
+        format_description: CMFormatDescriptionRef,
+        resolution: (u32, u32),
+        // boxed so the pointer given to the output callback stays valid
+        frame: Box<DecodedFrame>,
+    }
+
+    // SAFETY: VideoToolbox sessions can be used from any thread, and this is only ever used through `&mut self`.
+    unsafe impl Send for VideoToolboxMjpegDecoder {}
+
+    impl VideoToolboxMjpegDecoder {
+        /// Creates a new decoder for frames of `width` x `height`.
+        /// # Errors
+        /// If there is no hardware JPEG decoder, this will error.
+        pub fn new(width: u32, height: u32) -> Result<Self, AVFError> {
+            let mut decoder = VideoToolboxMjpegDecoder {
+                session: null_mut(),
+                format_description: null_mut(),
+                resolution: (0, 0),
+                frame: Box::new(DecodedFrame::default()),
+            };
+            decoder.create_session(width, height)?;
+            Ok(decoder)
+        }
+
+        /// Decodes a JPEG frame of `width` x `height` into BGRA. Returns the resolution and the pixels of the decoded frame,
+        /// which stay valid until the next call to `decode()`.
+        /// # Errors
+        /// If the frame fails to decode, this will error.
+        pub fn decode(
+            &mut self,
+            data: &[u8],
+            width: u32,
+            height: u32,
+        ) -> Result<(u32, u32, &[u8]), AVFError> {
+            if self.resolution != (width, height) {
+                self.create_session(width, height)?;
+            }
+
+            let mut block_buffer: CMBlockBufferRef = null_mut();
+            let status = unsafe {
+                // kCFAllocatorNull: the block buffer borrows `data` instead of freeing it
+                CMBlockBufferCreateWithMemoryBlock(
+                    null(),
+                    data.as_ptr() as *mut c_void,
+                    data.len(),
+                    kCFAllocatorNull,
+                    null(),
+                    0,
+                    data.len(),
+                    0,
+                    &mut block_buffer,
+                )
+            };
+            if status != 0 {
+                return Err(AVFError::DecodeFrame(format!(
+                    "CMBlockBufferCreateWithMemoryBlock: {}",
+                    status
+                )));
+            }
+
+            let sample_size = data.len();
+            let mut sample_buffer: CMSampleBufferRef = null_mut();
+            let status = unsafe {
+                CMSampleBufferCreateReady(
+                    null(),
+                    block_buffer,
+                    self.format_description,
+                    1,
+                    0,
+                    null(),
+                    1,
+                    &sample_size,
+                    &mut sample_buffer,
+                )
+            };
+            unsafe { CFRelease(block_buffer as CFTypeRef) };
+            if status != 0 {
+                return Err(AVFError::DecodeFrame(format!(
+                    "CMSampleBufferCreateReady: {}",
+                    status
+                )));
+            }
+
+            self.frame.status = 0;
+            let status = unsafe {
+                // no flags: decode synchronously, the output callback runs before this returns
+                let status = VTDecompressionSessionDecodeFrame(
+                    self.session,
+                    sample_buffer,
+                    0,
+                    null_mut(),
+                    null_mut(),
+                );
+                VTDecompressionSessionWaitForAsynchronousFrames(self.session);
+                CFRelease(sample_buffer as CFTypeRef);
+                status
+            };
+            if status != 0 || self.frame.status != 0 {
+                return Err(AVFError::DecodeFrame(format!(
+                    "VTDecompressionSessionDecodeFrame: {} {}",
+                    status, self.frame.status
+                )));
+            }
+
+            Ok((self.frame.width, self.frame.height, &self.frame.data))
+        }
+
+        fn create_session(&mut self, width: u32, height: u32) -> Result<(), AVFError> {
+            self.destroy_session();
+
+            let status = unsafe {
+                CMVideoFormatDescriptionCreate(
+                    null(),
+                    kCMVideoCodecType_JPEG,
+                    width as i32,
+                    height as i32,
+                    null(),
+                    &mut self.format_description,
+                )
+            };
+            if status != 0 {
+                self.format_description = null_mut();
+                return Err(AVFError::DecodeFrame(format!(
+                    "CMVideoFormatDescriptionCreate: {}",
+                    status
+                )));
+            }
+
+            let status = unsafe {
+                let pixel_format = kCVPixelFormatType_32BGRA as i32;
+                let pixel_format_number = CFNumberCreate(
+                    null(),
+                    kCFNumberSInt32Type,
+                    (&pixel_format as *const i32).cast(),
+                );
+                let attributes = CFDictionaryCreate(
+                    null(),
+                    &kCVPixelBufferPixelFormatTypeKey,
+                    &pixel_format_number,
+                    1,
+                    &kCFTypeDictionaryKeyCallBacks,
+                    &kCFTypeDictionaryValueCallBacks,
+                );
+                // fail instead of silently falling back to the software decoder
+                let specification = CFDictionaryCreate(
+                    null(),
+                    &kVTVideoDecoderSpecification_RequireHardwareAcceleratedVideoDecoder,
+                    &kCFBooleanTrue,
+                    1,
+                    &kCFTypeDictionaryKeyCallBacks,
+                    &kCFTypeDictionaryValueCallBacks,
+                );
+                let callback = VTDecompressionOutputCallbackRecord {
+                    decompressionOutputCallback: decompression_output_callback,
+                    decompressionOutputRefCon: (&mut *self.frame as *mut DecodedFrame).cast(),
+                };
+
+                let status = VTDecompressionSessionCreate(
+                    null(),
+                    self.format_description,
+                    specification,
+                    attributes,
+                    &callback,
+                    &mut self.session,
+                );
+
+                CFRelease(specification);
+                CFRelease(attributes);
+                CFRelease(pixel_format_number);
+                status
+            };
+            if status != 0 {
+                self.session = null_mut();
+                self.destroy_session();
+                return Err(AVFError::DecodeFrame(format!(
+                    "VTDecompressionSessionCreate: {}",
+                    status
+                )));
+            }
+
+            self.resolution = (width, height);
+            Ok(())
+        }
+
+        fn destroy_session(&mut self) {
+            unsafe {
+                if !self.session.is_null() {
+                    VTDecompressionSessionInvalidate(self.session);
+                    CFRelease(self.session as CFTypeRef);
+                    self.session = null_mut();
+                }
+                if !self.format_description.is_null() {
+                    CFRelease(self.format_description as CFTypeRef);
+                    self.format_description = null_mut();
+                }
+            }
+            self.resolution = (0, 0);
+        }
+    }
+
+    impl Drop for VideoToolboxMjpegDecoder {
+        fn drop(&mut self) {
+            self.destroy_session();
+        }
+    }
+}
+
+#[cfg(not(any(target_os = "macos", target_os = "ios")))]
+pub mod video_toolbox {
+    use crate::AVFError;
+
+    pub struct VideoToolboxMjpegDecoder {}
+
+    impl VideoToolboxMjpegDecoder {
+        pub fn new(_: u32, _: u32) -> Result<Self, AVFError> {
+            Err(AVFError::NotSupported)
+        }
+
+        pub fn decode(&mut self, _: &[u8], _: u32, _: u32) -> Result<(u32, u32, &[u8]), AVFError> {
+            Err(AVFError::NotSupported)
+        }
+    }
+}
@@ -57,6 +57,8 @@ pub enum BindingError {
     DeviceOpenFailError(String, String),
     #[error("Failed to read frame: {0}")]
     ReadFrameError(String),
+    #[error("Failed to decode frame: {0}")]
+    DecodeFrameError(String),
     #[error("Not Implemented!")]
     NotImplementedError,
 }
@@ -71,6 +73,28 @@ pub struct MFResolution {
 pub enum MFFrameFormat {
     MJPEG,
     YUYV,
+    /// A Y plane followed by an interleaved U, V plane at half resolution.
+    NV12,
+    /// A Y plane followed by a U plane and a V plane, both at half resolution.
+    I420,
+}
+
+/// The format of a frame that came out of a [`MediaFoundationMjpegDecoder`](crate::wmf::MediaFoundationMjpegDecoder).
+#[derive(Copy, Clone, Debug, PartialEq, Hash, PartialOrd, Ord, Eq)]
+pub enum MFDecodedFormat {
+    /// B, G, R, X.
+    RGB32,
+    YUY2,
+    /// A Y plane followed by an interleaved U, V plane at half resolution.
+    NV12,
+}
+
+/// A frame decoded by a [`MediaFoundationMjpegDecoder`](crate::wmf::MediaFoundationMjpegDecoder). The rows are tightly packed.
+#[derive(Copy, Clone, Debug, Hash, PartialEq)]
+pub struct MFDecodedFrame<'a> {
+    pub format: MFDecodedFormat,
+    pub resolution: MFResolution,
+    pub data: &'a [u8],
 }
 
 #[derive(Copy, Clone, Debug, Hash, PartialEq)]
@@ -363,23 +387,31 @@ impl MFControl {
 pub mod wmf {
     #![windows_subsystem = "windows"]
     use crate::{
-        BindingError, MFCameraFormat, MFControl, MFFrameFormat, MFResolution,
-        MediaFoundationControls, MediaFoundationDeviceDescriptor,
+        BindingError, MFCameraFormat, MFControl, MFDecodedFormat, MFDecodedFrame, MFFrameFormat,
+        MFResolution, MediaFoundationControls, MediaFoundationDeviceDescriptor,
     };
     use std::{
         borrow::Cow,
         cell::Cell,
+        ffi::c_void,
         mem::MaybeUninit,
         slice::from_raw_parts,
         sync::{
             atomic::{AtomicBool, AtomicUsize, Ordering},
-            Arc,
+            Arc, Condvar, Mutex, MutexGuard,
         },
+        task::{Context, Poll, Waker},
+        time::Duration,
     };
     use windows::{
-        core::{Interface, GUID},
+        core::{implement, Interface, GUID, HRESULT},
         Win32::{
-            Foundation::PWSTR,
+            Devices::DeviceAndDriverInstallation::{
+                CM_Register_Notification, CM_Unregister_Notification, CM_NOTIFY_ACTION,
+                CM_NOTIFY_EVENT_DATA, CM_NOTIFY_FILTER, CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE,
+                CR_SUCCESS, HCMNOTIFICATION,
+            },
+            Foundation::{E_POINTER, PWSTR},
             Media::{
                 DirectShow::{
                     CameraControl_Exposure, CameraControl_Focus, CameraControl_Iris,
@@ -390,19 +422,25 @@ pub mod wmf {
                     VideoProcAmp_Saturation, VideoProcAmp_Sharpness, VideoProcAmp_WhiteBalance,
                 },
                 MediaFoundation::{
-                    IMFActivate, IMFAttributes, IMFMediaSource, IMFSample, IMFSourceReader,
-                    MFCreateAttributes, MFCreateMediaType, MFCreateSourceReaderFromMediaSource,
-                    MFEnumDeviceSources, MFMediaType_Video, MFShutdown, MFStartup,
-                    MFSTARTUP_NOSOCKET, MF_API_VERSION, MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME,
+                    IMF2DBuffer2, IMFActivate, IMFAttributes, IMFMediaBuffer, IMFMediaEvent,
+                    IMFMediaEventGenerator, IMFMediaSource, IMFMediaType, IMFSample,
+                    IMFSourceReader, IMFSourceReaderCallback, IMFSourceReaderCallback_Impl,
+                    IMFTransform, MF2DBuffer_LockFlags_Read, MFCreateAttributes, MFCreateMediaType,
+                    MFCreateMemoryBuffer, MFCreateSample, MFCreateSourceReaderFromMediaSource,
+                    MFEnumDeviceSources, MFMediaType_Video, MFShutdown, MFStartup, MFTEnumEx,
+                    MFSTARTUP_NOSOCKET, MFT_MESSAGE_COMMAND_FLUSH,
+                    MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, MFT_MESSAGE_NOTIFY_END_STREAMING,
+                    MFT_MESSAGE_NOTIFY_START_OF_STREAM, MFT_OUTPUT_DATA_BUFFER,
+                    MFT_REGISTER_TYPE_INFO, MF_API_VERSION, MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME,
                     MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
                     MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID,
-                    MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_SYMBOLIC_LINK,
+                    MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_SYMBOLIC_LINK, MF_LOW_LATENCY,
                     MF_MEDIASOURCE_SERVICE, MF_MT_FRAME_RATE, MF_MT_FRAME_RATE_RANGE_MAX,
                     MF_MT_FRAME_RATE_RANGE_MIN, MF_MT_FRAME_SIZE, MF_MT_MAJOR_TYPE, MF_MT_SUBTYPE,
-                    MF_READWRITE_DISABLE_CONVERTERS,
+                    MF_READWRITE_DISABLE_CONVERTERS, MF_SOURCE_READER_ASYNC_CALLBACK,
                 },
             },
-            System::Com::{CoInitializeEx, CoUninitialize, COINIT},
+            System::Com::{CoInitializeEx, CoTaskMemFree, CoUninitialize, COINIT},
         },
     };
 
@@ -428,6 +466,18 @@ pub mod wmf {
         0x0010,
         [0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71],
     );
+    const MF_VIDEO_FORMAT_NV12: GUID = GUID::from_values(
+        0x3231_564E,
+        0x0000,
+        0x0010,
+        [0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71],
+    );
+    const MF_VIDEO_FORMAT_I420: GUID = GUID::from_values(
+        0x3032_3449,
+        0x0000,
+        0x0010,
+        [0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71],
+    );
 
     const MEDIA_FOUNDATION_FIRST_VIDEO_STREAM: u32 = 0xFFFF_FFFC;
 
@@ -566,11 +616,451 @@ pub mod wmf {
         Ok(device_list)
     }
 
+    pub type DeviceChangeCallback = Box<dyn Fn() + Send + Sync + 'static>;
+
+    // `KSCATEGORY_VIDEO_CAMERA`, the device interface class of the cameras Media Foundation enumerates
+    const KSCATEGORY_VIDEO_CAMERA: GUID = GUID::from_values(
+        0xE532_3777,
+        0xF976,
+        0x4F5B,
+        [0x9B, 0x55, 0xB9, 0x46, 0x99, 0xC4, 0x6E, 0x44],
+    );
+
+    unsafe extern "system" fn device_change_callback(
+        _: HCMNOTIFICATION,
+        context: *const c_void,
+        _: CM_NOTIFY_ACTION,
+        _: *const CM_NOTIFY_EVENT_DATA,
+        _: u32,
+    ) -> u32 {
+        // SAFETY: `context` is the callback `DeviceNotification` owns, which outlives the registration.
+        let callback = &*context.cast::<DeviceChangeCallback>();
+        callback();
+        // ERROR_SUCCESS
+        0
+    }
+
+    /// Calls a callback every time a camera is connected or disconnected (`CM_Register_Notification`), until this is dropped.
+    ///
+    /// The callback is called on a thread of the system's thread pool, it should return quickly.
+    pub struct DeviceNotification {
+        handle: HCMNOTIFICATION,
+        callback: *mut DeviceChangeCallback,
+    }
+
+    impl DeviceNotification {
+        pub fn register(callback: DeviceChangeCallback) -> Result<Self, BindingError> {
+            let callback = Box::into_raw(Box::new(callback));
+            // SAFETY: this is a plain C struct, for which all zeroes is a valid (empty) value.
+            let mut filter: CM_NOTIFY_FILTER = unsafe { std::mem::zeroed() };
+            filter.cbSize = std::mem::size_of::<CM_NOTIFY_FILTER>() as u32;
+            filter.FilterType = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+            filter.u.DeviceInterface.ClassGuid = KSCATEGORY_VIDEO_CAMERA;
+
+            let mut handle = HCMNOTIFICATION::default();
+            let result = unsafe {
+                CM_Register_Notification(
+                    &filter,
+                    callback.cast::<c_void>(),
+                    Some(device_change_callback),
+                    &mut handle,
+                )
+            };
+            if result != CR_SUCCESS {
+                // SAFETY: the registration failed, nobody else has the callback
+                drop(unsafe { Box::from_raw(callback) });
+                return Err(BindingError::EnumerateError(format!(
+                    "Failed to register for device notifications: CONFIGRET {}",
+                    result.0
+                )));
+            }
+
+            Ok(DeviceNotification { handle, callback })
+        }
+    }
+
+    impl Drop for DeviceNotification {
+        fn drop(&mut self) {
+            // waits for callbacks that are still running, after which nothing uses the callback anymore
+            unsafe {
+                CM_Unregister_Notification(self.handle);
+                drop(Box::from_raw(self.callback));
+            }
+        }
+    }
+
+    // SAFETY: The callback is `Send + Sync`, and the handle is only ever given back to `CM_Unregister_Notification`.
+    unsafe impl Send for DeviceNotification {}
+    unsafe impl Sync for DeviceNotification {}
+
+    // what the source reader's callback hands over to `MediaFoundationDevice`
+    #[derive(Default)]
+    struct SampleSlot {
+        sample: Option<(IMFSample, i64)>,
+        error: Option<String>,
+        // a `ReadSample()` is in flight
+        requested: bool,
+        waker: Option<Waker>,
+    }
+
+    // The source reader runs in async mode: `ReadSample()` returns right away, and the sample is delivered to `SampleCallback`
+    // on one of Media Foundation's work queue threads.
+    #[derive(Default)]
+    struct SampleQueue {
+        slot: Mutex<SampleSlot>,
+        ready: Condvar,
+        // Only set in low latency mode. The callback then asks for the next sample as soon as it got one, so the slot always
+        // holds the newest (replacing frames nobody took). This is a reference cycle that `stop()` breaks.
+        continuous: Mutex<Option<IMFSourceReader>>,
+    }
+
+    // SAFETY: The source reader and the samples it hands out are free threaded.
+    unsafe impl Send for SampleQueue {}
+    unsafe impl Sync for SampleQueue {}
+
+    impl SampleQueue {
+        fn slot(&self) -> MutexGuard<SampleSlot> {
+            match self.slot.lock() {
+                Ok(slot) => slot,
+                Err(poisoned) => poisoned.into_inner(),
+            }
+        }
+
+        fn set_continuous(&self, reader: Option<IMFSourceReader>) {
+            let mut continuous = match self.continuous.lock() {
+                Ok(continuous) => continuous,
+                Err(poisoned) => poisoned.into_inner(),
+            };
+            *continuous = reader;
+        }
+
+        fn continuous(&self) -> Option<IMFSourceReader> {
+            match self.continuous.lock() {
+                Ok(continuous) => continuous.clone(),
+                Err(poisoned) => poisoned.into_inner().clone(),
+            }
+        }
+
+        // Asks `reader` for the next sample, unless a request is in flight already.
+        fn request(slot: &mut SampleSlot, reader: &IMFSourceReader) -> Result<(), BindingError> {
+            if slot.requested {
+                return Ok(());
+            }
+            // in async mode, everything is handed to the callback instead
+            if let Err(why) = unsafe {
+                reader.ReadSample(
+                    MEDIA_FOUNDATION_FIRST_VIDEO_STREAM,
+                    0,
+                    std::ptr::null_mut(),
+                    std::ptr::null_mut(),
+                    std::ptr::null_mut(),
+                    std::ptr::null_mut(),
+                )
+            } {
+                return Err(BindingError::ReadFrameError(why.to_string()));
+            }
+            slot.requested = true;
+            Ok(())
+        }
+
+        // Waits for the next sample, asking `reader` for one if needed.
+        fn take(&self, reader: &IMFSourceReader) -> Result<(IMFSample, i64), BindingError> {
+            let mut slot = self.slot();
+            loop {
+                if let Some(sample) = slot.sample.take() {
+                    return Ok(sample);
+                }
+                if let Some(why) = slot.error.take() {
+                    return Err(BindingError::ReadFrameError(why));
+                }
+                Self::request(&mut slot, reader)?;
+                slot = match self.ready.wait(slot) {
+                    Ok(slot) => slot,
+                    Err(poisoned) => poisoned.into_inner(),
+                };
+            }
+        }
+
+        fn poll(
+            &self,
+            reader: &IMFSourceReader,
+            cx: &mut Context<'_>,
+        ) -> Poll<Result<(), BindingError>> {
+            let mut slot = self.slot();
+            // an error is handed out by `take()`
+            if slot.sample.is_some() || slot.error.is_some() {
+                return Poll::Ready(Ok(()));
+            }
+            if let Err(why) = Self::request(&mut slot, reader) {
+                return Poll::Ready(Err(why));
+            }
+            slot.waker = Some(cx.waker().clone());
+            Poll::Pending
+        }
+
+        // Forgets about requests made to a source reader that is flushed or replaced.
+        fn reset(&self) {
+            let mut slot = self.slot();
+            slot.sample = None;
+            slot.error = None;
+            slot.requested = false;
+        }
+
+        fn stop(&self) {
+            self.set_continuous(None);
+            self.reset();
+        }
+    }
+
+    #[implement(IMFSourceReaderCallback)]
+    struct SampleCallback {
+        queue: Arc<SampleQueue>,
+    }
+
+    #[allow(non_snake_case)]
+    impl IMFSourceReaderCallback_Impl for SampleCallback {
+        fn OnReadSample(
+            &self,
+            hrstatus: HRESULT,
+            _dwstreamindex: u32,
+            _dwstreamflags: u32,
+            lltimestamp: i64,
+            psample: &Option<IMFSample>,
+        ) -> windows::core::Result<()> {
+            let mut slot = self.queue.slot();
+            slot.requested = false;
+            match (hrstatus.ok(), psample) {
+                (Err(why), _) => slot.error = Some(why.to_string()),
+                (Ok(_), Some(sample)) => slot.sample = Some((sample.clone(), lltimestamp)),
+                // stream ticks (gaps in the stream) come without a sample, whoever waits asks again
+                (Ok(_), None) => {}
+            }
+
+            if slot.error.is_none() {
+                if let Some(reader) = self.queue.continuous() {
+                    if let Err(why) = SampleQueue::request(&mut slot, &reader) {
+                        slot.error = Some(why.to_string());
+                    }
+                }
+            }
+
+            let waker = slot.waker.take();
+            drop(slot);
+            self.queue.ready.notify_all();
+            if let Some(waker) = waker {
+                waker.wake();
+            }
+            Ok(())
+        }
+
+        fn OnFlush(&self, _dwstreamindex: u32) -> windows::core::Result<()> {
+            self.queue.slot().requested = false;
+            self.queue.ready.notify_all();
+            Ok(())
+        }
+
+        fn OnEvent(
+            &self,
+            _dwstreamindex: u32,
+            _pevent: &Option<IMFMediaEvent>,
+        ) -> windows::core::Result<()> {
+            Ok(())
+        }
+    }
+
+    /// A sample handed out by the source reader, with its buffer locked for as long as this lives.
+    /// Dropping it unlocks the buffer and gives it back to Media Foundation.
+    ///
+    /// Uncompressed frames are locked with `IMF2DBuffer2::Lock2DSize` when the buffer supports it. The buffer is then used as it is,
+    /// and [`pitch()`](MFSampleBuffer::pitch) tells the layout of its rows instead of Media Foundation copying it into a contiguous one.
+    pub struct MFSampleBuffer {
+        sample: IMFSample,
+        buffer: IMFMediaBuffer,
+        buffer_2d: Option<IMF2DBuffer2>,
+        data: *const u8,
+        len: usize,
+        pitch: Option<isize>,
+        timestamp: Option<Duration>,
+    }
+
+    impl MFSampleBuffer {
+        fn lock(
+            sample: IMFSample,
+            timestamp: i64,
+            two_dimensional: bool,
+        ) -> Result<Self, BindingError> {
+            let read_error =
+                |why: windows::core::Error| BindingError::ReadFrameError(why.to_string());
+            // only samples made of more than one buffer need to be copied into a contiguous one
+            let buffer = unsafe {
+                if sample.GetBufferCount().map_err(read_error)? == 1 {
+                    sample.GetBufferByIndex(0)
+                } else {
+                    sample.ConvertToContiguousBuffer()
+                }
+            }
+            .map_err(read_error)?;
+
+            let mut data = std::ptr::null_mut::<u8>();
+            let mut len = 0_u32;
+            let mut pitch = None;
+            let buffer_2d = if two_dimensional {
+                buffer.cast::<IMF2DBuffer2>().ok()
+            } else {
+                None
+            };
+            match &buffer_2d {
+                Some(buffer_2d) => {
+                    let mut scanline_0 = std::ptr::null_mut::<u8>();
+                    let mut stride = 0_i32;
+                    unsafe {
+                        buffer_2d.Lock2DSize(
+                            MF2DBuffer_LockFlags_Read,
+                            &mut scanline_0,
+                            &mut stride,
+                            &mut data,
+                            &mut len,
+                        )
+                    }
+                    .map_err(read_error)?;
+                    pitch = Some(stride as isize);
+                }
+                None => unsafe { buffer.Lock(&mut data, std::ptr::null_mut(), &mut len) }
+                    .map_err(read_error)?,
+            }
+
+            // from here on, dropping unlocks the buffer
+            let frame = MFSampleBuffer {
+                sample,
+                buffer,
+                buffer_2d,
+                data,
+                len: len as usize,
+                pitch,
+                timestamp: u64::try_from(timestamp)
+                    .ok()
+                    .map(|timestamp| Duration::from_nanos(timestamp.saturating_mul(100))),
+            };
+            if frame.data.is_null() {
+                return Err(BindingError::ReadFrameError(
+                    "Buffer Pointer Null".to_string(),
+                ));
+            }
+            if frame.len == 0 {
+                return Err(BindingError::ReadFrameError("No Data Size".to_string()));
+            }
+            Ok(frame)
+        }
+
+        /// The locked bytes of the buffer. If [`pitch()`](MFSampleBuffer::pitch) is `Some`, the rows may be padded or bottom-up.
+        pub fn data(&self) -> &[u8] {
+            unsafe { from_raw_parts(self.data, self.len) }
+        }
+
+        /// The distance in bytes from one row to the next, if the buffer was locked as a 2D buffer.
+        /// This is negative if the image is stored bottom-up, in which case [`data()`](MFSampleBuffer::data) starts with the last row.
+        pub fn pitch(&self) -> Option<isize> {
+            self.pitch
+        }
+
+        /// The sample time of the frame.
+        pub fn timestamp(&self) -> Option<Duration> {
+            self.timestamp
+        }
+
+        pub fn sample(&self) -> &IMFSample {
+            &self.sample
+        }
+
+        pub fn buffer(&self) -> &IMFMediaBuffer {
+            &self.buffer
+        }
+    }
+
+    impl Drop for MFSampleBuffer {
+        fn drop(&mut self) {
+            // swallow errors
+            let unlocked = unsafe {
+                match &self.buffer_2d {
+                    Some(buffer_2d) => buffer_2d.Unlock2D(),
+                    None => self.buffer.Unlock(),
+                }
+            };
+            if unlocked.is_ok() {}
+        }
+    }
+
+    fn create_source_reader(
+        index: usize,
+        media_source: &IMFMediaSource,
+        low_latency: bool,
+        queue: &Arc<SampleQueue>,
+    ) -> Result<IMFSourceReader, BindingError> {
+        let source_reader_attr: Option<IMFAttributes> = {
+            let attr = match {
+                let mut attr: Option<IMFAttributes> = None;
+
+                if let Err(why) = unsafe { MFCreateAttributes(&mut attr, 3) } {
+                    return Err(BindingError::AttributeError(why.to_string()));
+                }
+
+                attr
+            } {
+                Some(imf_attr) => imf_attr,
+                None => {
+                    return Err(BindingError::AttributeError(
+                        "Attribute Alloc Fail".to_string(),
+                    ))
+                }
+            };
+
+            if let Err(why) =
+                unsafe { attr.SetUINT32(&MF_READWRITE_DISABLE_CONVERTERS, true as u32) }
+            {
+                return Err(BindingError::AttributeError(why.to_string()));
+            }
+
+            let callback: IMFSourceReaderCallback = SampleCallback {
+                queue: queue.clone(),
+            }
+            .into();
+            if let Err(why) =
+                unsafe { attr.SetUnknown(&MF_SOURCE_READER_ASYNC_CALLBACK, &callback) }
+            {
+                return Err(BindingError::AttributeError(why.to_string()));
+            }
+
+            // stops the source reader (and the camera's driver) from buffering frames ahead
+            if low_latency {
+                if let Err(why) = unsafe { attr.SetUINT32(&MF_LOW_LATENCY, true as u32) } {
+                    return Err(BindingError::AttributeError(why.to_string()));
+                }
+            }
+
+            Some(attr)
+        };
+
+        match unsafe { MFCreateSourceReaderFromMediaSource(media_source, source_reader_attr) } {
+            Ok(sr) => Ok(sr),
+            Err(why) => Err(BindingError::DeviceOpenFailError(
+                index.to_string(),
+                why.to_string(),
+            )),
+        }
+    }
+
     pub struct MediaFoundationDevice<'a> {
         is_open: Cell<bool>,
         device_specifier: MediaFoundationDeviceDescriptor<'a>,
         device_format: MFCameraFormat,
+        media_source: IMFMediaSource,
+        low_latency: bool,
         source_reader: IMFSourceReader,
+        sample_queue: Arc<SampleQueue>,
+        // the frame `raw_bytes` lent out last, kept locked until the next one is requested
+        last_frame: Option<MFSampleBuffer>,
+        // reused between frames for frames that have to be repacked
+        frame_buffer: Vec<u8>,
     }
 
     impl<'a> MediaFoundationDevice<'a> {
@@ -596,44 +1086,8 @@ pub mod wmf {
                 }
             };
 
-            let source_reader_attr: Option<IMFAttributes> = {
-                let attr = match {
-                    let mut attr: Option<IMFAttributes> = None;
-
-                    if let Err(why) = unsafe { MFCreateAttributes(&mut attr, 3) } {
-                        return Err(BindingError::AttributeError(why.to_string()));
-                    }
-
-                    attr
-                } {
-                    Some(imf_attr) => imf_attr,
-                    None => {
-                        return Err(BindingError::AttributeError(
-                            "Attribute Alloc Fail".to_string(),
-                        ))
-                    }
-                };
-
-                if let Err(why) =
-                    unsafe { attr.SetUINT32(&MF_READWRITE_DISABLE_CONVERTERS, true as u32) }
-                {
-                    return Err(BindingError::AttributeError(why.to_string()));
-                }
-
-                Some(attr)
-            };
-
-            let source_reader = match unsafe {
-                MFCreateSourceReaderFromMediaSource(&media_source, source_reader_attr)
-            } {
-                Ok(sr) => sr,
-                Err(why) => {
-                    return Err(BindingError::DeviceOpenFailError(
-                        index.to_string(),
-                        why.to_string(),
-                    ))
-                }
-            };
+            let sample_queue = Arc::new(SampleQueue::default());
+            let source_reader = create_source_reader(index, &media_source, false, &sample_queue)?;
 
             // increment refcnt
             CAMERA_REFCNT.store(CAMERA_REFCNT.load(Ordering::SeqCst) + 1, Ordering::SeqCst);
@@ -642,7 +1096,12 @@ pub mod wmf {
                 is_open: Cell::new(false),
                 device_specifier: device_descriptor,
                 device_format: MFCameraFormat::default(),
+                media_source,
+                low_latency: false,
                 source_reader,
+                sample_queue,
+                last_frame: None,
+                frame_buffer: Vec::new(),
             })
         }
 
@@ -770,47 +1229,26 @@ pub mod wmf {
                         }
                     };
 
-                if fourcc == MF_VIDEO_FORMAT_MJPEG {
-                    if frame_rate_min != 0 {
-                        camera_format_list.push(MFCameraFormat {
-                            resolution: MFResolution {
-                                width_x: width,
-                                height_y: height,
-                            },
-                            format: MFFrameFormat::MJPEG,
-                            frame_rate: frame_rate_min,
-                        });
-                    }
-
-                    if frame_rate != 0 && frame_rate_min != frame_rate {
-                        camera_format_list.push(MFCameraFormat {
-                            resolution: MFResolution {
-                                width_x: width,
-                                height_y: height,
-                            },
-                            format: MFFrameFormat::MJPEG,
-                            frame_rate,
-                        });
-                    }
-
-                    if frame_rate_max != 0 && frame_rate != frame_rate_max {
-                        camera_format_list.push(MFCameraFormat {
-                            resolution: MFResolution {
-                                width_x: width,
-                                height_y: height,
-                            },
-                            format: MFFrameFormat::MJPEG,
-                            frame_rate: frame_rate_max,
-                        });
-                    }
+                let format = if fourcc == MF_VIDEO_FORMAT_MJPEG {
+                    Some(MFFrameFormat::MJPEG)
                 } else if fourcc == MF_VIDEO_FORMAT_YUY2 {
+                    Some(MFFrameFormat::YUYV)
+                } else if fourcc == MF_VIDEO_FORMAT_NV12 {
+                    Some(MFFrameFormat::NV12)
+                } else if fourcc == MF_VIDEO_FORMAT_I420 {
+                    Some(MFFrameFormat::I420)
+                } else {
+                    None
+                };
+
+                if let Some(format) = format {
                     if frame_rate_min != 0 {
                         camera_format_list.push(MFCameraFormat {
                             resolution: MFResolution {
                                 width_x: width,
                                 height_y: height,
                             },
-                            format: MFFrameFormat::YUYV,
+                            format,
                             frame_rate: frame_rate_min,
                         });
                     }
@@ -821,7 +1259,7 @@ pub mod wmf {
                                 width_x: width,
                                 height_y: height,
                             },
-                            format: MFFrameFormat::YUYV,
+                            format,
                             frame_rate,
                         });
                     }
@@ -832,7 +1270,7 @@ pub mod wmf {
                                 width_x: width,
                                 height_y: height,
                             },
-                            format: MFFrameFormat::YUYV,
+                            format,
                             frame_rate: frame_rate_max,
                         });
                     }
@@ -1614,6 +2052,8 @@ pub mod wmf {
             let fourcc = match format.format {
                 MFFrameFormat::MJPEG => MF_VIDEO_FORMAT_MJPEG,
                 MFFrameFormat::YUYV => MF_VIDEO_FORMAT_YUY2,
+                MFFrameFormat::NV12 => MF_VIDEO_FORMAT_NV12,
+                MFFrameFormat::I420 => MF_VIDEO_FORMAT_I420,
             };
             // setting to the new media_type
             if let Err(why) = unsafe { media_type.SetGUID(&MF_MT_MAJOR_TYPE, &MFMediaType_Video) } {
@@ -1681,6 +2121,35 @@ pub mod wmf {
             self.is_open.get()
         }
 
+        pub fn low_latency(&self) -> bool {
+            self.low_latency
+        }
+
+        /// Sets `MF_LOW_LATENCY` on the source reader. This can only be set when the source reader is created,
+        /// so it is recreated with the current format (and stream, if it is open).
+        ///
+        /// In low latency mode, a sample is always requested from the source reader, so that the newest one is handed out
+        /// (and older ones that were not taken in time are dropped). Otherwise, the next sample is requested once one is taken.
+        pub fn set_low_latency(&mut self, low_latency: bool) -> Result<(), BindingError> {
+            if self.low_latency == low_latency {
+                return Ok(());
+            }
+            self.last_frame = None;
+            self.sample_queue.stop();
+            self.source_reader = create_source_reader(
+                self.index(),
+                &self.media_source,
+                low_latency,
+                &self.sample_queue,
+            )?;
+            self.low_latency = low_latency;
+            self.set_format(self.device_format)?;
+            if self.is_open.get() {
+                self.start_stream()?;
+            }
+            Ok(())
+        }
+
         pub fn start_stream(&mut self) -> Result<(), BindingError> {
             if let Err(why) = unsafe {
                 self.source_reader
@@ -1690,118 +2159,719 @@ pub mod wmf {
                 return Err(BindingError::ReadFrameError(why.to_string()));
             }
 
+            if self.low_latency {
+                self.sample_queue
+                    .set_continuous(Some(self.source_reader.clone()));
+            }
+            // get the first sample on its way
+            SampleQueue::request(&mut self.sample_queue.slot(), &self.source_reader)?;
+
             self.is_open.set(true);
             Ok(())
         }
 
-        pub fn raw_bytes(&mut self) -> Result<Cow<'a, [u8]>, BindingError> {
-            let mut flags: u32 = 0;
-            let mut imf_sample: Option<IMFSample> = None;
+        /// Waits for the next frame and hands it out locked, without copying it.
+        pub fn frame(&mut self) -> Result<MFSampleBuffer, BindingError> {
+            let (sample, timestamp) = self.sample_queue.take(&self.source_reader)?;
+            // keep the next one coming while this one is looked at
+            SampleQueue::request(&mut self.sample_queue.slot(), &self.source_reader)?;
+            MFSampleBuffer::lock(
+                sample,
+                timestamp,
+                self.device_format.format != MFFrameFormat::MJPEG,
+            )
+        }
 
-            {
-                loop {
-                    if let Err(why) = unsafe {
-                        self.source_reader.ReadSample(
-                            MEDIA_FOUNDATION_FIRST_VIDEO_STREAM,
-                            0,
-                            std::ptr::null_mut(),
-                            &mut flags,
-                            std::ptr::null_mut(),
-                            &mut imf_sample,
-                        )
-                    } {
-                        return Err(BindingError::ReadFrameError(why.to_string()));
-                    }
+        /// Checks if a frame is waiting, so that [`frame()`](MediaFoundationDevice::frame) will not block.
+        /// If there is none, the task of `cx` is woken once the source reader delivered the next one.
+        pub fn poll_frame(&self, cx: &mut Context<'_>) -> Poll<Result<(), BindingError>> {
+            self.sample_queue.poll(&self.source_reader, cx)
+        }
+
+        pub fn raw_bytes(&mut self) -> Result<Cow<[u8]>, BindingError> {
+            self.raw_sample().map(|(data, _)| data)
+        }
 
-                    if imf_sample.is_some() {
-                        break;
+        /// Same as [`raw_bytes()`](MediaFoundationDevice::raw_bytes), but also returns the sample time of the frame.
+        ///
+        /// The data is borrowed straight from the locked buffer when its rows are tightly packed, and only repacked if they are not.
+        pub fn raw_sample(&mut self) -> Result<(Cow<[u8]>, Option<Duration>), BindingError> {
+            // unlock the last frame before waiting for the next one
+            self.last_frame = None;
+            let frame = self.frame()?;
+            let timestamp = frame.timestamp();
+
+            let format = self.device_format.format;
+            let resolution = self.device_format.resolution;
+            let packed_pitch = match format {
+                MFFrameFormat::MJPEG => None,
+                MFFrameFormat::YUYV => Some(resolution.width_x as isize * 2),
+                MFFrameFormat::NV12 | MFFrameFormat::I420 => Some(resolution.width_x as isize),
+            };
+
+            let frame = self.last_frame.insert(frame);
+            match (frame.pitch(), packed_pitch) {
+                (Some(pitch), Some(packed_pitch)) if pitch != packed_pitch => {
+                    if !pack_frame(
+                        frame.data(),
+                        format,
+                        resolution,
+                        pitch,
+                        &mut self.frame_buffer,
+                    ) {
+                        return Err(BindingError::ReadFrameError(
+                            "Buffer is smaller than the frame".to_string(),
+                        ));
                     }
+                    Ok((Cow::from(self.frame_buffer.as_slice()), timestamp))
                 }
+                _ => Ok((Cow::from(frame.data()), timestamp)),
             }
+        }
 
-            let imf_sample = match imf_sample {
-                Some(sample) => sample,
-                None => {
-                    // shouldn't happen
-                    return Err(BindingError::ReadFrameError("why".to_string()));
-                }
-            };
-
-            let buffer = match unsafe { imf_sample.ConvertToContiguousBuffer() } {
-                Ok(buf) => buf,
-                Err(why) => return Err(BindingError::ReadFrameError(why.to_string())),
+        /// Same as [`raw_sample()`](MediaFoundationDevice::raw_sample), but also returns the distance in bytes from one row of the
+        /// first plane to the next. Top-down frames are borrowed as they are, even if their rows are padded, only bottom-up frames are repacked.
+        pub fn strided_sample(
+            &mut self,
+        ) -> Result<(Cow<[u8]>, usize, Option<Duration>), BindingError> {
+            // unlock the last frame before waiting for the next one
+            self.last_frame = None;
+            let frame = self.frame()?;
+            let timestamp = frame.timestamp();
+
+            let format = self.device_format.format;
+            let resolution = self.device_format.resolution;
+            let packed_pitch = match format {
+                MFFrameFormat::MJPEG => 0,
+                MFFrameFormat::YUYV => resolution.width_x as usize * 2,
+                MFFrameFormat::NV12 | MFFrameFormat::I420 => resolution.width_x as usize,
             };
 
-            let mut buffer_valid_length = 0;
-            let mut buffer_start_ptr = std::ptr::null_mut::<u8>();
-
+            let frame = self.last_frame.insert(frame);
+            match frame.pitch() {
+                Some(pitch) if pitch > 0 => {
+                    Ok((Cow::from(frame.data()), pitch as usize, timestamp))
+                }
+                Some(pitch) => {
+                    if !pack_frame(
+                        frame.data(),
+                        format,
+                        resolution,
+                        pitch,
+                        &mut self.frame_buffer,
+                    ) {
+                        return Err(BindingError::ReadFrameError(
+                            "Buffer is smaller than the frame".to_string(),
+                        ));
+                    }
+                    Ok((
+                        Cow::from(self.frame_buffer.as_slice()),
+                        packed_pitch,
+                        timestamp,
+                    ))
+                }
+                None => Ok((Cow::from(frame.data()), packed_pitch, timestamp)),
+            }
+        }
+
+        pub fn stop_stream(&mut self) {
+            self.last_frame = None;
+            self.sample_queue.stop();
+            // swallow errors, this cancels the request in flight
+            if unsafe {
+                self.source_reader
+                    .Flush(MEDIA_FOUNDATION_FIRST_VIDEO_STREAM)
+            }
+            .is_ok()
+            {}
+            self.is_open.set(false);
+        }
+    }
+
+    impl<'a> Drop for MediaFoundationDevice<'a> {
+        fn drop(&mut self) {
+            self.last_frame = None;
+            // the callback holds on to the source reader in low latency mode
+            self.sample_queue.stop();
+            // swallow errors
+            unsafe {
+                if self
+                    .source_reader
+                    .Flush(MEDIA_FOUNDATION_FIRST_VIDEO_STREAM)
+                    .is_ok()
+                {}
+
+                // decrement refcnt
+                if CAMERA_REFCNT.load(Ordering::SeqCst) > 0 {
+                    CAMERA_REFCNT.store(CAMERA_REFCNT.load(Ordering::SeqCst) - 1, Ordering::SeqCst);
+                }
+                if CAMERA_REFCNT.load(Ordering::SeqCst) == 0 {
+                    #[allow(clippy::let_underscore_drop)]
+                    let _ = de_initialize_mf();
+                }
+            }
+        }
+    }
+
+    // See: https://docs.microsoft.com/en-us/windows/win32/medfound/mft-enum-flag
+    const MFT_ENUM_FLAG_HARDWARE: u32 = 0x0000_0004;
+    const MFT_ENUM_FLAG_SORTANDFILTER: u32 = 0x0000_0040;
+    // See: https://docs.microsoft.com/en-us/windows/win32/api/mftransform/ne-mftransform-_mft_output_stream_info_flags
+    const MFT_OUTPUT_STREAM_PROVIDES_SAMPLES: u32 = 0x0000_0100;
+    const MFT_OUTPUT_STREAM_CAN_PROVIDE_SAMPLES: u32 = 0x0000_0200;
+    // See: https://docs.microsoft.com/en-us/windows/win32/medfound/media-event-types
+    const ME_TRANSFORM_NEED_INPUT: u32 = 601;
+    const ME_TRANSFORM_HAVE_OUTPUT: u32 = 602;
+    // See: https://docs.microsoft.com/en-us/windows/win32/medfound/media-foundation-error-codes
+    const MF_E_TRANSFORM_NEED_MORE_INPUT: i32 = 0xC00D_6D72_u32 as i32;
+    const MF_E_TRANSFORM_STREAM_CHANGE: i32 = 0xC00D_6D61_u32 as i32;
+
+    const MFT_CATEGORY_VIDEO_DECODER: GUID = GUID::from_values(
+        0xD6C0_2D4B,
+        0x6833,
+        0x45B4,
+        [0x97, 0x1A, 0x05, 0xA4, 0xB0, 0x4B, 0xAB, 0x91],
+    );
+    const MF_TRANSFORM_ASYNC: GUID = GUID::from_values(
+        0xF81A_699A,
+        0x649A,
+        0x497D,
+        [0x8C, 0x73, 0x29, 0xF8, 0xFE, 0xD6, 0xAD, 0x7A],
+    );
+    const MF_TRANSFORM_ASYNC_UNLOCK: GUID = GUID::from_values(
+        0xE566_6D6B,
+        0x3422,
+        0x4EB6,
+        [0xA4, 0x21, 0xDA, 0x7D, 0xB1, 0xF8, 0xE2, 0x07],
+    );
+    const MF_MT_DEFAULT_STRIDE: GUID = GUID::from_values(
+        0x644B_4E48,
+        0x1E02,
+        0x4516,
+        [0xB0, 0xEB, 0xC0, 0x1C, 0xA9, 0xD4, 0x9A, 0xC6],
+    );
+    const MF_VIDEO_FORMAT_RGB32: GUID = GUID::from_values(
+        0x0000_0016,
+        0x0000,
+        0x0010,
+        [0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71],
+    );
+
+    /// A `MJPEG` decoder that runs on the hardware JPEG decoder `MFT` of the GPU.
+    ///
+    /// Only hardware `MFT`s are used: if there are none, [`new()`](MediaFoundationMjpegDecoder::new) errors.
+    pub struct MediaFoundationMjpegDecoder {
+        transform: IMFTransform,
+        // only set for asynchronous MFTs, which is what almost all hardware MFTs are
+        events: Option<IMFMediaEventGenerator>,
+        input_resolution: Option<MFResolution>,
+        output_format: MFDecodedFormat,
+        output_resolution: MFResolution,
+        output_stride: isize,
+        // reused between frames when the MFT does not provide its own samples
+        output_sample: Option<IMFSample>,
+        frame_buffer: Vec<u8>,
+        // events of asynchronous MFTs that arrived while waiting for the other kind
+        pending_need_input: u32,
+        pending_have_output: u32,
+    }
+
+    // SAFETY: Media Foundation objects are free threaded, and the MFT is only ever used through `&mut self`.
+    unsafe impl Send for MediaFoundationMjpegDecoder {}
+
+    impl MediaFoundationMjpegDecoder {
+        pub fn new() -> Result<Self, BindingError> {
+            initialize_mf()?;
+
+            let input_type = MFT_REGISTER_TYPE_INFO {
+                guidMajorType: MFMediaType_Video,
+                guidSubtype: MF_VIDEO_FORMAT_MJPEG,
+            };
+            let mut count: u32 = 0;
+            let mut activates: MaybeUninit<*mut Option<IMFActivate>> = MaybeUninit::uninit();
+
             if let Err(why) = unsafe {
-                buffer.Lock(
-                    &mut buffer_start_ptr,
-                    std::ptr::null_mut(),
-                    &mut buffer_valid_length,
+                MFTEnumEx(
+                    MFT_CATEGORY_VIDEO_DECODER,
+                    MFT_ENUM_FLAG_HARDWARE | MFT_ENUM_FLAG_SORTANDFILTER,
+                    &input_type,
+                    std::ptr::null(),
+                    activates.as_mut_ptr(),
+                    &mut count,
                 )
             } {
-                return Err(BindingError::ReadFrameError(why.to_string()));
+                return Err(BindingError::EnumerateError(why.to_string()));
+            }
+            // the array is ours to free, and the activates in it ours to release (which dropping them does)
+            let activates = unsafe {
+                let array = activates.assume_init();
+                let owned = (0..count as usize)
+                    .map(|idx| std::ptr::read(array.add(idx)))
+                    .collect::<Vec<Option<IMFActivate>>>();
+                CoTaskMemFree(array.cast::<c_void>());
+                owned
+            };
+            if activates.is_empty() {
+                return Err(BindingError::NotImplementedError);
             }
 
-            if buffer_start_ptr.is_null() {
-                return Err(BindingError::ReadFrameError(
-                    "Buffer Pointer Null".to_string(),
-                ));
+            // sorted by preference, take the first one that activates
+            let transform = activates
+                .iter()
+                .flatten()
+                .find_map(|activate| unsafe { activate.ActivateObject::<IMFTransform>() }.ok());
+            let transform = match transform {
+                Some(transform) => transform,
+                None => {
+                    return Err(BindingError::DeviceOpenFailError(
+                        "MJPEG Decoder MFT".to_string(),
+                        "Failed to activate".to_string(),
+                    ))
+                }
+            };
+
+            let events = match unsafe { transform.GetAttributes() } {
+                Ok(attributes)
+                    if unsafe { attributes.GetUINT32(&MF_TRANSFORM_ASYNC) }.unwrap_or(0) != 0 =>
+                {
+                    if let Err(why) =
+                        unsafe { attributes.SetUINT32(&MF_TRANSFORM_ASYNC_UNLOCK, true as u32) }
+                    {
+                        return Err(BindingError::AttributeError(why.to_string()));
+                    }
+                    match transform.cast::<IMFMediaEventGenerator>() {
+                        Ok(events) => Some(events),
+                        Err(why) => return Err(BindingError::AttributeError(why.to_string())),
+                    }
+                }
+                _ => None,
+            };
+
+            Ok(MediaFoundationMjpegDecoder {
+                transform,
+                events,
+                input_resolution: None,
+                output_format: MFDecodedFormat::RGB32,
+                output_resolution: MFResolution {
+                    width_x: 0,
+                    height_y: 0,
+                },
+                output_stride: 0,
+                output_sample: None,
+                frame_buffer: Vec::new(),
+                pending_need_input: 0,
+                pending_have_output: 0,
+            })
+        }
+
+        /// Decodes a JPEG frame of `resolution`. The decoded frame is valid until the next call to `decode()`.
+        pub fn decode(
+            &mut self,
+            data: &[u8],
+            resolution: MFResolution,
+        ) -> Result<MFDecodedFrame, BindingError> {
+            if self.input_resolution != Some(resolution) {
+                self.set_input_resolution(resolution)?;
             }
 
-            if buffer_valid_length == 0 {
-                return Err(BindingError::ReadFrameError("No Data Size".to_string()));
+            let input_sample = create_sample(data)?;
+            if self.events.is_some() {
+                self.wait_for_event(ME_TRANSFORM_NEED_INPUT)?;
+            }
+            if let Err(why) = unsafe { self.transform.ProcessInput(0, &input_sample, 0) } {
+                return Err(BindingError::DecodeFrameError(why.to_string()));
             }
 
-            let mut data_slice = Vec::with_capacity(buffer_valid_length as usize);
+            // the output type may change once the MFT has seen the first frame, in which case we try again
+            for _ in 0..2 {
+                if self.events.is_some() {
+                    self.wait_for_event(ME_TRANSFORM_HAVE_OUTPUT)?;
+                }
+                match self.process_output() {
+                    Ok(()) => {
+                        return Ok(MFDecodedFrame {
+                            format: self.output_format,
+                            resolution: self.output_resolution,
+                            data: &self.frame_buffer,
+                        })
+                    }
+                    Err(why) if why.code().0 == MF_E_TRANSFORM_STREAM_CHANGE => {
+                        self.set_output_type()?;
+                    }
+                    Err(why) if why.code().0 == MF_E_TRANSFORM_NEED_MORE_INPUT => {
+                        return Err(BindingError::DecodeFrameError(
+                            "Decoder did not output a frame".to_string(),
+                        ))
+                    }
+                    Err(why) => return Err(BindingError::DecodeFrameError(why.to_string())),
+                }
+            }
+
+            Err(BindingError::DecodeFrameError(
+                "Decoder output type keeps changing".to_string(),
+            ))
+        }
+
+        fn set_input_resolution(&mut self, resolution: MFResolution) -> Result<(), BindingError> {
+            let media_type = match unsafe { MFCreateMediaType() } {
+                Ok(mt) => mt,
+                Err(why) => return Err(BindingError::AttributeError(why.to_string())),
+            };
+            let frame_size =
+                (u64::from(resolution.width_x) << 32_u64) + u64::from(resolution.height_y);
+
+            if let Err(why) = unsafe { media_type.SetGUID(&MF_MT_MAJOR_TYPE, &MFMediaType_Video) } {
+                return Err(BindingError::GUIDSetError(
+                    "MF_MT_MAJOR_TYPE".to_string(),
+                    "MFMediaType_Video".to_string(),
+                    why.to_string(),
+                ));
+            }
+            if let Err(why) = unsafe { media_type.SetGUID(&MF_MT_SUBTYPE, &MF_VIDEO_FORMAT_MJPEG) }
+            {
+                return Err(BindingError::GUIDSetError(
+                    "MF_MT_SUBTYPE".to_string(),
+                    format!("{:?}", MF_VIDEO_FORMAT_MJPEG),
+                    why.to_string(),
+                ));
+            }
+            if let Err(why) = unsafe { media_type.SetUINT64(&MF_MT_FRAME_SIZE, frame_size) } {
+                return Err(BindingError::GUIDSetError(
+                    "MF_MT_FRAME_SIZE".to_string(),
+                    frame_size.to_string(),
+                    why.to_string(),
+                ));
+            }
 
             unsafe {
-                // Copy pointer because we're bout to drop IMFSample
-                data_slice.extend_from_slice(std::slice::from_raw_parts_mut(
-                    buffer_start_ptr,
-                    buffer_valid_length as usize,
-                ) as &[u8]);
-                // swallow errors
-                if buffer
-                    .Lock(
-                        &mut buffer_start_ptr,
-                        std::ptr::null_mut(),
-                        &mut buffer_valid_length,
-                    )
+                // swallow errors, there is nothing in flight on the first frame
+                if self
+                    .transform
+                    .ProcessMessage(MFT_MESSAGE_COMMAND_FLUSH, 0)
                     .is_ok()
                 {}
+                if let Err(why) = self.transform.SetInputType(0, &media_type, 0) {
+                    return Err(BindingError::GUIDSetError(
+                        "MFT Input Type".to_string(),
+                        format!("{:?}", media_type),
+                        why.to_string(),
+                    ));
+                }
             }
+            self.set_output_type()?;
 
-            Ok(Cow::from(data_slice))
+            unsafe {
+                if let Err(why) = self
+                    .transform
+                    .ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, 0)
+                {
+                    return Err(BindingError::DecodeFrameError(why.to_string()));
+                }
+                if let Err(why) = self
+                    .transform
+                    .ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, 0)
+                {
+                    return Err(BindingError::DecodeFrameError(why.to_string()));
+                }
+            }
+
+            self.input_resolution = Some(resolution);
+            Ok(())
         }
 
-        pub fn stop_stream(&mut self) {
-            self.is_open.set(false);
+        fn set_output_type(&mut self) -> Result<(), BindingError> {
+            // RGB32 needs no conversion at all, NV12 is the worst
+            let mut best: Option<(MFDecodedFormat, IMFMediaType)> = None;
+            let mut type_index = 0;
+            while let Ok(media_type) =
+                unsafe { self.transform.GetOutputAvailableType(0, type_index) }
+            {
+                type_index += 1;
+                let format = match unsafe { media_type.GetGUID(&MF_MT_SUBTYPE) } {
+                    Ok(subtype) if subtype == MF_VIDEO_FORMAT_RGB32 => MFDecodedFormat::RGB32,
+                    Ok(subtype) if subtype == MF_VIDEO_FORMAT_YUY2 => MFDecodedFormat::YUY2,
+                    Ok(subtype) if subtype == MF_VIDEO_FORMAT_NV12 => MFDecodedFormat::NV12,
+                    _ => continue,
+                };
+                if best
+                    .as_ref()
+                    .map_or(true, |(best_format, _)| format < *best_format)
+                {
+                    best = Some((format, media_type));
+                }
+            }
+
+            let (format, media_type) = match best {
+                Some(best) => best,
+                None => {
+                    return Err(BindingError::DecodeFrameError(
+                        "Decoder has no usable output type".to_string(),
+                    ))
+                }
+            };
+            if let Err(why) = unsafe { self.transform.SetOutputType(0, &media_type, 0) } {
+                return Err(BindingError::GUIDSetError(
+                    "MFT Output Type".to_string(),
+                    format!("{:?}", format),
+                    why.to_string(),
+                ));
+            }
+
+            let frame_size = match unsafe { media_type.GetUINT64(&MF_MT_FRAME_SIZE) } {
+                Ok(frame_size) => frame_size,
+                Err(why) => {
+                    return Err(BindingError::GUIDReadError(
+                        "MF_MT_FRAME_SIZE".to_string(),
+                        why.to_string(),
+                    ))
+                }
+            };
+            self.output_resolution = MFResolution {
+                width_x: (frame_size >> 32) as u32,
+                height_y: frame_size as u32,
+            };
+            // negative strides are bottom-up images
+            self.output_stride = match unsafe { media_type.GetUINT32(&MF_MT_DEFAULT_STRIDE) } {
+                Ok(stride) => stride as i32 as isize,
+                Err(_) => {
+                    let width = self.output_resolution.width_x as isize;
+                    match format {
+                        MFDecodedFormat::RGB32 => width * 4,
+                        MFDecodedFormat::YUY2 => width * 2,
+                        MFDecodedFormat::NV12 => width,
+                    }
+                }
+            };
+            self.output_format = format;
+            self.output_sample = None;
+            Ok(())
+        }
+
+        fn wait_for_event(&mut self, event_type: u32) -> Result<(), BindingError> {
+            let events = match &self.events {
+                Some(events) => events,
+                None => return Ok(()),
+            };
+
+            let pending = match event_type {
+                ME_TRANSFORM_NEED_INPUT => &mut self.pending_need_input,
+                _ => &mut self.pending_have_output,
+            };
+            if *pending > 0 {
+                *pending -= 1;
+                return Ok(());
+            }
+
+            loop {
+                let event = match unsafe { events.GetEvent(0) } {
+                    Ok(event) => event,
+                    Err(why) => return Err(BindingError::DecodeFrameError(why.to_string())),
+                };
+                match unsafe { event.GetType() } {
+                    Ok(received) if received == event_type => return Ok(()),
+                    // keep it for later, or we would wait for it forever
+                    Ok(ME_TRANSFORM_NEED_INPUT) => self.pending_need_input += 1,
+                    Ok(ME_TRANSFORM_HAVE_OUTPUT) => self.pending_have_output += 1,
+                    Ok(_) => {}
+                    Err(why) => return Err(BindingError::DecodeFrameError(why.to_string())),
+                }
+            }
+        }
+
+        fn process_output(&mut self) -> windows::core::Result<()> {
+            let stream_info = unsafe { self.transform.GetOutputStreamInfo(0) }?;
+            let provides_samples = stream_info.dwFlags
+                & (MFT_OUTPUT_STREAM_PROVIDES_SAMPLES | MFT_OUTPUT_STREAM_CAN_PROVIDE_SAMPLES)
+                != 0;
+
+            let sample = if provides_samples {
+                None
+            } else {
+                if self.output_sample.is_none() {
+                    let buffer = unsafe { MFCreateMemoryBuffer(stream_info.cbSize) }?;
+                    let sample = unsafe { MFCreateSample() }?;
+                    unsafe { sample.AddBuffer(&buffer) }?;
+                    self.output_sample = Some(sample);
+                }
+                self.output_sample.clone()
+            };
+
+            let mut output = [MFT_OUTPUT_DATA_BUFFER {
+                dwStreamID: 0,
+                pSample: sample,
+                dwStatus: 0,
+                pEvents: None,
+            }];
+            let mut status = 0;
+            unsafe { self.transform.ProcessOutput(0, &mut output, &mut status) }?;
+
+            let sample = match output[0].pSample.take() {
+                Some(sample) => sample,
+                None => return Err(windows::core::Error::from(E_POINTER)),
+            };
+            let buffer = unsafe { sample.ConvertToContiguousBuffer() }?;
+
+            let mut buffer_valid_length = 0;
+            let mut buffer_start_ptr = std::ptr::null_mut::<u8>();
+            unsafe {
+                buffer.Lock(
+                    &mut buffer_start_ptr,
+                    std::ptr::null_mut(),
+                    &mut buffer_valid_length,
+                )
+            }?;
+            if buffer_start_ptr.is_null() {
+                unsafe { buffer.Unlock() }?;
+                return Err(windows::core::Error::from(E_POINTER));
+            }
+
+            let data =
+                unsafe { from_raw_parts(buffer_start_ptr, buffer_valid_length as usize) as &[u8] };
+            let packed = pack_planes(
+                data,
+                self.output_format,
+                self.output_resolution,
+                self.output_stride,
+                &mut self.frame_buffer,
+            );
+            unsafe { buffer.Unlock() }?;
+
+            if packed {
+                Ok(())
+            } else {
+                Err(windows::core::Error::from(E_POINTER))
+            }
         }
     }
 
-    impl<'a> Drop for MediaFoundationDevice<'a> {
+    impl Drop for MediaFoundationMjpegDecoder {
         fn drop(&mut self) {
             // swallow errors
             unsafe {
                 if self
-                    .source_reader
-                    .Flush(MEDIA_FOUNDATION_FIRST_VIDEO_STREAM)
+                    .transform
+                    .ProcessMessage(MFT_MESSAGE_NOTIFY_END_STREAMING, 0)
                     .is_ok()
                 {}
+            }
+        }
+    }
 
-                // decrement refcnt
-                if CAMERA_REFCNT.load(Ordering::SeqCst) > 0 {
-                    CAMERA_REFCNT.store(CAMERA_REFCNT.load(Ordering::SeqCst) - 1, Ordering::SeqCst);
+    fn create_sample(data: &[u8]) -> Result<IMFSample, BindingError> {
+        let decode_error =
+            |why: windows::core::Error| BindingError::DecodeFrameError(why.to_string());
+        unsafe {
+            let buffer = MFCreateMemoryBuffer(data.len() as u32).map_err(decode_error)?;
+            let mut buffer_start_ptr = std::ptr::null_mut::<u8>();
+            buffer
+                .Lock(
+                    &mut buffer_start_ptr,
+                    std::ptr::null_mut(),
+                    std::ptr::null_mut(),
+                )
+                .map_err(decode_error)?;
+            std::ptr::copy_nonoverlapping(data.as_ptr(), buffer_start_ptr, data.len());
+            buffer.Unlock().map_err(decode_error)?;
+            buffer
+                .SetCurrentLength(data.len() as u32)
+                .map_err(decode_error)?;
+
+            let sample = MFCreateSample().map_err(decode_error)?;
+            sample.AddBuffer(&buffer).map_err(decode_error)?;
+            Ok(sample)
+        }
+    }
+
+    // same as `pack_planes()`, for the formats a camera hands out
+    fn pack_frame(
+        data: &[u8],
+        format: MFFrameFormat,
+        resolution: MFResolution,
+        stride: isize,
+        dest: &mut Vec<u8>,
+    ) -> bool {
+        match format {
+            MFFrameFormat::YUYV => {
+                pack_planes(data, MFDecodedFormat::YUY2, resolution, stride, dest)
+            }
+            MFFrameFormat::NV12 => {
+                pack_planes(data, MFDecodedFormat::NV12, resolution, stride, dest)
+            }
+            // the U and V planes have half the pitch of the Y plane
+            MFFrameFormat::I420 if stride > 0 => {
+                let width = resolution.width_x as usize;
+                let height = resolution.height_y as usize;
+                let stride = stride.unsigned_abs();
+                let planes = [
+                    (width, height, stride),
+                    (width / 2, height / 2, stride / 2),
+                    (width / 2, height / 2, stride / 2),
+                ];
+                let needed = planes
+                    .iter()
+                    .map(|(_, rows, plane_stride)| rows * plane_stride)
+                    .sum::<usize>();
+                if stride < width || data.len() < needed {
+                    return false;
                 }
-                if CAMERA_REFCNT.load(Ordering::SeqCst) == 0 {
-                    #[allow(clippy::let_underscore_drop)]
-                    let _ = de_initialize_mf();
+
+                dest.clear();
+                let mut start = 0;
+                for (row_size, rows, plane_stride) in planes {
+                    for row in 0..rows {
+                        let row_start = start + row * plane_stride;
+                        dest.extend_from_slice(&data[row_start..row_start + row_size]);
+                    }
+                    start += rows * plane_stride;
                 }
+                true
+            }
+            MFFrameFormat::I420 | MFFrameFormat::MJPEG => false,
+        }
+    }
+
+    // copies the (possibly padded, possibly bottom-up) planes of `data` into `dest` with tightly packed rows
+    fn pack_planes(
+        data: &[u8],
+        format: MFDecodedFormat,
+        resolution: MFResolution,
+        stride: isize,
+        dest: &mut Vec<u8>,
+    ) -> bool {
+        let width = resolution.width_x as usize;
+        let height = resolution.height_y as usize;
+        // (bytes per row, rows) of every plane, the planes follow each other with the same stride
+        let planes: &[(usize, usize)] = match format {
+            MFDecodedFormat::RGB32 => &[(width * 4, height)],
+            MFDecodedFormat::YUY2 => &[(width * 2, height)],
+            // the UV plane has half the rows of the Y plane
+            MFDecodedFormat::NV12 => &[(width, height), (width, height / 2)],
+        };
+        let stride_len = stride.unsigned_abs();
+        let rows = planes.iter().map(|(_, rows)| rows).sum::<usize>();
+        if height == 0
+            || stride_len < planes[0].0
+            || data.len() < stride_len * (rows - 1) + planes[0].0
+        {
+            return false;
+        }
+
+        dest.clear();
+        let mut plane_start = 0;
+        for (row_size, plane_rows) in planes.iter().copied() {
+            // a bottom-up image is bottom-up in every plane on its own, the planes stay in order
+            for row in 0..plane_rows {
+                let src_row = if stride < 0 {
+                    plane_rows - 1 - row
+                } else {
+                    row
+                };
+                let start = plane_start + src_row * stride_len;
+                dest.extend_from_slice(&data[start..start + row_size]);
             }
+            plane_start += plane_rows * stride_len;
         }
+        true
     }
 }
 
@@ -1810,10 +2880,14 @@ pub mod wmf {
 #[allow(clippy::unused_self)]
 pub mod wmf {
     use crate::{
-        BindingError, MFCameraFormat, MFControl, MediaFoundationControls,
-        MediaFoundationDeviceDescriptor,
+        BindingError, MFCameraFormat, MFControl, MFDecodedFrame, MFResolution,
+        MediaFoundationControls, MediaFoundationDeviceDescriptor,
+    };
+    use std::{
+        borrow::Cow,
+        task::{Context, Poll},
+        time::Duration,
     };
-    use std::borrow::Cow;
 
     pub fn initialize_mf() -> Result<(), BindingError> {
         Err(BindingError::NotImplementedError)
@@ -1827,6 +2901,16 @@ pub mod wmf {
         Err(BindingError::NotImplementedError)
     }
 
+    pub type DeviceChangeCallback = Box<dyn Fn() + Send + Sync + 'static>;
+
+    pub struct DeviceNotification {}
+
+    impl DeviceNotification {
+        pub fn register(_: DeviceChangeCallback) -> Result<Self, BindingError> {
+            Err(BindingError::NotImplementedError)
+        }
+    }
+
     struct Empty();
 
     pub struct MediaFoundationDevice<'a> {
@@ -1877,14 +2961,40 @@ pub mod wmf {
             false
         }
 
+        pub fn low_latency(&self) -> bool {
+            false
+        }
+
+        pub fn set_low_latency(&mut self, _low_latency: bool) -> Result<(), BindingError> {
+            Err(BindingError::NotImplementedError)
+        }
+
         pub fn start_stream(&mut self) -> Result<(), BindingError> {
             Err(BindingError::NotImplementedError)
         }
 
+        pub fn frame(&mut self) -> Result<MFSampleBuffer, BindingError> {
+            Err(BindingError::NotImplementedError)
+        }
+
+        pub fn poll_frame(&self, _cx: &mut Context<'_>) -> Poll<Result<(), BindingError>> {
+            Poll::Ready(Err(BindingError::NotImplementedError))
+        }
+
         pub fn raw_bytes(&mut self) -> Result<Cow<[u8]>, BindingError> {
             Err(BindingError::NotImplementedError)
         }
 
+        pub fn raw_sample(&mut self) -> Result<(Cow<[u8]>, Option<Duration>), BindingError> {
+            Err(BindingError::NotImplementedError)
+        }
+
+        pub fn strided_sample(
+            &mut self,
+        ) -> Result<(Cow<[u8]>, usize, Option<Duration>), BindingError> {
+            Err(BindingError::NotImplementedError)
+        }
+
         pub fn stop_stream(&mut self) {
             self.phantom = &Empty();
         }
@@ -1893,4 +3003,41 @@ pub mod wmf {
     impl<'a> Drop for MediaFoundationDevice<'a> {
         fn drop(&mut self) {}
     }
+
+    pub struct MFSampleBuffer {
+        phantom: Empty,
+    }
+
+    impl MFSampleBuffer {
+        pub fn data(&self) -> &[u8] {
+            &[]
+        }
+
+        pub fn pitch(&self) -> Option<isize> {
+            None
+        }
+
+        pub fn timestamp(&self) -> Option<Duration> {
+            None
+        }
+    }
+
+    pub struct MediaFoundationMjpegDecoder {
+        phantom: Empty,
+    }
+
+    impl MediaFoundationMjpegDecoder {
+        pub fn new() -> Result<Self, BindingError> {
+            Err(BindingError::NotImplementedError)
+        }
+
+        pub fn decode(
+            &mut self,
+            _data: &[u8],
+            _resolution: MFResolution,
+        ) -> Result<MFDecodedFrame, BindingError> {
+            self.phantom = Empty();
+            Err(BindingError::NotImplementedError)
+        }
+    }
 }
@@ -14,13 +14,14 @@
  * limitations under the License.
  */
 
-use crate::{mjpeg_to_rgb, yuyv422_to_rgb, CameraControl, CameraFormat, CameraInfo, CaptureAPIBackend, CaptureBackendTrait, ControlValueSetter, FrameFormat, KnownCameraControl, NokhwaError, PixelFormat, Resolution, nokhwa_initialize, nokhwa_check};
+use crate::{mjpeg_to_rgb, yuyv422_to_rgb, CameraControl, CameraFormat, CameraInfo, CaptureAPIBackend, CaptureBackendTrait, ControlValueSetter, FrameCounter, FrameFormat, FrameMetadata, FrameRef, KnownCameraControl, NokhwaError, PixelFormat, Resolution, nokhwa_initialize, nokhwa_check};
 use image::{ImageBuffer, Rgb};
+use crate::metrics::{self, Stage};
 use nokhwa_bindings_macos::avfoundation::{
     query_avfoundation, AVCaptureDevice, AVCaptureDeviceInput, AVCaptureSession,
-    AVCaptureVideoCallback, AVCaptureVideoDataOutput, AVFourCC,
+    AVCaptureVideoCallback, AVCaptureVideoDataOutput, AVFourCC, AVPixelBuffer,
 };
-use std::{any::Any, borrow::Borrow, borrow::Cow, collections::HashMap, ops::Deref};
+use std::{any::Any, borrow::Borrow, borrow::Cow, collections::HashMap, ops::Deref, task::{Context, Poll}};
 
 /// The backend struct that interfaces with V4L2.
 /// To see what this does, please see [`CaptureBackendTrait`].
@@ -30,6 +31,7 @@ use std::{any::Any, borrow::Borrow, borrow::Cow, collections::HashMap, ops::Dere
 /// - This only works on 64 bit platforms.
 /// - FPS adjustment does not work.
 /// - If permission has not been granted and you call `init()` it will error.
+/// - Frames are not copied out of `AVFoundation`: the last frame's pixel buffer is held until the next frame is requested or the stream is stopped.
 #[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-avfoundation")))]
 pub struct AVFoundationCaptureDevice {
     device: AVCaptureDevice,
@@ -37,8 +39,10 @@ pub struct AVFoundationCaptureDevice {
     session: Option<AVCaptureSession>,
     data_out: Option<AVCaptureVideoDataOutput>,
     data_collect: Option<AVCaptureVideoCallback>,
+    last_frame: Option<AVPixelBuffer>,
     info: CameraInfo,
     format: CameraFormat,
+    frame_counter: FrameCounter,
 }
 
 impl AVFoundationCaptureDevice {
@@ -73,8 +77,10 @@ impl AVFoundationCaptureDevice {
             session: None,
             data_out: None,
             data_collect: None,
+            last_frame: None,
             info: device_descriptor,
             format: camera_format,
+            frame_counter: FrameCounter::default(),
         })
     }
 
@@ -94,6 +100,50 @@ impl AVFoundationCaptureDevice {
     }
 }
 
+impl AVFoundationCaptureDevice {
+    fn next_frame(&mut self) -> Result<(Cow<'_, [u8]>, AVFourCC, FrameMetadata), NokhwaError> {
+        match &self.session {
+            Some(session) => {
+                if !session.is_running() {
+                    return Err(NokhwaError::ReadFrameError(
+                        "Stream Not Started".to_string(),
+                    ));
+                }
+                if session.is_interrupted() {
+                    return Err(NokhwaError::ReadFrameError(
+                        "Stream Interrupted".to_string(),
+                    ));
+                }
+            }
+            None => {
+                return Err(NokhwaError::ReadFrameError(
+                    "Stream Not Started".to_string(),
+                ))
+            }
+        }
+
+        match &self.data_collect {
+            Some(collector) => {
+                let dequeue_timer = metrics::time(Stage::Dequeue);
+                let (pixel_buffer, timing) = collector.frame_to_slice()?;
+                drop(dequeue_timer);
+                // AVFoundation tells us about every sample buffer it drops
+                let metadata = self.frame_counter.timed(
+                    timing.presentation_time,
+                    self.format.frame_rate(),
+                    Some(timing.dropped),
+                );
+                // this gives the previous pixel buffer back to AVFoundation
+                let pixel_buffer = self.last_frame.insert(pixel_buffer);
+                Ok((pixel_buffer.contiguous(), pixel_buffer.fourcc(), metadata))
+            }
+            None => Err(NokhwaError::ReadFrameError(
+                "Stream Not Started".to_string(),
+            )),
+        }
+    }
+}
+
 impl CaptureBackendTrait for AVFoundationCaptureDevice {
     fn init(&mut self) -> Result<CameraFormat, NokhwaError> {
         if !nokhwa_check() {
@@ -230,6 +280,7 @@ impl CaptureBackendTrait for AVFoundationCaptureDevice {
         self.session = Some(session);
         self.data_collect = Some(callback);
         self.data_out = Some(output);
+        self.frame_counter.reset();
         Ok(())
     }
 
@@ -247,6 +298,14 @@ impl CaptureBackendTrait for AVFoundationCaptureDevice {
         }
     }
 
+    fn poll_frame_ready(&mut self, cx: &mut Context<'_>) -> Poll<Result<(), NokhwaError>> {
+        match &self.data_collect {
+            // the delegate wakes us once it sent the next sample buffer down the pipe
+            Some(collector) => collector.poll_frame(cx).map_err(NokhwaError::from),
+            None => Poll::Ready(Ok(())),
+        }
+    }
+
     fn frame(&mut self) -> Result<ImageBuffer<Rgb<u8>, Vec<u8>>, NokhwaError> {
         let cam_fmt = self.camera_format();
         let conv = self.frame_raw()?.to_vec();
@@ -271,40 +330,20 @@ impl CaptureBackendTrait for AVFoundationCaptureDevice {
     }
 
     fn frame_raw(&mut self) -> Result<Cow<[u8]>, NokhwaError> {
-        match &self.session {
-            Some(session) => {
-                if !session.is_running() {
-                    return Err(NokhwaError::ReadFrameError(
-                        "Stream Not Started".to_string(),
-                    ));
-                }
-                if session.is_interrupted() {
-                    return Err(NokhwaError::ReadFrameError(
-                        "Stream Interrupted".to_string(),
-                    ));
-                }
-            }
-            None => {
-                return Err(NokhwaError::ReadFrameError(
-                    "Stream Not Started".to_string(),
-                ))
-            }
-        }
+        let (data, fourcc, _) = self.next_frame()?;
+        let data = match fourcc {
+            AVFourCC::YUV2 => Cow::from(yuyv422_to_rgb(data.borrow(), false)),
+            AVFourCC::MJPEG => Cow::from(mjpeg_to_rgb(data.borrow(), false)),
+            AVFourCC::GRAY8 => {}
+            // planar frames are passed through as they are, see `Buffer::planes()`
+            AVFourCC::NV12 | AVFourCC::I420 => data,
+        };
+        Ok(data)
+    }
 
-        match &self.data_collect {
-            Some(collector) => {
-                let data = collector.frame_to_slice()?;
-                let data = match data.1 {
-                    AVFourCC::YUV2 => Cow::from(yuyv422_to_rgb(data.0.borrow(), false)),
-                    AVFourCC::MJPEG => Cow::from(mjpeg_to_rgb(data.0.borrow(), false)),
-                    AVFourCC::GRAY8 => {}
-                };
-                Ok(data)
-            }
-            None => Err(NokhwaError::ReadFrameError(
-                "Stream Not Started".to_string(),
-            )),
-        }
+    fn frame_ref(&mut self) -> Result<FrameRef, NokhwaError> {
+        let (data, _, metadata) = self.next_frame()?;
+        Ok(FrameRef::new(self.format.resolution(), data, self.format.format()).with_metadata(metadata))
     }
 
     fn stop_stream(&mut self) -> Result<(), NokhwaError> {
@@ -312,6 +351,8 @@ impl CaptureBackendTrait for AVFoundationCaptureDevice {
             return Ok(());
         }
 
+        self.last_frame = None;
+
         let session = match &self.session {
             Some(session) => session,
             None => return Ok(()),
@@ -15,31 +15,84 @@
  */
 
 use crate::{
-    mjpeg_to_rgb, yuyv422_to_rgb, CameraControl, CameraFormat, CameraInfo, CaptureAPIBackend,
-    CaptureBackendTrait, FrameFormat, KnownCameraControl, NokhwaError, Resolution,
+    buf_mjpeg_to_rgb, buf_yuyv422_to_rgb, mjpeg_to_rgb, yuyv422_to_rgb, BufferPool, CameraControl,
+    CameraFormat, CameraInfo, CaptureAPIBackend, CaptureBackendTrait, DequeueMode, FrameCounter,
+    FrameFormat, FrameMetadata, FrameRef, FrameState, IoMode, KnownCameraControl, NokhwaError,
+    Resolution, StreamConfig,
 };
 use glib::Quark;
 use gstreamer::{
+    buffer::Readable,
     element_error,
     glib::Cast,
-    prelude::{DeviceExt, DeviceMonitorExt, DeviceMonitorExtManual, ElementExt, GstBinExt},
-    Bin, Caps, ClockTime, DeviceMonitor, Element, FlowError, FlowSuccess, MessageView,
-    ResourceError, State,
+    prelude::{
+        DeviceExt, DeviceMonitorExt, DeviceMonitorExtManual, ElementExt, ElementExtManual,
+        GstBinExt,
+    },
+    Bin, BufferRef, Caps, CapsRef, ClockTime, DeviceMonitor, Element, FlowError, FlowSuccess,
+    MappedBuffer, MessageView, ResourceError, State, BUFFER_OFFSET_NONE,
 };
 use gstreamer_app::{AppSink, AppSinkCallbacks};
 use gstreamer_video::{VideoFormat, VideoInfo};
 use image::{ImageBuffer, Rgb};
 use parking_lot::Mutex;
 use regex::Regex;
-use std::{any::Any, borrow::Cow, collections::HashMap, str::FromStr, sync::Arc};
+use std::{any::Any, borrow::Cow, collections::HashMap, str::FromStr, sync::Arc, time::Duration};
 
-type PipelineGenRet = (Element, AppSink, Arc<Mutex<ImageBuffer<Rgb<u8>, Vec<u8>>>>);
+type DecodedFrame = (ImageBuffer<Rgb<u8>, Vec<u8>>, SampleTiming);
+type PipelineGenRet = (Element, AppSink, Arc<Mutex<DecodedFrame>>);
+
+/// What the `appsink` of a [`GStreamerCaptureDevice`] hands out, see [`GStreamerCaptureDevice::set_sink_mode()`].
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-gst")))]
+#[derive(Copy, Clone, Debug, Hash, PartialEq, Eq, PartialOrd, Ord)]
+pub enum GStreamerSinkMode {
+    /// Every sample is decoded to RGB as it arrives, and [`frame_raw()`](CaptureBackendTrait::frame_raw) hands out a copy of the newest one.
+    DecodeRgb,
+    /// The camera's own caps (or whatever the pipeline fragment outputs) are negotiated on the `appsink`, and
+    /// [`frame_raw()`](CaptureBackendTrait::frame_raw) pulls a sample and lends out its mapped buffer, without a copy.
+    /// Nothing is decoded.
+    Native,
+}
+
+impl Default for GStreamerSinkMode {
+    fn default() -> Self {
+        GStreamerSinkMode::DecodeRgb
+    }
+}
+
+// when a sample was captured, according to its buffer
+#[derive(Copy, Clone, Debug, Default)]
+struct SampleTiming {
+    timestamp: Option<Duration>,
+    // `v4l2src` puts the driver's sequence number here
+    sequence: Option<u64>,
+}
+
+impl SampleTiming {
+    // The `PTS` is in running time, adding the base time of the pipeline gives the clock time.
+    fn of(buffer: &BufferRef, base_time: Option<ClockTime>) -> Self {
+        let timestamp = buffer
+            .pts()
+            .zip(base_time)
+            .map(|(pts, base_time)| Duration::from_nanos(pts.nseconds() + base_time.nseconds()));
+        let sequence = match buffer.offset() {
+            BUFFER_OFFSET_NONE => None,
+            offset => Some(offset),
+        };
+        SampleTiming {
+            timestamp,
+            sequence,
+        }
+    }
+}
 
 /// The backend struct that interfaces with `GStreamer`.
 /// To see what this does, please see [`CaptureBackendTrait`].
 /// # Quirks
 /// - `Drop`-ing this may cause a `panic`.
 /// - Setting controls is not supported.
+/// - `open_stream_with()` only supports [`IoMode::Mmap`]. The buffer count is the `max-buffers` of the `appsink`, [`DequeueMode::LowLatency`] turns on its `drop`.
+/// - By default, frames are decoded to RGB on `GStreamer`'s streaming thread. Use [`GStreamerSinkMode::Native`] to get the samples as they are, without a copy.
 #[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-gst")))]
 #[deprecated(
     since = "0.10",
@@ -50,8 +103,17 @@ pub struct GStreamerCaptureDevice {
     app_sink: AppSink,
     camera_format: CameraFormat,
     camera_info: CameraInfo,
-    image_lock: Arc<Mutex<ImageBuffer<Rgb<u8>, Vec<u8>>>>,
+    image_lock: Arc<Mutex<DecodedFrame>>,
     caps: Option<Caps>,
+    stream_config: StreamConfig,
+    sink_mode: GStreamerSinkMode,
+    pipeline_fragment: Option<String>,
+    // the sample `frame_raw()` lent out last in `GStreamerSinkMode::Native`
+    last_sample: Option<MappedBuffer<Readable>>,
+    // what the frame `frame_raw()` handed out last actually is, which the pipeline fragment may have changed
+    last_layout: (Resolution, FrameFormat, FrameState),
+    frame_counter: FrameCounter,
+    last_metadata: FrameMetadata,
 }
 
 impl GStreamerCaptureDevice {
@@ -126,7 +188,12 @@ impl GStreamerCaptureDevice {
             )
         };
 
-        let (pipeline, app_sink, receiver) = generate_pipeline(camera_format, index as usize)?;
+        let (pipeline, app_sink, receiver) = generate_pipeline(
+            camera_format,
+            index as usize,
+            GStreamerSinkMode::default(),
+            None,
+        )?;
 
         Ok(GStreamerCaptureDevice {
             pipeline,
@@ -135,6 +202,17 @@ impl GStreamerCaptureDevice {
             camera_info,
             image_lock: receiver,
             caps,
+            stream_config: StreamConfig::default(),
+            sink_mode: GStreamerSinkMode::default(),
+            pipeline_fragment: None,
+            last_sample: None,
+            last_layout: (
+                camera_format.resolution(),
+                camera_format.format(),
+                FrameState::Raw,
+            ),
+            frame_counter: FrameCounter::default(),
+            last_metadata: FrameMetadata::default(),
         })
     }
 
@@ -147,6 +225,60 @@ impl GStreamerCaptureDevice {
         let cam_fmt = CameraFormat::new(Resolution::new(width, height), FrameFormat::MJPEG, fps);
         GStreamerCaptureDevice::new(index, Some(cam_fmt))
     }
+
+    /// The [`GStreamerSinkMode`] of the `appsink`.
+    #[must_use]
+    pub fn sink_mode(&self) -> GStreamerSinkMode {
+        self.sink_mode
+    }
+
+    /// Sets what the `appsink` hands out. This rebuilds the pipeline (and reopens the stream, if it is open).
+    /// # Errors
+    /// If the pipeline fails to be rebuilt, this will error.
+    pub fn set_sink_mode(&mut self, sink_mode: GStreamerSinkMode) -> Result<(), NokhwaError> {
+        let last_mode = self.sink_mode;
+        self.sink_mode = sink_mode;
+        if let Err(why) = self.set_camera_format(self.camera_format) {
+            self.sink_mode = last_mode;
+            return Err(why);
+        }
+        Ok(())
+    }
+
+    /// The pipeline fragment between the camera's caps and the `appsink`, if any.
+    #[must_use]
+    pub fn pipeline_fragment(&self) -> Option<&str> {
+        self.pipeline_fragment.as_deref()
+    }
+
+    /// Puts a fragment of `gst-launch` syntax between the camera's caps and the `appsink`, e.g. `vaapijpegdec ! videoconvert ! video/x-raw,format=RGB`
+    /// to decode `MJPEG` on the GPU, or `v4l2convert` to use a hardware converter. `None` removes it.
+    /// This rebuilds the pipeline (and reopens the stream, if it is open).
+    ///
+    /// In [`GStreamerSinkMode::DecodeRgb`], the fragment has to output `YUY2`, `RGB` or `JPEG`. In [`GStreamerSinkMode::Native`],
+    /// [`frame_raw()`](CaptureBackendTrait::frame_raw) hands out whatever it outputs, regardless of [`frame_format()`](CaptureBackendTrait::frame_format).
+    /// [`frame_ref()`](CaptureBackendTrait::frame_ref) tags the frame with the format and [`FrameState`](crate::FrameState) of the caps it
+    /// actually has.
+    /// # Errors
+    /// If the pipeline fails to be built with the fragment, this will error and the last fragment is kept.
+    pub fn set_pipeline_fragment(&mut self, fragment: Option<String>) -> Result<(), NokhwaError> {
+        let last_fragment = std::mem::replace(&mut self.pipeline_fragment, fragment);
+        if let Err(why) = self.set_camera_format(self.camera_format) {
+            self.pipeline_fragment = last_fragment;
+            return Err(why);
+        }
+        Ok(())
+    }
+
+    fn count_frame(&mut self, timing: SampleTiming) {
+        self.last_metadata = match timing.sequence {
+            Some(sequence) => self.frame_counter.sequenced(sequence, timing.timestamp),
+            None => {
+                self.frame_counter
+                    .timed(timing.timestamp, self.camera_format.frame_rate(), None)
+            }
+        };
+    }
 }
 
 impl GStreamerCaptureDevice {
@@ -168,8 +300,13 @@ impl GStreamerCaptureDevice {
             self.stop_stream()?;
             reopen = true;
         }
-        let (pipeline, app_sink, receiver) =
-            generate_pipeline(new_fmt, self.camera_info.index_num()? as usize)?;
+        let (pipeline, app_sink, receiver) = generate_pipeline(
+            new_fmt,
+            self.camera_info.index_num()? as usize,
+            self.sink_mode,
+            self.pipeline_fragment.as_deref(),
+        )?;
+        self.last_sample = None;
         self.pipeline = pipeline;
         self.app_sink = app_sink;
         self.image_lock = receiver;
@@ -484,15 +621,32 @@ impl GStreamerCaptureDevice {
     }
 
     fn open_stream(&mut self) -> Result<(), NokhwaError> {
+        self.app_sink
+            .set_max_buffers(self.stream_config.buffer_count());
+        self.app_sink
+            .set_drop(self.stream_config.dequeue_mode() == DequeueMode::LowLatency);
         if let Err(why) = self.pipeline.set_state(State::Playing) {
             return Err(NokhwaError::OpenStreamError(format!(
                 "Failed to set appsink to playing: {}",
                 why
             )));
         }
+        self.frame_counter.reset();
         Ok(())
     }
 
+    fn open_stream_with(&mut self, config: StreamConfig) -> Result<(), NokhwaError> {
+        if config.io_mode() != IoMode::Mmap {
+            return Err(NokhwaError::UnsupportedOperationError(self.backend()));
+        }
+        self.stream_config = config;
+        self.open_stream()
+    }
+
+    fn stream_config(&self) -> StreamConfig {
+        self.stream_config
+    }
+
     // TODO: someone validate this
     fn is_stream_open(&self) -> bool {
         let (res, state_from, state_to) = self.pipeline.state(ClockTime::from_mseconds(16));
@@ -510,10 +664,24 @@ impl GStreamerCaptureDevice {
     }
 
     fn frame(&mut self) -> Result<ImageBuffer<Rgb<u8>, Vec<u8>>, NokhwaError> {
-        let cam_fmt = self.camera_format;
-        let image_data = self.frame_raw()?;
+        let frame = self.next_frame()?;
+        let (resolution, format, state) = self.last_layout;
+        let raw_data = match frame {
+            Some(frame) => Cow::from(frame),
+            None => self.lent_sample(),
+        };
+        let image_data = match (state, format) {
+            (FrameState::Rgb, _) => raw_data.to_vec(),
+            (FrameState::Raw, FrameFormat::MJPEG) => mjpeg_to_rgb(&raw_data, false)?,
+            (FrameState::Raw, FrameFormat::YUYV) => yuyv422_to_rgb(&raw_data, false)?,
+            _ => {
+                return Err(NokhwaError::UnsupportedOperationError(
+                    CaptureAPIBackend::GStreamer,
+                ))
+            }
+        };
         let imagebuf =
-            match ImageBuffer::from_vec(cam_fmt.width(), cam_fmt.height(), image_data.to_vec()) {
+            match ImageBuffer::from_vec(resolution.width(), resolution.height(), image_data) {
                 Some(buf) => {
                     let rgbbuf: ImageBuffer<Rgb<u8>, Vec<u8>> = buf;
                     rgbbuf
@@ -527,6 +695,15 @@ impl GStreamerCaptureDevice {
     }
 
     fn frame_raw(&mut self) -> Result<Cow<[u8]>, NokhwaError> {
+        match self.next_frame()? {
+            Some(frame) => Ok(Cow::from(frame)),
+            None => Ok(self.lent_sample()),
+        }
+    }
+
+    // Gets the next frame. In `GStreamerSinkMode::DecodeRgb` it is a copy of the newest decoded frame, in `GStreamerSinkMode::Native`
+    // it is kept in `last_sample` (see `lent_sample()`). Either way, `last_layout` says what it is.
+    fn next_frame(&mut self) -> Result<Option<Vec<u8>>, NokhwaError> {
         let bus = match self.pipeline.bus() {
             Some(bus) => bus,
             None => {
@@ -551,10 +728,82 @@ impl GStreamerCaptureDevice {
             }
         }
 
-        Ok(Cow::from(self.image_lock.lock().to_vec()))
+        match self.sink_mode {
+            GStreamerSinkMode::DecodeRgb => {
+                let (frame, timing, resolution) = {
+                    let decoded = self.image_lock.lock();
+                    (
+                        decoded.0.to_vec(),
+                        decoded.1,
+                        Resolution::new(decoded.0.width(), decoded.0.height()),
+                    )
+                };
+                self.count_frame(timing);
+                self.last_layout = (resolution, self.camera_format.format(), FrameState::Rgb);
+                Ok(Some(frame))
+            }
+            GStreamerSinkMode::Native => {
+                // give the last sample back to the pipeline before waiting for the next one
+                self.last_sample = None;
+                let sample = match self.app_sink.pull_sample() {
+                    Ok(sample) => sample,
+                    Err(why) => {
+                        return Err(NokhwaError::ReadFrameError(format!(
+                            "Failed to pull sample: {}",
+                            why
+                        )))
+                    }
+                };
+                self.last_layout = sample_layout(
+                    sample.caps(),
+                    (self.camera_format.resolution(), self.camera_format.format()),
+                );
+                let buffer = match sample.buffer_owned() {
+                    Some(buffer) => buffer,
+                    None => {
+                        return Err(NokhwaError::ReadFrameError(
+                            "Sample has no buffer!".to_string(),
+                        ))
+                    }
+                };
+                self.count_frame(SampleTiming::of(&buffer, self.pipeline.base_time()));
+                let mapped = match buffer.into_mapped_buffer_readable() {
+                    Ok(mapped) => mapped,
+                    Err(_) => {
+                        return Err(NokhwaError::ReadFrameError(
+                            "Failed to map buffer to readablemap".to_string(),
+                        ))
+                    }
+                };
+                self.last_sample = Some(mapped);
+                Ok(None)
+            }
+        }
+    }
+
+    // the mapped buffer of the sample `next_frame()` pulled last
+    fn lent_sample(&self) -> Cow<[u8]> {
+        Cow::from(
+            self.last_sample
+                .as_ref()
+                .map_or(&[][..], |sample| sample.as_slice()),
+        )
+    }
+
+    fn frame_ref(&mut self) -> Result<FrameRef, NokhwaError> {
+        let frame = self.next_frame()?;
+        let (resolution, format, state) = self.last_layout;
+        let frame = match frame {
+            Some(frame) => Cow::from(frame),
+            None => self.lent_sample(),
+        };
+        Ok(FrameRef::new(resolution, frame, format)
+            .with_state(state)
+            .with_metadata(self.last_metadata))
     }
 
     fn stop_stream(&mut self) -> Result<(), NokhwaError> {
+        self.last_sample = None;
         if let Err(why) = self.pipeline.set_state(State::Null) {
             return Err(NokhwaError::StreamShutdownError(format!(
                 "Could not change state: {}",
@@ -571,14 +820,53 @@ impl Drop for GStreamerCaptureDevice {
     }
 }
 
+// What a sample the appsink negotiated holds: its resolution, its format, and if it is decoded already. Caps that say
+// neither are taken to be the camera's `fallback` format.
+fn sample_layout(
+    caps: Option<&CapsRef>,
+    fallback: (Resolution, FrameFormat),
+) -> (Resolution, FrameFormat, FrameState) {
+    let (fallback_resolution, fallback_format) = fallback;
+    let video_info = match caps.map(VideoInfo::from_caps) {
+        Some(Ok(video_info)) => video_info,
+        _ => return (fallback_resolution, fallback_format, FrameState::Raw),
+    };
+    let resolution = Resolution::new(video_info.width(), video_info.height());
+    let jpeg = caps
+        .and_then(|caps| caps.structure(0))
+        .map_or(false, |structure| structure.has_name("image/jpeg"));
+    let (format, state) = match video_info.format() {
+        VideoFormat::Encoded if jpeg => (FrameFormat::MJPEG, FrameState::Raw),
+        VideoFormat::Yuy2 => (FrameFormat::YUYV, FrameState::Raw),
+        VideoFormat::Nv12 => (FrameFormat::NV12, FrameState::Raw),
+        VideoFormat::I420 => (FrameFormat::I420, FrameState::Raw),
+        VideoFormat::Gray8 => (FrameFormat::GRAY8, FrameState::Raw),
+        // decoded by the fragment, `FrameFormat` has no RGB of its own
+        VideoFormat::Rgb => (fallback_format, FrameState::Rgb),
+        VideoFormat::Rgba => (fallback_format, FrameState::Rgba),
+        _ => (fallback_format, FrameState::Raw),
+    };
+    (resolution, format, state)
+}
+
+// the end of the pipeline, with the user's fragment (if any) in front of the appsink
+fn appsink_fragment(fragment: Option<&str>) -> String {
+    let appsink = "appsink name=appsink async=false sync=false";
+    match fragment {
+        Some(fragment) => format!("{} ! {}", fragment, appsink),
+        None => appsink.to_string(),
+    }
+}
+
 #[cfg(target_os = "macos")]
-fn webcam_pipeline(device: &str, camera_format: CameraFormat) -> String {
+fn webcam_pipeline(device: &str, camera_format: CameraFormat, fragment: Option<&str>) -> String {
+    let sink = appsink_fragment(fragment);
     match camera_format.format() {
         FrameFormat::MJPEG => {
-            format!("autovideosrc location=/dev/video{} ! image/jpeg,width={},height={},framerate={}/1 ! appsink name=appsink async=false sync=false", device, camera_format.width(), camera_format.height(), camera_format.frame_rate())
+            format!("autovideosrc location=/dev/video{} ! image/jpeg,width={},height={},framerate={}/1 ! {}", device, camera_format.width(), camera_format.height(), camera_format.frame_rate(), sink)
         }
         FrameFormat::YUYV => {
-            format!("autovideosrc location=/dev/video{} ! video/x-raw,format=YUY2,width={},height={},framerate={}/1 ! appsink name=appsink async=false sync=false", device, camera_format.width(), camera_format.height(), camera_format.frame_rate())
+            format!("autovideosrc location=/dev/video{} ! video/x-raw,format=YUY2,width={},height={},framerate={}/1 ! {}", device, camera_format.width(), camera_format.height(), camera_format.frame_rate(), sink)
         }
         _ => {
             format!("unsupproted! if you see this, switch to something else!")
@@ -587,13 +875,21 @@ fn webcam_pipeline(device: &str, camera_format: CameraFormat) -> String {
 }
 
 #[cfg(target_os = "linux")]
-fn webcam_pipeline(device: &str, camera_format: CameraFormat) -> String {
+fn webcam_pipeline(device: &str, camera_format: CameraFormat, fragment: Option<&str>) -> String {
+    let sink = appsink_fragment(fragment);
     match camera_format.format() {
         FrameFormat::MJPEG => {
-            format!("v4l2src device=/dev/video{} ! image/jpeg, width={},height={},framerate={}/1 ! appsink name=appsink async=false sync=false", device, camera_format.width(), camera_format.height(), camera_format.frame_rate())
+            format!(
+                "v4l2src device=/dev/video{} ! image/jpeg, width={},height={},framerate={}/1 ! {}",
+                device,
+                camera_format.width(),
+                camera_format.height(),
+                camera_format.frame_rate(),
+                sink
+            )
         }
         FrameFormat::YUYV => {
-            format!("v4l2src device=/dev/video{} ! video/x-raw,format=YUY2,width={},height={},framerate={}/1 ! appsink name=appsink async=false sync=false", device, camera_format.width(), camera_format.height(), camera_format.frame_rate())
+            format!("v4l2src device=/dev/video{} ! video/x-raw,format=YUY2,width={},height={},framerate={}/1 ! {}", device, camera_format.width(), camera_format.height(), camera_format.frame_rate(), sink)
         }
         _ => {
             format!("unsupproted! if you see this, switch to something else!")
@@ -602,13 +898,21 @@ fn webcam_pipeline(device: &str, camera_format: CameraFormat) -> String {
 }
 
 #[cfg(target_os = "windows")]
-fn webcam_pipeline(device: &str, camera_format: CameraFormat) -> String {
+fn webcam_pipeline(device: &str, camera_format: CameraFormat, fragment: Option<&str>) -> String {
+    let sink = appsink_fragment(fragment);
     match camera_format.format() {
         FrameFormat::MJPEG => {
-            format!("ksvideosrc device_index={} ! image/jpeg, width={},height={},framerate={}/1 ! appsink name=appsink async=false sync=false", device, camera_format.width(), camera_format.height(), camera_format.frame_rate())
+            format!(
+                "ksvideosrc device_index={} ! image/jpeg, width={},height={},framerate={}/1 ! {}",
+                device,
+                camera_format.width(),
+                camera_format.height(),
+                camera_format.frame_rate(),
+                sink
+            )
         }
         FrameFormat::YUYV => {
-            format!("ksvideosrc device_index={} ! video/x-raw,format=YUY2,width={},height={},framerate={}/1 ! appsink name=appsink async=false sync=false", device, camera_format.width(), camera_format.height(), camera_format.frame_rate())
+            format!("ksvideosrc device_index={} ! video/x-raw,format=YUY2,width={},height={},framerate={}/1 ! {}", device, camera_format.width(), camera_format.height(), camera_format.frame_rate(), sink)
         }
         _ => {
             format!("unsupproted! if you see this, switch to something else!")
@@ -618,22 +922,25 @@ fn webcam_pipeline(device: &str, camera_format: CameraFormat) -> String {
 
 #[allow(clippy::too_many_lines)]
 #[allow(clippy::let_and_return)]
-fn generate_pipeline(fmt: CameraFormat, index: usize) -> Result<PipelineGenRet, NokhwaError> {
-    let pipeline =
-        match gstreamer::parse_launch(webcam_pipeline(format!("{}", index).as_str(), fmt).as_str())
-        {
-            Ok(p) => p,
-            Err(why) => {
-                return Err(NokhwaError::OpenDeviceError(
-                    index.to_string(),
-                    format!(
-                        "Failed to open pipeline with args {}: {}",
-                        webcam_pipeline(format!("{}", index).as_str(), fmt),
-                        why
-                    ),
-                ))
-            }
-        };
+fn generate_pipeline(
+    fmt: CameraFormat,
+    index: usize,
+    sink_mode: GStreamerSinkMode,
+    fragment: Option<&str>,
+) -> Result<PipelineGenRet, NokhwaError> {
+    let pipeline_description = webcam_pipeline(format!("{}", index).as_str(), fmt, fragment);
+    let pipeline = match gstreamer::parse_launch(pipeline_description.as_str()) {
+        Ok(p) => p,
+        Err(why) => {
+            return Err(NokhwaError::OpenDeviceError(
+                index.to_string(),
+                format!(
+                    "Failed to open pipeline with args {}: {}",
+                    pipeline_description, why
+                ),
+            ))
+        }
+    };
 
     let sink = match pipeline
         .clone()
@@ -662,8 +969,17 @@ fn generate_pipeline(fmt: CameraFormat, index: usize) -> Result<PipelineGenRet,
 
     pipeline.set_state(State::Playing).unwrap();
 
-    let image_lock = Arc::new(Mutex::new(ImageBuffer::default()));
+    let image_lock = Arc::new(Mutex::new((
+        ImageBuffer::default(),
+        SampleTiming::default(),
+    )));
+    // the samples stay queued in the appsink, `frame_raw()` pulls them itself
+    if sink_mode == GStreamerSinkMode::Native {
+        return Ok((pipeline, appsink, image_lock));
+    }
+
     let img_lck_clone = image_lock.clone();
+    let buffer_pool = BufferPool::default();
 
     appsink.set_callbacks(
         AppSinkCallbacks::builder()
@@ -717,109 +1033,25 @@ fn generate_pipeline(fmt: CameraFormat, index: usize) -> Result<PipelineGenRet,
                     }
                 };
 
-                let channels = if video_info.has_alpha() { 4 } else { 3 };
+                // decode straight into a recycled buffer instead of allocating a new one every frame
+                let mut decoded_buffer =
+                    buffer_pool.take((video_info.width() * video_info.height() * 3) as usize);
 
-                let image_buffer = match video_info.format() {
+                let decode_result = match video_info.format() {
                     VideoFormat::Yuy2 => {
-                        let mut decoded_buffer = match yuyv422_to_rgb(&buffer_map, false) {
-                            Ok(buf) => buf,
-                            Err(why) => {
-                                element_error!(
-                                    appsink,
-                                    ResourceError::Failed,
-                                    (format!("Failed to make yuy2 into rgb888: {}", why).as_str())
-                                );
-
-                                return Err(FlowError::Error);
-                            }
-                        };
-
-                        decoded_buffer.resize(
-                            (video_info.width() * video_info.height() * channels) as usize,
-                            0_u8,
-                        );
-
-                        let image = if let Some(i) = ImageBuffer::from_vec(
-                            video_info.width(),
-                            video_info.height(),
-                            decoded_buffer,
-                        ) {
-                            let rgb: ImageBuffer<Rgb<u8>, Vec<u8>> = i;
-                            rgb
-                        } else {
-                            element_error!(
-                                appsink,
-                                ResourceError::Failed,
-                                ("Failed to make rgb buffer into imagebuffer")
-                            );
-
-                            return Err(FlowError::Error);
-                        };
-                        image
+                        buf_yuyv422_to_rgb(&buffer_map, &mut decoded_buffer, false)
                     }
                     VideoFormat::Rgb => {
-                        let mut decoded_buffer = buffer_map.as_slice().to_vec();
-                        decoded_buffer.resize(
-                            (video_info.width() * video_info.height() * channels) as usize,
-                            0_u8,
-                        );
-                        let image = if let Some(i) = ImageBuffer::from_vec(
-                            video_info.width(),
-                            video_info.height(),
-                            decoded_buffer,
-                        ) {
-                            let rgb: ImageBuffer<Rgb<u8>, Vec<u8>> = i;
-                            rgb
-                        } else {
-                            element_error!(
-                                appsink,
-                                ResourceError::Failed,
-                                ("Failed to make rgb buffer into imagebuffer")
-                            );
-
-                            return Err(FlowError::Error);
-                        };
-                        image
+                        let copy_len = decoded_buffer.len().min(buffer_map.len());
+                        decoded_buffer[..copy_len].copy_from_slice(&buffer_map[..copy_len]);
+                        Ok(())
                     }
                     // MJPEG
                     VideoFormat::Encoded => {
-                        let mut decoded_buffer = match mjpeg_to_rgb(&buffer_map, false) {
-                            Ok(buf) => buf,
-                            Err(why) => {
-                                element_error!(
-                                    appsink,
-                                    ResourceError::Failed,
-                                    (format!("Failed to make yuy2 into rgb888: {}", why).as_str())
-                                );
-
-                                return Err(FlowError::Error);
-                            }
-                        };
-
-                        decoded_buffer.resize(
-                            (video_info.width() * video_info.height() * channels) as usize,
-                            0_u8,
-                        );
-
-                        let image = if let Some(i) = ImageBuffer::from_vec(
-                            video_info.width(),
-                            video_info.height(),
-                            decoded_buffer,
-                        ) {
-                            let rgb: ImageBuffer<Rgb<u8>, Vec<u8>> = i;
-                            rgb
-                        } else {
-                            element_error!(
-                                appsink,
-                                ResourceError::Failed,
-                                ("Failed to make rgb buffer into imagebuffer")
-                            );
-
-                            return Err(FlowError::Error);
-                        };
-                        image
+                        buf_mjpeg_to_rgb(&buffer_map, &mut decoded_buffer, false)
                     }
                     _ => {
+                        buffer_pool.recycle(decoded_buffer);
                         element_error!(
                             appsink,
                             ResourceError::Failed,
@@ -829,7 +1061,40 @@ fn generate_pipeline(fmt: CameraFormat, index: usize) -> Result<PipelineGenRet,
                     }
                 };
 
-                *img_lck_clone.lock() = image_buffer;
+                if let Err(why) = decode_result {
+                    buffer_pool.recycle(decoded_buffer);
+                    element_error!(
+                        appsink,
+                        ResourceError::Failed,
+                        (format!(
+                            "Failed to make {} into rgb888: {}",
+                            video_info.format(),
+                            why
+                        )
+                        .as_str())
+                    );
+
+                    return Err(FlowError::Error);
+                }
+
+                let image_buffer: ImageBuffer<Rgb<u8>, Vec<u8>> = if let Some(i) =
+                    ImageBuffer::from_vec(video_info.width(), video_info.height(), decoded_buffer)
+                {
+                    i
+                } else {
+                    element_error!(
+                        appsink,
+                        ResourceError::Failed,
+                        ("Failed to make rgb buffer into imagebuffer")
+                    );
+
+                    return Err(FlowError::Error);
+                };
+
+                let timing = SampleTiming::of(buffer, appsink.base_time());
+                let (last_image, _) =
+                    std::mem::replace(&mut *img_lck_clone.lock(), (image_buffer, timing));
+                buffer_pool.recycle(last_image.into_raw());
 
                 Ok(FlowSuccess::Ok)
             })
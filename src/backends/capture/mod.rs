@@ -66,12 +66,22 @@ pub use uvc_backend::UVCCaptureDevice;
 mod gst_backend;
 #[cfg(feature = "input-gst")]
 #[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-gst")))]
-pub use gst_backend::GStreamerCaptureDevice;
+pub use gst_backend::{GStreamerCaptureDevice, GStreamerSinkMode};
 #[cfg(feature = "input-jscam")]
 mod browser_backend;
 #[cfg(feature = "input-jscam")]
 #[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-jscam")))]
 pub use browser_backend::BrowserCaptureDevice;
+#[cfg(feature = "recording")]
+mod replay_backend;
+#[cfg(feature = "recording")]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "recording")))]
+pub use replay_backend::{ReplayCaptureDevice, ReplayRate};
+#[cfg(feature = "input-network")]
+mod network_backend;
+#[cfg(feature = "input-network")]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-network")))]
+pub use network_backend::{ConnectionState, NetworkCaptureDevice, ReconnectPolicy};
 #[cfg(feature = "input-opencv")]
 mod opencv_backend;
 #[cfg(feature = "input-opencv")]
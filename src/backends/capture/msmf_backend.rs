@@ -15,13 +15,20 @@
  */
 
 use crate::{
-    all_known_camera_controls, mjpeg_to_rgb, yuyv422_to_rgb, CameraControl, CameraFormat,
-    CameraInfo, CaptureAPIBackend, CaptureBackendTrait, FrameFormat, KnownCameraControl,
-    KnownCameraControlFlag, NokhwaError, Resolution,
+    all_known_camera_controls,
+    metrics::{self, Stage},
+    mjpeg_to_rgb, yuyv422_to_rgb, Buffer, CameraControl, CameraFormat, CameraInfo,
+    CaptureAPIBackend, CaptureBackendTrait, DequeueMode, FrameCounter, FrameFormat, FrameMetadata,
+    FrameRef, FrameState, IoMode, KnownCameraControl, KnownCameraControlFlag, NokhwaError,
+    Resolution, StreamConfig,
 };
-use image::{ImageBuffer, Rgb};
 use nokhwa_bindings_windows::{wmf::MediaFoundationDevice, MFControl, MediaFoundationControls};
-use std::{any::Any, borrow::Cow, collections::HashMap};
+use std::{
+    any::Any,
+    borrow::Cow,
+    collections::HashMap,
+    task::{Context, Poll},
+};
 
 /// The backend that deals with Media Foundation on Windows.
 /// To see what this does, please see [`CaptureBackendTrait`].
@@ -34,10 +41,14 @@ use std::{any::Any, borrow::Cow, collections::HashMap};
 /// - The symbolic link for the device is listed in the `misc` attribute of the [`CameraInfo`].
 /// - The names may contain invalid characters since they were converted from UTF16.
 /// - When you call new or drop the struct, `initialize`/`de_initialize` will automatically be called.
+/// - [`open_stream_with()`](CaptureBackendTrait::open_stream_with) only supports [`IoMode::Mmap`]. Media Foundation picks its own amount of buffers, [`DequeueMode::LowLatency`] sets `MF_LOW_LATENCY`.
+/// - The source reader runs asynchronously. The last frame's buffer stays locked until the next frame is requested or the stream is stopped.
 #[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-msmf")))]
 pub struct MediaFoundationCaptureDevice<'a> {
     inner: MediaFoundationDevice<'a>,
     info: CameraInfo,
+    frame_counter: FrameCounter,
+    stream_config: StreamConfig,
 }
 
 impl<'a> MediaFoundationCaptureDevice<'a> {
@@ -60,6 +71,8 @@ impl<'a> MediaFoundationCaptureDevice<'a> {
         Ok(MediaFoundationCaptureDevice {
             inner: mf_device,
             info,
+            frame_counter: FrameCounter::default(),
+            stream_config: StreamConfig::default(),
         })
     }
 
@@ -78,6 +91,30 @@ impl<'a> MediaFoundationCaptureDevice<'a> {
     }
 }
 
+impl<'a> MediaFoundationCaptureDevice<'a> {
+    fn next_frame(&mut self) -> Result<(Cow<[u8]>, FrameMetadata), NokhwaError> {
+        let frame_rate = self.camera_format().frame_rate();
+        let (data, timestamp) = {
+            let _timer = metrics::time(Stage::Dequeue);
+            self.inner.raw_sample()?
+        };
+        // the source reader does not number its samples
+        let metadata = self.frame_counter.timed(timestamp, frame_rate, None);
+        Ok((data, metadata))
+    }
+
+    // same as `next_frame()`, without packing padded rows, along with the stride of the first plane
+    fn next_strided_frame(&mut self) -> Result<(Cow<[u8]>, usize, FrameMetadata), NokhwaError> {
+        let frame_rate = self.camera_format().frame_rate();
+        let (data, stride, timestamp) = {
+            let _timer = metrics::time(Stage::Dequeue);
+            self.inner.strided_sample()?
+        };
+        let metadata = self.frame_counter.timed(timestamp, frame_rate, None);
+        Ok((data, stride, metadata))
+    }
+}
+
 impl<'a> CaptureBackendTrait for MediaFoundationCaptureDevice<'a> {
     fn backend(&self) -> CaptureAPIBackend {
         CaptureAPIBackend::MediaFoundation
@@ -327,42 +364,87 @@ impl<'a> CaptureBackendTrait for MediaFoundationCaptureDevice<'a> {
         if let Err(why) = self.inner.start_stream() {
             return Err(why.into());
         }
+        self.frame_counter.reset();
 
         Ok(())
     }
 
+    fn open_stream_with(&mut self, config: StreamConfig) -> Result<(), NokhwaError> {
+        if config.io_mode() != IoMode::Mmap {
+            return Err(NokhwaError::UnsupportedOperationError(self.backend()));
+        }
+        self.inner
+            .set_low_latency(config.dequeue_mode() == DequeueMode::LowLatency)?;
+        self.stream_config = config;
+        self.open_stream()
+    }
+
+    fn stream_config(&self) -> StreamConfig {
+        self.stream_config
+    }
+
     fn is_stream_open(&self) -> bool {
         self.inner.is_stream_open()
     }
 
-    fn frame(&mut self) -> Result<ImageBuffer<Rgb<u8>, Vec<u8>>, NokhwaError> {
+    fn frame(&mut self) -> Result<Buffer, NokhwaError> {
         let camera_format = self.camera_format();
-        let raw_data = self.frame_raw()?;
-        let conv = match camera_format.format() {
-            FrameFormat::MJPEG => mjpeg_to_rgb(raw_data.as_ref(), false)?,
-            FrameFormat::YUYV => yuyv422_to_rgb(raw_data.as_ref(), false)?,
-        };
+        let resolution = camera_format.resolution();
+        match camera_format.format() {
+            FrameFormat::MJPEG | FrameFormat::YUYV => {
+                let (raw_data, metadata) = self.next_frame()?;
+                let conv = match camera_format.format() {
+                    FrameFormat::MJPEG => mjpeg_to_rgb(raw_data.as_ref(), false)?,
+                    _ => yuyv422_to_rgb(raw_data.as_ref(), false)?,
+                };
+                Ok(Buffer::new(resolution, conv, camera_format.format())
+                    .with_state(FrameState::Rgb)
+                    .with_metadata(metadata))
+            }
+            // planar frames are passed through as they are, with the stride of the sample, see `Buffer::planes()`
+            format => {
+                let (raw_data, stride, metadata) = self.next_strided_frame()?;
+                let strides = match format {
+                    FrameFormat::NV12 => [stride, stride, 0],
+                    FrameFormat::I420 => [stride, stride / 2, stride / 2],
+                    _ => [stride, 0, 0],
+                };
+                Ok(
+                    Buffer::with_strides(resolution, raw_data.to_vec(), format, &strides)?
+                        .with_metadata(metadata),
+                )
+            }
+        }
+    }
 
-        let imagebuf =
-            match ImageBuffer::from_vec(camera_format.width(), camera_format.height(), conv) {
-                Some(buf) => {
-                    let rgbbuf: ImageBuffer<Rgb<u8>, Vec<u8>> = buf;
-                    rgbbuf
-                }
-                None => return Err(NokhwaError::ReadFrameError(
-                    "Imagebuffer is not large enough! This is probably a bug, please report it!"
-                        .to_string(),
-                )),
-            };
+    fn frame_raw(&mut self) -> Result<Cow<[u8]>, NokhwaError> {
+        Ok(self.next_frame()?.0)
+    }
 
-        Ok(imagebuf)
+    fn frame_ref(&mut self) -> Result<FrameRef, NokhwaError> {
+        let camera_format = self.camera_format();
+        let resolution = camera_format.resolution();
+        let frame = match camera_format.format() {
+            format @ (FrameFormat::MJPEG | FrameFormat::YUYV) => {
+                let (data, metadata) = self.next_frame()?;
+                FrameRef::new(resolution, data, format).with_metadata(metadata)
+            }
+            // with the stride of the sample, like `frame()`
+            format => {
+                let (data, stride, metadata) = self.next_strided_frame()?;
+                let strides = match format {
+                    FrameFormat::NV12 => [stride, stride, 0],
+                    FrameFormat::I420 => [stride, stride / 2, stride / 2],
+                    _ => [stride, 0, 0],
+                };
+                FrameRef::with_strides(resolution, data, format, &strides)?.with_metadata(metadata)
+            }
+        };
+        Ok(frame)
     }
 
-    fn frame_raw(&mut self) -> Result<Cow<[u8]>, NokhwaError> {
-        match self.inner.raw_bytes() {
-            Ok(data) => Ok(data),
-            Err(why) => Err(why.into()),
-        }
+    fn poll_frame_ready(&mut self, cx: &mut Context<'_>) -> Poll<Result<(), NokhwaError>> {
+        self.inner.poll_frame(cx).map_err(NokhwaError::from)
     }
 
     fn stop_stream(&mut self) -> Result<(), NokhwaError> {
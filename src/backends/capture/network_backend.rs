@@ -0,0 +1,1633 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+use crate::{
+    metrics::{self, Stage},
+    mjpeg_to_rgb, Buffer, CameraControl, CameraFormat, CameraInfo, CaptureAPIBackend,
+    CaptureBackendTrait, ControlValueSetter, DequeueMode, FrameCounter, FrameFormat, FrameMetadata,
+    FrameRef, FrameState, KnownCameraControl, NokhwaError, Resolution, StreamConfig,
+};
+use std::{
+    borrow::Cow,
+    collections::{HashMap, VecDeque},
+    io::{BufRead, BufReader, Read, Write},
+    net::{Shutdown, TcpStream, ToSocketAddrs},
+    sync::{
+        atomic::{AtomicBool, Ordering},
+        Arc, Condvar, Mutex, MutexGuard,
+    },
+    task::{Context, Poll, Waker},
+    thread::JoinHandle,
+    time::{Duration, Instant},
+};
+
+/// How a [`NetworkCaptureDevice`] reconnects once its stream is lost.
+///
+/// The delay between attempts starts at [`initial_delay()`](ReconnectPolicy::initial_delay) and doubles after every failed attempt,
+/// up to [`max_delay()`](ReconnectPolicy::max_delay). It starts over once a connection delivers a frame.
+#[derive(Copy, Clone, Debug, Hash, PartialEq, Eq, PartialOrd, Ord)]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-network")))]
+pub struct ReconnectPolicy {
+    initial_delay: Duration,
+    max_delay: Duration,
+    max_attempts: Option<u32>,
+    stall_timeout: Duration,
+    max_frame_size: usize,
+}
+
+// the default `ReconnectPolicy::max_frame_size()`, room for a 4K frame that barely compresses
+const DEFAULT_MAX_FRAME_SIZE: usize = 3840 * 2160 * 3;
+
+// the longest status or header line that is accepted
+const MAX_LINE_LENGTH: usize = 8 * 1024;
+// the most headers a response (or the part of a multipart stream) can have
+const MAX_HEADERS: usize = 100;
+// the largest body of an RTSP response (e.g. the session description)
+const MAX_BODY_LENGTH: usize = 64 * 1024;
+
+impl ReconnectPolicy {
+    /// Creates a new [`ReconnectPolicy`] that waits `initial_delay` before the first attempt, doubling up to `max_delay`, and never gives up.
+    #[must_use]
+    pub fn new(initial_delay: Duration, max_delay: Duration) -> Self {
+        ReconnectPolicy {
+            initial_delay,
+            max_delay: max_delay.max(initial_delay),
+            max_attempts: None,
+            stall_timeout: Duration::from_secs(5),
+            max_frame_size: DEFAULT_MAX_FRAME_SIZE,
+        }
+    }
+
+    /// The delay before the first attempt to reconnect.
+    #[must_use]
+    pub fn initial_delay(&self) -> Duration {
+        self.initial_delay
+    }
+
+    /// The longest the delay between attempts gets.
+    #[must_use]
+    pub fn max_delay(&self) -> Duration {
+        self.max_delay
+    }
+
+    /// How many attempts in a row can fail before the device gives up (see [`ConnectionState::Failed`]), or `None` to never give up.
+    #[must_use]
+    pub fn max_attempts(&self) -> Option<u32> {
+        self.max_attempts
+    }
+
+    /// Sets how many attempts in a row can fail before the device gives up, or `None` to never give up.
+    pub fn set_max_attempts(&mut self, max_attempts: Option<u32>) {
+        self.max_attempts = max_attempts;
+    }
+
+    /// How long connecting or reading can stall before the connection is considered lost. This is also the longest getting a frame blocks.
+    #[must_use]
+    pub fn stall_timeout(&self) -> Duration {
+        self.stall_timeout
+    }
+
+    /// Sets how long connecting or reading can stall before the connection is considered lost.
+    pub fn set_stall_timeout(&mut self, stall_timeout: Duration) {
+        self.stall_timeout = stall_timeout.max(Duration::from_millis(1));
+    }
+
+    /// The largest frame, in bytes, a camera can send (by default `3840 * 2160 * 3`). A larger one (or a header line longer than 8KiB)
+    /// is considered a broken connection, so a misbehaving camera cannot make the device allocate without bound.
+    #[must_use]
+    pub fn max_frame_size(&self) -> usize {
+        self.max_frame_size
+    }
+
+    /// Sets the largest frame, in bytes, a camera can send.
+    pub fn set_max_frame_size(&mut self, max_frame_size: usize) {
+        self.max_frame_size = max_frame_size.max(1);
+    }
+}
+
+impl Default for ReconnectPolicy {
+    fn default() -> Self {
+        ReconnectPolicy::new(Duration::from_millis(250), Duration::from_secs(30))
+    }
+}
+
+/// The connection of a [`NetworkCaptureDevice`] to its camera, see [`NetworkCaptureDevice::connection_state()`].
+#[derive(Clone, Debug, Hash, PartialEq, Eq, PartialOrd, Ord)]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-network")))]
+pub enum ConnectionState {
+    /// The stream is not open.
+    Closed,
+    /// Connecting for the first time.
+    Connecting,
+    /// Connected, frames are coming in.
+    Connected,
+    /// The connection was lost (or could not be made), this is the `attempt`th time in a row it is being made again.
+    Reconnecting {
+        /// How many attempts in a row failed.
+        attempt: u32,
+        /// Why the last connection was lost.
+        error: String,
+    },
+    /// The [`ReconnectPolicy::max_attempts()`] failed. Getting a frame errors, open the stream again to start over.
+    Failed(String),
+}
+
+/// A native backend for IP cameras, reading MJPEG over HTTP (`multipart/x-mixed-replace`) and RTSP streams of RTP/JPEG ([RFC 2435](https://datatracker.ietf.org/doc/html/rfc2435)).
+///
+/// Each device has one thread that only does network I/O: it reassembles the JPEG frames into a bounded jitter buffer of
+/// [`StreamConfig::buffer_count()`] frames, and reconnects with backoff (see [`ReconnectPolicy`]) whenever the stream is lost.
+/// Frames are handed out compressed, as they came from the camera: [`frame_raw()`](CaptureBackendTrait::frame_raw()) and
+/// [`frame_ref()`](CaptureBackendTrait::frame_ref()) borrow the buffer the frame was received into, which is reused once the next frame is taken,
+/// so no frame is copied or decoded unless [`frame()`](CaptureBackendTrait::frame()) is called. This makes it cheap to run many cameras and
+/// decode their frames on a pool of your own.
+///
+/// To see what this does, please see [`CaptureBackendTrait`].
+/// # Quirks
+/// - URLs are `http://[user:password@]host[:port]/path` or `rtsp://[user:password@]host[:port]/path`. Credentials are sent as `Basic` authentication, `Digest` is not supported.
+/// - RTSP is always played over the RTSP connection (interleaved TCP, no UDP), and only JPEG video (payload type 26) is supported. H.264/H.265 streams are rejected.
+/// - The [`CameraFormat`] is always [`FrameFormat::MJPEG`] and cannot be changed. Its resolution follows the frames, its frame rate is the one the RTSP
+///   server announces (or 30 if it does not).
+/// - Frame timestamps are when the frame was received, relative to when the first network camera of the process was created, so the timestamps
+///   of different network cameras can be compared. Frames dropped because the jitter buffer was full, or because a part of them was lost, count
+///   as dropped in their [`FrameMetadata`].
+/// - Every device has a reader thread of its own (with a small stack), they are not multiplexed onto a shared reactor. Running a lot of cameras
+///   means running as many threads.
+/// - [`DequeueMode::LowLatency`] hands out only the newest frame in the jitter buffer.
+/// - There are no camera controls.
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-network")))]
+pub struct NetworkCaptureDevice {
+    camera_info: CameraInfo,
+    url: StreamUrl,
+    policy: ReconnectPolicy,
+    camera_format: CameraFormat,
+    stream_config: StreamConfig,
+    shared: Arc<Shared>,
+    reader: Option<JoinHandle<()>>,
+    // the connection made by `new()`, handed to the reader thread once the stream is opened
+    probe: Option<Session>,
+    // the frame handed out last
+    frame: Vec<u8>,
+    metadata: FrameMetadata,
+    frame_counter: FrameCounter,
+}
+
+impl NetworkCaptureDevice {
+    /// Connects to the MJPEG or RTSP stream at `url`, reconnecting with the default [`ReconnectPolicy`].
+    /// # Errors
+    /// If the URL is invalid, the camera cannot be reached, or its stream is not MJPEG, this will error.
+    pub fn new(url: &str) -> Result<Self, NokhwaError> {
+        NetworkCaptureDevice::with_policy(url, ReconnectPolicy::default())
+    }
+
+    /// Connects to the MJPEG or RTSP stream at `url`, reconnecting according to `policy`.
+    ///
+    /// This connects and waits for the first frame, to find out the stream's [`CameraFormat`]. The connection is kept for [`open_stream()`](CaptureBackendTrait::open_stream()).
+    /// # Errors
+    /// If the URL is invalid, the camera cannot be reached, or its stream is not MJPEG, this will error.
+    pub fn with_policy(url: &str, policy: ReconnectPolicy) -> Result<Self, NokhwaError> {
+        // starts the clock before the first frame can be received
+        epoch();
+        let url = StreamUrl::parse(url)?;
+        let mut session = Session::open(&url, policy)?;
+        let mut frame = Vec::new();
+        let resolution = match session.next_frame(&mut frame) {
+            Ok(resolution) => resolution,
+            Err(why) => return Err(NokhwaError::OpenDeviceError(url.display(), why.to_string())),
+        };
+
+        let camera_format = CameraFormat::new(
+            resolution,
+            FrameFormat::MJPEG,
+            session
+                .frame_rate()
+                .unwrap_or_else(|| CameraFormat::default().frame_rate()),
+        );
+        let description = match url.protocol {
+            Protocol::Http => "MJPEG over HTTP",
+            Protocol::Rtsp => "RTSP (RTP/JPEG)",
+        };
+        let camera_info = CameraInfo::new(&url.display(), description, &url.display(), 0);
+
+        Ok(NetworkCaptureDevice {
+            camera_info,
+            url,
+            policy,
+            camera_format,
+            stream_config: StreamConfig::default(),
+            shared: Arc::new(Shared::default()),
+            reader: None,
+            probe: Some(session),
+            frame,
+            metadata: FrameMetadata::default(),
+            frame_counter: FrameCounter::default(),
+        })
+    }
+
+    /// The [`ReconnectPolicy`] of the device.
+    #[must_use]
+    pub fn policy(&self) -> ReconnectPolicy {
+        self.policy
+    }
+
+    /// Sets the [`ReconnectPolicy`] of the device. It is used from the next time the stream is opened.
+    pub fn set_policy(&mut self, policy: ReconnectPolicy) {
+        self.policy = policy;
+    }
+
+    /// The current [`ConnectionState`] of the device.
+    #[must_use]
+    pub fn connection_state(&self) -> ConnectionState {
+        lock(&self.shared.queue).state.clone()
+    }
+
+    /// How many times the connection was made again since the stream was opened.
+    #[must_use]
+    pub fn reconnects(&self) -> u64 {
+        lock(&self.shared.queue).reconnects
+    }
+
+    // takes the next frame out of the jitter buffer into `self.frame`, blocking for up to the stall timeout
+    fn next_frame(&mut self) -> Result<(), NokhwaError> {
+        if self.reader.is_none() {
+            return Err(NokhwaError::ReadFrameError(
+                "Stream is not open!".to_string(),
+            ));
+        }
+        let _timer = metrics::time(Stage::Dequeue);
+        let deadline = Instant::now() + self.policy.stall_timeout;
+
+        let mut queue = lock(&self.shared.queue);
+        loop {
+            if self.stream_config.dequeue_mode() == DequeueMode::LowLatency {
+                queue.skip_to_newest();
+            }
+            if let Some(frame) = queue.frames.pop_front() {
+                // the last frame's buffer goes back to the reader thread
+                let last = std::mem::replace(&mut self.frame, frame.data);
+                queue.free.push(last);
+                drop(queue);
+
+                self.camera_format.set_resolution(frame.resolution);
+                self.metadata = self.frame_counter.timed(
+                    Some(frame.received.saturating_duration_since(epoch())),
+                    self.camera_format.frame_rate(),
+                    Some(frame.dropped),
+                );
+                return Ok(());
+            }
+            if let ConnectionState::Failed(why) = &queue.state {
+                return Err(NokhwaError::ReadFrameError(why.clone()));
+            }
+
+            let now = Instant::now();
+            if now >= deadline {
+                return Err(NokhwaError::ReadFrameError(format!(
+                    "No frame within {:?} ({:?})",
+                    self.policy.stall_timeout, queue.state
+                )));
+            }
+            queue = match self.shared.ready.wait_timeout(queue, deadline - now) {
+                Ok((guard, _)) => guard,
+                Err(poisoned) => poisoned.into_inner().0,
+            };
+        }
+    }
+}
+
+impl CaptureBackendTrait for NetworkCaptureDevice {
+    fn init(&mut self) -> Result<CameraFormat, NokhwaError> {
+        Ok(self.camera_format)
+    }
+
+    fn backend(&self) -> CaptureAPIBackend {
+        CaptureAPIBackend::Network
+    }
+
+    fn camera_info(&self) -> &CameraInfo {
+        &self.camera_info
+    }
+
+    fn refresh_camera_format(&mut self) -> Result<(), NokhwaError> {
+        Ok(())
+    }
+
+    fn camera_format(&self) -> CameraFormat {
+        self.camera_format
+    }
+
+    fn set_camera_format(&mut self, new_fmt: CameraFormat) -> Result<(), NokhwaError> {
+        if new_fmt == self.camera_format {
+            return Ok(());
+        }
+        Err(NokhwaError::SetPropertyError {
+            property: "CameraFormat".to_string(),
+            value: new_fmt.to_string(),
+            error: "The format of a network stream is set by the camera".to_string(),
+        })
+    }
+
+    fn compatible_list_by_resolution(
+        &mut self,
+        fourcc: FrameFormat,
+    ) -> Result<HashMap<Resolution, Vec<u32>>, NokhwaError> {
+        let mut compatible = HashMap::new();
+        if fourcc == FrameFormat::MJPEG {
+            compatible.insert(
+                self.camera_format.resolution(),
+                vec![self.camera_format.frame_rate()],
+            );
+        }
+        Ok(compatible)
+    }
+
+    fn compatible_fourcc(&mut self) -> Result<Vec<FrameFormat>, NokhwaError> {
+        Ok(vec![FrameFormat::MJPEG])
+    }
+
+    fn resolution(&self) -> Resolution {
+        self.camera_format.resolution()
+    }
+
+    fn set_resolution(&mut self, new_res: Resolution) -> Result<(), NokhwaError> {
+        let mut new_fmt = self.camera_format;
+        new_fmt.set_resolution(new_res);
+        self.set_camera_format(new_fmt)
+    }
+
+    fn frame_rate(&self) -> u32 {
+        self.camera_format.frame_rate()
+    }
+
+    fn set_frame_rate(&mut self, new_fps: u32) -> Result<(), NokhwaError> {
+        let mut new_fmt = self.camera_format;
+        new_fmt.set_frame_rate(new_fps);
+        self.set_camera_format(new_fmt)
+    }
+
+    fn frame_format(&self) -> FrameFormat {
+        FrameFormat::MJPEG
+    }
+
+    fn set_frame_format(&mut self, fourcc: FrameFormat) -> Result<(), NokhwaError> {
+        let mut new_fmt = self.camera_format;
+        new_fmt.set_format(fourcc);
+        self.set_camera_format(new_fmt)
+    }
+
+    fn camera_control(&self, control: KnownCameraControl) -> Result<CameraControl, NokhwaError> {
+        Err(NokhwaError::GetPropertyError {
+            property: control.to_string(),
+            error: "A network stream has no camera controls".to_string(),
+        })
+    }
+
+    fn camera_controls(&self) -> Result<Vec<CameraControl>, NokhwaError> {
+        Ok(vec![])
+    }
+
+    fn set_camera_control(
+        &mut self,
+        _id: KnownCameraControl,
+        _value: ControlValueSetter,
+    ) -> Result<(), NokhwaError> {
+        Err(NokhwaError::UnsupportedOperationError(
+            CaptureAPIBackend::Network,
+        ))
+    }
+
+    fn open_stream(&mut self) -> Result<(), NokhwaError> {
+        self.stop_stream()?;
+
+        self.shared = Arc::new(Shared::default());
+        {
+            let mut queue = lock(&self.shared.queue);
+            queue.depth = self.stream_config.buffer_count() as usize;
+            queue.state = ConnectionState::Connecting;
+        }
+        self.frame_counter.reset();
+
+        let url = self.url.clone();
+        let policy = self.policy;
+        let shared = self.shared.clone();
+        let session = self.probe.take();
+        let reader = std::thread::Builder::new()
+            .name(format!("NetworkReaderThread {}", self.url.display()))
+            .stack_size(256 * 1024)
+            .spawn(move || read_frames(&url, policy, &shared, session));
+        match reader {
+            Ok(reader) => {
+                self.reader = Some(reader);
+                Ok(())
+            }
+            Err(why) => Err(NokhwaError::OpenStreamError(why.to_string())),
+        }
+    }
+
+    fn open_stream_with(&mut self, config: StreamConfig) -> Result<(), NokhwaError> {
+        self.stream_config = config;
+        self.open_stream()
+    }
+
+    fn stream_config(&self) -> StreamConfig {
+        self.stream_config
+    }
+
+    fn is_stream_open(&self) -> bool {
+        self.reader.is_some()
+    }
+
+    fn frame(&mut self) -> Result<Buffer, NokhwaError> {
+        self.next_frame()?;
+        let decoded = mjpeg_to_rgb(&self.frame, false)?;
+        Ok(
+            Buffer::new(self.camera_format.resolution(), decoded, FrameFormat::MJPEG)
+                .with_state(FrameState::Rgb)
+                .with_metadata(self.metadata),
+        )
+    }
+
+    fn frame_raw(&mut self) -> Result<Cow<[u8]>, NokhwaError> {
+        self.next_frame()?;
+        Ok(Cow::Borrowed(&self.frame))
+    }
+
+    fn frame_ref(&mut self) -> Result<FrameRef, NokhwaError> {
+        self.next_frame()?;
+        Ok(FrameRef::new(
+            self.camera_format.resolution(),
+            Cow::Borrowed(&self.frame),
+            FrameFormat::MJPEG,
+        )
+        .with_metadata(self.metadata))
+    }
+
+    fn poll_frame_ready(&mut self, cx: &mut Context<'_>) -> Poll<Result<(), NokhwaError>> {
+        if self.reader.is_none() {
+            return Poll::Ready(Err(NokhwaError::ReadFrameError(
+                "Stream is not open!".to_string(),
+            )));
+        }
+        let queue = lock(&self.shared.queue);
+        if !queue.frames.is_empty() {
+            return Poll::Ready(Ok(()));
+        }
+        if let ConnectionState::Failed(why) = &queue.state {
+            return Poll::Ready(Err(NokhwaError::ReadFrameError(why.clone())));
+        }
+        // set while the queue is locked, so the reader thread cannot push a frame in between and miss it
+        *lock(&self.shared.waker) = Some(cx.waker().clone());
+        Poll::Pending
+    }
+
+    fn stop_stream(&mut self) -> Result<(), NokhwaError> {
+        if let Some(reader) = self.reader.take() {
+            self.shared.stop();
+            let joined = reader.join();
+            self.shared.set_state(ConnectionState::Closed);
+            if joined.is_err() {
+                return Err(NokhwaError::StreamShutdownError(
+                    "The reader thread panicked".to_string(),
+                ));
+            }
+        }
+        Ok(())
+    }
+}
+
+impl Drop for NetworkCaptureDevice {
+    fn drop(&mut self) {
+        let _stop_stream_err = self.stop_stream();
+    }
+}
+
+// The timestamps of every network camera are measured from this, so they can be compared (e.g. by a `CameraGroup`).
+fn epoch() -> Instant {
+    static EPOCH: Mutex<Option<Instant>> = Mutex::new(None);
+    *lock(&EPOCH).get_or_insert_with(Instant::now)
+}
+
+fn lock<T>(mutex: &Mutex<T>) -> MutexGuard<'_, T> {
+    match mutex.lock() {
+        Ok(guard) => guard,
+        Err(poisoned) => poisoned.into_inner(),
+    }
+}
+
+struct QueuedFrame {
+    data: Vec<u8>,
+    resolution: Resolution,
+    received: Instant,
+    // frames dropped between the frame before this one and this one
+    dropped: u64,
+}
+
+// The jitter buffer, filled by the reader thread.
+struct FrameQueue {
+    frames: VecDeque<QueuedFrame>,
+    // buffers of frames that were handed out or dropped, reused to receive the next frames into
+    free: Vec<Vec<u8>>,
+    depth: usize,
+    state: ConnectionState,
+    reconnects: u64,
+}
+
+impl FrameQueue {
+    fn push(&mut self, mut frame: QueuedFrame) {
+        if self.frames.is_empty() {
+            // nobody is waiting on frames that are not coming, the remainder is not worth keeping around
+            self.free.truncate(self.depth + 1);
+        }
+        while self.frames.len() >= self.depth.max(1) {
+            if let Some(oldest) = self.frames.pop_front() {
+                self.free.push(oldest.data);
+                match self.frames.front_mut() {
+                    Some(next) => next.dropped += oldest.dropped + 1,
+                    None => frame.dropped += oldest.dropped + 1,
+                }
+            }
+        }
+        self.frames.push_back(frame);
+    }
+
+    fn skip_to_newest(&mut self) {
+        while self.frames.len() > 1 {
+            if let Some(skipped) = self.frames.pop_front() {
+                self.free.push(skipped.data);
+                if let Some(next) = self.frames.front_mut() {
+                    next.dropped += skipped.dropped + 1;
+                }
+            }
+        }
+    }
+}
+
+struct Shared {
+    queue: Mutex<FrameQueue>,
+    // signalled when a frame is pushed or the connection failed for good
+    ready: Condvar,
+    // signalled when the reader thread should stop
+    stopping: Condvar,
+    stop: AtomicBool,
+    // a handle to the socket of the current connection, shut down to unblock the reader thread
+    socket: Mutex<Option<TcpStream>>,
+    waker: Mutex<Option<Waker>>,
+}
+
+impl Default for Shared {
+    fn default() -> Self {
+        Shared {
+            queue: Mutex::new(FrameQueue {
+                frames: VecDeque::new(),
+                free: Vec::new(),
+                depth: 1,
+                state: ConnectionState::Closed,
+                reconnects: 0,
+            }),
+            ready: Condvar::new(),
+            stopping: Condvar::new(),
+            stop: AtomicBool::new(false),
+            socket: Mutex::new(None),
+            waker: Mutex::new(None),
+        }
+    }
+}
+
+impl Shared {
+    fn stopped(&self) -> bool {
+        self.stop.load(Ordering::Acquire)
+    }
+
+    fn stop(&self) {
+        self.stop.store(true, Ordering::Release);
+        if let Some(socket) = lock(&self.socket).take() {
+            let _shutdown = socket.shutdown(Shutdown::Both);
+        }
+        let _queue = lock(&self.queue);
+        self.stopping.notify_all();
+    }
+
+    fn set_state(&self, state: ConnectionState) {
+        let failed = matches!(state, ConnectionState::Failed(_));
+        lock(&self.queue).state = state;
+        if failed {
+            self.notify();
+        }
+    }
+
+    fn notify(&self) {
+        self.ready.notify_all();
+        if let Some(waker) = lock(&self.waker).take() {
+            waker.wake();
+        }
+    }
+
+    // sleeps for `duration`, or until the reader thread should stop
+    fn sleep(&self, duration: Duration) {
+        let queue = lock(&self.queue);
+        let _wait = self
+            .stopping
+            .wait_timeout_while(queue, duration, |_| !self.stopped());
+    }
+}
+
+// The reader thread: receives frames into the jitter buffer until stopped, reconnecting whenever the connection is lost.
+fn read_frames(
+    url: &StreamUrl,
+    policy: ReconnectPolicy,
+    shared: &Shared,
+    mut session: Option<Session>,
+) {
+    let mut attempt = 0_u32;
+    let mut delay = policy.initial_delay;
+
+    while !shared.stopped() {
+        let mut current = match session.take() {
+            Some(session) => session,
+            None => match Session::open(url, policy) {
+                Ok(session) => {
+                    lock(&shared.queue).reconnects += 1;
+                    session
+                }
+                Err(why) => {
+                    attempt += 1;
+                    if policy.max_attempts.map_or(false, |max| attempt >= max) {
+                        shared.set_state(ConnectionState::Failed(why.to_string()));
+                        return;
+                    }
+                    shared.set_state(ConnectionState::Reconnecting {
+                        attempt,
+                        error: why.to_string(),
+                    });
+                    shared.sleep(delay);
+                    delay = (delay * 2).min(policy.max_delay);
+                    continue;
+                }
+            },
+        };
+
+        if let Ok(socket) = current.socket().try_clone() {
+            *lock(&shared.socket) = Some(socket);
+        }
+        // `stop()` may have come before the socket could be shut down
+        if shared.stopped() {
+            break;
+        }
+        shared.set_state(ConnectionState::Connected);
+
+        let error = loop {
+            let mut data = lock(&shared.queue).free.pop().unwrap_or_default();
+            match current.next_frame(&mut data) {
+                Ok(resolution) => {
+                    attempt = 0;
+                    delay = policy.initial_delay;
+                    let frame = QueuedFrame {
+                        data,
+                        resolution,
+                        received: Instant::now(),
+                        dropped: current.take_lost(),
+                    };
+                    lock(&shared.queue).push(frame);
+                    shared.notify();
+                }
+                Err(why) => break why,
+            }
+            if shared.stopped() {
+                return;
+            }
+        };
+        lock(&shared.socket).take();
+
+        if !shared.stopped() {
+            attempt += 1;
+            shared.set_state(ConnectionState::Reconnecting {
+                attempt,
+                error: error.to_string(),
+            });
+            shared.sleep(delay);
+            delay = (delay * 2).min(policy.max_delay);
+        }
+    }
+}
+
+#[derive(Copy, Clone, Debug, PartialEq, Eq)]
+enum Protocol {
+    Http,
+    Rtsp,
+}
+
+#[derive(Clone, Debug)]
+struct StreamUrl {
+    protocol: Protocol,
+    // as given, with the port if there was one (used for `Host` and RTSP request URLs)
+    authority: String,
+    host: String,
+    port: u16,
+    // with the query, always starting with `/`
+    path: String,
+    credentials: Option<(String, String)>,
+}
+
+impl StreamUrl {
+    fn parse(url: &str) -> Result<Self, NokhwaError> {
+        let invalid = |why: &str| NokhwaError::OpenDeviceError(url.to_string(), why.to_string());
+
+        let (protocol, default_port, rest) = if let Some(rest) = url.strip_prefix("http://") {
+            (Protocol::Http, 80, rest)
+        } else if let Some(rest) = url.strip_prefix("rtsp://") {
+            (Protocol::Rtsp, 554, rest)
+        } else {
+            return Err(invalid(
+                "Only http:// (MJPEG) and rtsp:// URLs are supported",
+            ));
+        };
+        let (authority, path) = match rest.find('/') {
+            Some(slash) => rest.split_at(slash),
+            None => (rest, "/"),
+        };
+        let (credentials, authority) = match authority.rsplit_once('@') {
+            Some((user_info, authority)) => {
+                let (user, password) = user_info.split_once(':').unwrap_or((user_info, ""));
+                (Some((user.to_string(), password.to_string())), authority)
+            }
+            None => (None, authority),
+        };
+        // `[::1]:554` has its port after the last `:`, `[::1]` has none
+        let (host, port) = match authority.rsplit_once(':') {
+            Some((host, port)) if !port.contains(']') => match port.parse::<u16>() {
+                Ok(port) => (host, port),
+                Err(_) => return Err(invalid("Invalid port")),
+            },
+            _ => (authority, default_port),
+        };
+        let host = host.trim_start_matches('[').trim_end_matches(']');
+        if host.is_empty() {
+            return Err(invalid("No host"));
+        }
+
+        Ok(StreamUrl {
+            protocol,
+            authority: authority.to_string(),
+            host: host.to_string(),
+            port,
+            path: path.to_string(),
+            credentials,
+        })
+    }
+
+    // without the credentials
+    fn display(&self) -> String {
+        let scheme = match self.protocol {
+            Protocol::Http => "http",
+            Protocol::Rtsp => "rtsp",
+        };
+        format!("{}://{}{}", scheme, self.authority, self.path)
+    }
+
+    fn authorization(&self) -> String {
+        match &self.credentials {
+            Some((user, password)) => format!(
+                "Authorization: Basic {}\r\n",
+                base64(format!("{}:{}", user, password).as_bytes())
+            ),
+            None => String::new(),
+        }
+    }
+
+    fn connect(&self, timeout: Duration) -> Result<TcpStream, NokhwaError> {
+        let open_error = |why: String| NokhwaError::OpenDeviceError(self.display(), why);
+
+        let addresses = match (self.host.as_str(), self.port).to_socket_addrs() {
+            Ok(addresses) => addresses,
+            Err(why) => return Err(open_error(why.to_string())),
+        };
+        let mut last_error = "No address".to_string();
+        for address in addresses {
+            match TcpStream::connect_timeout(&address, timeout) {
+                Ok(stream) => {
+                    // a stalled camera is noticed by reads timing out
+                    if let Err(why) = stream
+                        .set_read_timeout(Some(timeout))
+                        .and_then(|_| stream.set_write_timeout(Some(timeout)))
+                        .and_then(|_| stream.set_nodelay(true))
+                    {
+                        return Err(open_error(why.to_string()));
+                    }
+                    return Ok(stream);
+                }
+                Err(why) => last_error = why.to_string(),
+            }
+        }
+        Err(open_error(last_error))
+    }
+}
+
+fn base64(data: &[u8]) -> String {
+    const ALPHABET: &[u8; 64] = b"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    let mut encoded = String::with_capacity((data.len() + 2) / 3 * 4);
+    for chunk in data.chunks(3) {
+        let bytes = [
+            chunk[0],
+            chunk.get(1).copied().unwrap_or(0),
+            chunk.get(2).copied().unwrap_or(0),
+        ];
+        let triple = u32::from(bytes[0]) << 16 | u32::from(bytes[1]) << 8 | u32::from(bytes[2]);
+        for i in 0..4 {
+            if i <= chunk.len() {
+                encoded.push(ALPHABET[(triple >> (18 - 6 * i) & 0x3F) as usize] as char);
+            } else {
+                encoded.push('=');
+            }
+        }
+    }
+    encoded
+}
+
+fn read_error(why: impl ToString) -> NokhwaError {
+    NokhwaError::ReadFrameError(why.to_string())
+}
+
+// reads a line of at most `MAX_LINE_LENGTH`, without the line ending
+fn read_line(reader: &mut impl BufRead, line: &mut Vec<u8>) -> Result<(), NokhwaError> {
+    line.clear();
+    match (&mut *reader)
+        .take(MAX_LINE_LENGTH as u64 + 1)
+        .read_until(b'\n', line)
+    {
+        Ok(0) => Err(read_error("Connection closed")),
+        Ok(_) if line.len() > MAX_LINE_LENGTH => Err(read_error("Line too long")),
+        Ok(_) => {
+            while line
+                .last()
+                .map_or(false, |last| *last == b'\n' || *last == b'\r')
+            {
+                line.pop();
+            }
+            Ok(())
+        }
+        Err(why) => Err(read_error(why)),
+    }
+}
+
+// The status code and headers of an HTTP or RTSP response, whose status line is `first_line`.
+struct Head {
+    status: u16,
+    headers: Vec<(String, String)>,
+}
+
+impl Head {
+    fn read(reader: &mut impl BufRead, first_line: &[u8]) -> Result<Head, NokhwaError> {
+        let status_line = String::from_utf8_lossy(first_line);
+        let status = match status_line.split_whitespace().nth(1).map(str::parse::<u16>) {
+            Some(Ok(status)) => status,
+            _ => return Err(read_error(format!("Bad status line {:?}", status_line))),
+        };
+
+        let mut headers = Vec::new();
+        let mut line = Vec::new();
+        loop {
+            read_line(reader, &mut line)?;
+            if line.is_empty() {
+                break;
+            }
+            if headers.len() == MAX_HEADERS {
+                return Err(read_error("Too many headers"));
+            }
+            if let Some((name, value)) = String::from_utf8_lossy(&line).split_once(':') {
+                headers.push((name.trim().to_ascii_lowercase(), value.trim().to_string()));
+            }
+        }
+        Ok(Head { status, headers })
+    }
+
+    fn header(&self, name: &str) -> Option<&str> {
+        self.headers
+            .iter()
+            .find(|(header, _)| header == name)
+            .map(|(_, value)| value.as_str())
+    }
+
+    fn content_length(&self) -> Option<usize> {
+        self.header("content-length")
+            .and_then(|length| length.parse().ok())
+    }
+}
+
+// finds the resolution of a JPEG in its start of frame segment
+fn jpeg_resolution(data: &[u8]) -> Option<Resolution> {
+    let mut position = 2;
+    while position + 9 <= data.len() {
+        if data[position] != 0xFF {
+            return None;
+        }
+        let marker = data[position + 1];
+        let length = usize::from(u16::from_be_bytes([data[position + 2], data[position + 3]]));
+        // SOF0 to SOF15, except DHT, JPG and DAC
+        if (0xC0..=0xCF).contains(&marker) && !matches!(marker, 0xC4 | 0xC8 | 0xCC) {
+            let height = u16::from_be_bytes([data[position + 5], data[position + 6]]);
+            let width = u16::from_be_bytes([data[position + 7], data[position + 8]]);
+            return Some(Resolution::new(u32::from(width), u32::from(height)));
+        }
+        position += 2 + length;
+    }
+    None
+}
+
+// A connection to a camera, see `read_frames()`.
+enum Session {
+    Http(MjpegHttpSession),
+    Rtsp(Box<RtspSession>),
+}
+
+impl Session {
+    fn open(url: &StreamUrl, policy: ReconnectPolicy) -> Result<Session, NokhwaError> {
+        match url.protocol {
+            Protocol::Http => Ok(Session::Http(MjpegHttpSession::open(url, policy)?)),
+            Protocol::Rtsp => Ok(Session::Rtsp(Box::new(RtspSession::open(url, policy)?))),
+        }
+    }
+
+    fn socket(&self) -> &TcpStream {
+        match self {
+            Session::Http(session) => session.reader.get_ref(),
+            Session::Rtsp(session) => session.reader.get_ref(),
+        }
+    }
+
+    fn frame_rate(&self) -> Option<u32> {
+        match self {
+            Session::Http(_) => None,
+            Session::Rtsp(session) => session.frame_rate,
+        }
+    }
+
+    // receives the next JPEG into `frame`
+    fn next_frame(&mut self, frame: &mut Vec<u8>) -> Result<Resolution, NokhwaError> {
+        match self {
+            Session::Http(session) => session.next_frame(frame),
+            Session::Rtsp(session) => session.next_frame(frame),
+        }
+    }
+
+    // how many frames were lost since this was last called
+    fn take_lost(&mut self) -> u64 {
+        match self {
+            Session::Http(_) => 0,
+            Session::Rtsp(session) => std::mem::take(&mut session.assembler.lost),
+        }
+    }
+}
+
+// `multipart/x-mixed-replace` over HTTP: every part is a JPEG.
+struct MjpegHttpSession {
+    reader: BufReader<TcpStream>,
+    // with the leading `--`
+    boundary: Vec<u8>,
+    line: Vec<u8>,
+    max_frame_size: usize,
+}
+
+impl MjpegHttpSession {
+    fn open(url: &StreamUrl, policy: ReconnectPolicy) -> Result<Self, NokhwaError> {
+        let open_error = |why: String| NokhwaError::OpenDeviceError(url.display(), why);
+
+        let mut stream = url.connect(policy.stall_timeout)?;
+        // HTTP/1.0, so the server does not use chunked transfer encoding
+        let request = format!(
+            "GET {} HTTP/1.0\r\nHost: {}\r\nUser-Agent: nokhwa\r\nAccept: multipart/x-mixed-replace, image/jpeg\r\n{}\r\n",
+            url.path,
+            url.authority,
+            url.authorization()
+        );
+        if let Err(why) = stream.write_all(request.as_bytes()) {
+            return Err(open_error(why.to_string()));
+        }
+
+        let mut reader = BufReader::with_capacity(64 * 1024, stream);
+        let mut line = Vec::new();
+        read_line(&mut reader, &mut line)?;
+        let head = Head::read(&mut reader, &line)?;
+        if head.status != 200 {
+            return Err(open_error(format!("HTTP status {}", head.status)));
+        }
+
+        let content_type = head.header("content-type").unwrap_or_default();
+        let boundary = match content_type
+            .to_ascii_lowercase()
+            .find("boundary=")
+            .map(|start| &content_type[start + 9..])
+        {
+            Some(boundary) => boundary
+                .split(';')
+                .next()
+                .unwrap_or_default()
+                .trim()
+                .trim_matches('"')
+                .trim_start_matches("--"),
+            None => {
+                return Err(open_error(format!(
+                    "Not a multipart MJPEG stream ({})",
+                    content_type
+                )))
+            }
+        };
+
+        Ok(MjpegHttpSession {
+            reader,
+            boundary: format!("--{}", boundary).into_bytes(),
+            line,
+            max_frame_size: policy.max_frame_size,
+        })
+    }
+
+    fn next_frame(&mut self, frame: &mut Vec<u8>) -> Result<Resolution, NokhwaError> {
+        // some cameras leave out the `--` of the boundary
+        loop {
+            read_line(&mut self.reader, &mut self.line)?;
+            let start = self
+                .line
+                .iter()
+                .position(|byte| !byte.is_ascii_whitespace())
+                .unwrap_or(self.line.len());
+            let line = &self.line[start..];
+            if line.starts_with(&self.boundary) || line.starts_with(&self.boundary[2..]) {
+                break;
+            }
+        }
+        // the part headers have no status line, so they are read like a response with a made up one
+        let head = Head::read(&mut self.reader, b"PART 200")?;
+
+        frame.clear();
+        match head.content_length() {
+            Some(length) if length > self.max_frame_size => {
+                return Err(read_error(format!(
+                    "A part of {} bytes is larger than the maximum frame size",
+                    length
+                )))
+            }
+            Some(length) => {
+                frame.resize(length, 0);
+                if let Err(why) = self.reader.read_exact(frame) {
+                    return Err(read_error(why));
+                }
+            }
+            // without a length, the part ends with the JPEG's end of image marker
+            None => loop {
+                let room = (self.max_frame_size + 1).saturating_sub(frame.len()) as u64;
+                match (&mut self.reader).take(room).read_until(0xD9, frame) {
+                    Ok(0) => return Err(read_error("Connection closed")),
+                    Ok(_) if frame.len() > self.max_frame_size => {
+                        return Err(read_error(
+                            "A part of the stream is larger than the maximum frame size",
+                        ))
+                    }
+                    Ok(_) if frame.ends_with(&[0xFF, 0xD9]) => break,
+                    Ok(_) => {}
+                    Err(why) => return Err(read_error(why)),
+                }
+            },
+        }
+
+        match jpeg_resolution(frame) {
+            Some(resolution) => Ok(resolution),
+            None => Err(read_error("A part of the stream is not a JPEG")),
+        }
+    }
+}
+
+// RTSP, with RTP/JPEG interleaved on the RTSP connection.
+struct RtspSession {
+    reader: BufReader<TcpStream>,
+    url: StreamUrl,
+    // the URL requests for the whole presentation go to
+    base: String,
+    cseq: u32,
+    session: String,
+    keepalive: Duration,
+    last_keepalive: Instant,
+    frame_rate: Option<u32>,
+    assembler: RtpJpegAssembler,
+    packet: Vec<u8>,
+}
+
+impl RtspSession {
+    fn open(url: &StreamUrl, policy: ReconnectPolicy) -> Result<Self, NokhwaError> {
+        let stream = url.connect(policy.stall_timeout)?;
+        let mut session = RtspSession {
+            reader: BufReader::with_capacity(64 * 1024, stream),
+            url: url.clone(),
+            base: url.display(),
+            cseq: 0,
+            session: String::new(),
+            keepalive: Duration::from_secs(30),
+            last_keepalive: Instant::now(),
+            frame_rate: None,
+            assembler: RtpJpegAssembler {
+                max_frame_size: policy.max_frame_size,
+                ..RtpJpegAssembler::default()
+            },
+            packet: Vec::new(),
+        };
+
+        let (head, sdp) =
+            session.request("DESCRIBE", &url.display(), "Accept: application/sdp\r\n")?;
+        if let Some(base) = head
+            .header("content-base")
+            .or_else(|| head.header("content-location"))
+        {
+            session.base = base.to_string();
+        }
+        let sdp = Sdp::parse(&String::from_utf8_lossy(&sdp));
+        if !sdp.jpeg {
+            return Err(NokhwaError::OpenDeviceError(
+                url.display(),
+                "The stream is not RTP/JPEG (RFC 2435), only MJPEG is supported".to_string(),
+            ));
+        }
+        session.frame_rate = sdp.frame_rate;
+
+        let track = resolve_control(&session.base, sdp.video_control.as_deref());
+        let (head, _) = session.request(
+            "SETUP",
+            &track,
+            "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n",
+        )?;
+        let session_header = head.header("session").unwrap_or_default().to_string();
+        let mut parameters = session_header.split(';');
+        session.session = parameters.next().unwrap_or_default().trim().to_string();
+        if let Some(seconds) = parameters
+            .filter_map(|parameter| parameter.trim().strip_prefix("timeout="))
+            .find_map(|seconds| seconds.parse::<u64>().ok())
+        {
+            session.keepalive = Duration::from_secs(seconds.max(2) / 2);
+        }
+
+        let presentation = resolve_control(&session.base, sdp.session_control.as_deref());
+        let headers = format!("Session: {}\r\nRange: npt=0.000-\r\n", session.session);
+        session.request("PLAY", &presentation, &headers)?;
+        session.last_keepalive = Instant::now();
+        Ok(session)
+    }
+
+    fn send(&mut self, method: &str, uri: &str, headers: &str) -> Result<(), NokhwaError> {
+        self.cseq += 1;
+        let request = format!(
+            "{} {} RTSP/1.0\r\nCSeq: {}\r\nUser-Agent: nokhwa\r\n{}{}\r\n",
+            method,
+            uri,
+            self.cseq,
+            self.url.authorization(),
+            headers
+        );
+        match self.reader.get_mut().write_all(request.as_bytes()) {
+            Ok(_) => Ok(()),
+            Err(why) => Err(read_error(why)),
+        }
+    }
+
+    // sends a request during setup and reads its response
+    fn request(
+        &mut self,
+        method: &str,
+        uri: &str,
+        headers: &str,
+    ) -> Result<(Head, Vec<u8>), NokhwaError> {
+        let display = self.url.display();
+        let open_error = |why: String| NokhwaError::OpenDeviceError(display, why);
+
+        self.send(method, uri, headers)?;
+        let mut line = Vec::new();
+        read_line(&mut self.reader, &mut line)?;
+        let head = Head::read(&mut self.reader, &line)?;
+        let length = head.content_length().unwrap_or(0);
+        if length > MAX_BODY_LENGTH {
+            return Err(read_error(format!(
+                "{} got a response of {} bytes",
+                method, length
+            )));
+        }
+        let mut body = vec![0; length];
+        if let Err(why) = self.reader.read_exact(&mut body) {
+            return Err(read_error(why));
+        }
+
+        match head.status {
+            200 => Ok((head, body)),
+            401 => Err(open_error(format!(
+                "{} needs authentication, nokhwa only supports Basic ({})",
+                method,
+                head.header("www-authenticate").unwrap_or_default()
+            ))),
+            status => Err(open_error(format!("{} got RTSP status {}", method, status))),
+        }
+    }
+
+    fn next_frame(&mut self, frame: &mut Vec<u8>) -> Result<Resolution, NokhwaError> {
+        loop {
+            // keeps the session from timing out, the response is skipped below
+            if self.last_keepalive.elapsed() >= self.keepalive {
+                let headers = format!("Session: {}\r\n", self.session);
+                let base = self.base.clone();
+                self.send("GET_PARAMETER", &base, &headers)?;
+                self.last_keepalive = Instant::now();
+            }
+
+            let mut header = [0_u8; 4];
+            if let Err(why) = self.reader.read_exact(&mut header[..1]) {
+                return Err(read_error(why));
+            }
+            if header[0] != b'$' {
+                self.skip_message(header[0])?;
+                continue;
+            }
+            if let Err(why) = self.reader.read_exact(&mut header[1..]) {
+                return Err(read_error(why));
+            }
+            let channel = header[1];
+            let length = usize::from(u16::from_be_bytes([header[2], header[3]]));
+            self.packet.resize(length, 0);
+            if let Err(why) = self.reader.read_exact(&mut self.packet) {
+                return Err(read_error(why));
+            }
+            // channel 1 is RTCP
+            if channel == 0 {
+                if let Some(resolution) = self.assembler.push(&self.packet, frame) {
+                    return Ok(resolution);
+                }
+            }
+        }
+    }
+
+    // skips an RTSP message (a response to a keepalive, or a request from the server) that starts with `first`
+    fn skip_message(&mut self, first: u8) -> Result<(), NokhwaError> {
+        let mut line = vec![first];
+        let mut rest = Vec::new();
+        read_line(&mut self.reader, &mut rest)?;
+        line.extend_from_slice(&rest);
+        let head = Head::read(&mut self.reader, &line)?;
+        let length = head.content_length().unwrap_or(0);
+        if length > MAX_BODY_LENGTH {
+            return Err(read_error(format!(
+                "The server sent a message of {} bytes",
+                length
+            )));
+        }
+        match std::io::copy(
+            &mut (&mut self.reader).take(length as u64),
+            &mut std::io::sink(),
+        ) {
+            Ok(_) => Ok(()),
+            Err(why) => Err(read_error(why)),
+        }
+    }
+}
+
+impl Drop for RtspSession {
+    fn drop(&mut self) {
+        if !self.session.is_empty() {
+            let headers = format!("Session: {}\r\n", self.session);
+            let base = self.base.clone();
+            let _teardown = self.send("TEARDOWN", &base, &headers);
+        }
+    }
+}
+
+// What matters of the session description of an RTSP stream: its first video stream.
+#[derive(Default)]
+struct Sdp {
+    jpeg: bool,
+    frame_rate: Option<u32>,
+    session_control: Option<String>,
+    video_control: Option<String>,
+}
+
+impl Sdp {
+    #[allow(clippy::cast_possible_truncation, clippy::cast_sign_loss)]
+    fn parse(sdp: &str) -> Sdp {
+        let mut description = Sdp::default();
+        // none: session level, true: the first video stream, false: another stream
+        let mut in_video = None;
+        for line in sdp.lines().map(str::trim) {
+            if let Some(media) = line.strip_prefix("m=") {
+                let first_video = media.starts_with("video") && in_video.is_none();
+                in_video = Some(first_video);
+                if first_video {
+                    // `video <port> RTP/AVP <payload types>`, 26 is JPEG
+                    description.jpeg = media.split_whitespace().skip(3).any(|pt| pt == "26");
+                }
+                continue;
+            }
+            let attribute = match line.strip_prefix("a=") {
+                Some(attribute) => attribute,
+                None => continue,
+            };
+            match (in_video, attribute.split_once(':')) {
+                (None, Some(("control", control))) => {
+                    description.session_control = Some(control.to_string());
+                }
+                (Some(true), Some(("control", control))) => {
+                    description.video_control = Some(control.to_string());
+                }
+                (Some(true), Some(("rtpmap", rtpmap))) => {
+                    description.jpeg |= rtpmap.to_ascii_uppercase().contains("JPEG/");
+                }
+                (Some(true), Some(("framerate", rate))) => {
+                    description.frame_rate = rate
+                        .trim()
+                        .parse::<f64>()
+                        .ok()
+                        .map(|rate| rate.round() as u32);
+                }
+                _ => {}
+            }
+        }
+        description
+    }
+}
+
+// resolves the `a=control` of a stream against the base URL of the presentation
+fn resolve_control(base: &str, control: Option<&str>) -> String {
+    match control {
+        None | Some("*") => base.to_string(),
+        Some(control) if control.starts_with("rtsp://") => control.to_string(),
+        Some(control) if base.ends_with('/') => format!("{}{}", base, control),
+        Some(control) => format!("{}/{}", base, control),
+    }
+}
+
+// The quantization tables of RFC 2435 (the ones of the JPEG standard), in zigzag order.
+const LUMA_QUANTIZER: [u8; 64] = [
+    16, 11, 12, 14, 12, 10, 16, 14, 13, 14, 18, 17, 16, 19, 24, 40, 26, 24, 22, 22, 24, 49, 35, 37,
+    29, 40, 58, 51, 61, 60, 57, 51, 56, 55, 64, 72, 92, 78, 64, 68, 87, 69, 55, 56, 80, 109, 81,
+    87, 95, 98, 103, 104, 103, 62, 77, 113, 121, 112, 100, 120, 92, 101, 103, 99,
+];
+const CHROMA_QUANTIZER: [u8; 64] = [
+    17, 18, 18, 24, 21, 24, 47, 26, 26, 47, 99, 66, 56, 66, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+];
+
+// The Huffman tables of the JPEG standard (Annex K.3), which RTP/JPEG frames are always coded with: (class and id, code lengths, values).
+#[rustfmt::skip]
+const HUFFMAN_TABLES: [(u8, [u8; 16], &[u8]); 4] = [
+    (0x00, [0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0], &[0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11]),
+    (0x10, [0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D], &[
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+        0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+        0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+        0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+        0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+        0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+        0xF9, 0xFA,
+    ]),
+    (0x01, [0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0], &[0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11]),
+    (0x11, [0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77], &[
+        0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+        0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+        0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+        0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+        0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+        0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+        0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+        0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+        0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+        0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+        0xF9, 0xFA,
+    ]),
+];
+
+// The main JPEG header of the fragments of an RTP/JPEG frame (RFC 2435, 3.1).
+#[derive(Copy, Clone, Debug, PartialEq, Eq)]
+struct JpegHeader {
+    kind: u8,
+    quality: u8,
+    width: u16,
+    height: u16,
+    restart_interval: u16,
+}
+
+// Reassembles the JPEG frames of an RTP/JPEG stream from its packets, adding back the JPEG headers RFC 2435 leaves out.
+#[derive(Default)]
+struct RtpJpegAssembler {
+    // the RTP timestamp of the frame being reassembled, all of its packets have it
+    timestamp: Option<u32>,
+    header: Option<JpegHeader>,
+    // the entropy coded data of the frame, every fragment at its offset
+    scan: Vec<u8>,
+    received: usize,
+    // in-band quantization tables, kept for the frames that refer to them without sending them again
+    tables: HashMap<u8, Vec<u8>>,
+    last_sequence: Option<u16>,
+    // if a packet of the current frame went missing
+    broken: bool,
+    // frames that could not be reassembled since the last time this was taken
+    lost: u64,
+    // fragments past this are thrown away, along with their frame
+    max_frame_size: usize,
+}
+
+impl RtpJpegAssembler {
+    // Takes an RTP packet. Once it completes a frame, the frame is written to `frame` and its resolution returned.
+    fn push(&mut self, packet: &[u8], frame: &mut Vec<u8>) -> Option<Resolution> {
+        if packet.len() < 12 || packet[0] >> 6 != 2 {
+            return None;
+        }
+        let marker = packet[1] & 0x80 != 0;
+        let sequence = u16::from_be_bytes([packet[2], packet[3]]);
+        let timestamp = u32::from_be_bytes([packet[4], packet[5], packet[6], packet[7]]);
+        let mut start = 12 + 4 * usize::from(packet[0] & 0x0F);
+        if packet[0] & 0x10 != 0 {
+            // the header extension, its length is in 32 bit words
+            let words = packet.get(start + 2..start + 4)?;
+            start += 4 + 4 * usize::from(u16::from_be_bytes([words[0], words[1]]));
+        }
+        let mut end = packet.len();
+        if packet[0] & 0x20 != 0 {
+            end = end.saturating_sub(usize::from(packet[packet.len() - 1]));
+        }
+        let payload = packet.get(start..end)?;
+        if payload.len() < 8 {
+            return None;
+        }
+
+        if self
+            .last_sequence
+            .map_or(false, |last| sequence != last.wrapping_add(1))
+        {
+            self.broken = true;
+        }
+        self.last_sequence = Some(sequence);
+        if self.timestamp != Some(timestamp) {
+            // the last frame never got its last packet
+            if self.timestamp.is_some() {
+                self.lost += 1;
+            }
+            self.start_frame(timestamp);
+        }
+
+        let offset =
+            usize::from(payload[1]) << 16 | usize::from(payload[2]) << 8 | usize::from(payload[3]);
+        let mut header = JpegHeader {
+            kind: payload[4],
+            quality: payload[5],
+            width: u16::from(payload[6]) * 8,
+            height: u16::from(payload[7]) * 8,
+            restart_interval: 0,
+        };
+        let mut position = 8;
+        // types 64 to 127 have a restart marker header
+        if (64..128).contains(&header.kind) {
+            let restart = payload.get(position..position + 4)?;
+            header.restart_interval = u16::from_be_bytes([restart[0], restart[1]]);
+            position += 4;
+        }
+        if header.quality >= 128 && offset == 0 {
+            let table_header = payload.get(position..position + 4)?;
+            let length = usize::from(u16::from_be_bytes([table_header[2], table_header[3]]));
+            position += 4;
+            // only 8 bit tables are supported
+            if table_header[1] != 0 {
+                self.broken = true;
+            } else if length > 0 {
+                let tables = payload.get(position..position + length)?;
+                self.tables.insert(header.quality, tables.to_vec());
+            }
+            position += length;
+        }
+        if offset == 0 {
+            self.header = Some(header);
+        }
+
+        let data = payload.get(position..)?;
+        if offset + data.len() > self.max_frame_size {
+            self.broken = true;
+            return None;
+        }
+        if self.scan.len() < offset + data.len() {
+            self.scan.resize(offset + data.len(), 0);
+        }
+        self.scan[offset..offset + data.len()].copy_from_slice(data);
+        self.received += data.len();
+
+        if !marker {
+            return None;
+        }
+        self.timestamp = None;
+        let complete = !self.broken && self.received == self.scan.len();
+        match self.header {
+            Some(header) if complete && self.build_frame(header, frame) => Some(Resolution::new(
+                u32::from(header.width),
+                u32::from(header.height),
+            )),
+            _ => {
+                self.lost += 1;
+                None
+            }
+        }
+    }
+
+    fn start_frame(&mut self, timestamp: u32) {
+        self.timestamp = Some(timestamp);
+        self.header = None;
+        self.scan.clear();
+        self.received = 0;
+        self.broken = false;
+    }
+
+    // writes the whole JPEG, with the headers of RFC 2435 appendix B, to `frame`
+    #[allow(clippy::cast_possible_truncation)]
+    fn build_frame(&self, header: JpegHeader, frame: &mut Vec<u8>) -> bool {
+        // the luma sampling factors of types 0 (4:2:2) and 1 (4:2:0)
+        let sampling = match header.kind & !64 {
+            0 => 0x21,
+            1 => 0x22,
+            _ => return false,
+        };
+        // 0 means wider or taller than 2040, which RFC 2435 cannot say
+        if header.width == 0 || header.height == 0 {
+            return false;
+        }
+        let (luma, chroma) = match header.quality {
+            1..=127 => (
+                quantizer(&LUMA_QUANTIZER, header.quality),
+                quantizer(&CHROMA_QUANTIZER, header.quality),
+            ),
+            _ => match self.tables.get(&header.quality) {
+                Some(tables) if tables.len() >= 128 => {
+                    let (luma, chroma) = tables.split_at(64);
+                    (luma.to_vec(), chroma[..64].to_vec())
+                }
+                // one table for both
+                Some(tables) if tables.len() >= 64 => {
+                    (tables[..64].to_vec(), tables[..64].to_vec())
+                }
+                _ => return false,
+            },
+        };
+
+        frame.clear();
+        frame.reserve(self.scan.len() + 1024);
+        frame.extend_from_slice(&[0xFF, 0xD8]);
+        for (id, table) in [(0_u8, &luma), (1, &chroma)] {
+            frame.extend_from_slice(&[0xFF, 0xDB, 0x00, 0x43, id]);
+            frame.extend_from_slice(table);
+        }
+        if header.restart_interval != 0 {
+            frame.extend_from_slice(&[0xFF, 0xDD, 0x00, 0x04]);
+            frame.extend_from_slice(&header.restart_interval.to_be_bytes());
+        }
+        frame.extend_from_slice(&[0xFF, 0xC0, 0x00, 0x11, 0x08]);
+        frame.extend_from_slice(&header.height.to_be_bytes());
+        frame.extend_from_slice(&header.width.to_be_bytes());
+        frame.extend_from_slice(&[
+            0x03, 0x01, sampling, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01,
+        ]);
+        for (class_id, lengths, values) in &HUFFMAN_TABLES {
+            let length = 2 + 1 + 16 + values.len() as u16;
+            frame.extend_from_slice(&[0xFF, 0xC4]);
+            frame.extend_from_slice(&length.to_be_bytes());
+            frame.push(*class_id);
+            frame.extend_from_slice(lengths);
+            frame.extend_from_slice(values);
+        }
+        frame.extend_from_slice(&[
+            0xFF, 0xDA, 0x00, 0x0C, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11, 0x00, 0x3F, 0x00,
+        ]);
+        frame.extend_from_slice(&self.scan);
+        if !self.scan.ends_with(&[0xFF, 0xD9]) {
+            frame.extend_from_slice(&[0xFF, 0xD9]);
+        }
+        true
+    }
+}
+
+// scales a quantization table to `quality` (1 to 99), like RFC 2435 appendix A
+#[allow(clippy::cast_possible_truncation)]
+fn quantizer(table: &[u8; 64], quality: u8) -> Vec<u8> {
+    let quality = u32::from(quality.clamp(1, 99));
+    let factor = if quality < 50 {
+        5000 / quality
+    } else {
+        200 - quality * 2
+    };
+    table
+        .iter()
+        .map(|value| ((u32::from(*value) * factor + 50) / 100).clamp(1, 255) as u8)
+        .collect()
+}
@@ -16,18 +16,21 @@
 
 use crate::pixel_format::PixelFormat;
 use crate::{
-    CameraControl, CameraFormat, CameraInfo, CaptureAPIBackend, CaptureBackendTrait, FrameFormat,
-    KnownCameraControl, NokhwaError, Resolution,
+    metrics::{self, Stage},
+    CameraControl, CameraFormat, CameraInfo, CaptureAPIBackend, CaptureBackendTrait, FrameCounter,
+    FrameFormat, FrameMetadata, FrameRef, FrameState, KnownCameraControl, NokhwaError, Resolution,
 };
 use image::{ImageBuffer, Rgb};
 use opencv::{
-    core::{Mat, MatTraitConst, MatTraitConstManual, Vec3b},
+    core::{Mat, MatTraitConst, MatTraitConstManual},
+    imgproc::{cvt_color, COLOR_BGR2RGB},
     videoio::{
         VideoCapture, VideoCaptureTrait, VideoCaptureTraitConst, CAP_ANY, CAP_AVFOUNDATION,
-        CAP_MSMF, CAP_PROP_FPS, CAP_PROP_FRAME_HEIGHT, CAP_PROP_FRAME_WIDTH, CAP_V4L2,
+        CAP_MSMF, CAP_PROP_FPS, CAP_PROP_FRAME_HEIGHT, CAP_PROP_FRAME_WIDTH, CAP_PROP_POS_MSEC,
+        CAP_V4L2,
     },
 };
-use std::{any::Any, borrow::Cow, collections::HashMap};
+use std::{any::Any, borrow::Cow, collections::HashMap, time::Duration};
 
 /// Converts $from into $to
 /// Example usage:
@@ -68,6 +71,7 @@ macro_rules! tryinto_num {
 ///  - The API Preference order is the native OS API (linux => `v4l2`, mac => `AVFoundation`, windows => `MSMF`) than [`CAP_AUTO`](https://docs.opencv.org/4.5.2/d4/d15/group__videoio__flags__base.html#gga023786be1ee68a9105bf2e48c700294da77ab1fe260fd182f8ec7655fab27a31d)
 /// - The `Any` type for [`raw_camera_control()`](CaptureBackendTrait::raw_camera_control) is [`i32`], and its return `Any` is a [`f64`]. Please check [`OpenCV Documentation Constants`](https://docs.rs/opencv/0.53.1/opencv/videoio/index.html) for more.
 /// - The `Any` type for `control` for [`set_raw_camera_control()`](CaptureBackendTrait::set_raw_camera_control) is [`i32`] and [`f64`]. Please check [`OpenCV Documentation Constants`](https://docs.rs/opencv/0.53.1/opencv/videoio/index.html) for more.
+/// - `OpenCV` captures in BGR. Use [`frame_mat()`](OpenCvCaptureDevice::frame_mat) to get the captured `Mat` as it is, without converting it to RGB.
 #[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-opencv")))]
 pub struct OpenCvCaptureDevice {
     camera_format: CameraFormat,
@@ -75,6 +79,11 @@ pub struct OpenCvCaptureDevice {
     camera_info: CameraInfo,
     api_preference: i32,
     video_capture: VideoCapture,
+    // reused between frames, so `read()` and `cvt_color()` do not allocate every frame
+    frame: Mat,
+    rgb_frame: Mat,
+    frame_counter: FrameCounter,
+    last_metadata: FrameMetadata,
 }
 
 #[allow(clippy::must_use_candidate)]
@@ -135,6 +144,10 @@ impl OpenCvCaptureDevice {
             camera_info,
             api_preference: api,
             video_capture,
+            frame: Mat::default(),
+            rgb_frame: Mat::default(),
+            frame_counter: FrameCounter::default(),
+            last_metadata: FrameMetadata::default(),
         })
     }
 
@@ -206,19 +219,21 @@ impl OpenCvCaptureDevice {
         self.api_preference
     }
 
-    /// Gets the RGB24 frame directly read from `OpenCV` without any additional processing.
-    /// # Errors
-    /// If the frame is failed to be read, this will error.
+    // Reads the next frame into `self.frame`, reusing its allocation.
+    #[allow(clippy::cast_possible_truncation)]
     #[allow(clippy::cast_sign_loss)]
-    pub fn raw_frame_vec(&mut self) -> Result<Cow<[u8]>, NokhwaError> {
+    fn read_frame(&mut self) -> Result<(), NokhwaError> {
         if !self.is_stream_open() {
             return Err(NokhwaError::ReadFrameError(
                 "Stream is not open!".to_string(),
             ));
         }
 
-        let mut frame = Mat::default();
-        match self.video_capture.read(&mut frame) {
+        let read = {
+            let _timer = metrics::time(Stage::Dequeue);
+            self.video_capture.read(&mut self.frame)
+        };
+        match read {
             Ok(a) => {
                 if !a {
                     return Err(NokhwaError::ReadFrameError(
@@ -234,46 +249,79 @@ impl OpenCvCaptureDevice {
             }
         }
 
-        if frame.empty() {
+        if self.frame.empty() {
             return Err(NokhwaError::ReadFrameError("Frame Empty!".to_string()));
         }
 
-        match frame.size() {
+        // the position of the frame in the stream, which is the driver's timestamp for most camera APIs
+        let timestamp = match self.video_capture.get(CAP_PROP_POS_MSEC) {
+            Ok(msec) if msec > 0_f64 => Some(Duration::from_nanos((msec * 1_000_000_f64) as u64)),
+            _ => None,
+        };
+        self.last_metadata =
+            self.frame_counter
+                .timed(timestamp, self.camera_format.frame_rate(), None);
+        Ok(())
+    }
+
+    /// Gets the next frame as the `Mat` `OpenCV` captured it into (usually BGR), without any copy or conversion.
+    ///
+    /// The `Mat` is reused for the next frame, so it will be overwritten. Use [`take_frame_mat()`](OpenCvCaptureDevice::take_frame_mat) to keep it.
+    /// # Errors
+    /// If the frame is failed to be read, this will error.
+    pub fn frame_mat(&mut self) -> Result<&Mat, NokhwaError> {
+        self.read_frame()?;
+        Ok(&self.frame)
+    }
+
+    /// Same as [`frame_mat()`](OpenCvCaptureDevice::frame_mat), but hands out the `Mat` itself. The next frame is read into a new `Mat`.
+    /// # Errors
+    /// If the frame is failed to be read, this will error.
+    pub fn take_frame_mat(&mut self) -> Result<Mat, NokhwaError> {
+        self.read_frame()?;
+        Ok(std::mem::take(&mut self.frame))
+    }
+
+    /// Gets the RGB24 frame directly read from `OpenCV` without any additional processing.
+    ///
+    /// The frame is converted from BGR into a reused `Mat` and then borrowed from it, so this does not allocate once it has warmed up.
+    /// # Errors
+    /// If the frame is failed to be read, this will error.
+    pub fn raw_frame_vec(&mut self) -> Result<Cow<[u8]>, NokhwaError> {
+        self.read_frame()?;
+        Ok(Cow::from(self.convert_frame()?))
+    }
+
+    // Converts the last frame that was read into `self.rgb_frame`.
+    fn convert_frame(&mut self) -> Result<&[u8], NokhwaError> {
+        match self.frame.size() {
             Ok(size) => {
-                if size.width > 0 {
-                    return if frame.is_continuous() {
-                        let mut raw_vec: Vec<u8> = Vec::new();
-
-                        let frame_data_vec = match Mat::data_typed::<Vec3b>(&frame) {
-                            Ok(v) => v,
-                            Err(why) => {
-                                return Err(NokhwaError::ReadFrameError(format!(
-                                    "Failed to convert frame into raw Vec3b: {}",
-                                    why
-                                )))
-                            }
-                        };
-
-                        for pixel in frame_data_vec.iter() {
-                            let pixel_slice: &[u8; 3] = &**pixel;
-                            raw_vec.push(pixel_slice[2]);
-                            raw_vec.push(pixel_slice[1]);
-                            raw_vec.push(pixel_slice[0]);
-                        }
-
-                        Ok(Cow::from(raw_vec))
-                    } else {
-                        Err(NokhwaError::ReadFrameError(
-                            "Failed to read frame from videocapture: not cont".to_string(),
-                        ))
-                    };
+                if size.width <= 0 {
+                    return Err(NokhwaError::ReadFrameError(
+                        "Frame width is less than zero!".to_string(),
+                    ));
                 }
-                Err(NokhwaError::ReadFrameError(
-                    "Frame width is less than zero!".to_string(),
-                ))
             }
+            Err(why) => {
+                return Err(NokhwaError::ReadFrameError(format!(
+                    "Failed to read frame from videocapture: failed to read size: {}",
+                    why
+                )))
+            }
+        }
+
+        if let Err(why) = cvt_color(&self.frame, &mut self.rgb_frame, COLOR_BGR2RGB, 0) {
+            return Err(NokhwaError::ReadFrameError(format!(
+                "Failed to convert frame from BGR to RGB: {}",
+                why
+            )));
+        }
+
+        // `cvt_color()` always allocates its output continuously
+        match self.rgb_frame.data_bytes() {
+            Ok(data) => Ok(data),
             Err(why) => Err(NokhwaError::ReadFrameError(format!(
-                "Failed to read frame from videocapture: failed to read size: {}",
+                "Failed to read frame data: {}",
                 why
             ))),
         }
@@ -599,6 +647,22 @@ impl CaptureBackendTrait for OpenCvCaptureDevice {
         Ok(cow)
     }
 
+    #[allow(clippy::cast_sign_loss)]
+    fn frame_ref(&mut self) -> Result<FrameRef, NokhwaError> {
+        let camera_format = self.camera_format;
+        self.read_frame()?;
+        let metadata = self.last_metadata;
+        // `OpenCV` decodes every frame itself, so it is RGB at whatever size `VideoCapture` gave it, not the camera's format
+        let resolution = match self.frame.size() {
+            Ok(size) => Resolution::new(size.width as u32, size.height as u32),
+            Err(_) => camera_format.resolution(),
+        };
+        let frame = Cow::from(self.convert_frame()?);
+        Ok(FrameRef::new(resolution, frame, camera_format.format())
+            .with_state(FrameState::Rgb)
+            .with_metadata(metadata))
+    }
+
     fn stop_stream(&mut self) -> Result<(), NokhwaError> {
         match self.video_capture.release() {
             Ok(_) => Ok(()),
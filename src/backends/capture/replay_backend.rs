@@ -0,0 +1,347 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+use crate::{
+    mjpeg_to_rgb,
+    recording::{map_recording, read_index, RecordEntry},
+    yuyv422_to_rgb, Buffer, CameraControl, CameraFormat, CameraInfo, CaptureAPIBackend,
+    CaptureBackendTrait, ControlValueSetter, FrameFormat, FrameRef, FrameState, KnownCameraControl,
+    NokhwaError, Resolution, VirtualBackendTrait,
+};
+use memmap2::Mmap;
+use std::{
+    borrow::Cow,
+    collections::HashMap,
+    path::Path,
+    time::{Duration, Instant},
+};
+
+/// How fast a [`ReplayCaptureDevice`] hands out frames.
+#[derive(Copy, Clone, Debug, Hash, PartialEq, Eq, PartialOrd, Ord)]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "recording")))]
+pub enum ReplayRate {
+    /// At the rate the frames were recorded at, going by their timestamps (or the frame rate, if they have none).
+    Original,
+    /// As fast as they are asked for, e.g. to benchmark a decoding pipeline.
+    Unthrottled,
+}
+
+impl Default for ReplayRate {
+    fn default() -> Self {
+        ReplayRate::Original
+    }
+}
+
+/// A virtual backend that replays a recording made by a [`FrameRecorder`](crate::FrameRecorder).
+///
+/// The recording is memory mapped, and frames are handed out straight from the mapping: [`frame_raw()`](CaptureBackendTrait::frame_raw())
+/// and [`frame_ref()`](CaptureBackendTrait::frame_ref()) do not copy, so at [`ReplayRate::Unthrottled`] frames come out as fast as the page cache can supply them.
+///
+/// To see what this does, please see [`CaptureBackendTrait`] and [`VirtualBackendTrait`].
+/// # Quirks
+/// - The [`CameraFormat`] is the one the recording was made with and cannot be changed.
+/// - Frames keep the sequence numbers and [`FrameMetadata`](crate::FrameMetadata) they were recorded with, timestamps included.
+/// - There are no camera controls.
+/// - Once the last frame has been handed out, getting a frame errors, unless [`set_looping()`](ReplayCaptureDevice::set_looping) is on.
+/// - Only the frames that were in the recording when it was opened are replayed.
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "recording")))]
+pub struct ReplayCaptureDevice {
+    camera_info: CameraInfo,
+    camera_format: CameraFormat,
+    recording: Mmap,
+    frames: Vec<RecordEntry>,
+    position: usize,
+    rate: ReplayRate,
+    looping: bool,
+    stream_open: bool,
+    // when the first frame of the current run was handed out, and its recorded timestamp
+    pacing: Option<(Instant, Duration)>,
+}
+
+impl ReplayCaptureDevice {
+    /// Opens the recording at `path`, to be replayed at `rate`.
+    /// # Errors
+    /// If the file cannot be opened or is not a recording, this will error.
+    pub fn new(path: impl AsRef<Path>, rate: ReplayRate) -> Result<Self, NokhwaError> {
+        let path = path.as_ref();
+        let recording = map_recording(path)?;
+        let (camera_format, frames) = read_index(&recording)?;
+        let camera_info = CameraInfo::new(
+            &format!("Recording {}", path.display()),
+            &format!("{} frames of {camera_format}", frames.len()),
+            "",
+            0,
+        );
+
+        Ok(ReplayCaptureDevice {
+            camera_info,
+            camera_format,
+            recording,
+            frames,
+            position: 0,
+            rate,
+            looping: false,
+            stream_open: false,
+            pacing: None,
+        })
+    }
+
+    /// The [`ReplayRate`] frames are handed out at.
+    #[must_use]
+    pub fn rate(&self) -> ReplayRate {
+        self.rate
+    }
+
+    /// Sets the [`ReplayRate`] frames are handed out at.
+    pub fn set_rate(&mut self, rate: ReplayRate) {
+        self.rate = rate;
+        self.pacing = None;
+    }
+
+    /// Checks if the recording starts over once its last frame has been handed out.
+    #[must_use]
+    pub fn looping(&self) -> bool {
+        self.looping
+    }
+
+    /// Sets if the recording starts over once its last frame has been handed out.
+    pub fn set_looping(&mut self, looping: bool) {
+        self.looping = looping;
+    }
+
+    // sleeps until `entry`, the `index`th frame, is due
+    #[allow(clippy::cast_possible_truncation)]
+    fn pace(&mut self, index: usize, entry: &RecordEntry) {
+        if self.rate == ReplayRate::Unthrottled {
+            return;
+        }
+        let interval = Duration::from_secs(1) / self.camera_format.frame_rate().max(1);
+        let recorded = entry
+            .metadata
+            .timestamp()
+            .unwrap_or(interval * index as u32);
+        let (started, first) = *self.pacing.get_or_insert((Instant::now(), recorded));
+        let due = recorded.saturating_sub(first);
+        let elapsed = started.elapsed();
+        if due > elapsed {
+            std::thread::sleep(due - elapsed);
+        }
+    }
+
+    fn next_frame(&mut self) -> Result<(&[u8], RecordEntry), NokhwaError> {
+        if !self.stream_open {
+            return Err(NokhwaError::ReadFrameError(
+                "Stream is not open!".to_string(),
+            ));
+        }
+        if self.position >= self.frames.len() {
+            if !self.looping || self.frames.is_empty() {
+                return Err(NokhwaError::ReadFrameError("End of recording".to_string()));
+            }
+            self.position = 0;
+            self.pacing = None;
+        }
+
+        let index = self.position;
+        let entry = self.frames[index];
+        self.pace(index, &entry);
+        self.position += 1;
+        Ok((entry.data(&self.recording), entry))
+    }
+}
+
+impl CaptureBackendTrait for ReplayCaptureDevice {
+    fn init(&mut self) -> Result<CameraFormat, NokhwaError> {
+        Ok(self.camera_format)
+    }
+
+    fn backend(&self) -> CaptureAPIBackend {
+        CaptureAPIBackend::Replay
+    }
+
+    fn camera_info(&self) -> &CameraInfo {
+        &self.camera_info
+    }
+
+    fn refresh_camera_format(&mut self) -> Result<(), NokhwaError> {
+        Ok(())
+    }
+
+    fn camera_format(&self) -> CameraFormat {
+        self.camera_format
+    }
+
+    fn set_camera_format(&mut self, new_fmt: CameraFormat) -> Result<(), NokhwaError> {
+        if new_fmt == self.camera_format {
+            return Ok(());
+        }
+        Err(NokhwaError::SetPropertyError {
+            property: "CameraFormat".to_string(),
+            value: new_fmt.to_string(),
+            error: "A recording can only be replayed in the format it was recorded in".to_string(),
+        })
+    }
+
+    fn compatible_list_by_resolution(
+        &mut self,
+        fourcc: FrameFormat,
+    ) -> Result<HashMap<Resolution, Vec<u32>>, NokhwaError> {
+        let mut compatible = HashMap::new();
+        if fourcc == self.camera_format.format() {
+            compatible.insert(
+                self.camera_format.resolution(),
+                vec![self.camera_format.frame_rate()],
+            );
+        }
+        Ok(compatible)
+    }
+
+    fn compatible_fourcc(&mut self) -> Result<Vec<FrameFormat>, NokhwaError> {
+        Ok(vec![self.camera_format.format()])
+    }
+
+    fn resolution(&self) -> Resolution {
+        self.camera_format.resolution()
+    }
+
+    fn set_resolution(&mut self, new_res: Resolution) -> Result<(), NokhwaError> {
+        let mut new_fmt = self.camera_format;
+        new_fmt.set_resolution(new_res);
+        self.set_camera_format(new_fmt)
+    }
+
+    fn frame_rate(&self) -> u32 {
+        self.camera_format.frame_rate()
+    }
+
+    fn set_frame_rate(&mut self, new_fps: u32) -> Result<(), NokhwaError> {
+        let mut new_fmt = self.camera_format;
+        new_fmt.set_frame_rate(new_fps);
+        self.set_camera_format(new_fmt)
+    }
+
+    fn frame_format(&self) -> FrameFormat {
+        self.camera_format.format()
+    }
+
+    fn set_frame_format(&mut self, fourcc: FrameFormat) -> Result<(), NokhwaError> {
+        let mut new_fmt = self.camera_format;
+        new_fmt.set_format(fourcc);
+        self.set_camera_format(new_fmt)
+    }
+
+    fn camera_control(&self, control: KnownCameraControl) -> Result<CameraControl, NokhwaError> {
+        Err(NokhwaError::GetPropertyError {
+            property: control.to_string(),
+            error: "A recording has no camera controls".to_string(),
+        })
+    }
+
+    fn camera_controls(&self) -> Result<Vec<CameraControl>, NokhwaError> {
+        Ok(vec![])
+    }
+
+    fn set_camera_control(
+        &mut self,
+        _id: KnownCameraControl,
+        _value: ControlValueSetter,
+    ) -> Result<(), NokhwaError> {
+        Err(NokhwaError::UnsupportedOperationError(
+            CaptureAPIBackend::Replay,
+        ))
+    }
+
+    fn open_stream(&mut self) -> Result<(), NokhwaError> {
+        self.stream_open = true;
+        self.pacing = None;
+        Ok(())
+    }
+
+    fn is_stream_open(&self) -> bool {
+        self.stream_open
+    }
+
+    fn frame(&mut self) -> Result<Buffer, NokhwaError> {
+        let format = self.camera_format.format();
+        let (raw_frame, entry) = self.next_frame()?;
+        let buffer = match format {
+            FrameFormat::MJPEG => {
+                Buffer::new(entry.resolution, mjpeg_to_rgb(raw_frame, false)?, format)
+                    .with_state(FrameState::Rgb)
+            }
+            FrameFormat::YUYV => {
+                Buffer::new(entry.resolution, yuyv422_to_rgb(raw_frame, false)?, format)
+                    .with_state(FrameState::Rgb)
+            }
+            // planar frames are passed through as they were recorded, see `Buffer::planes()`
+            FrameFormat::GRAY8 | FrameFormat::NV12 | FrameFormat::I420 => {
+                let strides = entry.strides.map(|stride| stride as usize);
+                Buffer::with_strides(entry.resolution, raw_frame.to_vec(), format, &strides)?
+            }
+        };
+        Ok(buffer
+            .with_sequence(entry.sequence)
+            .with_metadata(entry.metadata))
+    }
+
+    fn frame_raw(&mut self) -> Result<Cow<[u8]>, NokhwaError> {
+        Ok(Cow::Borrowed(self.next_frame()?.0))
+    }
+
+    fn frame_ref(&mut self) -> Result<FrameRef, NokhwaError> {
+        let format = self.camera_format.format();
+        let (data, entry) = self.next_frame()?;
+        let frame = match format {
+            FrameFormat::MJPEG | FrameFormat::YUYV => {
+                FrameRef::new(entry.resolution, Cow::Borrowed(data), format)
+            }
+            // planar frames keep the strides they were recorded with
+            FrameFormat::GRAY8 | FrameFormat::NV12 | FrameFormat::I420 => {
+                let strides = entry.strides.map(|stride| stride as usize);
+                FrameRef::with_strides(entry.resolution, Cow::Borrowed(data), format, &strides)?
+            }
+        };
+        Ok(frame.with_metadata(entry.metadata))
+    }
+
+    fn stop_stream(&mut self) -> Result<(), NokhwaError> {
+        self.stream_open = false;
+        Ok(())
+    }
+}
+
+impl VirtualBackendTrait for ReplayCaptureDevice {
+    fn frame_count(&self) -> Option<usize> {
+        Some(self.frames.len())
+    }
+
+    fn position(&self) -> usize {
+        self.position
+    }
+
+    fn seek(&mut self, frame: usize) -> Result<(), NokhwaError> {
+        if frame >= self.frames.len() {
+            return Err(NokhwaError::SetPropertyError {
+                property: "Position".to_string(),
+                value: frame.to_string(),
+                error: format!("The recording has {} frames", self.frames.len()),
+            });
+        }
+        self.position = frame;
+        self.pacing = None;
+        Ok(())
+    }
+}
@@ -17,25 +17,38 @@
 use crate::{
     buffer::Buffer,
     error::NokhwaError,
+    metrics::{self, Stage},
     mjpeg_to_rgb,
-    pixel_format::PixelFormat,
     utils::{CameraFormat, CameraInfo},
     yuyv422_to_rgb, CameraControl, CaptureAPIBackend, CaptureBackendTrait, ControlDescription,
-    ControlValueSetter, FrameFormat, KnownCameraControl, KnownCameraControlFlag, Resolution,
+    ControlValueSetter, DequeueMode, DmaBuf, FrameCounter, FrameFormat, FrameMetadata, FrameRef,
+    FrameState, IoMode, KnownCameraControl, KnownCameraControlFlag, Resolution, StreamConfig,
+    DRM_FORMAT_MOD_LINEAR,
 };
-use image::ImageBuffer;
+#[cfg(feature = "output-async")]
+use async_io::Async;
 use std::{
     borrow::Cow,
     collections::HashMap,
     io::{self, ErrorKind},
+    os::unix::io::{FromRawFd, OwnedFd},
+    sync::Arc,
+    time::Duration,
+};
+#[cfg(feature = "output-async")]
+use std::{
+    os::unix::io::{AsRawFd, RawFd},
+    task::{Context, Poll},
 };
 use v4l::{
-    buffer::Type,
+    buffer::{Metadata, Type},
     control::{Control, Flags, Value},
+    device::Handle,
     frameinterval::FrameIntervalEnum,
     framesize::FrameSizeEnum,
     io::traits::CaptureStream,
-    prelude::MmapStream,
+    prelude::{MmapStream, UserptrStream},
+    v4l2::{self, vidioc},
     video::{capture::Parameters, Capture},
     Device, Format, FourCC,
 };
@@ -93,13 +106,25 @@ pub fn id_to_known_camera_control(id: u32) -> KnownCameraControl {
 /// - The `Any` return type for [`raw_supported_camera_controls()`](CaptureBackendTrait::raw_supported_camera_controls) is [`Description`]
 /// - The `Any` type for [`raw_camera_control()`](CaptureBackendTrait::raw_camera_control) is [`u32`], and its return `Any` is a [`Control`]
 /// - The `Any` type for `control` for [`set_raw_camera_control()`](CaptureBackendTrait::set_raw_camera_control) is [`u32`] and [`Control`]
+/// - [`frame_raw()`](CaptureBackendTrait::frame_raw) and [`frame_ref()`](CaptureBackendTrait::frame_ref) borrow the memory mapped driver buffer directly (zero-copy). The buffer is re-queued to the driver on the next dequeue.
+/// - [`open_stream_with()`](CaptureBackendTrait::open_stream_with) supports every [`IoMode`]. With [`DequeueMode::LowLatency`], every frame that is already waiting behind the newest one is re-queued straight away.
+/// - With [`IoMode::DmaBuf`], [`frame_dmabuf()`](CaptureBackendTrait::frame_dmabuf) hands out the driver buffer itself. The driver writes the next frame into it once it is re-queued,
+///   which happens on the next call to [`frame_dmabuf()`](CaptureBackendTrait::frame_dmabuf), so be done with the previous frame before asking for the next one (or copy it on the GPU).
+///   The driver buffers are only freed once every [`DmaBuf`] handed out is dropped, until then the stream cannot be opened again.
+/// - With the `output-async` feature, [`poll_frame_ready()`](CaptureBackendTrait::poll_frame_ready) waits on the device's file descriptor through `epoll` (using `async-io`'s reactor thread, shared by all cameras).
 #[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-v4l")))]
 pub struct V4LCaptureDevice<'a> {
     initialized: bool,
     camera_format: CameraFormat,
     camera_info: CameraInfo,
     device: Device,
-    stream_handle: Option<MmapStream<'a>>,
+    stream_handle: Option<V4LStream<'a>>,
+    stream_config: StreamConfig,
+    frame_counter: FrameCounter,
+    // the bytes per line of the driver's buffers, as of when the stream was opened
+    bytes_per_line: usize,
+    #[cfg(feature = "output-async")]
+    readiness: Option<Async<DeviceFd>>,
 }
 
 impl<'a> V4LCaptureDevice<'a> {
@@ -140,6 +165,8 @@ impl<'a> V4LCaptureDevice<'a> {
             FrameFormat::MJPEG => FourCC::new(b"MJPG"),
             FrameFormat::YUYV => FourCC::new(b"YUYV"),
             FrameFormat::GRAY8 => FourCC::new(b"GRAY"),
+            FrameFormat::NV12 => FourCC::new(b"NV12"),
+            FrameFormat::I420 => FourCC::new(b"YU12"),
         };
 
         let new_param = Parameters::with_fps(camera_format.frame_rate());
@@ -192,6 +219,11 @@ impl<'a> V4LCaptureDevice<'a> {
             camera_info,
             device,
             stream_handle: None,
+            stream_config: StreamConfig::default(),
+            frame_counter: FrameCounter::default(),
+            bytes_per_line: 0,
+            #[cfg(feature = "output-async")]
+            readiness: None,
         })
     }
 
@@ -214,6 +246,8 @@ impl<'a> V4LCaptureDevice<'a> {
             FrameFormat::MJPEG => FourCC::new(b"MJPG"),
             FrameFormat::YUYV => FourCC::new(b"YUYV"),
             FrameFormat::GRAY8 => FourCC::new(b"GRAY"),
+            FrameFormat::NV12 => FourCC::new(b"NV12"),
+            FrameFormat::I420 => FourCC::new(b"YU12"),
         };
 
         // match Capture::enum_framesizes(&self.device, format) {
@@ -273,6 +307,287 @@ impl<'a> V4LCaptureDevice<'a> {
     }
 }
 
+impl<'a> V4LCaptureDevice<'a> {
+    // dequeues the next buffer of the memory mapped stream, which stays borrowed until the next call
+    fn next_frame(&mut self) -> Result<(&[u8], FrameMetadata), NokhwaError> {
+        let _timer = metrics::time(Stage::Dequeue);
+        let stream_handler = match &mut self.stream_handle {
+            Some(stream_handler) => stream_handler,
+            None => {
+                return Err(NokhwaError::ReadFrameError(
+                    "Stream not initialized! Please call \"open_stream()\" first!".to_string(),
+                ))
+            }
+        };
+
+        let read_error = |why: io::Error| NokhwaError::ReadFrameError(why.to_string());
+        let (data, meta) = stream_handler.next().map_err(read_error)?;
+        let (mut data, mut meta): (*const [u8], Metadata) = (data, *meta);
+        if self.stream_config.dequeue_mode() == DequeueMode::LowLatency {
+            let handle = self.device.handle();
+            // if another buffer is done already, this one is stale: give it back and take that one
+            while buffer_ready(&handle) {
+                let (newer_data, newer_meta) = stream_handler.next().map_err(read_error)?;
+                data = newer_data;
+                meta = *newer_meta;
+            }
+        }
+        // SAFETY: `data` points into the newest dequeued buffer, which is only given back to the driver by the next `next()`.
+        // That needs `&mut self`, which the returned borrow prevents.
+        let data = unsafe { &*data };
+
+        let metadata = self.frame_counter.sequenced(
+            u64::from(meta.sequence),
+            driver_timestamp(meta.timestamp.sec, meta.timestamp.usec),
+        );
+        Ok((data, metadata))
+    }
+
+    // strides of the planes of the current format, from the bytes per line of the driver
+    fn plane_strides(&self, bytes_per_line: usize) -> [usize; 3] {
+        match self.camera_format.format() {
+            FrameFormat::NV12 => [bytes_per_line, bytes_per_line, 0],
+            FrameFormat::I420 => [bytes_per_line, bytes_per_line / 2, bytes_per_line / 2],
+            FrameFormat::MJPEG | FrameFormat::YUYV | FrameFormat::GRAY8 => [bytes_per_line, 0, 0],
+        }
+    }
+}
+
+// the device's file descriptor, for `async-io` to wait on. The device is opened non-blocking already.
+#[cfg(feature = "output-async")]
+struct DeviceFd(Arc<Handle>);
+
+#[cfg(feature = "output-async")]
+impl AsRawFd for DeviceFd {
+    fn as_raw_fd(&self) -> RawFd {
+        self.0.fd()
+    }
+}
+
+// the stream types of the I/O modes `V4L2` supports
+enum V4LStream<'a> {
+    Mmap(MmapStream<'a>),
+    UserPtr(UserptrStream),
+    DmaBuf(DmaBufStream),
+}
+
+impl<'a> V4LStream<'a> {
+    fn new(device: &Device, config: StreamConfig) -> io::Result<Self> {
+        match config.io_mode() {
+            IoMode::Mmap => {
+                MmapStream::with_buffers(device, Type::VideoCapture, config.buffer_count())
+                    .map(V4LStream::Mmap)
+            }
+            IoMode::UserPtr => {
+                UserptrStream::with_buffers(device, Type::VideoCapture, config.buffer_count())
+                    .map(V4LStream::UserPtr)
+            }
+            IoMode::DmaBuf => {
+                DmaBufStream::new(device, config.buffer_count()).map(V4LStream::DmaBuf)
+            }
+        }
+    }
+
+    fn next(&mut self) -> io::Result<(&[u8], &Metadata)> {
+        match self {
+            V4LStream::Mmap(stream) => stream.next(),
+            V4LStream::UserPtr(stream) => stream.next(),
+            V4LStream::DmaBuf(_) => Err(io::Error::new(
+                ErrorKind::Unsupported,
+                "The stream hands out DMABUFs, use `frame_dmabuf()`",
+            )),
+        }
+    }
+}
+
+// the flags of the exported file descriptors
+#[allow(clippy::cast_sign_loss)]
+const EXPORT_FLAGS: u32 = (libc::O_CLOEXEC | libc::O_RDWR) as u32;
+
+// Frees the driver's buffers (`VIDIOC_REQBUFS` with a count of 0). The driver refuses to (`EBUSY`) while any of them
+// is still exported, so every `DmaBuf` handed out keeps this alive, and it goes last.
+struct DriverBuffers {
+    handle: Arc<Handle>,
+}
+
+impl Drop for DriverBuffers {
+    fn drop(&mut self) {
+        let mut request: v4l2_sys_mit::v4l2_requestbuffers = unsafe { std::mem::zeroed() };
+        request.type_ = Type::VideoCapture as u32;
+        request.memory = v4l2_sys_mit::v4l2_memory_V4L2_MEMORY_MMAP;
+        // SAFETY: every ioctl gets the struct it is defined with.
+        let _free = unsafe {
+            v4l2::ioctl(
+                self.handle.fd(),
+                vidioc::VIDIOC_REQBUFS,
+                (&mut request as *mut v4l2_sys_mit::v4l2_requestbuffers).cast(),
+            )
+        };
+    }
+}
+
+// The driver's buffers, exported as `DMABUF`s (`VIDIOC_EXPBUF`). They are never mapped into memory,
+// so this talks to the driver directly instead of going through one of `v4l`'s streams.
+struct DmaBufStream {
+    handle: Arc<Handle>,
+    buffers: Vec<Arc<OwnedFd>>,
+    // declared after `buffers`, so their file descriptors are closed first
+    driver_buffers: Arc<DriverBuffers>,
+    bytes_per_line: usize,
+    // the buffer handed out last, given back to the driver on the next dequeue
+    dequeued: Option<u32>,
+    streaming: bool,
+}
+
+impl DmaBufStream {
+    fn new(device: &Device, buffer_count: u32) -> io::Result<Self> {
+        let handle = device.handle();
+        let bytes_per_line = Capture::format(device)?.stride as usize;
+
+        // SAFETY: these are plain C structs, for which all zeroes is a valid (empty) value.
+        let mut request: v4l2_sys_mit::v4l2_requestbuffers = unsafe { std::mem::zeroed() };
+        request.count = buffer_count;
+        request.type_ = Type::VideoCapture as u32;
+        request.memory = v4l2_sys_mit::v4l2_memory_V4L2_MEMORY_MMAP;
+        // SAFETY: every ioctl gets the struct it is defined with.
+        unsafe {
+            v4l2::ioctl(
+                handle.fd(),
+                vidioc::VIDIOC_REQBUFS,
+                (&mut request as *mut v4l2_sys_mit::v4l2_requestbuffers).cast(),
+            )?;
+        }
+        // frees the buffers again if exporting one of them fails
+        let driver_buffers = Arc::new(DriverBuffers {
+            handle: handle.clone(),
+        });
+
+        let mut buffers = Vec::with_capacity(request.count as usize);
+        for index in 0..request.count {
+            let mut export: v4l2_sys_mit::v4l2_exportbuffer = unsafe { std::mem::zeroed() };
+            export.type_ = Type::VideoCapture as u32;
+            export.index = index;
+            export.flags = EXPORT_FLAGS;
+            unsafe {
+                v4l2::ioctl(
+                    handle.fd(),
+                    vidioc::VIDIOC_EXPBUF,
+                    (&mut export as *mut v4l2_sys_mit::v4l2_exportbuffer).cast(),
+                )?;
+            }
+            // SAFETY: the driver just opened this file descriptor for us, nobody else owns it.
+            buffers.push(Arc::new(unsafe { OwnedFd::from_raw_fd(export.fd) }));
+        }
+
+        Ok(DmaBufStream {
+            handle,
+            buffers,
+            driver_buffers,
+            bytes_per_line,
+            dequeued: None,
+            streaming: false,
+        })
+    }
+
+    fn queue(&self, index: u32) -> io::Result<()> {
+        let mut buffer: v4l2_sys_mit::v4l2_buffer = unsafe { std::mem::zeroed() };
+        buffer.type_ = Type::VideoCapture as u32;
+        buffer.memory = v4l2_sys_mit::v4l2_memory_V4L2_MEMORY_MMAP;
+        buffer.index = index;
+        unsafe {
+            v4l2::ioctl(
+                self.handle.fd(),
+                vidioc::VIDIOC_QBUF,
+                (&mut buffer as *mut v4l2_sys_mit::v4l2_buffer).cast(),
+            )
+        }
+    }
+
+    fn dequeue(&mut self) -> io::Result<v4l2_sys_mit::v4l2_buffer> {
+        if let Some(index) = self.dequeued.take() {
+            self.queue(index)?;
+        }
+        // the device is opened non-blocking
+        self.handle.poll(libc::POLLIN, -1)?;
+        let mut buffer: v4l2_sys_mit::v4l2_buffer = unsafe { std::mem::zeroed() };
+        buffer.type_ = Type::VideoCapture as u32;
+        buffer.memory = v4l2_sys_mit::v4l2_memory_V4L2_MEMORY_MMAP;
+        unsafe {
+            v4l2::ioctl(
+                self.handle.fd(),
+                vidioc::VIDIOC_DQBUF,
+                (&mut buffer as *mut v4l2_sys_mit::v4l2_buffer).cast(),
+            )?;
+        }
+        self.dequeued = Some(buffer.index);
+        Ok(buffer)
+    }
+
+    // dequeues the next filled buffer, giving the last one back to the driver
+    fn next(&mut self, low_latency: bool) -> io::Result<v4l2_sys_mit::v4l2_buffer> {
+        if !self.streaming {
+            for index in 0..self.buffers.len() {
+                #[allow(clippy::cast_possible_truncation)]
+                self.queue(index as u32)?;
+            }
+            let mut buffer_type = Type::VideoCapture as u32;
+            unsafe {
+                v4l2::ioctl(
+                    self.handle.fd(),
+                    vidioc::VIDIOC_STREAMON,
+                    (&mut buffer_type as *mut u32).cast(),
+                )?;
+            }
+            self.streaming = true;
+        }
+
+        let mut buffer = self.dequeue()?;
+        while low_latency && buffer_ready(&self.handle) {
+            buffer = self.dequeue()?;
+        }
+        Ok(buffer)
+    }
+}
+
+impl Drop for DmaBufStream {
+    fn drop(&mut self) {
+        // the buffers themselves are freed by `DriverBuffers`, once the last `DmaBuf` handed out is dropped
+        let mut buffer_type = Type::VideoCapture as u32;
+        let _stream_off = unsafe {
+            v4l2::ioctl(
+                self.handle.fd(),
+                vidioc::VIDIOC_STREAMOFF,
+                (&mut buffer_type as *mut u32).cast(),
+            )
+        };
+    }
+}
+
+// Checks, without waiting, if the driver has a filled buffer to dequeue. `Handle::poll()` counts the device as ready on `POLLERR`
+// too, which the driver reports when no buffer is queued at all (e.g. the only buffer of the stream was just dequeued).
+fn buffer_ready(handle: &Handle) -> bool {
+    let mut poll_fd = libc::pollfd {
+        fd: handle.fd(),
+        events: libc::POLLIN,
+        revents: 0,
+    };
+    // SAFETY: `poll_fd` is the one entry `poll` is told about.
+    let ready = unsafe { libc::poll(&mut poll_fd, 1, 0) };
+    ready > 0 && poll_fd.revents & libc::POLLIN != 0
+}
+
+// drivers that do not timestamp their buffers leave it at 0
+fn driver_timestamp(secs: impl TryInto<u64>, micros: impl TryInto<u64>) -> Option<Duration> {
+    let secs = secs.try_into().ok()?;
+    let micros = micros.try_into().ok()?;
+    let timestamp = Duration::from_secs(secs) + Duration::from_micros(micros);
+    if timestamp.is_zero() {
+        None
+    } else {
+        Some(timestamp)
+    }
+}
+
 impl<'a> CaptureBackendTrait for V4LCaptureDevice<'a> {
     fn init(&mut self) -> Result<CameraFormat, NokhwaError> {
         let camera_format = self.camera_format;
@@ -395,6 +710,8 @@ impl<'a> CaptureBackendTrait for V4LCaptureDevice<'a> {
             FrameFormat::MJPEG => FourCC::new(b"MJPG"),
             FrameFormat::YUYV => FourCC::new(b"YUYV"),
             FrameFormat::GRAY8 => FourCC::new(b"GRAY"),
+            FrameFormat::NV12 => FourCC::new(b"NV12"),
+            FrameFormat::I420 => FourCC::new(b"YU12"),
         };
         let mut res_map = HashMap::new();
         for res in resolutions {
@@ -442,6 +759,8 @@ impl<'a> CaptureBackendTrait for V4LCaptureDevice<'a> {
                     match format_as_string {
                         "YUYV" => frame_format_vec.push(FrameFormat::YUYV),
                         "MJPG" => frame_format_vec.push(FrameFormat::MJPEG),
+                        "NV12" => frame_format_vec.push(FrameFormat::NV12),
+                        "YU12" => frame_format_vec.push(FrameFormat::I420),
                         _ => {}
                     }
                 }
@@ -636,45 +955,144 @@ impl<'a> CaptureBackendTrait for V4LCaptureDevice<'a> {
     }
 
     fn open_stream(&mut self) -> Result<(), NokhwaError> {
-        let stream = match MmapStream::new(&self.device, Type::VideoCapture) {
+        // the old buffers have to be freed before the driver can allocate new ones
+        self.stream_handle = None;
+        self.bytes_per_line = match Capture::format(&self.device) {
+            Ok(format) => format.stride as usize,
+            Err(why) => return Err(NokhwaError::OpenStreamError(why.to_string())),
+        };
+        let stream = match V4LStream::new(&self.device, self.stream_config) {
             Ok(s) => s,
             Err(why) => return Err(NokhwaError::OpenStreamError(why.to_string())),
         };
         self.stream_handle = Some(stream);
+        // the driver numbers the frames of every stream from 0
+        self.frame_counter.reset();
         Ok(())
     }
 
+    fn open_stream_with(&mut self, config: StreamConfig) -> Result<(), NokhwaError> {
+        self.stream_config = config;
+        self.open_stream()
+    }
+
+    fn stream_config(&self) -> StreamConfig {
+        self.stream_config
+    }
+
+    fn frame_dmabuf(&mut self) -> Result<Buffer, NokhwaError> {
+        let _timer = metrics::time(Stage::Dequeue);
+        let low_latency = self.stream_config.dequeue_mode() == DequeueMode::LowLatency;
+        let stream = match &mut self.stream_handle {
+            Some(V4LStream::DmaBuf(stream)) => stream,
+            Some(_) => {
+                return Err(NokhwaError::ReadFrameError(
+                    "Stream was not opened with `IoMode::DmaBuf`!".to_string(),
+                ))
+            }
+            None => {
+                return Err(NokhwaError::ReadFrameError(
+                    "Stream not initialized! Please call \"open_stream()\" first!".to_string(),
+                ))
+            }
+        };
+
+        let dequeued = stream
+            .next(low_latency)
+            .map_err(|why| NokhwaError::ReadFrameError(why.to_string()))?;
+        let dmabuf = DmaBuf::new(
+            stream.buffers[dequeued.index as usize].clone(),
+            dequeued.bytesused as usize,
+            DRM_FORMAT_MOD_LINEAR,
+        )
+        .with_owner(stream.driver_buffers.clone());
+        let bytes_per_line = stream.bytes_per_line;
+        let strides = self.plane_strides(bytes_per_line);
+        let metadata = self.frame_counter.sequenced(
+            u64::from(dequeued.sequence),
+            driver_timestamp(dequeued.timestamp.tv_sec, dequeued.timestamp.tv_usec),
+        );
+
+        Ok(Buffer::from_dmabuf(
+            self.camera_format.resolution(),
+            dmabuf,
+            self.camera_format.format(),
+            &strides,
+        )?
+        .with_metadata(metadata))
+    }
+
+    #[cfg(feature = "output-async")]
+    fn poll_frame_ready(&mut self, cx: &mut Context<'_>) -> Poll<Result<(), NokhwaError>> {
+        // let getting the frame say why it cannot
+        if self.stream_handle.is_none() {
+            return Poll::Ready(Ok(()));
+        }
+
+        let readiness = match self.readiness.take() {
+            Some(readiness) => readiness,
+            None => match Async::new(DeviceFd(self.device.handle())) {
+                Ok(readiness) => readiness,
+                Err(why) => return Poll::Ready(Err(NokhwaError::ReadFrameError(why.to_string()))),
+            },
+        };
+        let readiness = self.readiness.insert(readiness);
+        // The driver only starts streaming on the first dequeue. Until then the device polls as an error, which reads as ready,
+        // so the first frame after opening the stream is waited for by the dequeue itself.
+        readiness
+            .poll_readable(cx)
+            .map_err(|why| NokhwaError::ReadFrameError(why.to_string()))
+    }
+
     fn is_stream_open(&self) -> bool {
         self.stream_handle.is_some()
     }
 
     fn frame(&mut self) -> Result<Buffer, NokhwaError> {
         let cam_fmt = self.camera_format;
-        let raw_frame = self.frame_raw()?;
-        let conv = match cam_fmt.format() {
-            FrameFormat::MJPEG => mjpeg_to_rgb(&raw_frame, false)?,
-            FrameFormat::YUYV => yuyv422_to_rgb(&raw_frame, false)?,
-            FrameFormat::GRAY8 => raw_frame.to_vec(),
-        };
-        Ok(Buffer::new(cam_fmt.resolution(), conv, cam_fmt.format()))
+        let strides = self.plane_strides(self.bytes_per_line);
+        let (raw_frame, metadata) = self.next_frame()?;
+        match cam_fmt.format() {
+            FrameFormat::MJPEG => Ok(Buffer::new(
+                cam_fmt.resolution(),
+                mjpeg_to_rgb(raw_frame, false)?,
+                FrameFormat::MJPEG,
+            )
+            .with_state(FrameState::Rgb)
+            .with_metadata(metadata)),
+            FrameFormat::YUYV => Ok(Buffer::new(
+                cam_fmt.resolution(),
+                yuyv422_to_rgb(raw_frame, false)?,
+                FrameFormat::YUYV,
+            )
+            .with_state(FrameState::Rgb)
+            .with_metadata(metadata)),
+            // planar frames are passed through as they are, with the driver's strides, see `Buffer::planes()`
+            format @ (FrameFormat::GRAY8 | FrameFormat::NV12 | FrameFormat::I420) => Ok(
+                Buffer::with_strides(cam_fmt.resolution(), raw_frame.to_vec(), format, &strides)?
+                    .with_metadata(metadata),
+            ),
+        }
     }
 
-    fn frame_typed<F: PixelFormat>(
-        &mut self,
-    ) -> Result<ImageBuffer<F::Output, Vec<u8>>, NokhwaError> {
-        self.frame()?.to_image_with_custom_format::<F>()
+    fn frame_raw(&mut self) -> Result<Cow<[u8]>, NokhwaError> {
+        Ok(Cow::from(self.next_frame()?.0))
     }
 
-    fn frame_raw(&mut self) -> Result<Cow<[u8]>, NokhwaError> {
-        match &mut self.stream_handle {
-            Some(stream_handler) => match stream_handler.next() {
-                Ok((data, _)) => Ok(Cow::from(data)),
-                Err(why) => Err(NokhwaError::ReadFrameError(why.to_string())),
-            },
-            None => Err(NokhwaError::ReadFrameError(
-                "Stream not initialized! Please call \"open_stream()\" first!".to_string(),
-            )),
-        }
+    fn frame_ref(&mut self) -> Result<FrameRef, NokhwaError> {
+        let cam_fmt = self.camera_format;
+        let strides = self.plane_strides(self.bytes_per_line);
+        let (data, metadata) = self.next_frame()?;
+        let frame = match cam_fmt.format() {
+            FrameFormat::MJPEG | FrameFormat::YUYV => {
+                FrameRef::new(cam_fmt.resolution(), Cow::from(data), cam_fmt.format())
+            }
+            // with the driver's strides, like `frame()`
+            format @ (FrameFormat::GRAY8 | FrameFormat::NV12 | FrameFormat::I420) => {
+                FrameRef::with_strides(cam_fmt.resolution(), Cow::from(data), format, &strides)?
+            }
+        };
+        Ok(frame.with_metadata(metadata))
     }
 
     fn stop_stream(&mut self) -> Result<(), NokhwaError> {
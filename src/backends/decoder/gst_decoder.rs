@@ -0,0 +1,221 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+use crate::{CaptureAPIBackend, FrameDecoder, FrameFormat, NokhwaError, Resolution};
+use gstreamer::{
+    glib::Cast,
+    prelude::{ElementExt, GstBinExt},
+    Bin, ClockTime, Element, ElementFactory, State,
+};
+use gstreamer_app::{AppSink, AppSrc};
+use gstreamer_video::VideoInfo;
+
+// hardware JPEG decoders, in order of preference
+const HARDWARE_JPEG_DECODERS: &[&str] = &["vajpegdec", "vaapijpegdec", "v4l2jpegdec", "nvjpegdec"];
+
+// how long to wait for a frame to come out of the decoder before giving up on it
+const DECODE_TIMEOUT_MS: u64 = 1000;
+
+/// A `MJPEG` decoder that uses `GStreamer`'s hardware JPEG decoders: `VA-API` (`vajpegdec`/`vaapijpegdec`), `V4L2` memory-to-memory (`v4l2jpegdec`)
+/// or `NVDEC` (`nvjpegdec`), whichever is installed first.
+/// # Quirks
+/// - Every frame is copied into a `GStreamer` buffer before being decoded.
+/// - The conversion to RGB is done by `videoconvert`, on the CPU.
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-gst")))]
+pub struct GStreamerMjpegDecoder {
+    pipeline: Element,
+    app_src: AppSrc,
+    app_sink: AppSink,
+    element: &'static str,
+    rgba: bool,
+}
+
+impl GStreamerMjpegDecoder {
+    /// Creates a new [`GStreamerMjpegDecoder`] that decodes to RGB888, or RGBA if `rgba` is true.
+    /// # Errors
+    /// If `GStreamer` fails to initialize, no hardware JPEG decoder is installed, or the pipeline fails to start, this will error.
+    pub fn new(rgba: bool) -> Result<Self, NokhwaError> {
+        if let Err(why) = gstreamer::init() {
+            return Err(NokhwaError::InitializeError {
+                backend: CaptureAPIBackend::GStreamer,
+                error: why.to_string(),
+            });
+        }
+
+        let element = match HARDWARE_JPEG_DECODERS
+            .iter()
+            .find(|name| ElementFactory::find(name).is_some())
+        {
+            Some(element) => *element,
+            None => {
+                return Err(NokhwaError::NotImplementedError(
+                    "No hardware JPEG decoder found".to_string(),
+                ))
+            }
+        };
+
+        let pipeline_args = decoder_pipeline(element, rgba);
+        let pipeline = match gstreamer::parse_launch(&pipeline_args) {
+            Ok(p) => p,
+            Err(why) => {
+                return Err(NokhwaError::GeneralError(format!(
+                    "Failed to open pipeline with args {}: {}",
+                    pipeline_args, why
+                )))
+            }
+        };
+
+        let bin = match pipeline.clone().dynamic_cast::<Bin>() {
+            Ok(bin) => bin,
+            Err(_) => {
+                return Err(NokhwaError::GeneralError(
+                    "Failed to get pipeline as bin".to_string(),
+                ))
+            }
+        };
+        let app_src = match bin
+            .by_name("appsrc")
+            .map(|element| element.dynamic_cast::<AppSrc>())
+        {
+            Some(Ok(app_src)) => app_src,
+            _ => {
+                return Err(NokhwaError::GeneralError(
+                    "Failed to get source element as appsrc".to_string(),
+                ))
+            }
+        };
+        let app_sink = match bin
+            .by_name("appsink")
+            .map(|element| element.dynamic_cast::<AppSink>())
+        {
+            Some(Ok(app_sink)) => app_sink,
+            _ => {
+                return Err(NokhwaError::GeneralError(
+                    "Failed to get sink element as appsink".to_string(),
+                ))
+            }
+        };
+
+        if let Err(why) = pipeline.set_state(State::Playing) {
+            let _ = pipeline.set_state(State::Null);
+            return Err(NokhwaError::GeneralError(format!(
+                "Failed to start pipeline: {}",
+                why
+            )));
+        }
+
+        Ok(GStreamerMjpegDecoder {
+            pipeline,
+            app_src,
+            app_sink,
+            element,
+            rgba,
+        })
+    }
+
+    fn process_error(&self, error: String) -> NokhwaError {
+        NokhwaError::ProcessFrameError {
+            src: FrameFormat::MJPEG,
+            destination: if self.rgba { "RGBA8888" } else { "RGB888" }.to_string(),
+            error,
+        }
+    }
+}
+
+impl FrameDecoder for GStreamerMjpegDecoder {
+    fn name(&self) -> &'static str {
+        self.element
+    }
+
+    fn hardware_accelerated(&self) -> bool {
+        true
+    }
+
+    fn source_format(&self) -> FrameFormat {
+        FrameFormat::MJPEG
+    }
+
+    fn rgba(&self) -> bool {
+        self.rgba
+    }
+
+    fn decoded_size(&self, source: Resolution) -> usize {
+        let pixel_size = if self.rgba { 4 } else { 3 };
+        (source.width() * source.height()) as usize * pixel_size
+    }
+
+    fn decode_frame(
+        &mut self,
+        data: &[u8],
+        _source: Resolution,
+        dest: &mut [u8],
+    ) -> Result<Resolution, NokhwaError> {
+        if let Err(why) = self
+            .app_src
+            .push_buffer(gstreamer::Buffer::from_slice(data.to_vec()))
+        {
+            return Err(self.process_error(format!("Failed to push frame: {}", why)));
+        }
+
+        let sample = match self
+            .app_sink
+            .try_pull_sample(ClockTime::from_mseconds(DECODE_TIMEOUT_MS))
+        {
+            Some(sample) => sample,
+            None => return Err(self.process_error("Timed out waiting for frame".to_string())),
+        };
+        let video_info = match sample.caps().map(VideoInfo::from_caps) {
+            Some(Ok(video_info)) => video_info,
+            _ => return Err(self.process_error("Failed to get videoinfo from caps".to_string())),
+        };
+        let buffer_map = match sample.buffer().map(|buffer| buffer.map_readable()) {
+            Some(Ok(buffer_map)) => buffer_map,
+            _ => return Err(self.process_error("Failed to map buffer".to_string())),
+        };
+
+        let resolution = Resolution::new(video_info.width(), video_info.height());
+        let row_size = video_info.width() as usize * if self.rgba { 4 } else { 3 };
+        if dest.len() != row_size * video_info.height() as usize {
+            return Err(self.process_error(format!(
+                "Bad destination buffer size: expected {}, got {}",
+                row_size * video_info.height() as usize,
+                dest.len()
+            )));
+        }
+
+        // videoconvert pads rows to 4 bytes
+        #[allow(clippy::cast_sign_loss)]
+        let stride = video_info.stride()[0] as usize;
+        for (row, dest_row) in dest.chunks_exact_mut(row_size).enumerate() {
+            match buffer_map.get(row * stride..row * stride + row_size) {
+                Some(src_row) => dest_row.copy_from_slice(src_row),
+                None => return Err(self.process_error("Buffer too small".to_string())),
+            }
+        }
+
+        Ok(resolution)
+    }
+}
+
+impl Drop for GStreamerMjpegDecoder {
+    fn drop(&mut self) {
+        let _ = self.pipeline.set_state(State::Null);
+    }
+}
+
+fn decoder_pipeline(element: &str, rgba: bool) -> String {
+    format!("appsrc name=appsrc is-live=true format=time do-timestamp=true caps=image/jpeg ! jpegparse ! {} ! videoconvert ! video/x-raw,format={} ! appsink name=appsink sync=false max-buffers=1", element, if rgba { "RGBA" } else { "RGB" })
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! Hardware `MJPEG` decoders, used by [`AutoMjpegDecoder`](crate::AutoMjpegDecoder).
+//!
+//! Each of these implements [`FrameDecoder`] and can also be used on its own.
+
+use crate::FrameDecoder;
+
+#[cfg(all(feature = "input-gst", target_os = "linux"))]
+mod gst_decoder;
+#[cfg(all(feature = "input-gst", target_os = "linux"))]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-gst")))]
+pub use gst_decoder::GStreamerMjpegDecoder;
+#[cfg(all(feature = "input-msmf", target_os = "windows"))]
+mod msmf_decoder;
+#[cfg(all(feature = "input-msmf", target_os = "windows"))]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-msmf")))]
+pub use msmf_decoder::MediaFoundationMjpegDecoder;
+#[cfg(all(
+    feature = "input-avfoundation",
+    any(target_os = "macos", target_os = "ios")
+))]
+mod videotoolbox_decoder;
+#[cfg(all(
+    feature = "input-avfoundation",
+    any(target_os = "macos", target_os = "ios")
+))]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-avfoundation")))]
+pub use videotoolbox_decoder::VideoToolboxMjpegDecoder;
+
+/// Opens the hardware `MJPEG` decoder of this platform, if there is one that works.
+#[allow(unused_variables)]
+pub(crate) fn hardware_mjpeg_decoder(rgba: bool) -> Option<Box<dyn FrameDecoder>> {
+    #[cfg(all(feature = "input-gst", target_os = "linux"))]
+    {
+        if let Ok(decoder) = GStreamerMjpegDecoder::new(rgba) {
+            return Some(Box::new(decoder));
+        }
+    }
+    #[cfg(all(feature = "input-msmf", target_os = "windows"))]
+    {
+        if let Ok(decoder) = MediaFoundationMjpegDecoder::new(rgba) {
+            return Some(Box::new(decoder));
+        }
+    }
+    #[cfg(all(
+        feature = "input-avfoundation",
+        any(target_os = "macos", target_os = "ios")
+    ))]
+    {
+        if let Ok(decoder) = VideoToolboxMjpegDecoder::new(rgba) {
+            return Some(Box::new(decoder));
+        }
+    }
+    None
+}
+
+// B, G, R, X -> R, G, B (, A)
+#[cfg(any(
+    all(feature = "input-msmf", target_os = "windows"),
+    all(
+        feature = "input-avfoundation",
+        any(target_os = "macos", target_os = "ios")
+    )
+))]
+fn bgrx_to_rgb(data: &[u8], dest: &mut [u8], rgba: bool) -> Result<(), crate::NokhwaError> {
+    let pixel_size = if rgba { 4 } else { 3 };
+    if data.len() % 4 != 0 || dest.len() != data.len() / 4 * pixel_size {
+        return Err(crate::NokhwaError::ProcessFrameError {
+            src: crate::FrameFormat::MJPEG,
+            destination: if rgba { "RGBA8888" } else { "RGB888" }.to_string(),
+            error: format!(
+                "Bad destination buffer size: expected {}, got {}",
+                data.len() / 4 * pixel_size,
+                dest.len()
+            ),
+        });
+    }
+
+    for (bgrx, pixel) in data.chunks_exact(4).zip(dest.chunks_exact_mut(pixel_size)) {
+        pixel[0] = bgrx[2];
+        pixel[1] = bgrx[1];
+        pixel[2] = bgrx[0];
+        if rgba {
+            pixel[3] = 255;
+        }
+    }
+    Ok(())
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+use super::bgrx_to_rgb;
+use crate::{
+    buf_nv12_to_rgb, buf_yuyv422_to_rgb, FrameDecoder, FrameFormat, NokhwaError, Resolution,
+};
+use nokhwa_bindings_windows::{wmf, MFDecodedFormat, MFResolution};
+
+/// A `MJPEG` decoder that uses the hardware JPEG decoder `MFT` of the GPU through `Media Foundation`.
+/// # Quirks
+/// - Hardware `MFT`s output `YUY2` or `NV12` most of the time, which is then converted to RGB on the CPU.
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-msmf")))]
+pub struct MediaFoundationMjpegDecoder {
+    inner: wmf::MediaFoundationMjpegDecoder,
+    rgba: bool,
+}
+
+impl MediaFoundationMjpegDecoder {
+    /// Creates a new [`MediaFoundationMjpegDecoder`] that decodes to RGB888, or RGBA if `rgba` is true.
+    /// # Errors
+    /// If `Media Foundation` fails to initialize or there is no hardware JPEG decoder, this will error.
+    pub fn new(rgba: bool) -> Result<Self, NokhwaError> {
+        Ok(MediaFoundationMjpegDecoder {
+            inner: wmf::MediaFoundationMjpegDecoder::new()?,
+            rgba,
+        })
+    }
+}
+
+impl FrameDecoder for MediaFoundationMjpegDecoder {
+    fn name(&self) -> &'static str {
+        "msmf-mft"
+    }
+
+    fn hardware_accelerated(&self) -> bool {
+        true
+    }
+
+    fn source_format(&self) -> FrameFormat {
+        FrameFormat::MJPEG
+    }
+
+    fn rgba(&self) -> bool {
+        self.rgba
+    }
+
+    fn decoded_size(&self, source: Resolution) -> usize {
+        let pixel_size = if self.rgba { 4 } else { 3 };
+        (source.width() * source.height()) as usize * pixel_size
+    }
+
+    fn decode_frame(
+        &mut self,
+        data: &[u8],
+        source: Resolution,
+        dest: &mut [u8],
+    ) -> Result<Resolution, NokhwaError> {
+        let frame = self.inner.decode(
+            data,
+            MFResolution {
+                width_x: source.width(),
+                height_y: source.height(),
+            },
+        )?;
+        let resolution = Resolution::new(frame.resolution.width_x, frame.resolution.height_y);
+
+        match frame.format {
+            MFDecodedFormat::RGB32 => bgrx_to_rgb(frame.data, dest, self.rgba)?,
+            MFDecodedFormat::YUY2 => buf_yuyv422_to_rgb(frame.data, dest, self.rgba)?,
+            MFDecodedFormat::NV12 => buf_nv12_to_rgb(resolution, frame.data, dest, self.rgba)?,
+        }
+        Ok(resolution)
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+use super::bgrx_to_rgb;
+use crate::{FrameDecoder, FrameFormat, NokhwaError, Resolution};
+use nokhwa_bindings_macos::video_toolbox;
+
+/// A `MJPEG` decoder that uses the hardware JPEG decoder through `VideoToolbox`.
+/// # Quirks
+/// - `VideoToolbox` decodes to BGRA, which is then swizzled to RGB on the CPU.
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-avfoundation")))]
+pub struct VideoToolboxMjpegDecoder {
+    inner: video_toolbox::VideoToolboxMjpegDecoder,
+    rgba: bool,
+}
+
+impl VideoToolboxMjpegDecoder {
+    /// Creates a new [`VideoToolboxMjpegDecoder`] that decodes to RGB888, or RGBA if `rgba` is true.
+    /// # Errors
+    /// If there is no hardware JPEG decoder, this will error.
+    pub fn new(rgba: bool) -> Result<Self, NokhwaError> {
+        // the session is made again for the actual resolution on the first frame
+        Ok(VideoToolboxMjpegDecoder {
+            inner: video_toolbox::VideoToolboxMjpegDecoder::new(640, 480)?,
+            rgba,
+        })
+    }
+}
+
+impl FrameDecoder for VideoToolboxMjpegDecoder {
+    fn name(&self) -> &'static str {
+        "videotoolbox"
+    }
+
+    fn hardware_accelerated(&self) -> bool {
+        true
+    }
+
+    fn source_format(&self) -> FrameFormat {
+        FrameFormat::MJPEG
+    }
+
+    fn rgba(&self) -> bool {
+        self.rgba
+    }
+
+    fn decoded_size(&self, source: Resolution) -> usize {
+        let pixel_size = if self.rgba { 4 } else { 3 };
+        (source.width() * source.height()) as usize * pixel_size
+    }
+
+    fn decode_frame(
+        &mut self,
+        data: &[u8],
+        source: Resolution,
+        dest: &mut [u8],
+    ) -> Result<Resolution, NokhwaError> {
+        let (width, height, bgra) = self.inner.decode(data, source.width(), source.height())?;
+        bgrx_to_rgb(bgra, dest, self.rgba)?;
+        Ok(Resolution::new(width, height))
+    }
+}
@@ -15,85 +15,882 @@
  */
 
 use crate::pixel_format::{PixelFormat};
-use crate::{FrameFormat, NokhwaError, Resolution};
+#[cfg(target_os = "linux")]
+use crate::DmaBuf;
+use crate::{
+    region::{write_decoded_region, write_region},
+    BufferPool, FrameDecoder, FrameFormat, FrameMetadata, NokhwaError, Region, Resolution,
+};
 use image::ImageBuffer;
 #[cfg(feature = "input-opencv")]
-use opencv::core::Mat;
-#[cfg(feature = "input-opencv")]
-use rgb::{FromSlice, RGB};
+use opencv::core::{Mat, MatTraitManual, Scalar, CV_8UC1, CV_8UC3, CV_8UC4};
 #[cfg(feature = "serde")]
 use serde::{Deserialize, Serialize};
+use std::borrow::Cow;
+
+/// The maximum amount of planes a [`Buffer`] can have.
+pub const MAX_PLANES: usize = 3;
+
+/// What the data of a [`Buffer`] or [`FrameRef`] is: the frame as the camera gave it, or the frame already decoded.
+///
+/// A decoded frame keeps the [`source_frame_format()`](Buffer::source_frame_format) of the frame it was decoded from,
+/// so this is what tells e.g. [`decode_image()`](Buffer::decode_image) not to decode it a second time.
+#[derive(Copy, Clone, Debug, Hash, PartialEq, Eq, PartialOrd, Ord)]
+#[cfg_attr(feature = "serde", derive(Serialize, Deserialize))]
+pub enum FrameState {
+    /// The frame as the camera gave it, in its [`FrameFormat`].
+    Raw,
+    /// Decoded to RGB888.
+    Rgb,
+    /// Decoded to RGBA8888.
+    Rgba,
+}
+
+impl FrameState {
+    /// Checks if the frame was decoded.
+    #[must_use]
+    pub fn is_decoded(self) -> bool {
+        self != FrameState::Raw
+    }
+
+    /// The size of a pixel of a decoded frame in bytes, `None` if the frame is [`Raw`](FrameState::Raw).
+    #[must_use]
+    pub fn pixel_size(self) -> Option<usize> {
+        match self {
+            FrameState::Raw => None,
+            FrameState::Rgb => Some(3),
+            FrameState::Rgba => Some(4),
+        }
+    }
+
+    /// The state of a frame decoded to RGBA if `rgba` is true, RGB888 otherwise.
+    #[must_use]
+    pub fn decoded(rgba: bool) -> Self {
+        if rgba {
+            FrameState::Rgba
+        } else {
+            FrameState::Rgb
+        }
+    }
+}
+
+impl Default for FrameState {
+    fn default() -> Self {
+        FrameState::Raw
+    }
+}
+
+/// Where one plane of a frame lives inside a [`Buffer`].
+///
+/// Packed formats (and frames that were already converted to RGB) have a single plane spanning the entire buffer.
+#[derive(Copy, Clone, Debug, Default, Hash, PartialEq, Eq, PartialOrd, Ord)]
+#[cfg_attr(feature = "serde", derive(Serialize, Deserialize))]
+pub struct Plane {
+    offset: usize,
+    stride: usize,
+    rows: usize,
+}
+
+impl Plane {
+    /// The offset of the first byte of the plane, from the start of the buffer.
+    #[must_use]
+    pub fn offset(&self) -> usize {
+        self.offset
+    }
+
+    /// The amount of bytes per row of the plane, including padding.
+    #[must_use]
+    pub fn stride(&self) -> usize {
+        self.stride
+    }
+
+    /// The amount of rows of the plane.
+    #[must_use]
+    pub fn rows(&self) -> usize {
+        self.rows
+    }
+
+    /// The amount of bytes the plane takes up.
+    #[must_use]
+    pub fn len(&self) -> usize {
+        self.stride * self.rows
+    }
+
+    /// Checks if the plane is empty.
+    #[must_use]
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+}
+
+// the (unpadded) row size and amount of rows of every plane of a planar format
+fn planar_dimensions(format: FrameFormat, resolution: Resolution) -> [(usize, usize); MAX_PLANES] {
+    let width = resolution.width() as usize;
+    let height = resolution.height() as usize;
+    let chroma_width = (width + 1) / 2;
+    let chroma_height = (height + 1) / 2;
+    match format {
+        FrameFormat::NV12 => [(width, height), (chroma_width * 2, chroma_height), (0, 0)],
+        FrameFormat::I420 => [
+            (width, height),
+            (chroma_width, chroma_height),
+            (chroma_width, chroma_height),
+        ],
+        FrameFormat::MJPEG | FrameFormat::YUYV | FrameFormat::GRAY8 => [(0, 0); MAX_PLANES],
+    }
+}
+
+// a single plane spanning all of the buffer
+fn packed_layout(resolution: Resolution, len: usize, stride: Option<usize>) -> [Plane; MAX_PLANES] {
+    let rows = resolution.height() as usize;
+    let mut planes = [Plane::default(); MAX_PLANES];
+    planes[0] = Plane {
+        offset: 0,
+        stride: stride.unwrap_or(if rows == 0 { 0 } else { len / rows }),
+        rows,
+    };
+    planes
+}
+
+fn planar_layout(
+    format: FrameFormat,
+    resolution: Resolution,
+    len: usize,
+    strides: Option<&[usize]>,
+) -> Result<[Plane; MAX_PLANES], NokhwaError> {
+    let mut planes = [Plane::default(); MAX_PLANES];
+    let mut offset = 0;
+    for (idx, (row_size, rows)) in planar_dimensions(format, resolution)
+        .into_iter()
+        .take(format.plane_count())
+        .enumerate()
+    {
+        let stride = strides
+            .and_then(|strides| strides.get(idx).copied())
+            .unwrap_or(row_size);
+        if stride < row_size {
+            return Err(NokhwaError::ProcessFrameError {
+                src: format,
+                destination: "Buffer".to_string(),
+                error: format!("Stride of plane {idx} is smaller than its row! [row: {row_size}, stride: {stride}]"),
+            });
+        }
+        planes[idx] = Plane {
+            offset,
+            stride,
+            rows,
+        };
+        offset += stride * rows;
+    }
+
+    if offset > len {
+        return Err(NokhwaError::ProcessFrameError {
+            src: format,
+            destination: "Buffer".to_string(),
+            error: format!("Buffer too small for its planes! [expected: {offset}, actual: {len}]"),
+        });
+    }
+    Ok(planes)
+}
+
+// the layout of a frame whose planes have the given strides, as given by `Buffer::with_strides()`
+fn strided_layout(
+    format: FrameFormat,
+    resolution: Resolution,
+    len: usize,
+    strides: &[usize],
+) -> Result<([Plane; MAX_PLANES], usize), NokhwaError> {
+    let plane_count = format.plane_count();
+    if strides.len() < plane_count {
+        return Err(NokhwaError::ProcessFrameError {
+            src: format,
+            destination: "Buffer".to_string(),
+            error: format!("Expected {plane_count} strides, got {}", strides.len()),
+        });
+    }
+
+    let planes = if plane_count == 1 {
+        // compressed frames have no rows to speak of
+        let stride = Some(strides[0]).filter(|stride| *stride != 0);
+        packed_layout(resolution, len, stride)
+    } else {
+        planar_layout(format, resolution, len, Some(strides))?
+    };
+    Ok((planes, plane_count))
+}
+
+// a decoded frame is a single plane of tightly packed pixels
+fn decoded_layout(
+    state: FrameState,
+    resolution: Resolution,
+    len: usize,
+) -> Option<([Plane; MAX_PLANES], usize)> {
+    let pixel_size = state.pixel_size()?;
+    let stride = resolution.width() as usize * pixel_size;
+    Some((packed_layout(resolution, len, Some(stride)), 1))
+}
+
+// the layout of a frame without any row padding, as given by `Buffer::new()`
+pub(crate) fn tight_layout(
+    format: FrameFormat,
+    resolution: Resolution,
+    len: usize,
+) -> ([Plane; MAX_PLANES], usize) {
+    let planar = if format.is_planar() {
+        planar_layout(format, resolution, len, None)
+            .ok()
+            .filter(|planes| planes.iter().map(Plane::len).sum::<usize>() == len)
+    } else {
+        None
+    };
+    match planar {
+        Some(planes) => (planes, format.plane_count()),
+        None => (packed_layout(resolution, len, None), 1),
+    }
+}
 
-#[derive(Clone, Debug, Default, Hash, PartialOrd, PartialEq)]
+#[derive(Debug, Default, Hash, PartialOrd, PartialEq)]
 #[cfg_attr(feature = "serde", Serialize, Deserialize)]
 pub struct Buffer {
     resolution: Resolution,
     buffer: Vec<u8>,
     source_frame_format: FrameFormat,
+    state: FrameState,
+    sequence: u64,
+    metadata: FrameMetadata,
+    planes: [Plane; MAX_PLANES],
+    plane_count: usize,
+    #[cfg(target_os = "linux")]
+    dmabuf: Option<DmaBuf>,
 }
 
 impl Buffer {
+    /// Creates a new [`Buffer`]. Planar formats are assumed to be tightly packed (no padding after a row), see
+    /// [`with_strides()`](Buffer::with_strides) if they are not.
+    ///
+    /// Frames that are not in their planar source format anymore (e.g. converted to RGB, so the size does not match) get a single plane.
     pub fn new(res: Resolution, buf: Vec<u8>, source_frame_format: FrameFormat) -> Self {
+        let (planes, plane_count) = tight_layout(source_frame_format, res, buf.len());
         Self {
             resolution: res,
             buffer: buf,
             source_frame_format,
+            state: FrameState::Raw,
+            sequence: 0,
+            metadata: FrameMetadata::default(),
+            planes,
+            plane_count,
+            #[cfg(target_os = "linux")]
+            dmabuf: None,
+        }
+    }
+
+    /// Creates a new [`Buffer`] whose planes have the given `strides` (bytes per row, including padding), one for each of the
+    /// [`plane_count()`](FrameFormat::plane_count) planes of the format. The planes follow each other in the buffer.
+    /// A stride of `0` for a packed format (e.g. `MJPEG`, which has no rows) means the same as [`new()`](Buffer::new).
+    ///
+    /// The data is kept as it is, so e.g. the planes of a `NV12` frame from a driver can be handed to a GPU or an encoder without any conversion.
+    /// # Errors
+    /// If a stride is smaller than a row of its plane, there are not enough strides, or `buf` is too small to hold all planes, this will error.
+    pub fn with_strides(
+        res: Resolution,
+        buf: Vec<u8>,
+        source_frame_format: FrameFormat,
+        strides: &[usize],
+    ) -> Result<Self, NokhwaError> {
+        let (planes, plane_count) = strided_layout(source_frame_format, res, buf.len(), strides)?;
+        Ok(Self {
+            resolution: res,
+            buffer: buf,
+            source_frame_format,
+            state: FrameState::Raw,
+            sequence: 0,
+            metadata: FrameMetadata::default(),
+            planes,
+            plane_count,
+            #[cfg(target_os = "linux")]
+            dmabuf: None,
+        })
+    }
+
+    /// Creates a new [`Buffer`] that holds its frame in a [`DmaBuf`] instead of in memory. The planes are laid out inside the
+    /// `DMABUF` like they would be in the buffer of [`with_strides()`](Buffer::with_strides).
+    ///
+    /// [`buffer()`](Buffer::buffer) is empty, as the frame never passes through the CPU. Use [`dmabuf()`](Buffer::dmabuf) to get at it.
+    /// # Errors
+    /// If a stride is smaller than a row of its plane, there are not enough strides, or the `DMABUF` is too small to hold all planes, this will error.
+    #[cfg(target_os = "linux")]
+    #[cfg_attr(feature = "docs-features", doc(cfg(target_os = "linux")))]
+    pub fn from_dmabuf(
+        res: Resolution,
+        dmabuf: DmaBuf,
+        source_frame_format: FrameFormat,
+        strides: &[usize],
+    ) -> Result<Self, NokhwaError> {
+        let (planes, plane_count) =
+            strided_layout(source_frame_format, res, dmabuf.len(), strides)?;
+        Ok(Self {
+            resolution: res,
+            buffer: Vec::new(),
+            source_frame_format,
+            state: FrameState::Raw,
+            sequence: 0,
+            metadata: FrameMetadata::default(),
+            planes,
+            plane_count,
+            dmabuf: Some(dmabuf),
+        })
+    }
+
+    /// Marks the frame as decoded (or not), see [`FrameState`]. A decoded frame has a single plane of tightly packed pixels.
+    ///
+    /// Backends call this on the frames their [`frame()`](crate::CaptureBackendTrait::frame) decoded, so it only needs to be called on frames decoded by hand.
+    #[must_use]
+    pub fn with_state(mut self, state: FrameState) -> Self {
+        self.state = state;
+        if let Some((planes, plane_count)) =
+            decoded_layout(state, self.resolution, self.buffer.len())
+        {
+            self.planes = planes;
+            self.plane_count = plane_count;
         }
+        self
+    }
+
+    /// Sets the sequence number of the frame.
+    #[must_use]
+    pub fn with_sequence(mut self, sequence: u64) -> Self {
+        self.sequence = sequence;
+        self
     }
 
+    /// Sets the [`FrameMetadata`] of the frame.
+    #[must_use]
+    pub fn with_metadata(mut self, metadata: FrameMetadata) -> Self {
+        self.metadata = metadata;
+        self
+    }
+
+    /// Converts the frame into an image of the [`PixelFormat`] `F` (e.g. [`RgbFormat`](crate::RgbFormat)).
+    /// # Errors
+    /// If `F` cannot convert from the [`source_frame_format()`](Buffer::source_frame_format) or the conversion fails, this will error.
     pub fn to_image_with_custom_format<F>(
         self,
     ) -> Result<ImageBuffer<F::Output, Vec<u8>>, NokhwaError>
     where
         F: PixelFormat,
     {
-        if self.source_frame_format != F::CODE {
-            return Err(NokhwaError::ProcessFrameError {
-                src: self.source_frame_format,
-                destination: F::CODE.to_string(),
-                error: "Assertion failed, wrong source!".to_string(),
-            });
+        self.decode_image::<F>()
+    }
+
+    /// Same as [`to_image_with_custom_format()`](Buffer::to_image_with_custom_format), without consuming the [`Buffer`].
+    /// # Errors
+    /// If `F` cannot convert from the [`source_frame_format()`](Buffer::source_frame_format) or the conversion fails, this will error.
+    pub fn decode_image<F>(&self) -> Result<ImageBuffer<F::Output, Vec<u8>>, NokhwaError>
+    where
+        F: PixelFormat,
+    {
+        decode_image::<F>(
+            self.source_frame_format,
+            self.state,
+            self.resolution,
+            &self.buffer,
+            self.planes(),
+        )
+    }
+
+    /// Converts only `region` of the frame to RGB888 (or RGBA if `rgba` is true), keeping every `downscale`th pixel of every `downscale`th row,
+    /// and writes it into `dest`, which must be exactly [`Region::output_size()`] bytes. Returns the resolution written.
+    ///
+    /// Only the pixels that end up in `dest` are read and converted, so a crop or a downscaled frame costs a fraction of a full conversion.
+    /// `MJPEG` frames are decoded with [`MjpegDecoder::decode_region_into()`](crate::MjpegDecoder::decode_region_into), frames that
+    /// are already decoded (see [`state()`](Buffer::state)) are only cropped and scaled.
+    /// Use [`Region::full()`] to only downscale.
+    /// # Errors
+    /// If the frame is malformed, `region` does not fit in the frame, `downscale` is 0, or `dest` is of the wrong size, this will error.
+    pub fn write_region_to_buffer(
+        &self,
+        region: Region,
+        downscale: u32,
+        dest: &mut [u8],
+        rgba: bool,
+    ) -> Result<Resolution, NokhwaError> {
+        if self.state.is_decoded() {
+            return write_decoded_region(
+                self.source_frame_format,
+                self.state,
+                self.resolution,
+                &self.buffer,
+                region,
+                downscale,
+                dest,
+                rgba,
+            );
         }
-        ImageBuffer::from_raw(
-            self.resolution.width_x,
-            self.resolution.height_y,
-            self.buffer,
+        write_region(
+            self.source_frame_format,
+            self.resolution,
+            &self.buffer,
+            self.planes(),
+            region,
+            downscale,
+            dest,
+            rgba,
         )
-        .ok_or(NokhwaError::ProcessFrameError {
-            src: F::CODE,
-            destination: stringify!(I::Output).to_string(),
-            error: "Buffer too small".to_string(),
-        })
     }
 
+    /// Copies the frame into a new `Mat`, in one go. Decoded frames (see [`state()`](Buffer::state)) become a RGB888 or RGBA `Mat`,
+    /// raw `MJPEG` and `YUYV` frames cannot be copied and have to be decoded first.
+    ///
+    /// If you capture with `OpenCV` anyway, [`OpenCvCaptureDevice::frame_mat()`](crate::backends::capture::OpenCvCaptureDevice::frame_mat)
+    /// hands out the captured `Mat` without any conversion.
+    /// # Errors
+    /// If the `Mat` fails to be allocated, this will error.
     #[cfg(feature = "input-opencv")]
+    #[allow(clippy::cast_possible_wrap)]
+    #[allow(clippy::cast_possible_truncation)]
     pub fn to_opencv_mat(self) -> Result<Mat, NokhwaError> {
-        Ok(match self.source_frame_format {
-            FrameFormat::MJPEG | FrameFormat::YUYV => Mat::from_slice_2d(
-                self.buffer
-                    .as_rgb()
-                    .chunks(self.resolution.height_y as usize)
-                    .collect::<&[&[RGB<u8>]]>(),
-            ),
-            FrameFormat::GRAY8 => Mat::from_slice_2d(
-                self.buffer
-                    .chunks(self.resolution.height_y as usize)
-                    .collect::<&[&[u8]]>(),
-            ),
-        }
-        .map_err(|why| NokhwaError::ProcessFrameError {
+        let width = self.resolution.width_x as usize;
+        let (cols, mat_type, row_size) = match (self.state, self.source_frame_format) {
+            (FrameState::Rgb, _) => (width, CV_8UC3, width * 3),
+            (FrameState::Rgba, _) => (width, CV_8UC4, width * 4),
+            (FrameState::Raw, FrameFormat::MJPEG | FrameFormat::YUYV) => {
+                return Err(NokhwaError::ProcessFrameError {
+                    src: self.source_frame_format,
+                    destination: "OpenCV Mat".to_string(),
+                    error: "The frame has to be decoded first".to_string(),
+                })
+            }
+            (FrameState::Raw, FrameFormat::GRAY8) => (width, CV_8UC1, width),
+            // planar frames are kept as they are, so this is the luma plane followed by the chroma plane(s)
+            (FrameState::Raw, FrameFormat::NV12 | FrameFormat::I420) => {
+                (self.planes[0].stride, CV_8UC1, self.planes[0].stride)
+            }
+        };
+        let rows = if row_size == 0 {
+            0
+        } else {
+            self.buffer.len() / row_size
+        };
+
+        let process_error = |why: opencv::Error| NokhwaError::ProcessFrameError {
             src: self.source_frame_format,
             destination: "OpenCV Mat".to_string(),
             error: why.to_string(),
-        })?)
+        };
+        let mut mat =
+            Mat::new_rows_cols_with_default(rows as i32, cols as i32, mat_type, Scalar::default())
+                .map_err(process_error)?;
+        mat.data_bytes_mut()
+            .map_err(process_error)?
+            .copy_from_slice(&self.buffer[..rows * row_size]);
+        Ok(mat)
+    }
+    pub fn resolution(&self) -> Resolution {
+        self.resolution
+    }
+    pub fn buffer(&self) -> &[u8] {
+        &self.buffer
+    }
+    /// The planes of the frame: one for packed formats like `YUYV`, more for planar formats like `NV12` or `I420`.
+    #[must_use]
+    pub fn planes(&self) -> &[Plane] {
+        &self.planes[..self.plane_count]
     }
+    /// The data of the plane at `index` (including row padding), or `None` if there is no such plane.
+    #[must_use]
+    pub fn plane_data(&self, index: usize) -> Option<&[u8]> {
+        let plane = self.planes().get(index)?;
+        self.buffer.get(plane.offset..plane.offset + plane.len())
+    }
+    /// The `DMABUF` the frame is in, if it came from [`from_dmabuf()`](Buffer::from_dmabuf) (e.g. [`Camera::frame_dmabuf()`](crate::Camera::frame_dmabuf)).
+    #[cfg(target_os = "linux")]
+    #[cfg_attr(feature = "docs-features", doc(cfg(target_os = "linux")))]
+    #[must_use]
+    pub fn dmabuf(&self) -> Option<&DmaBuf> {
+        self.dmabuf.as_ref()
+    }
+    /// Copies the [`Buffer`] into a new one whose storage is taken out of `pool`. Once the pool is warmed up, this does not allocate.
+    ///
+    /// A [`DmaBuf`](crate::DmaBuf) is shared, not copied.
+    #[must_use]
+    pub fn to_pooled_buffer(&self, pool: &BufferPool) -> Buffer {
+        let mut data = pool.take(self.buffer.len());
+        data.copy_from_slice(&self.buffer);
+        Buffer {
+            resolution: self.resolution,
+            buffer: data,
+            source_frame_format: self.source_frame_format,
+            state: self.state,
+            sequence: self.sequence,
+            metadata: self.metadata,
+            planes: self.planes,
+            plane_count: self.plane_count,
+            #[cfg(target_os = "linux")]
+            dmabuf: self.dmabuf.clone(),
+        }
+    }
+    /// Decodes the frame with `decoder` (e.g. a [`MjpegDecoder`](crate::MjpegDecoder) or [`AutoMjpegDecoder`](crate::AutoMjpegDecoder)) into a new [`Buffer`]
+    /// whose storage is taken out of `pool`, marked as decoded (see [`state()`](Buffer::state)). The sequence number and [`FrameMetadata`] are kept.
+    ///
+    /// A frame that is already decoded to what the decoder decodes to is copied instead.
+    /// # Errors
+    /// If the frame is not in the [`FrameFormat`] the decoder takes, was already decoded to something else, or fails to decode, this will error.
+    pub fn decode_with(
+        &self,
+        decoder: &mut dyn FrameDecoder,
+        pool: &BufferPool,
+    ) -> Result<Buffer, NokhwaError> {
+        if self.source_frame_format != decoder.source_format() {
+            return Err(NokhwaError::ProcessFrameError {
+                src: self.source_frame_format,
+                destination: decoder.name().to_string(),
+                error: "Assertion failed, wrong source!".to_string(),
+            });
+        }
+        let state = FrameState::decoded(decoder.rgba());
+        if self.state == state {
+            return Ok(self.to_pooled_buffer(pool));
+        }
+        if self.state.is_decoded() {
+            return Err(NokhwaError::ProcessFrameError {
+                src: self.source_frame_format,
+                destination: decoder.name().to_string(),
+                error: format!("The frame is already decoded ({:?})", self.state),
+            });
+        }
+
+        let mut decoded = pool.take(decoder.decoded_size(self.resolution));
+        match decoder.decode_frame(&self.buffer, self.resolution, &mut decoded) {
+            Ok(resolution) => Ok(Buffer::new(resolution, decoded, self.source_frame_format)
+                .with_state(state)
+                .with_sequence(self.sequence)
+                .with_metadata(self.metadata)),
+            Err(why) => {
+                pool.recycle(decoded);
+                Err(why)
+            }
+        }
+    }
+    /// Consumes the [`Buffer`], giving back the underlying data (e.g. to give it back to a [`BufferPool`]).
+    #[must_use]
+    pub fn into_vec(self) -> Vec<u8> {
+        self.buffer
+    }
+    pub fn source_frame_format(&self) -> FrameFormat {
+        self.source_frame_format
+    }
+    /// Whether the frame is as the camera gave it, in the [`source_frame_format()`](Buffer::source_frame_format), or already decoded.
+    #[must_use]
+    pub fn state(&self) -> FrameState {
+        self.state
+    }
+    /// Checks if the frame is already decoded, see [`state()`](Buffer::state).
+    #[must_use]
+    pub fn is_decoded(&self) -> bool {
+        self.state.is_decoded()
+    }
+    /// The sequence number of the frame, counting up from 0 for every frame captured. `0` if it is unknown.
+    ///
+    /// This is counted by nokhwa as frames are handed out (e.g. by a [`CallbackCamera`](crate::CallbackCamera)), see
+    /// [`metadata()`](Buffer::metadata) for the sequence number the driver gave the frame.
+    #[must_use]
+    pub fn sequence(&self) -> u64 {
+        self.sequence
+    }
+    /// When the frame was captured, the sequence number the driver gave it, and how many frames were dropped before it.
+    #[must_use]
+    pub fn metadata(&self) -> FrameMetadata {
+        self.metadata
+    }
+}
+
+impl Clone for Buffer {
+    fn clone(&self) -> Self {
+        Self {
+            resolution: self.resolution,
+            buffer: self.buffer.clone(),
+            source_frame_format: self.source_frame_format,
+            state: self.state,
+            sequence: self.sequence,
+            metadata: self.metadata,
+            planes: self.planes,
+            plane_count: self.plane_count,
+            #[cfg(target_os = "linux")]
+            dmabuf: self.dmabuf.clone(),
+        }
+    }
+
+    // reuses the allocation of `self`, so keeping a "last frame" does not allocate every frame
+    fn clone_from(&mut self, source: &Self) {
+        self.resolution = source.resolution;
+        self.buffer.clone_from(&source.buffer);
+        self.source_frame_format = source.source_frame_format;
+        self.state = source.state;
+        self.sequence = source.sequence;
+        self.metadata = source.metadata;
+        self.planes = source.planes;
+        self.plane_count = source.plane_count;
+        #[cfg(target_os = "linux")]
+        self.dmabuf.clone_from(&source.dmabuf);
+    }
+}
+
+/// A frame that borrows its data from the backend instead of owning it.
+///
+/// For backends that can hand out their driver buffers directly (e.g. the memory mapped stream of `V4L2`), this
+/// points straight into the kernel buffer, so no copy is done per frame. The buffer stays dequeued for as long as the
+/// [`FrameRef`] is alive (it borrows the camera mutably), and is given back to the driver once it is dropped and the next frame is requested.
+///
+/// Backends that cannot do this will give a [`FrameRef`] that owns its data instead.
+///
+/// The data is usually **not** processed, it is in the format given by [`source_frame_format()`](FrameRef::source_frame_format).
+/// Backends that can only hand out decoded frames (e.g. `OpenCV`) mark them as such, see [`state()`](FrameRef::state).
+#[derive(Clone, Debug, Hash, PartialOrd, PartialEq)]
+pub struct FrameRef<'a> {
+    resolution: Resolution,
+    buffer: Cow<'a, [u8]>,
+    source_frame_format: FrameFormat,
+    state: FrameState,
+    metadata: FrameMetadata,
+    planes: [Plane; MAX_PLANES],
+    plane_count: usize,
+}
+
+impl<'a> FrameRef<'a> {
+    /// Creates a new [`FrameRef`]. Planar formats are assumed to be tightly packed, see [`with_strides()`](FrameRef::with_strides) if they are not.
+    #[must_use]
+    pub fn new(res: Resolution, buf: Cow<'a, [u8]>, source_frame_format: FrameFormat) -> Self {
+        let (planes, plane_count) = tight_layout(source_frame_format, res, buf.len());
+        Self {
+            resolution: res,
+            buffer: buf,
+            source_frame_format,
+            state: FrameState::Raw,
+            metadata: FrameMetadata::default(),
+            planes,
+            plane_count,
+        }
+    }
+
+    /// Creates a new [`FrameRef`] whose planes have the given `strides`, the same as [`Buffer::with_strides()`].
+    /// # Errors
+    /// If a stride is smaller than a row of its plane, there are not enough strides, or `buf` is too small to hold all planes, this will error.
+    pub fn with_strides(
+        res: Resolution,
+        buf: Cow<'a, [u8]>,
+        source_frame_format: FrameFormat,
+        strides: &[usize],
+    ) -> Result<Self, NokhwaError> {
+        let (planes, plane_count) = strided_layout(source_frame_format, res, buf.len(), strides)?;
+        Ok(Self {
+            resolution: res,
+            buffer: buf,
+            source_frame_format,
+            state: FrameState::Raw,
+            metadata: FrameMetadata::default(),
+            planes,
+            plane_count,
+        })
+    }
+
+    /// Marks the frame as decoded (or not), see [`FrameState`]. A decoded frame has a single plane of tightly packed pixels.
+    #[must_use]
+    pub fn with_state(mut self, state: FrameState) -> Self {
+        self.state = state;
+        if let Some((planes, plane_count)) =
+            decoded_layout(state, self.resolution, self.buffer.len())
+        {
+            self.planes = planes;
+            self.plane_count = plane_count;
+        }
+        self
+    }
+
+    /// Sets the [`FrameMetadata`] of the frame.
+    #[must_use]
+    pub fn with_metadata(mut self, metadata: FrameMetadata) -> Self {
+        self.metadata = metadata;
+        self
+    }
+
+    /// Gets the resolution of the frame.
+    #[must_use]
     pub fn resolution(&self) -> Resolution {
         self.resolution
     }
+
+    /// Gets the raw frame data.
+    #[must_use]
     pub fn buffer(&self) -> &[u8] {
         &self.buffer
     }
+
+    /// The planes of the frame, see [`Buffer::planes()`].
+    #[must_use]
+    pub fn planes(&self) -> &[Plane] {
+        &self.planes[..self.plane_count]
+    }
+
+    /// Gets the [`FrameFormat`] of the frame data.
+    #[must_use]
     pub fn source_frame_format(&self) -> FrameFormat {
         self.source_frame_format
     }
+
+    /// Whether the frame is as the camera gave it, in the [`source_frame_format()`](FrameRef::source_frame_format), or already decoded.
+    #[must_use]
+    pub fn state(&self) -> FrameState {
+        self.state
+    }
+
+    /// Checks if the frame is already decoded, see [`state()`](FrameRef::state).
+    #[must_use]
+    pub fn is_decoded(&self) -> bool {
+        self.state.is_decoded()
+    }
+
+    /// When the frame was captured, the sequence number the driver gave it, and how many frames were dropped before it.
+    #[must_use]
+    pub fn metadata(&self) -> FrameMetadata {
+        self.metadata
+    }
+
+    /// Checks if this frame is borrowed from the backend (zero-copy).
+    #[must_use]
+    pub fn is_borrowed(&self) -> bool {
+        matches!(self.buffer, Cow::Borrowed(_))
+    }
+
+    /// Copies the frame into an owned [`Buffer`], releasing the borrow on the backend. The planes are kept.
+    #[must_use]
+    pub fn into_buffer(self) -> Buffer {
+        Buffer {
+            resolution: self.resolution,
+            buffer: self.buffer.into_owned(),
+            source_frame_format: self.source_frame_format,
+            state: self.state,
+            sequence: 0,
+            metadata: self.metadata,
+            planes: self.planes,
+            plane_count: self.plane_count,
+            #[cfg(target_os = "linux")]
+            dmabuf: None,
+        }
+    }
+}
+
+impl<'a> FrameRef<'a> {
+    /// Converts the frame into an image of the [`PixelFormat`] `F` (e.g. [`RgbFormat`](crate::RgbFormat)), straight from the backend's buffer.
+    /// # Errors
+    /// If `F` cannot convert from the [`source_frame_format()`](FrameRef::source_frame_format) or the conversion fails, this will error.
+    pub fn decode_image<F>(&self) -> Result<ImageBuffer<F::Output, Vec<u8>>, NokhwaError>
+    where
+        F: PixelFormat,
+    {
+        decode_image::<F>(
+            self.source_frame_format,
+            self.state,
+            self.resolution,
+            &self.buffer,
+            self.planes(),
+        )
+    }
+
+    /// Copies the frame into a [`Buffer`] whose storage is taken out of `pool`. Once the pool is warmed up, this does not allocate.
+    /// The planes are kept.
+    #[must_use]
+    pub fn to_pooled_buffer(&self, pool: &BufferPool) -> Buffer {
+        let mut data = pool.take(self.buffer.len());
+        data.copy_from_slice(&self.buffer);
+        Buffer {
+            resolution: self.resolution,
+            buffer: data,
+            source_frame_format: self.source_frame_format,
+            state: self.state,
+            sequence: 0,
+            metadata: self.metadata,
+            planes: self.planes,
+            plane_count: self.plane_count,
+            #[cfg(target_os = "linux")]
+            dmabuf: None,
+        }
+    }
+
+    /// Same as [`Buffer::write_region_to_buffer()`], straight from the backend's buffer.
+    /// # Errors
+    /// If the frame is malformed, `region` does not fit in the frame, `downscale` is 0, or `dest` is of the wrong size, this will error.
+    pub fn write_region_to_buffer(
+        &self,
+        region: Region,
+        downscale: u32,
+        dest: &mut [u8],
+        rgba: bool,
+    ) -> Result<Resolution, NokhwaError> {
+        if self.state.is_decoded() {
+            return write_decoded_region(
+                self.source_frame_format,
+                self.state,
+                self.resolution,
+                &self.buffer,
+                region,
+                downscale,
+                dest,
+                rgba,
+            );
+        }
+        write_region(
+            self.source_frame_format,
+            self.resolution,
+            &self.buffer,
+            self.planes(),
+            region,
+            downscale,
+            dest,
+            rgba,
+        )
+    }
+}
+
+fn decode_image<F: PixelFormat>(
+    source_frame_format: FrameFormat,
+    state: FrameState,
+    resolution: Resolution,
+    data: &[u8],
+    planes: &[Plane],
+) -> Result<ImageBuffer<F::Output, Vec<u8>>, NokhwaError> {
+    let mut image = vec![0; F::output_size(resolution)];
+    match state {
+        // already decoded, so only the pixels are converted
+        FrameState::Rgb | FrameState::Rgba => F::convert_decoded(
+            source_frame_format,
+            state == FrameState::Rgba,
+            resolution,
+            data,
+            &mut image,
+        )?,
+        FrameState::Raw => {
+            if !F::SUPPORTED_CODES.contains(&source_frame_format) {
+                return Err(NokhwaError::ProcessFrameError {
+                    src: source_frame_format,
+                    destination: F::NAME.to_string(),
+                    error: "Assertion failed, wrong source!".to_string(),
+                });
+            }
+            F::convert(source_frame_format, resolution, data, planes, &mut image)?;
+        }
+    }
+    ImageBuffer::from_raw(resolution.width(), resolution.height(), image).ok_or(
+        NokhwaError::ProcessFrameError {
+            src: source_frame_format,
+            destination: F::NAME.to_string(),
+            error: "Buffer too small".to_string(),
+        },
+    )
+}
+
+impl<'a> From<FrameRef<'a>> for Buffer {
+    fn from(frame: FrameRef<'a>) -> Self {
+        frame.into_buffer()
+    }
 }
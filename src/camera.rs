@@ -14,12 +14,31 @@
  * limitations under the License.
  */
 
+#[cfg(feature = "input-network")]
+use crate::backends::capture::{NetworkCaptureDevice, ReconnectPolicy};
+#[cfg(feature = "recording")]
+use crate::backends::capture::{ReplayCaptureDevice, ReplayRate};
+#[cfg(feature = "output-async")]
+use crate::FrameStream;
+#[cfg(feature = "metrics")]
+use crate::MetricsSnapshot;
 use crate::{
-    buffer::Buffer, pixel_format::PixelFormat, BackendsEnum, CameraControl, CameraFormat,
-    CameraInfo, CaptureAPIBackend, CaptureBackendTrait, FrameFormat, KnownCameraControl,
-    NokhwaError, Resolution,
+    buffer::{Buffer, FrameRef},
+    capabilities::{resolve_backend, FirstFrameTimer},
+    metrics::MetricsHandle,
+    BackendsEnum, BufferPool, CameraControl, CameraFormat, CameraInfo, CapabilityCache,
+    CaptureAPIBackend, CaptureBackendTrait, FrameFormat, KnownCameraControl, NokhwaError,
+    Resolution, StreamConfig,
+};
+#[cfg(feature = "output-wgpu")]
+use crate::{StreamedTexture, TextureStreamer};
+use std::{
+    any::Any,
+    borrow::Cow,
+    collections::HashMap,
+    task::{Context, Poll},
+    time::Duration,
 };
-use std::{any::Any, borrow::Cow, collections::HashMap};
 #[cfg(feature = "output-wgpu")]
 use wgpu::{Device as WgpuDevice, Queue as WgpuQueue, Texture as WgpuTexture};
 
@@ -28,6 +47,8 @@ pub struct Camera {
     idx: usize,
     backend: BackendsEnum,
     backend_api: CaptureAPIBackend,
+    metrics: MetricsHandle,
+    first_frame: FirstFrameTimer,
 }
 
 impl Camera {
@@ -46,15 +67,53 @@ impl Camera {
         format: Option<CameraFormat>,
         backend: CaptureAPIBackend,
     ) -> Result<Self, NokhwaError> {
+        let first_frame = FirstFrameTimer::start();
         let camera_backend = init_camera(index, format, backend)?;
 
         Ok(Camera {
             idx: index,
             backend: camera_backend,
             backend_api: backend,
+            metrics: MetricsHandle::new(index),
+            first_frame,
         })
     }
 
+    /// Create a new camera from an `index` and `backend`, opening it with the known-good [`CameraFormat`] `cache` has for it
+    /// (see [`CapabilityCache::remember()`]). The format is applied directly, nothing is enumerated. If the backend does not
+    /// apply the format it is created with (e.g. `MSMF`), it is applied with [`set_camera_format()`](Camera::set_camera_format) once the
+    /// device is known to be the one the cache remembered.
+    ///
+    /// If `cache` knows nothing about the device, the device at `index` is not the one the cache remembered, or the device
+    /// rejects the known-good format, this opens the camera like [`with_backend()`](Camera::with_backend) with no format.
+    /// # Errors
+    /// This will error if you either have a bad platform configuration (e.g. `input-v4l` but not on linux) or the backend cannot create the camera (e.g. permission denied).
+    pub fn with_cache(
+        index: usize,
+        backend: CaptureAPIBackend,
+        cache: &CapabilityCache,
+    ) -> Result<Self, NokhwaError> {
+        let cached = cache.get_by_index(resolve_backend(backend), index as u32);
+        if let Some((identity, known_good)) =
+            cached.and_then(|device| Some((device.identity(), device.known_good()?)))
+        {
+            if let Ok(mut camera) = Camera::with_backend(index, Some(known_good), backend) {
+                // checked before the format is applied below, so a different device is never switched over to it
+                if identity.matches(camera.info()) {
+                    // some backends (e.g. `MSMF`) do not apply the format they are created with
+                    let applied = match camera.camera_format() {
+                        Ok(format) if format == known_good => Ok(()),
+                        _ => camera.set_camera_format(known_good),
+                    };
+                    if applied.is_ok() {
+                        return Ok(camera);
+                    }
+                }
+            }
+        }
+        Camera::with_backend(index, None, backend)
+    }
+
     /// Create a new `Camera` from raw values.
     /// # Errors
     /// This will error if you either have a bad platform configuration (e.g. `input-v4l` but not on linux) or the backend cannot create the camera (e.g. permission denied).
@@ -70,6 +129,49 @@ impl Camera {
         Camera::with_backend(index, Some(camera_format), backend)
     }
 
+    /// Creates a `Camera` that replays the recording at `path` (made by a [`FrameRecorder`](crate::FrameRecorder)) at `rate`,
+    /// through a [`ReplayCaptureDevice`](crate::backends::capture::ReplayCaptureDevice).
+    ///
+    /// The recorded frames are handed out straight from the memory mapped recording, see [`frame_ref()`](Camera::frame_ref).
+    /// # Errors
+    /// If the file cannot be opened or is not a recording, this will error.
+    #[cfg(feature = "recording")]
+    #[cfg_attr(feature = "docs-features", doc(cfg(feature = "recording")))]
+    pub fn from_recording(
+        path: impl AsRef<std::path::Path>,
+        rate: ReplayRate,
+    ) -> Result<Self, NokhwaError> {
+        let first_frame = FirstFrameTimer::start();
+        let device = ReplayCaptureDevice::new(path, rate)?;
+        Ok(Camera {
+            idx: 0,
+            backend: device.into(),
+            backend_api: CaptureAPIBackend::Replay,
+            metrics: MetricsHandle::new(0),
+            first_frame,
+        })
+    }
+
+    /// Creates a `Camera` that reads the MJPEG over HTTP or RTSP stream at `url`, through a [`NetworkCaptureDevice`](crate::backends::capture::NetworkCaptureDevice)
+    /// that reconnects according to `policy`.
+    ///
+    /// The frames are handed out as the JPEGs the camera sent, see [`frame_raw()`](Camera::frame_raw).
+    /// # Errors
+    /// If the URL is invalid, the camera cannot be reached, or its stream is not MJPEG, this will error.
+    #[cfg(feature = "input-network")]
+    #[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-network")))]
+    pub fn from_network(url: &str, policy: ReconnectPolicy) -> Result<Self, NokhwaError> {
+        let first_frame = FirstFrameTimer::start();
+        let device = NetworkCaptureDevice::with_policy(url, policy)?;
+        Ok(Camera {
+            idx: 0,
+            backend: device.into(),
+            backend_api: CaptureAPIBackend::Network,
+            metrics: MetricsHandle::new(0),
+            first_frame,
+        })
+    }
+
     /// Gets the current Camera's index.
     #[must_use]
     pub fn index(&self) -> usize {
@@ -84,6 +186,7 @@ impl Camera {
             self.backend.stop_stream()?;
         }
         let new_camera_format = self.backend.camera_format()?;
+        self.first_frame = FirstFrameTimer::start();
         let new_camera = init_camera(new_idx, Some(new_camera_format), self.backend_api)?;
         self.backend = new_camera;
         Ok(())
@@ -103,6 +206,7 @@ impl Camera {
             self.backend.stop_stream()?;
         }
         let new_camera_format = self.backend.camera_format()?;
+        self.first_frame = FirstFrameTimer::start();
         let new_camera = init_camera(self.idx, Some(new_camera_format), new_backend)?;
         self.backend = new_camera;
         Ok(())
@@ -353,6 +457,19 @@ impl Camera {
         self.backend.open_stream()
     }
 
+    /// Will open the camera stream with the driver buffers and dequeue behaviour set by `config`. See [`StreamConfig`] for what each backend supports.
+    /// # Errors
+    /// If the backend does not support `config`, or fails to open the camera (e.g. already taken, busy, doesn't exist anymore) this will error.
+    pub fn open_stream_with(&mut self, config: StreamConfig) -> Result<(), NokhwaError> {
+        self.backend.open_stream_with(config)
+    }
+
+    /// Gets the [`StreamConfig`] the stream is opened with.
+    #[must_use]
+    pub fn stream_config(&self) -> StreamConfig {
+        self.backend.stream_config()
+    }
+
     /// Checks if stream if open. If it is, it will return true.
     #[must_use]
     pub fn is_stream_open(&self) -> bool {
@@ -365,19 +482,81 @@ impl Camera {
     /// If the backend fails to get the frame (e.g. already taken, busy, doesn't exist anymore), the decoding fails (e.g. MJPEG -> u8), or [`open_stream()`](CaptureBackendTrait::open_stream()) has not been called yet,
     /// this will error.
     pub fn frame(&mut self) -> Result<Buffer, NokhwaError> {
-        self.backend.frame()
+        let _scope = self.metrics.enter();
+        let frame = self.backend.frame()?;
+        self.metrics.record_frame(Some(frame.metadata()));
+        self.first_frame.mark();
+        Ok(frame)
     }
 
     /// Will get a frame from the camera **without** any processing applied, meaning you will usually get a frame you need to decode yourself.
     /// # Errors
     /// If the backend fails to get the frame (e.g. already taken, busy, doesn't exist anymore), or [`open_stream()`](CaptureBackendTrait::open_stream()) has not been called yet, this will error.
     pub fn frame_raw(&mut self) -> Result<Cow<[u8]>, NokhwaError> {
+        let _scope = self.metrics.enter();
         match self.backend.frame_raw() {
-            Ok(f) => Ok(f),
+            Ok(f) => {
+                self.metrics.record_frame(None);
+                self.first_frame.mark();
+                Ok(f)
+            }
             Err(why) => Err(why),
         }
     }
 
+    /// Will get a frame from the camera **without** any processing applied, borrowing the backend's buffer if it can (zero-copy).
+    /// See [`frame_ref()`](CaptureBackendTrait::frame_ref()) for more details.
+    /// # Errors
+    /// If the backend fails to get the frame (e.g. already taken, busy, doesn't exist anymore), or [`open_stream()`](CaptureBackendTrait::open_stream()) has not been called yet, this will error.
+    pub fn frame_ref(&mut self) -> Result<FrameRef, NokhwaError> {
+        let _scope = self.metrics.enter();
+        let frame = self.backend.frame_ref()?;
+        self.metrics.record_frame(Some(frame.metadata()));
+        self.first_frame.mark();
+        Ok(frame)
+    }
+
+    /// Will get a frame from the camera **without** any processing applied, copied into a [`Buffer`] taken out of `pool`.
+    /// See [`frame_pooled()`](CaptureBackendTrait::frame_pooled()) for more details.
+    /// # Errors
+    /// If the backend fails to get the frame (e.g. already taken, busy, doesn't exist anymore), or [`open_stream()`](CaptureBackendTrait::open_stream()) has not been called yet, this will error.
+    pub fn frame_pooled(&mut self, pool: &BufferPool) -> Result<Buffer, NokhwaError> {
+        let _scope = self.metrics.enter();
+        let frame = self.backend.frame_pooled(pool)?;
+        self.metrics.record_frame(Some(frame.metadata()));
+        self.first_frame.mark();
+        Ok(frame)
+    }
+
+    /// Will get a frame from the camera as a [`DmaBuf`](crate::DmaBuf), without it ever being copied or mapped into memory.
+    /// See [`frame_dmabuf()`](CaptureBackendTrait::frame_dmabuf()) for more details.
+    /// # Errors
+    /// If the backend does not support `DMABUF`, the stream is not opened with [`IoMode::DmaBuf`](crate::IoMode::DmaBuf), or the backend fails to get the frame, this will error.
+    pub fn frame_dmabuf(&mut self) -> Result<Buffer, NokhwaError> {
+        let _scope = self.metrics.enter();
+        let frame = self.backend.frame_dmabuf()?;
+        self.metrics.record_frame(Some(frame.metadata()));
+        self.first_frame.mark();
+        Ok(frame)
+    }
+
+    /// Checks if the next frame is ready, waking the task of `cx` once it is.
+    /// See [`poll_frame_ready()`](CaptureBackendTrait::poll_frame_ready()) for more details.
+    /// # Errors
+    /// If the backend fails to wait for the frame, this will error.
+    pub fn poll_frame_ready(&mut self, cx: &mut Context<'_>) -> Poll<Result<(), NokhwaError>> {
+        self.backend.poll_frame_ready(cx)
+    }
+
+    #[cfg(feature = "output-async")]
+    #[cfg_attr(feature = "docs-features", doc(cfg(feature = "output-async")))]
+    /// Gets the frames of this camera as an asynchronous [`Stream`](futures_core::Stream), see [`FrameStream`].
+    /// Call [`open_stream()`](Camera::open_stream()) first.
+    #[must_use]
+    pub fn frame_stream(&mut self) -> FrameStream<'_> {
+        FrameStream::new(self)
+    }
+
     /// Directly writes the current frame(RGB24) into said `buffer`. If `convert_rgba` is true, the buffer written will be written as an RGBA frame instead of a RGB frame. Returns the amount of bytes written on successful capture.
     /// # Errors
     /// If the backend fails to get the frame (e.g. already taken, busy, doesn't exist anymore), or [`open_stream()`](CaptureBackendTrait::open_stream()) has not been called yet, this will error.
@@ -386,21 +565,45 @@ impl Camera {
         buffer: &mut [u8],
         write_alpha: bool,
     ) -> Result<usize, NokhwaError> {
-        self.backend.write_frame_to_buffer(buffer, write_alpha)
+        let written = self.backend.write_frame_to_buffer(buffer, write_alpha)?;
+        self.first_frame.mark();
+        Ok(written)
     }
 
     #[cfg(feature = "output-wgpu")]
     #[cfg_attr(feature = "docs-features", doc(cfg(feature = "output-wgpu")))]
-    /// Directly copies a frame to a Wgpu texture. This will automatically convert the frame into a RGBA frame.
+    /// Directly copies a frame to a new Wgpu texture. This will automatically convert the frame into a RGBA frame.
+    ///
+    /// If you do this every frame, use [`frame_texture_streamed()`](Camera::frame_texture_streamed) instead, which reuses its textures.
     /// # Errors
     /// If the frame cannot be captured or the resolution is 0 on any axis, this will error.
-    pub fn frame_texture<'a, F: PixelFormat>(
+    pub fn frame_texture<'a>(
         &mut self,
         device: &WgpuDevice,
         queue: &WgpuQueue,
         label: Option<&'a str>,
     ) -> Result<WgpuTexture, NokhwaError> {
-        self.backend.frame_texture(device, queue, label)
+        let texture = self.backend.frame_texture(device, queue, label)?;
+        self.first_frame.mark();
+        Ok(texture)
+    }
+
+    #[cfg(feature = "output-wgpu")]
+    #[cfg_attr(feature = "docs-features", doc(cfg(feature = "output-wgpu")))]
+    /// Uploads a frame into the next texture of `streamer`, which converts it to RGBA on the GPU. See [`TextureStreamer`].
+    /// # Errors
+    /// If the frame cannot be captured, its format is not supported, or the resolution is 0 on any axis, this will error.
+    pub fn frame_texture_streamed<'a>(
+        &mut self,
+        streamer: &'a mut TextureStreamer,
+        device: &WgpuDevice,
+        queue: &WgpuQueue,
+    ) -> Result<&'a StreamedTexture, NokhwaError> {
+        let texture = self
+            .backend
+            .frame_texture_streamed(streamer, device, queue)?;
+        self.first_frame.mark();
+        Ok(texture)
     }
 
     /// Will drop the stream.
@@ -409,6 +612,35 @@ impl Camera {
     pub fn stop_stream(&mut self) -> Result<(), NokhwaError> {
         self.backend.stop_stream()
     }
+
+    #[cfg(feature = "metrics")]
+    #[cfg_attr(feature = "docs-features", doc(cfg(feature = "metrics")))]
+    /// Gets the capture metrics of this camera: frame rate, dropped frames and how long each [`Stage`](crate::Stage) of capturing took.
+    /// See [`MetricsSnapshot`].
+    #[must_use]
+    pub fn metrics(&self) -> MetricsSnapshot {
+        self.metrics.snapshot()
+    }
+
+    #[cfg(feature = "metrics")]
+    #[cfg_attr(feature = "docs-features", doc(cfg(feature = "metrics")))]
+    /// Resets the capture metrics of this camera, see [`metrics()`](Camera::metrics).
+    pub fn reset_metrics(&self) {
+        self.metrics.reset();
+    }
+
+    /// How long it took from starting to open this camera (or to re-initialize it, see [`set_index()`](Camera::set_index)
+    /// and [`set_backend()`](Camera::set_backend)) to its first frame, or `None` if no frame was captured yet.
+    ///
+    /// This includes opening the device, negotiating its format and opening the stream, see [`with_cache()`](Camera::with_cache) to make it faster.
+    #[must_use]
+    pub fn time_to_first_frame(&self) -> Option<Duration> {
+        self.first_frame.elapsed()
+    }
+
+    pub(crate) fn metrics_handle(&self) -> &MetricsHandle {
+        &self.metrics
+    }
 }
 
 impl Drop for Camera {
@@ -419,7 +651,7 @@ impl Drop for Camera {
 
 // TODO: Update as we go
 #[allow(clippy::ifs_same_cond)]
-fn figure_out_auto() -> Option<CaptureAPIBackend> {
+pub(crate) fn figure_out_auto() -> Option<CaptureAPIBackend> {
     let platform = std::env::consts::OS;
     let mut cap = CaptureAPIBackend::Auto;
     if cfg!(feature = "input-v4l") && platform == "linux" {
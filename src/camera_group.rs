@@ -0,0 +1,360 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+use crate::{
+    Buffer, BufferPool, Camera, CameraFormat, CaptureAPIBackend, NokhwaError, StreamConfig,
+};
+use std::{
+    sync::Arc,
+    task::{Context, Poll, Wake, Waker},
+    thread::Thread,
+    time::{Duration, Instant},
+};
+
+// how long to sleep while no camera has a frame ready, unless one wakes us earlier
+const IDLE_WAIT: Duration = Duration::from_millis(50);
+
+// Wakes a thread parked waiting for a frame, once the backend has it ready.
+pub(crate) struct ThreadWaker(pub(crate) Thread);
+
+impl Wake for ThreadWaker {
+    fn wake(self: Arc<Self>) {
+        self.0.unpark();
+    }
+}
+
+struct PendingFrame {
+    frame: Buffer,
+    // when we got the frame, for cameras that do not know when they captured it
+    dequeued: Duration,
+}
+
+/// A set of frames captured at (about) the same time, one per camera of a [`CameraGroup`], in the order of the cameras.
+#[derive(Debug)]
+pub struct FrameSet {
+    frames: Vec<Buffer>,
+    timestamp: Duration,
+    spread: Duration,
+}
+
+impl FrameSet {
+    /// The frames, one per camera of the [`CameraGroup`], in the order of the cameras.
+    #[must_use]
+    pub fn frames(&self) -> &[Buffer] {
+        &self.frames
+    }
+
+    /// The frame of the camera at `index` in the [`CameraGroup`].
+    #[must_use]
+    pub fn get(&self, index: usize) -> Option<&Buffer> {
+        self.frames.get(index)
+    }
+
+    /// The amount of frames in the set.
+    #[must_use]
+    pub fn len(&self) -> usize {
+        self.frames.len()
+    }
+
+    /// Checks if the set has no frames (the [`CameraGroup`] has no cameras).
+    #[must_use]
+    pub fn is_empty(&self) -> bool {
+        self.frames.is_empty()
+    }
+
+    /// When the earliest frame of the set was captured. See [`CameraGroup`] for the clock this is on.
+    #[must_use]
+    pub fn timestamp(&self) -> Duration {
+        self.timestamp
+    }
+
+    /// The time between the earliest and the latest frame of the set. This is never more than the tolerance of the [`CameraGroup`].
+    #[must_use]
+    pub fn spread(&self) -> Duration {
+        self.spread
+    }
+
+    /// Takes the frames out of the set.
+    #[must_use]
+    pub fn into_frames(self) -> Vec<Buffer> {
+        self.frames
+    }
+}
+
+/// Captures from several [`Camera`]s at once, handing out [`FrameSet`]s of frames that were captured within a tolerance of each other
+/// (e.g. for a stereo or multi-view rig).
+///
+/// All cameras are served by the thread calling [`frame_set()`](CameraGroup::frame_set): it asks every camera if its next frame is ready
+/// (see [`poll_frame_ready()`](crate::CaptureBackendTrait::poll_frame_ready)) and sleeps until one is, instead of needing a thread per camera.
+/// With the `output-async` feature, the `V4L2` devices of the group are all waited on in a single `epoll` set. Backends that cannot tell if
+/// a frame is ready (e.g. `OpenCV`, `GStreamer`) block while getting it, one camera after another.
+///
+/// Frames are matched by the timestamps their backend gave them (see [`FrameMetadata`](crate::FrameMetadata#timestamps)), if all the
+/// cameras use the same backend, that backend timestamps every device on the same clock (`V4L2`, `AVFoundation` and `GStreamer`), and
+/// the frames have timestamps. Otherwise, they are matched by when they were dequeued. If the frames
+/// are too far apart, the earliest one is dropped and replaced by the next frame of its camera, until they do match up.
+///
+/// The buffers of the frames come out of one [`BufferPool`], which is filled up when the streams are opened. Give the sets back with
+/// [`recycle_frame_set()`](CameraGroup::recycle_frame_set) once you are done with them, and capturing will not allocate.
+pub struct CameraGroup {
+    cameras: Vec<Camera>,
+    tolerance: Duration,
+    pool: BufferPool,
+    pending: Vec<Option<PendingFrame>>,
+    epoch: Instant,
+    unmatched: u64,
+}
+
+impl CameraGroup {
+    /// Creates a new [`CameraGroup`] out of `cameras`, matching frames that are at most `tolerance` apart.
+    #[must_use]
+    pub fn new(cameras: Vec<Camera>, tolerance: Duration) -> Self {
+        // a set with the caller, a set being matched and some slack
+        let pool = BufferPool::new(cameras.len() * 3);
+        let pending = cameras.iter().map(|_| None).collect();
+        CameraGroup {
+            cameras,
+            tolerance,
+            pool,
+            pending,
+            epoch: Instant::now(),
+            unmatched: 0,
+        }
+    }
+
+    /// Opens the cameras at `indices` with `format` and `backend` and puts them into a new [`CameraGroup`], see [`new()`](CameraGroup::new).
+    /// # Errors
+    /// If any of the cameras fails to open, this will error (see [`Camera::with_backend()`]).
+    pub fn open(
+        indices: &[usize],
+        format: Option<CameraFormat>,
+        backend: CaptureAPIBackend,
+        tolerance: Duration,
+    ) -> Result<Self, NokhwaError> {
+        let cameras = indices
+            .iter()
+            .map(|index| Camera::with_backend(*index, format, backend))
+            .collect::<Result<Vec<Camera>, NokhwaError>>()?;
+        Ok(CameraGroup::new(cameras, tolerance))
+    }
+
+    /// The cameras of the group, in the order their frames are in a [`FrameSet`].
+    #[must_use]
+    pub fn cameras(&self) -> &[Camera] {
+        &self.cameras
+    }
+
+    /// The camera at `index`, e.g. to change its controls. Changing its format only takes effect for the frames after the ones already waiting to be matched.
+    pub fn camera_mut(&mut self, index: usize) -> Option<&mut Camera> {
+        self.cameras.get_mut(index)
+    }
+
+    /// The maximum time between the earliest and latest frame of a [`FrameSet`].
+    #[must_use]
+    pub fn tolerance(&self) -> Duration {
+        self.tolerance
+    }
+
+    /// Sets the maximum time between the earliest and latest frame of a [`FrameSet`].
+    pub fn set_tolerance(&mut self, tolerance: Duration) {
+        self.tolerance = tolerance;
+    }
+
+    /// The [`BufferPool`] the frames are captured into.
+    #[must_use]
+    pub fn buffer_pool(&self) -> BufferPool {
+        self.pool.clone()
+    }
+
+    /// The amount of frames that were dropped because no frame of the other cameras was close enough to them.
+    #[must_use]
+    pub fn unmatched_frames(&self) -> u64 {
+        self.unmatched
+    }
+
+    /// Opens the streams of all cameras, see [`Camera::open_stream()`].
+    /// # Errors
+    /// If any of the cameras fails to open its stream, this will error.
+    pub fn open_stream(&mut self) -> Result<(), NokhwaError> {
+        self.open_stream_with(StreamConfig::default())
+    }
+
+    /// Opens the streams of all cameras with `config`, see [`Camera::open_stream_with()`].
+    /// # Errors
+    /// If any of the cameras does not support `config` or fails to open its stream, this will error.
+    pub fn open_stream_with(&mut self, config: StreamConfig) -> Result<(), NokhwaError> {
+        self.discard_pending();
+        for camera in &mut self.cameras {
+            camera.open_stream_with(config)?;
+        }
+        self.preallocate();
+        Ok(())
+    }
+
+    /// Stops the streams of all cameras, see [`Camera::stop_stream()`].
+    /// # Errors
+    /// If any of the cameras fails to stop its stream, this will error. The others are still stopped.
+    pub fn stop_stream(&mut self) -> Result<(), NokhwaError> {
+        self.discard_pending();
+        let mut result = Ok(());
+        for camera in &mut self.cameras {
+            if let Err(why) = camera.stop_stream() {
+                result = Err(why);
+            }
+        }
+        result
+    }
+
+    /// Waits for the next [`FrameSet`]: one frame per camera, all captured within the tolerance of each other.
+    ///
+    /// Frames that have been captured but not matched yet are kept for the next call if this errors.
+    /// A group without cameras hands out an empty set straight away.
+    /// # Errors
+    /// If any of the cameras fails to get its frame, this will error.
+    pub fn frame_set(&mut self) -> Result<FrameSet, NokhwaError> {
+        // there is nothing to wait for, and nothing to match
+        if self.cameras.is_empty() {
+            return Ok(FrameSet {
+                frames: Vec::new(),
+                timestamp: Duration::ZERO,
+                spread: Duration::ZERO,
+            });
+        }
+        let waker = Waker::from(Arc::new(ThreadWaker(std::thread::current())));
+        let mut cx = Context::from_waker(&waker);
+
+        loop {
+            let mut got_frame = false;
+            for (camera, pending) in self.cameras.iter_mut().zip(self.pending.iter_mut()) {
+                if pending.is_some() {
+                    continue;
+                }
+                match camera.poll_frame_ready(&mut cx) {
+                    Poll::Ready(Ok(())) => {}
+                    Poll::Ready(Err(why)) => return Err(why),
+                    Poll::Pending => continue,
+                }
+                let frame = camera.frame_pooled(&self.pool)?;
+                *pending = Some(PendingFrame {
+                    frame,
+                    dequeued: self.epoch.elapsed(),
+                });
+                got_frame = true;
+            }
+
+            if self.pending.iter().all(Option::is_some) {
+                if let Some(set) = self.match_pending() {
+                    return Ok(set);
+                }
+            } else if !got_frame {
+                std::thread::park_timeout(IDLE_WAIT);
+            }
+        }
+    }
+
+    /// Gives the frames of `set` back to the [`BufferPool`].
+    pub fn recycle_frame_set(&self, set: FrameSet) {
+        for frame in set.frames {
+            self.pool.recycle_buffer(frame);
+        }
+    }
+
+    /// Takes the cameras out of the group.
+    #[must_use]
+    pub fn into_cameras(mut self) -> Vec<Camera> {
+        self.discard_pending();
+        self.cameras
+    }
+
+    // Hands out the pending frames if they are close enough together. If not, drops the earliest one, which cannot match
+    // anything the other cameras capture from now on.
+    fn match_pending(&mut self) -> Option<FrameSet> {
+        // only these backends timestamp every device on one system wide clock, the others use a clock per device (e.g. the
+        // `MSMF` source reader's), or none at all
+        let same_clock = self
+            .cameras
+            .windows(2)
+            .all(|pair| pair[0].backend() == pair[1].backend())
+            && self.cameras.iter().all(|camera| {
+                matches!(
+                    camera.backend(),
+                    CaptureAPIBackend::Video4Linux
+                        | CaptureAPIBackend::AVFoundation
+                        | CaptureAPIBackend::GStreamer
+                )
+            });
+        let driver_times = self
+            .pending
+            .iter()
+            .flatten()
+            .map(|pending| pending.frame.metadata().timestamp())
+            .collect::<Option<Vec<Duration>>>();
+        let times = match driver_times {
+            Some(times) if same_clock => times,
+            _ => self
+                .pending
+                .iter()
+                .flatten()
+                .map(|pending| pending.dequeued)
+                .collect(),
+        };
+
+        let (earliest_idx, earliest) = times
+            .iter()
+            .copied()
+            .enumerate()
+            .min_by_key(|(_, time)| *time)?;
+        let latest = times.iter().copied().max()?;
+        let spread = latest - earliest;
+        if spread > self.tolerance {
+            if let Some(stale) = self.pending[earliest_idx].take() {
+                self.pool.recycle_buffer(stale.frame);
+            }
+            self.unmatched += 1;
+            return None;
+        }
+
+        let frames = self
+            .pending
+            .iter_mut()
+            .filter_map(Option::take)
+            .map(|pending| pending.frame)
+            .collect();
+        Some(FrameSet {
+            frames,
+            timestamp: earliest,
+            spread,
+        })
+    }
+
+    fn discard_pending(&mut self) {
+        for pending in &mut self.pending {
+            if let Some(stale) = pending.take() {
+                self.pool.recycle_buffer(stale.frame);
+            }
+        }
+    }
+
+    // Fills the pool with buffers for two sets, big enough for the raw frames of each camera
+    // (two bytes per pixel, as much as the largest uncompressed format takes).
+    fn preallocate(&self) {
+        for camera in &self.cameras {
+            let resolution = camera.cached_resolution();
+            let len = resolution.width() as usize * resolution.height() as usize * 2;
+            self.pool.preallocate(2, len);
+        }
+    }
+}
@@ -14,17 +14,29 @@
  * limitations under the License.
  */
 
+#[cfg(feature = "input-network")]
+use crate::backends::capture::NetworkCaptureDevice;
+#[cfg(feature = "recording")]
+use crate::backends::capture::ReplayCaptureDevice;
 use crate::{
     error::NokhwaError,
     frame_formats,
     utils::{
-        buf_mjpeg_to_rgb, buf_yuyv422_to_rgb, CameraFormat, CameraInfo, FrameFormat, Resolution,
+        buf_i420_planes_to_rgb, buf_mjpeg_to_rgb, buf_nv12_planes_to_rgb, buf_yuyv422_to_rgb,
+        expand_gray8, CameraFormat, CameraInfo, FrameFormat, Resolution,
     },
-    Buffer, CameraControl, CaptureAPIBackend, ControlValueSetter, KnownCameraControl, PixelFormat,
+    Buffer, BufferPool, CameraControl, CaptureAPIBackend, ControlValueSetter, FrameRef,
+    KnownCameraControl, PixelFormat, StreamConfig,
 };
+#[cfg(feature = "output-wgpu")]
+use crate::{RgbaFormat, StreamedTexture, TextureStreamer};
 use enum_dispatch::enum_dispatch;
 use image::{buffer::ConvertBuffer, ImageBuffer, RgbaImage};
-use std::{borrow::Cow, collections::HashMap};
+use std::{
+    borrow::Cow,
+    collections::HashMap,
+    task::{Context, Poll},
+};
 #[cfg(feature = "output-wgpu")]
 use wgpu::{
     Device as WgpuDevice, Extent3d, ImageCopyTexture, ImageDataLayout, Queue as WgpuQueue,
@@ -38,6 +50,10 @@ pub enum BackendsEnum {
     AVF,
     V4L2,
     OCV,
+    #[cfg(feature = "recording")]
+    ReplayCaptureDevice,
+    #[cfg(feature = "input-network")]
+    NetworkCaptureDevice,
 }
 
 /// This trait is for any backend that allows you to grab and take frames from a camera.
@@ -191,6 +207,24 @@ pub trait CaptureBackendTrait {
     /// If the specific backend fails to open the camera (e.g. already taken, busy, doesn't exist anymore) this will error.
     fn open_stream(&mut self) -> Result<(), NokhwaError>;
 
+    /// Will open the camera stream like [`open_stream()`](CaptureBackendTrait::open_stream()), with the driver buffers and dequeue behaviour set by `config`.
+    /// The backend keeps `config` for every time it reopens the stream (e.g. after [`set_camera_format()`](CaptureBackendTrait::set_camera_format())).
+    ///
+    /// See [`StreamConfig`] for what each backend supports.
+    /// # Errors
+    /// If the backend does not support `config`, or fails to open the camera (e.g. already taken, busy, doesn't exist anymore) this will error.
+    fn open_stream_with(&mut self, config: StreamConfig) -> Result<(), NokhwaError> {
+        if config != StreamConfig::default() {
+            return Err(NokhwaError::UnsupportedOperationError(self.backend()));
+        }
+        self.open_stream()
+    }
+
+    /// The [`StreamConfig`] the stream is opened with, see [`open_stream_with()`](CaptureBackendTrait::open_stream_with()).
+    fn stream_config(&self) -> StreamConfig {
+        StreamConfig::default()
+    }
+
     /// Checks if stream if open. If it is, it will return true.
     fn is_stream_open(&self) -> bool;
 
@@ -199,6 +233,8 @@ pub trait CaptureBackendTrait {
     /// # Errors
     /// If the backend fails to get the frame (e.g. already taken, busy, doesn't exist anymore), the decoding fails (e.g. MJPEG -> u8), or [`open_stream()`](CaptureBackendTrait::open_stream()) has not been called yet,
     /// this will error.
+    ///
+    /// Frames that were decoded are marked as such (see [`Buffer::state()`]), frames the backend passes through as they are (e.g. planar `NV12` frames) are not.
     fn frame(&mut self) -> Result<Buffer, NokhwaError>;
 
     /// Will get a frame from the camera as a Raw RGB image buffer. Depending on the backend, if you have not called [`open_stream()`](CaptureBackendTrait::open_stream()) before you called this,
@@ -208,19 +244,65 @@ pub trait CaptureBackendTrait {
     /// or if the PixelFormat is invalid, this will error.
     fn frame_typed<F: PixelFormat>(
         &mut self,
-    ) -> Result<ImageBuffer<F::Output, Vec<u8>>, NokhwaError>;
+    ) -> Result<ImageBuffer<F::Output, Vec<u8>>, NokhwaError> {
+        self.frame_ref()?.decode_image::<F>()
+    }
 
     /// Will get a frame from the camera **without** any processing applied, meaning you will usually get a frame you need to decode yourself.
     /// # Errors
     /// If the backend fails to get the frame (e.g. already taken, busy, doesn't exist anymore), or [`open_stream()`](CaptureBackendTrait::open_stream()) has not been called yet, this will error.
     fn frame_raw(&mut self) -> Result<Cow<[u8]>, NokhwaError>;
 
+    /// Will get a frame from the camera **without** any processing applied, as a [`FrameRef`] that borrows the backend's buffer if it can.
+    ///
+    /// For backends where [`frame_raw()`](CaptureBackendTrait::frame_raw()) returns borrowed data (e.g. `V4L2`'s memory mapped stream), this does no copy:
+    /// the [`FrameRef`] points straight into the driver's buffer, which is given back once the [`FrameRef`] is dropped and the next frame is requested.
+    /// # Errors
+    /// If the backend fails to get the frame (e.g. already taken, busy, doesn't exist anymore), or [`open_stream()`](CaptureBackendTrait::open_stream()) has not been called yet, this will error.
+    fn frame_ref(&mut self) -> Result<FrameRef, NokhwaError> {
+        let cfmt = self.camera_format();
+        let frame = self.frame_raw()?;
+        Ok(FrameRef::new(cfmt.resolution(), frame, cfmt.format()))
+    }
+
+    /// Will get a frame from the camera **without** any processing applied, copied into a [`Buffer`] taken out of `pool`.
+    ///
+    /// Give the [`Buffer`] back with [`BufferPool::recycle_buffer()`] once you are done with it: in steady state, this will then do no heap allocations per frame
+    /// (as long as the backend's [`frame_raw()`](CaptureBackendTrait::frame_raw()) does not allocate).
+    /// # Errors
+    /// If the backend fails to get the frame (e.g. already taken, busy, doesn't exist anymore), or [`open_stream()`](CaptureBackendTrait::open_stream()) has not been called yet, this will error.
+    fn frame_pooled(&mut self, pool: &BufferPool) -> Result<Buffer, NokhwaError> {
+        Ok(self.frame_ref()?.to_pooled_buffer(pool))
+    }
+
+    /// Will get a frame from the camera as a [`DmaBuf`](crate::DmaBuf) (see [`Buffer::dmabuf()`]), without it ever being copied or mapped into memory.
+    /// This needs the stream to be opened with [`IoMode::DmaBuf`](crate::IoMode::DmaBuf), see [`open_stream_with()`](CaptureBackendTrait::open_stream_with()).
+    ///
+    /// Only `V4L2` supports this.
+    /// # Errors
+    /// If the backend does not support `DMABUF`, the stream is not opened with [`IoMode::DmaBuf`](crate::IoMode::DmaBuf), or the backend fails to get the frame, this will error.
+    fn frame_dmabuf(&mut self) -> Result<Buffer, NokhwaError> {
+        Err(NokhwaError::UnsupportedOperationError(self.backend()))
+    }
+
+    /// Checks if the next frame is ready, so that getting it (e.g. with [`frame()`](CaptureBackendTrait::frame())) will not block.
+    /// If it is not, the task of `cx` is woken once it is. This is what drives [`FrameStream`](crate::FrameStream).
+    ///
+    /// Backends that cannot tell (the default) always return ready, meaning getting the frame may still block.
+    /// `V4L2` waits on the device's file descriptor (with the `output-async` feature), `AVFoundation` on its sample buffer delegate
+    /// and `MSMF` on its source reader callback.
+    /// # Errors
+    /// If the backend fails to wait for the frame, this will error.
+    fn poll_frame_ready(&mut self, _cx: &mut Context<'_>) -> Poll<Result<(), NokhwaError>> {
+        Poll::Ready(Ok(()))
+    }
+
     /// The minimum buffer size needed to write the current frame. If `alpha` is true, it will instead return the minimum size of the RGBA buffer needed.
     fn decoded_buffer_size(&self, alpha: bool) -> Result<usize, NokhwaError> {
         let cfmt = self.camera_format()?;
         let resolution = cfmt.resolution();
         let pxwidth = match cfmt.format() {
-            FrameFormat::MJPEG | FrameFormat::YUYV => 3,
+            FrameFormat::MJPEG | FrameFormat::YUYV | FrameFormat::NV12 | FrameFormat::I420 => 3,
             FrameFormat::GRAY8 => 1,
         };
         if alpha {
@@ -239,21 +321,29 @@ pub trait CaptureBackendTrait {
     ) -> Result<usize, NokhwaError> {
         // FIXME: ??????
         let cfmt = self.camera_format()?;
-        let frame = self.frame_raw()?;
+        // the planes of the frame tell where padded rows are
+        let frame_ref = self.frame_ref()?;
+        let (frame, planes) = (frame_ref.buffer(), frame_ref.planes());
         match cfmt.format() {
-            FrameFormat::MJPEG => buf_mjpeg_to_rgb(&frame, buffer, write_alpha)?,
-            FrameFormat::YUYV => buf_yuyv422_to_rgb(&frame, buffer, write_alpha)?,
+            FrameFormat::MJPEG => buf_mjpeg_to_rgb(frame, buffer, write_alpha)?,
+            FrameFormat::YUYV => buf_yuyv422_to_rgb(frame, buffer, write_alpha)?,
+            FrameFormat::NV12 => {
+                buf_nv12_planes_to_rgb(cfmt.resolution(), frame, planes, buffer, write_alpha)?;
+            }
+            FrameFormat::I420 => {
+                buf_i420_planes_to_rgb(cfmt.resolution(), frame, planes, buffer, write_alpha)?;
+            }
             FrameFormat::GRAY8 => {
-                let data = if write_alpha {
-                    frame
-                        .into_iter()
-                        .flat_map(|px| [*px, u8::MAX])
-                        .collect::<Cow<[u8]>>()
-                } else {
-                    frame
-                };
-
-                buffer.copy_from_slice(&data)
+                let expected = frame.len() * if write_alpha { 2 } else { 1 };
+                if buffer.len() != expected {
+                    return Err(NokhwaError::ProcessFrameError {
+                        src: FrameFormat::GRAY8,
+                        destination: "GRAY8".to_string(),
+                        error: format!("Assertion failure, the destination buffer is of the wrong size! [expected: {expected}, actual: {}]", buffer.len()),
+                    });
+                }
+                // written straight into `buffer`, with an alpha after every luma if `write_alpha`
+                expand_gray8(frame, buffer, 1, write_alpha);
             }
         };
         Ok(frame.len())
@@ -261,18 +351,19 @@ pub trait CaptureBackendTrait {
 
     #[cfg(feature = "output-wgpu")]
     #[cfg_attr(feature = "docs-features", doc(cfg(feature = "output-wgpu")))]
-    /// Directly copies a frame to a Wgpu texture. This will automatically convert the frame into a RGBA frame.
+    /// Directly copies a frame to a new Wgpu texture. This will automatically convert the frame into a RGBA frame.
+    ///
+    /// If you do this every frame, use [`frame_texture_streamed()`](CaptureBackendTrait::frame_texture_streamed()) instead, which reuses its textures.
     /// # Errors
     /// If the frame cannot be captured or the resolution is 0 on any axis, this will error.
-    fn frame_texture<'a, F: PixelFormat>(
+    fn frame_texture<'a>(
         &mut self,
         device: &WgpuDevice,
         queue: &WgpuQueue,
         label: Option<&'a str>,
     ) -> Result<WgpuTexture, NokhwaError> {
-        use image::RgbaImage;
         use std::{convert::TryFrom, num::NonZeroU32};
-        let frame = RgbaImage::from(elf.frame()?.to_image_with_custom_format::<F>()?);
+        let frame = self.frame_ref()?.decode_image::<RgbaFormat>()?;
 
         let texture_size = Extent3d {
             width: frame.width(),
@@ -307,7 +398,7 @@ pub trait CaptureBackendTrait {
                 origin: wgpu::Origin3d::ZERO,
                 aspect: TextureAspect::All,
             },
-            &rgba_frame.to_vec(),
+            frame.as_raw(),
             ImageDataLayout {
                 offset: 0,
                 bytes_per_row: width_nonzero,
@@ -319,10 +410,40 @@ pub trait CaptureBackendTrait {
         Ok(texture)
     }
 
+    #[cfg(feature = "output-wgpu")]
+    #[cfg_attr(feature = "docs-features", doc(cfg(feature = "output-wgpu")))]
+    /// Uploads a frame into the next texture of `streamer`, which converts it to RGBA on the GPU (see [`TextureStreamer`]).
+    ///
+    /// Unlike [`frame_texture()`](CaptureBackendTrait::frame_texture()), this does not create a new texture or convert the frame on the CPU.
+    /// # Errors
+    /// If the frame cannot be captured, its format is not supported, or the resolution is 0 on any axis, this will error.
+    fn frame_texture_streamed<'a>(
+        &mut self,
+        streamer: &'a mut TextureStreamer,
+        device: &WgpuDevice,
+        queue: &WgpuQueue,
+    ) -> Result<&'a StreamedTexture, NokhwaError> {
+        let frame = self.frame_ref()?;
+        streamer.upload_frame(device, queue, &frame)
+    }
+
     /// Will drop the stream.
     /// # Errors
     /// Please check the `Quirks` section of each backend.
     fn stop_stream(&mut self) -> Result<(), NokhwaError>;
 }
 
-pub trait VirtualBackendTrait {}
+/// This trait is for backends that do not capture from a camera, but produce their frames some other way
+/// (e.g. [`ReplayCaptureDevice`](crate::backends::capture::ReplayCaptureDevice), which replays a recording).
+pub trait VirtualBackendTrait: CaptureBackendTrait {
+    /// The amount of frames the backend can hand out before it runs out, or `None` if it never does.
+    fn frame_count(&self) -> Option<usize>;
+
+    /// The index of the next frame that will be handed out.
+    fn position(&self) -> usize;
+
+    /// Makes the frame at `frame` the next one to be handed out.
+    /// # Errors
+    /// If there is no such frame, or the backend cannot seek, this will error.
+    fn seek(&mut self, frame: usize) -> Result<(), NokhwaError>;
+}
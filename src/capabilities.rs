@@ -0,0 +1,283 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+use crate::{
+    camera::figure_out_auto, Camera, CameraFormat, CameraInfo, CaptureAPIBackend, NokhwaError,
+};
+#[cfg(feature = "serde")]
+use serde::{Deserialize, Serialize};
+use std::time::{Duration, Instant};
+
+/// What identifies a device across runs: the backend it is opened with, its index, and the name and `misc` of its [`CameraInfo`].
+///
+/// An index alone is not enough, another device can show up at the same index after a replug or a reboot.
+#[derive(Clone, Debug, Hash, PartialEq, Eq, PartialOrd, Ord)]
+#[cfg_attr(feature = "serde", derive(Serialize, Deserialize))]
+pub struct DeviceIdentity {
+    backend: CaptureAPIBackend,
+    index: u32,
+    human_name: String,
+    misc: String,
+}
+
+impl DeviceIdentity {
+    /// The identity of the device `info` of `backend`.
+    #[must_use]
+    pub fn new(backend: CaptureAPIBackend, info: &CameraInfo) -> Self {
+        DeviceIdentity {
+            backend,
+            index: info.index(),
+            human_name: info.human_name(),
+            misc: info.misc(),
+        }
+    }
+
+    /// The backend the device is opened with.
+    #[must_use]
+    pub fn backend(&self) -> CaptureAPIBackend {
+        self.backend
+    }
+
+    /// The index of the device.
+    #[must_use]
+    pub fn index(&self) -> u32 {
+        self.index
+    }
+
+    /// The human readable name of the device, see [`CameraInfo::human_name()`].
+    #[must_use]
+    pub fn human_name(&self) -> &str {
+        &self.human_name
+    }
+
+    /// The `misc` of the device, see [`CameraInfo::misc()`].
+    #[must_use]
+    pub fn misc(&self) -> &str {
+        &self.misc
+    }
+
+    /// Checks if `info` is the device this identifies.
+    #[must_use]
+    pub fn matches(&self, info: &CameraInfo) -> bool {
+        self.index == info.index()
+            && self.human_name == info.human_name()
+            && self.misc == info.misc()
+    }
+}
+
+/// What a [`CapabilityCache`] knows about a device.
+#[derive(Clone, Debug, PartialEq)]
+#[cfg_attr(feature = "serde", derive(Serialize, Deserialize))]
+pub struct DeviceCapabilities {
+    identity: DeviceIdentity,
+    formats: Vec<CameraFormat>,
+    known_good: Option<CameraFormat>,
+    time_to_first_frame: Option<Duration>,
+}
+
+impl DeviceCapabilities {
+    /// The device these are the capabilities of.
+    #[must_use]
+    pub fn identity(&self) -> &DeviceIdentity {
+        &self.identity
+    }
+
+    /// The compatible [`CameraFormat`]s of the device, see [`Camera::compatible_camera_formats()`].
+    #[must_use]
+    pub fn formats(&self) -> &[CameraFormat] {
+        &self.formats
+    }
+
+    /// The [`CameraFormat`] the device last streamed with, which [`Camera::with_cache()`] opens it with.
+    #[must_use]
+    pub fn known_good(&self) -> Option<CameraFormat> {
+        self.known_good
+    }
+
+    /// How long the device took from being opened to its first frame the last time it was remembered, see [`Camera::time_to_first_frame()`].
+    #[must_use]
+    pub fn time_to_first_frame(&self) -> Option<Duration> {
+        self.time_to_first_frame
+    }
+}
+
+/// A cache of the [`DeviceCapabilities`] of devices, so they do not have to be queried from the driver every time a device is opened.
+///
+/// Querying every format of a device (`V4L2` enumerating the frame sizes and intervals of every fourcc, `MSMF` walking every native media type)
+/// can take seconds. Remember an opened camera once with [`remember()`](CapabilityCache::remember), then open it with [`Camera::with_cache()`],
+/// which applies its known-good [`CameraFormat`] directly without enumerating anything.
+///
+/// With the `serialize` feature, the cache is `Serialize`/`Deserialize`, so it can be persisted between runs in whatever format you use.
+#[derive(Clone, Debug, Default, PartialEq)]
+#[cfg_attr(feature = "serde", derive(Serialize, Deserialize))]
+pub struct CapabilityCache {
+    // a `Vec`, as not every format can have a struct as the key of a map
+    devices: Vec<DeviceCapabilities>,
+}
+
+impl CapabilityCache {
+    /// Creates an empty [`CapabilityCache`].
+    #[must_use]
+    pub fn new() -> Self {
+        CapabilityCache::default()
+    }
+
+    /// The capabilities of the device `identity`, if they are known.
+    #[must_use]
+    pub fn get(&self, identity: &DeviceIdentity) -> Option<&DeviceCapabilities> {
+        self.devices
+            .iter()
+            .find(|device| &device.identity == identity)
+    }
+
+    /// The capabilities of the device at `index` of `backend`, whatever device that was when they were remembered.
+    #[must_use]
+    pub fn get_by_index(
+        &self,
+        backend: CaptureAPIBackend,
+        index: u32,
+    ) -> Option<&DeviceCapabilities> {
+        let backend = resolve_backend(backend);
+        self.devices
+            .iter()
+            .find(|device| device.identity.backend == backend && device.identity.index == index)
+    }
+
+    /// All the devices in the cache.
+    pub fn devices(&self) -> impl Iterator<Item = &DeviceCapabilities> {
+        self.devices.iter()
+    }
+
+    /// Sets the compatible `formats` of the device `identity`, keeping its known-good format only if it is one of them.
+    pub fn insert(&mut self, identity: DeviceIdentity, formats: Vec<CameraFormat>) {
+        let device = self.entry(identity);
+        if let Some(known_good) = device.known_good {
+            if !formats.contains(&known_good) {
+                device.known_good = None;
+            }
+        }
+        device.formats = formats;
+    }
+
+    /// Sets the [`CameraFormat`] the device `identity` is opened with by [`Camera::with_cache()`].
+    pub fn set_known_good(&mut self, identity: DeviceIdentity, format: CameraFormat) {
+        self.entry(identity).known_good = Some(format);
+    }
+
+    /// Remembers the opened `camera`: its current [`CameraFormat`] as known-good, its [`time_to_first_frame()`](Camera::time_to_first_frame)
+    /// and, if they are not known yet, its compatible formats (which queries them from the driver).
+    ///
+    /// Call this once the camera is streaming in the format you want it to open in next time.
+    /// # Errors
+    /// If the formats have to be queried and that fails, this will error.
+    pub fn remember(&mut self, camera: &mut Camera) -> Result<&DeviceCapabilities, NokhwaError> {
+        let identity = DeviceIdentity::new(resolve_backend(camera.backend()), camera.info());
+        let formats = match self.get(&identity) {
+            Some(device) if !device.formats.is_empty() => None,
+            _ => Some(camera.compatible_camera_formats()?),
+        };
+
+        let device = self.entry(identity);
+        if let Some(formats) = formats {
+            device.formats = formats;
+        }
+        device.known_good = Some(camera.cached_camera_format());
+        if let Some(time_to_first_frame) = camera.time_to_first_frame() {
+            device.time_to_first_frame = Some(time_to_first_frame);
+        }
+        Ok(device)
+    }
+
+    /// Forgets the device `identity`, returning what was known about it.
+    pub fn remove(&mut self, identity: &DeviceIdentity) -> Option<DeviceCapabilities> {
+        let position = self
+            .devices
+            .iter()
+            .position(|device| &device.identity == identity)?;
+        Some(self.devices.remove(position))
+    }
+
+    /// Forgets every device.
+    pub fn clear(&mut self) {
+        self.devices.clear();
+    }
+
+    /// The amount of devices in the cache.
+    #[must_use]
+    pub fn len(&self) -> usize {
+        self.devices.len()
+    }
+
+    /// Checks if the cache has no devices.
+    #[must_use]
+    pub fn is_empty(&self) -> bool {
+        self.devices.is_empty()
+    }
+
+    fn entry(&mut self, identity: DeviceIdentity) -> &mut DeviceCapabilities {
+        let position = match self
+            .devices
+            .iter()
+            .position(|device| device.identity == identity)
+        {
+            Some(position) => position,
+            None => {
+                self.devices.push(DeviceCapabilities {
+                    identity,
+                    formats: Vec::new(),
+                    known_good: None,
+                    time_to_first_frame: None,
+                });
+                self.devices.len() - 1
+            }
+        };
+        &mut self.devices[position]
+    }
+}
+
+// `Auto` is stored as the backend it stands for, so the cache stays valid if `Auto` is used to open it or not
+pub(crate) fn resolve_backend(backend: CaptureAPIBackend) -> CaptureAPIBackend {
+    match backend {
+        CaptureAPIBackend::Auto => figure_out_auto().unwrap_or(CaptureAPIBackend::Auto),
+        backend => backend,
+    }
+}
+
+// Measures the time from a camera starting to open to its first frame.
+#[derive(Copy, Clone, Debug)]
+pub(crate) struct FirstFrameTimer {
+    started: Instant,
+    elapsed: Option<Duration>,
+}
+
+impl FirstFrameTimer {
+    pub(crate) fn start() -> Self {
+        FirstFrameTimer {
+            started: Instant::now(),
+            elapsed: None,
+        }
+    }
+
+    pub(crate) fn mark(&mut self) {
+        if self.elapsed.is_none() {
+            self.elapsed = Some(self.started.elapsed());
+        }
+    }
+
+    pub(crate) fn elapsed(&self) -> Option<Duration> {
+        self.elapsed
+    }
+}
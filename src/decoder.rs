@@ -0,0 +1,570 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+use crate::{
+    backends::decoder::hardware_mjpeg_decoder,
+    metrics::{self, Stage},
+    FrameFormat, NokhwaError, Region, Resolution,
+};
+#[cfg(feature = "serde")]
+use serde::{Deserialize, Serialize};
+use std::{
+    cell::RefCell,
+    fmt::{Debug, Formatter},
+};
+
+/// The scale to decode a `MJPEG` frame at.
+///
+/// Anything other than [`DecodeScale::Full`] is done by libjpeg in the DCT domain, which is a lot cheaper
+/// than decoding the full frame and resizing it afterwards.
+#[derive(Copy, Clone, Debug, Hash, PartialEq, Eq, PartialOrd, Ord)]
+#[cfg_attr(feature = "serde", derive(Serialize, Deserialize))]
+pub enum DecodeScale {
+    /// Full resolution (1/1).
+    Full,
+    /// Half resolution (1/2).
+    Half,
+    /// Quarter resolution (1/4).
+    Quarter,
+    /// Eighth resolution (1/8).
+    Eighth,
+}
+
+impl DecodeScale {
+    /// The numerator of the scale, out of 8.
+    #[must_use]
+    pub fn numerator(self) -> u8 {
+        match self {
+            DecodeScale::Full => 8,
+            DecodeScale::Half => 4,
+            DecodeScale::Quarter => 2,
+            DecodeScale::Eighth => 1,
+        }
+    }
+
+    /// The resolution a frame of `source` resolution is decoded to. This rounds up, like libjpeg does.
+    #[must_use]
+    pub fn scaled_resolution(self, source: Resolution) -> Resolution {
+        let numerator = u32::from(self.numerator());
+        Resolution::new(
+            (source.width() * numerator + 7) / 8,
+            (source.height() * numerator + 7) / 8,
+        )
+    }
+}
+
+impl Default for DecodeScale {
+    fn default() -> Self {
+        DecodeScale::Full
+    }
+}
+
+/// A decoder that turns compressed frames into RGB888 (or RGBA).
+///
+/// This is what [`Buffer::decode_with()`](crate::Buffer::decode_with) calls into, so the `mozjpeg` based [`MjpegDecoder`] can be swapped out
+/// for a hardware decoder (see [`AutoMjpegDecoder`]) or your own implementation.
+pub trait FrameDecoder: Send {
+    /// The name of this decoder, e.g. `"mozjpeg"`.
+    fn name(&self) -> &'static str;
+
+    /// Checks if frames are decoded by dedicated hardware instead of on the CPU.
+    fn hardware_accelerated(&self) -> bool;
+
+    /// The [`FrameFormat`] this decoder takes in.
+    fn source_format(&self) -> FrameFormat;
+
+    /// Checks if this decoder decodes to RGBA instead of RGB888.
+    fn rgba(&self) -> bool;
+
+    /// The size in bytes of a frame of `source` resolution once decoded by this decoder.
+    fn decoded_size(&self, source: Resolution) -> usize;
+
+    /// Decodes `data`, a frame of `source` resolution, into `dest`, which is [`decoded_size()`](FrameDecoder::decoded_size) bytes.
+    /// Returns the resolution of the decoded frame.
+    /// # Errors
+    /// If `data` could not be decoded or `dest` is of the wrong size, this will error.
+    fn decode_frame(
+        &mut self,
+        data: &[u8],
+        source: Resolution,
+        dest: &mut [u8],
+    ) -> Result<Resolution, NokhwaError>;
+}
+
+thread_local! {
+    // used by the one-off conversion functions, so calling them every frame still reuses the scanline buffers
+    static SHARED_DECODERS: RefCell<[MjpegDecoder; 2]> =
+        RefCell::new([MjpegDecoder::new(false), MjpegDecoder::new(true)]);
+}
+
+/// Runs `f` with this thread's shared full scale decoder for RGB888, or RGBA if `rgba` is true.
+pub(crate) fn with_shared_decoder<R>(rgba: bool, f: impl FnOnce(&mut MjpegDecoder) -> R) -> R {
+    SHARED_DECODERS.with(|decoders| f(&mut decoders.borrow_mut()[usize::from(rgba)]))
+}
+
+/// A reusable `MJPEG` decoder.
+///
+/// Keep one of these around per camera (or per decoding thread) instead of calling [`mjpeg_to_rgb()`](crate::mjpeg_to_rgb) every frame:
+/// the decoded image is written into a buffer that is reused between frames, so decoding a stream does not allocate once the first frame has been decoded.
+/// Frames can also be decoded at a reduced [`DecodeScale`].
+#[derive(Clone, Debug, Default)]
+pub struct MjpegDecoder {
+    scale: DecodeScale,
+    rgba: bool,
+    buffer: Vec<u8>,
+    scanline: Vec<u8>,
+    resolution: Resolution,
+}
+
+impl MjpegDecoder {
+    /// Creates a new [`MjpegDecoder`] that decodes to RGB888, or RGBA if `rgba` is true, at full scale.
+    #[must_use]
+    pub fn new(rgba: bool) -> Self {
+        Self::with_scale(rgba, DecodeScale::Full)
+    }
+
+    /// Creates a new [`MjpegDecoder`] that decodes to RGB888, or RGBA if `rgba` is true, at `scale`.
+    #[must_use]
+    pub fn with_scale(rgba: bool, scale: DecodeScale) -> Self {
+        MjpegDecoder {
+            scale,
+            rgba,
+            buffer: Vec::new(),
+            scanline: Vec::new(),
+            resolution: Resolution::default(),
+        }
+    }
+
+    /// The [`DecodeScale`] of this decoder.
+    #[must_use]
+    pub fn scale(&self) -> DecodeScale {
+        self.scale
+    }
+
+    /// Sets the [`DecodeScale`] of this decoder.
+    pub fn set_scale(&mut self, scale: DecodeScale) {
+        self.scale = scale;
+    }
+
+    /// Checks if this decoder decodes to RGBA instead of RGB888.
+    #[must_use]
+    pub fn rgba(&self) -> bool {
+        self.rgba
+    }
+
+    /// The size in bytes of a frame of `source` resolution once decoded by this decoder.
+    #[must_use]
+    pub fn decoded_size(&self, source: Resolution) -> usize {
+        let resolution = self.scale.scaled_resolution(source);
+        let pixel_size = if self.rgba { 4 } else { 3 };
+        (resolution.width() * resolution.height()) as usize * pixel_size
+    }
+
+    /// The resolution of the last decoded frame.
+    #[must_use]
+    pub fn resolution(&self) -> Resolution {
+        self.resolution
+    }
+
+    /// Consumes the decoder, giving back the last decoded frame.
+    #[must_use]
+    pub fn into_buffer(self) -> Vec<u8> {
+        self.buffer
+    }
+
+    // hands out the last decoded frame, the next one grows a new buffer
+    pub(crate) fn take_buffer(&mut self) -> Vec<u8> {
+        std::mem::take(&mut self.buffer)
+    }
+
+    /// Decodes `data` into this decoder's internal buffer, returning the decoded pixels. The buffer is reused for the next frame.
+    /// # Errors
+    /// If `data` is not a valid JPEG, or decoding is not supported on this platform, this will error.
+    pub fn decode(&mut self, data: &[u8]) -> Result<&[u8], NokhwaError> {
+        let mut buffer = std::mem::take(&mut self.buffer);
+        let result = self.decode_inner(data, DecodeDestination::Grow(&mut buffer));
+        self.buffer = buffer;
+        result?;
+        Ok(&self.buffer)
+    }
+
+    /// Decodes `data` into `dest`, returning the resolution of the decoded frame.
+    /// # Errors
+    /// If `data` is not a valid JPEG, `dest` is not exactly [`decoded_size()`](MjpegDecoder::decoded_size) bytes, or decoding is not supported on this platform, this will error.
+    pub fn decode_into(&mut self, data: &[u8], dest: &mut [u8]) -> Result<Resolution, NokhwaError> {
+        self.decode_inner(data, DecodeDestination::Exact(dest))
+    }
+
+    /// Decodes only `region` of `data` into `dest`, keeping every `downscale`th pixel of every `downscale`th row, and returns the resolution written.
+    /// `dest` must be exactly [`Region::output_size()`] bytes. The [`scale()`](MjpegDecoder::scale) of this decoder is not used.
+    ///
+    /// The power of two part of `downscale` (up to 8) is done by libjpeg in the DCT domain, like a [`DecodeScale`], and only the rest by skipping pixels.
+    /// Decoding stops after the last row of the region, and only the columns of the region are copied out of each decoded row.
+    /// # Errors
+    /// If `data` is not a valid JPEG, `region` does not fit in it, `downscale` is 0, `dest` is of the wrong size, or decoding is not supported on this platform, this will error.
+    #[cfg(all(feature = "decoding", not(target_arch = "wasm")))]
+    pub fn decode_region_into(
+        &mut self,
+        data: &[u8],
+        region: Region,
+        downscale: u32,
+        dest: &mut [u8],
+    ) -> Result<Resolution, NokhwaError> {
+        use mozjpeg::Decompress;
+
+        let _timer = metrics::time(Stage::Decode);
+        let destination = if self.rgba { "RGBA8888" } else { "RGB888" };
+        let process_error = |error: String| NokhwaError::ProcessFrameError {
+            src: FrameFormat::MJPEG,
+            destination: destination.to_string(),
+            error,
+        };
+
+        let mut decompress =
+            Decompress::new_mem(data).map_err(|why| process_error(why.to_string()))?;
+        #[allow(clippy::cast_possible_truncation)]
+        let source = Resolution::new(decompress.width() as u32, decompress.height() as u32);
+        crate::region::check_region(
+            FrameFormat::MJPEG,
+            source,
+            region,
+            downscale,
+            dest,
+            self.rgba,
+        )?;
+
+        let scale = match downscale.trailing_zeros() {
+            0 => DecodeScale::Full,
+            1 => DecodeScale::Half,
+            2 => DecodeScale::Quarter,
+            _ => DecodeScale::Eighth,
+        };
+        let scale_factor = 8 / u32::from(scale.numerator());
+        decompress.scale(scale.numerator());
+
+        let mut jpeg_decompress = if self.rgba {
+            decompress.rgba()
+        } else {
+            decompress.rgb()
+        }
+        .map_err(|why| process_error(why.to_string()))?;
+
+        let pixel_size = if self.rgba { 4 } else { 3 };
+        let output = region.scaled_resolution(downscale);
+        let step = (downscale / scale_factor) as usize;
+        // the region in the rows and columns of the DCT scaled image
+        let (x, y) = (
+            (region.x() / scale_factor) as usize,
+            (region.y() / scale_factor) as usize,
+        );
+        // does not reallocate if the last frame was at least as wide
+        self.scanline
+            .resize(jpeg_decompress.width() * pixel_size, 0);
+
+        // mozjpeg does not expose jpeg_skip_scanlines() or jpeg_crop_scanline(),
+        // so the rows above the region still go through the IDCT
+        let mut next_row = 0;
+        for (out_row, dest_row) in dest
+            .chunks_exact_mut(output.width() as usize * pixel_size)
+            .enumerate()
+        {
+            let row = y + out_row * step;
+            while next_row <= row {
+                jpeg_decompress.read_scanlines_flat_into(&mut self.scanline);
+                next_row += 1;
+            }
+            if step == 1 {
+                let start = x * pixel_size;
+                dest_row.copy_from_slice(&self.scanline[start..start + dest_row.len()]);
+            } else {
+                for (out_col, pixel) in dest_row.chunks_exact_mut(pixel_size).enumerate() {
+                    let col = x + out_col * step;
+                    pixel.copy_from_slice(&self.scanline[col * pixel_size..][..pixel_size]);
+                }
+            }
+        }
+        // the rows below the region are never decoded, dropping the decompressor aborts it
+
+        self.resolution = output;
+        Ok(output)
+    }
+
+    #[cfg(not(all(feature = "decoding", not(target_arch = "wasm"))))]
+    #[allow(clippy::unused_self)]
+    pub fn decode_region_into(
+        &mut self,
+        _data: &[u8],
+        _region: Region,
+        _downscale: u32,
+        _dest: &mut [u8],
+    ) -> Result<Resolution, NokhwaError> {
+        Err(NokhwaError::NotImplementedError(
+            "Not available on WASM".to_string(),
+        ))
+    }
+
+    #[cfg(all(feature = "decoding", not(target_arch = "wasm")))]
+    fn decode_inner(
+        &mut self,
+        data: &[u8],
+        dest: DecodeDestination,
+    ) -> Result<Resolution, NokhwaError> {
+        use mozjpeg::Decompress;
+
+        let _timer = metrics::time(Stage::Decode);
+        let destination = if self.rgba { "RGBA8888" } else { "RGB888" };
+        let process_error = |error: String| NokhwaError::ProcessFrameError {
+            src: FrameFormat::MJPEG,
+            destination: destination.to_string(),
+            error,
+        };
+
+        let mut decompress =
+            Decompress::new_mem(data).map_err(|why| process_error(why.to_string()))?;
+        // DCT domain scaling, libjpeg does scale_num / 8
+        decompress.scale(self.scale.numerator());
+
+        let mut jpeg_decompress = if self.rgba {
+            decompress.rgba()
+        } else {
+            decompress.rgb()
+        }
+        .map_err(|why| process_error(why.to_string()))?;
+
+        #[allow(clippy::cast_possible_truncation)]
+        let resolution = Resolution::new(
+            jpeg_decompress.width() as u32,
+            jpeg_decompress.height() as u32,
+        );
+        let decoded_size = jpeg_decompress.min_flat_buffer_size();
+
+        let dest = match dest {
+            DecodeDestination::Grow(buffer) => {
+                // does not reallocate if the last frame was at least as large
+                buffer.resize(decoded_size, 0);
+                buffer.as_mut_slice()
+            }
+            DecodeDestination::Exact(buffer) => {
+                if buffer.len() != decoded_size {
+                    return Err(process_error(format!(
+                        "Bad destination buffer size: expected {}, got {}",
+                        decoded_size,
+                        buffer.len()
+                    )));
+                }
+                buffer
+            }
+        };
+
+        jpeg_decompress.read_scanlines_flat_into(dest);
+        if !jpeg_decompress.finish_decompress() {
+            return Err(process_error("Failed to finish decompressing".to_string()));
+        }
+
+        self.resolution = resolution;
+        Ok(resolution)
+    }
+
+    #[cfg(not(all(feature = "decoding", not(target_arch = "wasm"))))]
+    #[allow(clippy::unused_self)]
+    fn decode_inner(
+        &mut self,
+        _data: &[u8],
+        _dest: DecodeDestination,
+    ) -> Result<Resolution, NokhwaError> {
+        Err(NokhwaError::NotImplementedError(
+            "Not available on WASM".to_string(),
+        ))
+    }
+}
+
+impl FrameDecoder for MjpegDecoder {
+    fn name(&self) -> &'static str {
+        "mozjpeg"
+    }
+
+    fn hardware_accelerated(&self) -> bool {
+        false
+    }
+
+    fn source_format(&self) -> FrameFormat {
+        FrameFormat::MJPEG
+    }
+
+    fn rgba(&self) -> bool {
+        self.rgba
+    }
+
+    fn decoded_size(&self, source: Resolution) -> usize {
+        MjpegDecoder::decoded_size(self, source)
+    }
+
+    fn decode_frame(
+        &mut self,
+        data: &[u8],
+        _source: Resolution,
+        dest: &mut [u8],
+    ) -> Result<Resolution, NokhwaError> {
+        self.decode_into(data, dest)
+    }
+}
+
+/// A `MJPEG` decoder that uses the platform's hardware JPEG decoder if there is one, and [`MjpegDecoder`] (`mozjpeg`) otherwise.
+///
+/// The hardware decoders are:
+/// - `VA-API` (or `V4L2` memory-to-memory) through `GStreamer` on Linux, with feature `input-gst`
+/// - The `Media Foundation` JPEG decoder `MFT` on Windows, with feature `input-msmf`
+/// - `VideoToolbox` on macOS, with feature `input-avfoundation`
+///
+/// If the hardware decoder fails to decode a frame, that frame is decoded with `mozjpeg` instead, so a frame is only lost if
+/// `mozjpeg` cannot decode it either. Only after the hardware decoder failed 8 frames in a row is it thrown away, and this falls
+/// back to `mozjpeg` for good.
+///
+/// Hardware decoders always decode at full scale: if a reduced [`DecodeScale`] is asked for, `mozjpeg` is used, as
+/// scaling in the DCT domain is cheaper than decoding the full frame.
+pub struct AutoMjpegDecoder {
+    hardware: Option<Box<dyn FrameDecoder>>,
+    software: MjpegDecoder,
+    // frames in a row the hardware decoder failed
+    hardware_failures: u32,
+}
+
+// how many frames in a row the hardware decoder can fail before it is given up on. A single corrupt frame (e.g. a truncated
+// one from a flaky USB connection) should not cost every frame after it the hardware decoder.
+const HARDWARE_FAILURE_LIMIT: u32 = 8;
+
+impl AutoMjpegDecoder {
+    /// Creates a new [`AutoMjpegDecoder`] that decodes to RGB888, or RGBA if `rgba` is true, at full scale.
+    #[must_use]
+    pub fn new(rgba: bool) -> Self {
+        Self::with_scale(rgba, DecodeScale::Full)
+    }
+
+    /// Creates a new [`AutoMjpegDecoder`] that decodes to RGB888, or RGBA if `rgba` is true, at `scale`.
+    #[must_use]
+    pub fn with_scale(rgba: bool, scale: DecodeScale) -> Self {
+        let hardware = if scale == DecodeScale::Full {
+            hardware_mjpeg_decoder(rgba)
+        } else {
+            None
+        };
+        AutoMjpegDecoder {
+            hardware,
+            software: MjpegDecoder::with_scale(rgba, scale),
+            hardware_failures: 0,
+        }
+    }
+
+    /// Creates a new [`AutoMjpegDecoder`] that never uses a hardware decoder.
+    #[must_use]
+    pub fn software(rgba: bool, scale: DecodeScale) -> Self {
+        AutoMjpegDecoder {
+            hardware: None,
+            software: MjpegDecoder::with_scale(rgba, scale),
+            hardware_failures: 0,
+        }
+    }
+
+    /// The name of the decoder that is currently in use.
+    #[must_use]
+    pub fn active_decoder(&self) -> &'static str {
+        match &self.hardware {
+            Some(hardware) => hardware.name(),
+            None => self.software.name(),
+        }
+    }
+}
+
+impl Debug for AutoMjpegDecoder {
+    fn fmt(&self, f: &mut Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("AutoMjpegDecoder")
+            .field("active_decoder", &self.active_decoder())
+            .field("software", &self.software)
+            .finish_non_exhaustive()
+    }
+}
+
+impl FrameDecoder for AutoMjpegDecoder {
+    fn name(&self) -> &'static str {
+        "auto"
+    }
+
+    fn hardware_accelerated(&self) -> bool {
+        self.hardware.is_some()
+    }
+
+    fn source_format(&self) -> FrameFormat {
+        FrameFormat::MJPEG
+    }
+
+    fn rgba(&self) -> bool {
+        self.software.rgba()
+    }
+
+    fn decoded_size(&self, source: Resolution) -> usize {
+        self.software.decoded_size(source)
+    }
+
+    fn decode_frame(
+        &mut self,
+        data: &[u8],
+        source: Resolution,
+        dest: &mut [u8],
+    ) -> Result<Resolution, NokhwaError> {
+        // covers the hardware decoder, the software decoder only counts itself if it is called directly
+        let _timer = metrics::time(Stage::Decode);
+        if let Some(hardware) = &mut self.hardware {
+            // a wrong sized buffer is the callers fault, not the decoders
+            if dest.len() != hardware.decoded_size(source) {
+                let destination = if self.software.rgba() {
+                    "RGBA8888"
+                } else {
+                    "RGB888"
+                };
+                return Err(NokhwaError::ProcessFrameError {
+                    src: FrameFormat::MJPEG,
+                    destination: destination.to_string(),
+                    error: format!(
+                        "Bad destination buffer size: expected {}, got {}",
+                        hardware.decoded_size(source),
+                        dest.len()
+                    ),
+                });
+            }
+            match hardware.decode_frame(data, source, dest) {
+                Ok(resolution) => {
+                    self.hardware_failures = 0;
+                    return Ok(resolution);
+                }
+                Err(_) => {
+                    self.hardware_failures += 1;
+                    // it keeps failing on frames that are fine, so it is broken, not the frames
+                    if self.hardware_failures >= HARDWARE_FAILURE_LIMIT {
+                        self.hardware = None;
+                    }
+                }
+            }
+        }
+        self.software.decode_into(data, dest)
+    }
+}
+
+enum DecodeDestination<'a> {
+    // resized to fit the frame
+    Grow(&'a mut Vec<u8>),
+    // must be exactly the size of the frame
+    Exact(&'a mut [u8]),
+}
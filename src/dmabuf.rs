@@ -0,0 +1,116 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+use std::{
+    any::Any,
+    cmp::Ordering,
+    hash::{Hash, Hasher},
+    os::unix::io::{AsRawFd, BorrowedFd, OwnedFd, RawFd},
+    sync::Arc,
+};
+
+/// The `DRM` format modifier of a buffer without tiling or compression (`DRM_FORMAT_MOD_LINEAR`), which is what `V4L2` hands out.
+pub const DRM_FORMAT_MOD_LINEAR: u64 = 0;
+
+/// A frame that lives in a `DMABUF`, a file descriptor the kernel uses to share memory between devices.
+///
+/// Hand [`fd()`](DmaBuf::fd) to e.g. `VA-API` (`vaCreateSurfaces` with `VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2`), `Vulkan`
+/// (`VK_EXT_external_memory_dma_buf`) or `EGL` (`EGL_EXT_image_dma_buf_import`), together with the format (see [`FrameFormat::drm_fourcc()`](crate::FrameFormat::drm_fourcc)),
+/// the [`planes()`](crate::Buffer::planes) of the [`Buffer`](crate::Buffer) it came in and the [`modifier()`](DmaBuf::modifier), to use the frame without the CPU ever touching it.
+///
+/// The file descriptor belongs to the stream it came from. It is shared (not duplicated) between clones, and stays open until the last
+/// clone is dropped, even if the stream is closed, and so do the driver buffers behind it. See the backend for how long the frame in it stays valid.
+#[cfg_attr(feature = "docs-features", doc(cfg(target_os = "linux")))]
+#[derive(Clone, Debug)]
+pub struct DmaBuf {
+    // dropped before `owner`, which may need every exported file descriptor closed to free its buffers
+    fd: Arc<OwnedFd>,
+    len: usize,
+    modifier: u64,
+    owner: Option<Arc<dyn Any + Send + Sync>>,
+}
+
+impl DmaBuf {
+    /// Creates a new [`DmaBuf`] holding a frame of `len` bytes, laid out as given by the `DRM` format `modifier`.
+    #[must_use]
+    pub fn new(fd: Arc<OwnedFd>, len: usize, modifier: u64) -> Self {
+        DmaBuf {
+            fd,
+            len,
+            modifier,
+            owner: None,
+        }
+    }
+
+    // keeps `owner` (e.g. whatever frees the driver buffers) alive until the last clone is dropped
+    pub(crate) fn with_owner(mut self, owner: Arc<dyn Any + Send + Sync>) -> Self {
+        self.owner = Some(owner);
+        self
+    }
+
+    /// The `DMABUF` file descriptor.
+    #[must_use]
+    pub fn fd(&self) -> BorrowedFd<'_> {
+        // SAFETY: `OwnedFd` keeps the file descriptor open for as long as `self` (and so, the borrow) lives.
+        unsafe { BorrowedFd::borrow_raw(self.fd.as_raw_fd()) }
+    }
+
+    /// The raw `DMABUF` file descriptor. Do not close it, it is owned by this [`DmaBuf`].
+    #[must_use]
+    pub fn raw_fd(&self) -> RawFd {
+        self.fd.as_raw_fd()
+    }
+
+    /// The amount of bytes of the frame, starting at the beginning of the `DMABUF`.
+    #[must_use]
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    /// Checks if the `DMABUF` holds no frame data.
+    #[must_use]
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+
+    /// The `DRM` format modifier of the frame, e.g. [`DRM_FORMAT_MOD_LINEAR`].
+    #[must_use]
+    pub fn modifier(&self) -> u64 {
+        self.modifier
+    }
+
+    fn key(&self) -> (RawFd, usize, u64) {
+        (self.raw_fd(), self.len, self.modifier)
+    }
+}
+
+impl PartialEq for DmaBuf {
+    fn eq(&self, other: &Self) -> bool {
+        self.key() == other.key()
+    }
+}
+
+impl PartialOrd for DmaBuf {
+    fn partial_cmp(&self, other: &Self) -> Option<Ordering> {
+        self.key().partial_cmp(&other.key())
+    }
+}
+
+impl Hash for DmaBuf {
+    fn hash<H: Hasher>(&self, state: &mut H) {
+        self.key().hash(state);
+    }
+}
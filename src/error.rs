@@ -106,6 +106,11 @@ impl From<BindingError> for NokhwaError {
                 NokhwaError::OpenDeviceError(device, error)
             }
             BindingError::ReadFrameError(error) => NokhwaError::ReadFrameError(error),
+            BindingError::DecodeFrameError(error) => NokhwaError::ProcessFrameError {
+                src: FrameFormat::MJPEG,
+                destination: "Decoded Frame".to_string(),
+                error,
+            },
             BindingError::NotImplementedError => {
                 NokhwaError::NotImplementedError("Docs-Only MediaFoundation".to_string())
             }
@@ -170,6 +175,11 @@ impl From<AVFError> for NokhwaError {
             }
             AVFError::StreamOpen(why) => NokhwaError::OpenStreamError(why),
             AVFError::ReadFrame(why) => NokhwaError::ReadFrameError(why),
+            AVFError::DecodeFrame(why) => NokhwaError::ProcessFrameError {
+                src: FrameFormat::MJPEG,
+                destination: "BGRA".to_string(),
+                error: why,
+            },
             AVFError::NotSupported => {
                 NokhwaError::UnsupportedOperationError(CaptureAPIBackend::AVFoundation)
             }
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+use crate::{Buffer, BufferPool, Camera, NokhwaError};
+use futures_core::Stream;
+use std::{
+    pin::Pin,
+    task::{Context, Poll},
+};
+
+/// An asynchronous [`Stream`] of frames from a [`Camera`], created with [`Camera::frame_stream()`].
+///
+/// Instead of blocking a thread per camera, this waits for the backend to tell it the next frame is ready (see [`poll_frame_ready()`](crate::CaptureBackendTrait::poll_frame_ready)),
+/// so one executor thread can serve many cameras. Only then is the frame taken, the same way as [`Camera::frame()`] (or [`Camera::frame_pooled()`], see [`pooled()`](FrameStream::pooled)).
+///
+/// Errors are handed out as they come, the stream does not end on them. It never ends by itself.
+///
+/// **Note**: Backends that cannot tell if a frame is ready (e.g. `OpenCV`, `GStreamer`) will block the polling thread while getting the frame.
+pub struct FrameStream<'a> {
+    camera: &'a mut Camera,
+    pool: Option<&'a BufferPool>,
+}
+
+impl<'a> FrameStream<'a> {
+    pub(crate) fn new(camera: &'a mut Camera) -> Self {
+        FrameStream { camera, pool: None }
+    }
+
+    /// Takes the frames out of `pool` using [`Camera::frame_pooled()`] instead. Give them back with [`BufferPool::recycle_buffer()`] once you are done.
+    #[must_use]
+    pub fn pooled(mut self, pool: &'a BufferPool) -> Self {
+        self.pool = Some(pool);
+        self
+    }
+
+    /// The [`Camera`] this is streaming from.
+    #[must_use]
+    pub fn camera(&self) -> &Camera {
+        self.camera
+    }
+}
+
+impl<'a> Stream for FrameStream<'a> {
+    type Item = Result<Buffer, NokhwaError>;
+
+    fn poll_next(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Option<Self::Item>> {
+        let this = self.get_mut();
+        match this.camera.poll_frame_ready(cx) {
+            Poll::Ready(Ok(())) => {}
+            Poll::Ready(Err(why)) => return Poll::Ready(Some(Err(why))),
+            Poll::Pending => return Poll::Pending,
+        }
+
+        let frame = match this.pool {
+            Some(pool) => this.camera.frame_pooled(pool),
+            None => this.camera.frame(),
+        };
+        Poll::Ready(Some(frame))
+    }
+}
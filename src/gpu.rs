@@ -0,0 +1,529 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+use crate::{
+    Buffer, FrameFormat, FrameRef, FrameState, MjpegDecoder, NokhwaError, Plane, Resolution,
+};
+use std::{
+    borrow::Cow,
+    fmt::{Debug, Formatter},
+    num::NonZeroU32,
+};
+use wgpu::{
+    BindGroup, BindGroupDescriptor, BindGroupEntry, BindGroupLayout, BindGroupLayoutDescriptor,
+    BindGroupLayoutEntry, BindingResource, BindingType, Buffer as WgpuBuffer, BufferBindingType,
+    BufferDescriptor, BufferUsages, CommandEncoderDescriptor, ComputePassDescriptor,
+    ComputePipeline, ComputePipelineDescriptor, Device, Extent3d, ImageCopyTexture,
+    ImageDataLayout, Origin3d, PipelineLayoutDescriptor, Queue, ShaderModuleDescriptor,
+    ShaderSource, ShaderStages, StorageTextureAccess, Texture, TextureAspect, TextureDescriptor,
+    TextureDimension, TextureFormat, TextureUsages, TextureView, TextureViewDescriptor,
+    TextureViewDimension,
+};
+
+/// The default amount of textures a [`TextureStreamer`] cycles through.
+pub const DEFAULT_TEXTURE_RING: usize = 2;
+
+const SHADER: &str = include_str!("shaders/frame_to_rgba.wgsl");
+const WORKGROUP_SIZE: u32 = 8;
+// width, height, format, luma stride, chroma offset, chroma stride, V offset, padding
+const PARAMS_SIZE: usize = 8 * 4;
+
+/// One of the textures of a [`TextureStreamer`].
+pub struct StreamedTexture {
+    texture: Texture,
+    view: TextureView,
+    bind_group: Option<BindGroup>,
+}
+
+impl StreamedTexture {
+    /// The texture. It is `Rgba8Unorm` (storage textures cannot be sRGB), holding sRGB encoded colour.
+    #[must_use]
+    pub fn texture(&self) -> &Texture {
+        &self.texture
+    }
+
+    /// A view of the entire [`texture()`](StreamedTexture::texture).
+    #[must_use]
+    pub fn view(&self) -> &TextureView {
+        &self.view
+    }
+}
+
+impl Debug for StreamedTexture {
+    fn fmt(&self, f: &mut Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("StreamedTexture").finish_non_exhaustive()
+    }
+}
+
+/// Streams camera frames into a small ring of persistent `wgpu` textures.
+///
+/// Instead of creating a new texture for every frame, the textures are created once (and again only if the resolution changes) and reused,
+/// so a frame can be uploaded while the previous one is still being drawn.
+///
+/// `YUYV`, `NV12`, `I420` and `GRAY8` frames are uploaded as they are, and converted to RGBA by a compute shader on the GPU.
+/// The frame is written straight into `wgpu`'s mapped staging memory, so the only CPU side copy is the one out of the driver's buffer
+/// (when using [`upload_frame()`](TextureStreamer::upload_frame) with a borrowed [`FrameRef`]).
+/// `MJPEG` frames are decoded on the CPU into a reused buffer and then uploaded.
+/// Frames that were already decoded (see [`FrameState`]) are uploaded as RGBA, no matter which format they came from.
+pub struct TextureStreamer {
+    pipeline: ComputePipeline,
+    bind_group_layout: BindGroupLayout,
+    params: WgpuBuffer,
+    frame: Option<WgpuBuffer>,
+    frame_capacity: u64,
+    slots: Vec<StreamedTexture>,
+    ring_size: usize,
+    next: usize,
+    resolution: Resolution,
+    decoder: MjpegDecoder,
+    decoded: Vec<u8>,
+}
+
+impl TextureStreamer {
+    /// Creates a new [`TextureStreamer`] that cycles through `ring_size` textures (at least 1).
+    #[must_use]
+    pub fn new(device: &Device, ring_size: usize) -> Self {
+        let module = device.create_shader_module(&ShaderModuleDescriptor {
+            label: Some("nokhwa frame_to_rgba"),
+            source: ShaderSource::Wgsl(Cow::Borrowed(SHADER)),
+        });
+
+        let bind_group_layout = device.create_bind_group_layout(&BindGroupLayoutDescriptor {
+            label: Some("nokhwa frame_to_rgba"),
+            entries: &[
+                BindGroupLayoutEntry {
+                    binding: 0,
+                    visibility: ShaderStages::COMPUTE,
+                    ty: BindingType::Buffer {
+                        ty: BufferBindingType::Storage { read_only: true },
+                        has_dynamic_offset: false,
+                        min_binding_size: None,
+                    },
+                    count: None,
+                },
+                BindGroupLayoutEntry {
+                    binding: 1,
+                    visibility: ShaderStages::COMPUTE,
+                    ty: BindingType::Buffer {
+                        ty: BufferBindingType::Uniform,
+                        has_dynamic_offset: false,
+                        min_binding_size: None,
+                    },
+                    count: None,
+                },
+                BindGroupLayoutEntry {
+                    binding: 2,
+                    visibility: ShaderStages::COMPUTE,
+                    ty: BindingType::StorageTexture {
+                        access: StorageTextureAccess::WriteOnly,
+                        format: TextureFormat::Rgba8Unorm,
+                        view_dimension: TextureViewDimension::D2,
+                    },
+                    count: None,
+                },
+            ],
+        });
+
+        let layout = device.create_pipeline_layout(&PipelineLayoutDescriptor {
+            label: Some("nokhwa frame_to_rgba"),
+            bind_group_layouts: &[&bind_group_layout],
+            push_constant_ranges: &[],
+        });
+
+        let pipeline = device.create_compute_pipeline(&ComputePipelineDescriptor {
+            label: Some("nokhwa frame_to_rgba"),
+            layout: Some(&layout),
+            module: &module,
+            entry_point: "main",
+        });
+
+        let params = device.create_buffer(&BufferDescriptor {
+            label: Some("nokhwa frame_to_rgba params"),
+            size: PARAMS_SIZE as u64,
+            usage: BufferUsages::UNIFORM | BufferUsages::COPY_DST,
+            mapped_at_creation: false,
+        });
+
+        TextureStreamer {
+            pipeline,
+            bind_group_layout,
+            params,
+            frame: None,
+            frame_capacity: 0,
+            slots: vec![],
+            ring_size: ring_size.max(1),
+            next: 0,
+            resolution: Resolution::default(),
+            decoder: MjpegDecoder::new(true),
+            decoded: vec![],
+        }
+    }
+
+    /// The resolution of the textures. `0x0` if nothing has been uploaded yet.
+    #[must_use]
+    pub fn resolution(&self) -> Resolution {
+        self.resolution
+    }
+
+    /// The amount of textures this cycles through.
+    #[must_use]
+    pub fn ring_size(&self) -> usize {
+        self.ring_size
+    }
+
+    /// Uploads a frame (e.g. from [`frame_ref()`](crate::Camera::frame_ref)) into the next texture of the ring, returning it.
+    /// # Errors
+    /// If the frame format is not supported, the frame is smaller than its format and resolution need, or the resolution is 0 on any axis, this will error.
+    pub fn upload_frame(
+        &mut self,
+        device: &Device,
+        queue: &Queue,
+        frame: &FrameRef,
+    ) -> Result<&StreamedTexture, NokhwaError> {
+        self.upload(
+            device,
+            queue,
+            frame.source_frame_format(),
+            frame.state(),
+            frame.resolution(),
+            frame.buffer(),
+            frame.planes(),
+        )
+    }
+
+    /// Uploads a [`Buffer`] (e.g. from [`frame_pooled()`](crate::Camera::frame_pooled)) into the next texture of the ring, returning it.
+    /// The [`planes()`](Buffer::planes) of the buffer are respected, so padded rows are fine.
+    /// # Errors
+    /// If the frame format is not supported, the frame is smaller than its format and resolution need, or the resolution is 0 on any axis, this will error.
+    pub fn upload_buffer(
+        &mut self,
+        device: &Device,
+        queue: &Queue,
+        buffer: &Buffer,
+    ) -> Result<&StreamedTexture, NokhwaError> {
+        self.upload(
+            device,
+            queue,
+            buffer.source_frame_format(),
+            buffer.state(),
+            buffer.resolution(),
+            buffer.buffer(),
+            buffer.planes(),
+        )
+    }
+
+    fn upload(
+        &mut self,
+        device: &Device,
+        queue: &Queue,
+        format: FrameFormat,
+        state: FrameState,
+        resolution: Resolution,
+        data: &[u8],
+        planes: &[Plane],
+    ) -> Result<&StreamedTexture, NokhwaError> {
+        // the tag only says what the frame was captured as, the shader must not be picked from it once it is decoded
+        if state.is_decoded() || format == FrameFormat::MJPEG {
+            self.prepare_textures(device, format, resolution)?;
+            if state.is_decoded() {
+                expand_to_rgba(format, state, resolution, data, planes, &mut self.decoded)?;
+            } else {
+                self.decoded
+                    .resize(self.decoder.decoded_size(resolution), 0);
+                self.decoder.decode_into(data, &mut self.decoded)?;
+            }
+            let slot = self.next_slot();
+            write_rgba(queue, &self.slots[slot].texture, resolution, &self.decoded);
+            return Ok(&self.slots[slot]);
+        }
+
+        let params = shader_params(format, resolution, data.len(), planes)?;
+        self.prepare_textures(device, format, resolution)?;
+        self.write_frame(device, queue, data);
+        queue.write_buffer(&self.params, 0, &params);
+
+        let slot = self.next_slot();
+        if self.slots[slot].bind_group.is_none() {
+            let bind_group = self.create_bind_group(device, slot);
+            self.slots[slot].bind_group = Some(bind_group);
+        }
+
+        let mut encoder = device.create_command_encoder(&CommandEncoderDescriptor {
+            label: Some("nokhwa frame_to_rgba"),
+        });
+        {
+            let mut pass = encoder.begin_compute_pass(&ComputePassDescriptor {
+                label: Some("nokhwa frame_to_rgba"),
+            });
+            pass.set_pipeline(&self.pipeline);
+            if let Some(bind_group) = &self.slots[slot].bind_group {
+                pass.set_bind_group(0, bind_group, &[]);
+            }
+            pass.dispatch(
+                (resolution.width() + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                (resolution.height() + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                1,
+            );
+        }
+        queue.submit(Some(encoder.finish()));
+
+        Ok(&self.slots[slot])
+    }
+
+    fn next_slot(&mut self) -> usize {
+        let slot = self.next;
+        self.next = (self.next + 1) % self.slots.len();
+        slot
+    }
+
+    // (re)creates the textures if the resolution changed
+    fn prepare_textures(
+        &mut self,
+        device: &Device,
+        format: FrameFormat,
+        resolution: Resolution,
+    ) -> Result<(), NokhwaError> {
+        if resolution.width() == 0 || resolution.height() == 0 {
+            return Err(NokhwaError::ProcessFrameError {
+                src: format,
+                destination: "wgpu Texture".to_string(),
+                error: format!("Invalid resolution {resolution}"),
+            });
+        }
+        if resolution == self.resolution && !self.slots.is_empty() {
+            return Ok(());
+        }
+
+        self.slots = (0..self.ring_size)
+            .map(|_| {
+                let texture = device.create_texture(&TextureDescriptor {
+                    label: Some("nokhwa streamed frame"),
+                    size: Extent3d {
+                        width: resolution.width(),
+                        height: resolution.height(),
+                        depth_or_array_layers: 1,
+                    },
+                    mip_level_count: 1,
+                    sample_count: 1,
+                    dimension: TextureDimension::D2,
+                    format: TextureFormat::Rgba8Unorm,
+                    usage: TextureUsages::TEXTURE_BINDING
+                        | TextureUsages::STORAGE_BINDING
+                        | TextureUsages::COPY_DST
+                        | TextureUsages::COPY_SRC,
+                });
+                let view = texture.create_view(&TextureViewDescriptor::default());
+                StreamedTexture {
+                    texture,
+                    view,
+                    bind_group: None,
+                }
+            })
+            .collect();
+        self.next = 0;
+        self.resolution = resolution;
+        Ok(())
+    }
+
+    // `write_buffer` wants a multiple of 4 bytes, so the last (partial) word is padded separately instead of copying the frame
+    fn write_frame(&mut self, device: &Device, queue: &Queue, data: &[u8]) {
+        let needed = ((data.len() as u64 + 3) & !3).max(4);
+        if self.frame.is_none() || self.frame_capacity < needed {
+            self.frame = Some(device.create_buffer(&BufferDescriptor {
+                label: Some("nokhwa raw frame"),
+                size: needed,
+                usage: BufferUsages::STORAGE | BufferUsages::COPY_DST,
+                mapped_at_creation: false,
+            }));
+            self.frame_capacity = needed;
+            // the bind groups point to the old buffer
+            for slot in &mut self.slots {
+                slot.bind_group = None;
+            }
+        }
+
+        if let Some(frame) = &self.frame {
+            let aligned = data.len() & !3;
+            if aligned != 0 {
+                queue.write_buffer(frame, 0, &data[..aligned]);
+            }
+            if aligned != data.len() {
+                let mut tail = [0_u8; 4];
+                tail[..data.len() - aligned].copy_from_slice(&data[aligned..]);
+                queue.write_buffer(frame, aligned as u64, &tail);
+            }
+        }
+    }
+
+    fn create_bind_group(&self, device: &Device, slot: usize) -> BindGroup {
+        let mut entries = vec![];
+        if let Some(frame) = &self.frame {
+            entries.push(BindGroupEntry {
+                binding: 0,
+                resource: frame.as_entire_binding(),
+            });
+        }
+        entries.push(BindGroupEntry {
+            binding: 1,
+            resource: self.params.as_entire_binding(),
+        });
+        entries.push(BindGroupEntry {
+            binding: 2,
+            resource: BindingResource::TextureView(&self.slots[slot].view),
+        });
+
+        device.create_bind_group(&BindGroupDescriptor {
+            label: Some("nokhwa frame_to_rgba"),
+            layout: &self.bind_group_layout,
+            entries: &entries,
+        })
+    }
+}
+
+impl Debug for TextureStreamer {
+    fn fmt(&self, f: &mut Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("TextureStreamer")
+            .field("frame_capacity", &self.frame_capacity)
+            .field("ring_size", &self.ring_size)
+            .field("next", &self.next)
+            .field("resolution", &self.resolution)
+            .finish_non_exhaustive()
+    }
+}
+
+#[allow(clippy::cast_possible_truncation)]
+fn shader_params(
+    format: FrameFormat,
+    resolution: Resolution,
+    len: usize,
+    planes: &[Plane],
+) -> Result<[u8; PARAMS_SIZE], NokhwaError> {
+    let shader_format = match format {
+        FrameFormat::YUYV => 0,
+        FrameFormat::NV12 => 1,
+        FrameFormat::I420 => 2,
+        FrameFormat::GRAY8 => 3,
+        FrameFormat::MJPEG => {
+            return Err(NokhwaError::ProcessFrameError {
+                src: format,
+                destination: "wgpu Texture".to_string(),
+                error: "MJPEG must be decoded first".to_string(),
+            })
+        }
+    };
+    if planes.len() != format.plane_count() {
+        return Err(NokhwaError::ProcessFrameError {
+            src: format,
+            destination: "wgpu Texture".to_string(),
+            error: "The frame does not match the size of its format".to_string(),
+        });
+    }
+    // the planar layouts are checked when they are made, the packed ones only span whatever the buffer holds
+    let row_size = match format {
+        FrameFormat::YUYV => resolution.width() as usize * 2,
+        FrameFormat::GRAY8 => resolution.width() as usize,
+        _ => 0,
+    };
+    let fits = |plane: &Plane| plane.offset() + plane.len() <= len;
+    if planes[0].stride() < row_size || !planes.iter().all(fits) {
+        return Err(NokhwaError::ProcessFrameError {
+            src: format,
+            destination: "wgpu Texture".to_string(),
+            error: format!("The frame is too small for {format} at {resolution}! [actual: {len}]"),
+        });
+    }
+
+    let plane = |idx: usize| planes.get(idx).copied().unwrap_or_default();
+    let values = [
+        resolution.width(),
+        resolution.height(),
+        shader_format,
+        plane(0).stride() as u32,
+        plane(1).offset() as u32,
+        plane(1).stride() as u32,
+        plane(2).offset() as u32,
+        0,
+    ];
+
+    let mut params = [0_u8; PARAMS_SIZE];
+    for (value, bytes) in values.iter().zip(params.chunks_exact_mut(4)) {
+        bytes.copy_from_slice(&value.to_le_bytes());
+    }
+    Ok(params)
+}
+
+// copies a frame that was already decoded into tightly packed RGBA, dropping any row padding
+fn expand_to_rgba(
+    format: FrameFormat,
+    state: FrameState,
+    resolution: Resolution,
+    data: &[u8],
+    planes: &[Plane],
+    rgba: &mut Vec<u8>,
+) -> Result<(), NokhwaError> {
+    let pixel_size = state.pixel_size().unwrap_or(4);
+    let width = resolution.width() as usize;
+    let height = resolution.height() as usize;
+    let row_size = width * pixel_size;
+    let stride = planes.first().map_or(row_size, Plane::stride).max(row_size);
+    if data.len() < stride * (height - 1) + row_size {
+        return Err(NokhwaError::ProcessFrameError {
+            src: format,
+            destination: "wgpu Texture".to_string(),
+            error: format!(
+                "The decoded frame is too small for {resolution}! [expected: {}, actual: {}]",
+                row_size * height,
+                data.len()
+            ),
+        });
+    }
+
+    rgba.clear();
+    rgba.reserve(width * height * 4);
+    for row in data.chunks(stride).take(height) {
+        let row = &row[..row_size];
+        if pixel_size == 4 {
+            rgba.extend_from_slice(row);
+        } else {
+            for pixel in row.chunks_exact(3) {
+                rgba.extend_from_slice(&[pixel[0], pixel[1], pixel[2], 255]);
+            }
+        }
+    }
+    Ok(())
+}
+
+fn write_rgba(queue: &Queue, texture: &Texture, resolution: Resolution, data: &[u8]) {
+    queue.write_texture(
+        ImageCopyTexture {
+            texture,
+            mip_level: 0,
+            origin: Origin3d::ZERO,
+            aspect: TextureAspect::All,
+        },
+        data,
+        ImageDataLayout {
+            offset: 0,
+            bytes_per_row: NonZeroU32::new(4 * resolution.width()),
+            rows_per_image: NonZeroU32::new(resolution.height()),
+        },
+        Extent3d {
+            width: resolution.width(),
+            height: resolution.height(),
+            depth_or_array_layers: 1,
+        },
+    );
+}
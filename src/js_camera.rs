@@ -20,17 +20,21 @@
 //!
 //! This assumes that you are running a modern browser on the desktop.
 
-use crate::{CameraIndex, CameraInfo, NokhwaError, Resolution};
+use crate::{
+    CameraIndex, CameraInfo, FrameCounter, FrameFormat, FrameMetadata, FrameRef, NokhwaError,
+    Resolution,
+};
 use gstreamer::Array;
 use image::{buffer::ConvertBuffer, ImageBuffer, Rgb, RgbImage, Rgba};
 #[cfg(feature = "output-wasm")]
-use js_sys::{Array, JsString, Map, Object, Promise};
+use js_sys::{Array, Function, JsString, Map, Object, Promise, Reflect, Uint8Array};
 use std::{
     borrow::Borrow,
     borrow::Cow,
     convert::TryFrom,
     fmt::{Debug, Display, Formatter},
     ops::Deref,
+    time::Duration,
 };
 #[cfg(feature = "output-wasm")]
 use wasm_bindgen::{prelude::wasm_bindgen, JsCast, JsValue};
@@ -196,6 +200,76 @@ fn set_autoplay_inline(element: &Element) -> Result<(), NokhwaError> {
     Ok(())
 }
 
+fn js_get(target: &JsValue, key: &str) -> Result<JsValue, NokhwaError> {
+    match Reflect::get(target, &jsv!(key)) {
+        Ok(value) => Ok(value),
+        Err(why) => Err(NokhwaError::GetPropertyError {
+            property: key.to_string(),
+            error: format!("{:?}", why),
+        }),
+    }
+}
+
+fn js_set(target: &JsValue, key: &str, value: &JsValue) -> Result<(), NokhwaError> {
+    if let Err(why) = Reflect::set(target, &jsv!(key), value) {
+        return Err(NokhwaError::SetPropertyError {
+            property: key.to_string(),
+            value: format!("{:?}", value),
+            error: format!("{:?}", why),
+        });
+    }
+    Ok(())
+}
+
+// `web-sys` only has the WebCodecs and WebGPU APIs behind `web_sys_unstable_apis`, so they are called by name.
+fn js_call(target: &JsValue, method: &str, args: &Array) -> Result<JsValue, NokhwaError> {
+    let function = match js_get(target, method)?.dyn_into::<Function>() {
+        Ok(function) => function,
+        Err(_) => {
+            return Err(NokhwaError::StructureError {
+                structure: method.to_string(),
+                error: "Not a function".to_string(),
+            })
+        }
+    };
+    match Reflect::apply(&function, target, args) {
+        Ok(value) => Ok(value),
+        Err(why) => Err(NokhwaError::StructureError {
+            structure: method.to_string(),
+            error: format!("{:?}", why),
+        }),
+    }
+}
+
+async fn js_await(promise: JsValue, structure: &str) -> Result<JsValue, NokhwaError> {
+    match JsFuture::from(Promise::from(promise)).await {
+        Ok(value) => Ok(value),
+        Err(why) => Err(NokhwaError::StructureError {
+            structure: structure.to_string(),
+            error: format!("{:?}", why),
+        }),
+    }
+}
+
+/// Checks if the browser can capture frames as WebCodecs `VideoFrame`s through a `MediaStreamTrackProcessor`, see [`JSCamera::frame_video()`].
+#[must_use]
+pub fn supports_webcodecs() -> bool {
+    let global = js_sys::global();
+    ["MediaStreamTrackProcessor", "VideoFrame"]
+        .iter()
+        .all(|name| Reflect::has(&global, &jsv!(*name)).unwrap_or(false))
+}
+
+/// Checks if the browser can capture frames as WebCodecs `VideoFrame`s through a `MediaStreamTrackProcessor`, see [`JSCamera::frame_video()`].
+/// # JS-WASM
+/// This is exported as `supportsWebCodecs`.
+#[cfg(feature = "output-wasm")]
+#[cfg_attr(feature = "output-wasm", wasm_bindgen(js_name = supportsWebCodecs))]
+#[must_use]
+pub fn js_supports_webcodecs() -> bool {
+    supports_webcodecs()
+}
+
 /// Requests Webcam permissions from the browser using [`MediaDevices::get_user_media()`](https://rustwasm.github.io/wasm-bindgen/api/web_sys/struct.MediaDevices.html#method.get_user_media) [MDN](https://developer.mozilla.org/en-US/docs/Web/API/MediaDevices/getUserMedia)
 /// # Errors
 /// This will error if there is no valid web context or the web API is not supported
@@ -1689,6 +1763,11 @@ pub struct JSCamera {
     measured_resolution: Resolution,
     attached_canvas: Option<HtmlCanvasElement>,
     canvas_context: Option<CanvasRenderingContext2d>,
+    // the `ReadableStreamDefaultReader` of the `MediaStreamTrackProcessor` of the video track
+    frame_reader: Option<JsValue>,
+    // reused between frames, `VideoFrame.copyTo` writes into it
+    frame_buffer: Vec<u8>,
+    frame_counter: FrameCounter,
 }
 
 #[cfg(feature = "output-wasm")]
@@ -1845,6 +1924,21 @@ impl JSCamera {
         }
     }
 
+    /// Gets the `ReadableStreamDefaultReader` of the WebCodecs `VideoFrame`s of the camera, see [`video_frame()`](crate::js_camera::JSCamera::video_frame).
+    /// `read()` it for the next frame, then `copyTo()` it or import it with `GPUDevice.importExternalTexture({ source: frame })`, and `close()` it once you are done.
+    /// # Errors
+    /// If the browser does not support `MediaStreamTrackProcessor` or the stream has no video track, this will error.
+    /// # JS-WASM
+    /// This is exported as `videoFrameReader`. It may throw an error.
+    #[cfg(feature = "output-wasm")]
+    #[cfg_attr(feature = "output-wasm", wasm_bindgen(js_name = videoFrameReader))]
+    pub fn js_video_frame_reader(&mut self) -> Result<JsValue, JsValue> {
+        match self.frame_reader() {
+            Ok(reader) => Ok(reader),
+            Err(why) => Err(JsValue::from(why.to_string())),
+        }
+    }
+
     /// Copies camera frame to a `html_id`(by-id, canvas).
     ///
     /// If `generate_new` is true, the generated element will have an Id of `html_id`+`-canvas`. For example, if you pass "nokhwaisbest" for `html_id`, the new `<canvas>`'s ID will be "nokhwaisbest-canvas".
@@ -1951,6 +2045,9 @@ impl JSCamera {
             measured_resolution: Resolution::new(0, 0),
             attached_canvas: None,
             canvas_context: None,
+            frame_reader: None,
+            frame_buffer: Vec::new(),
+            frame_counter: FrameCounter::default(),
         };
         js_camera.measure_resolution()?;
 
@@ -2487,6 +2584,9 @@ impl JSCamera {
     }
 
     /// Creates an off-screen canvas and a `<video>` element (if not already attached) and returns a raw `Cow<[u8]>` RGBA frame.
+    ///
+    /// This reads the frame back from the GPU and copies it into wasm memory every frame. If the browser [`supports_webcodecs()`],
+    /// use [`frame_video()`](crate::js_camera::JSCamera::frame_video) instead.
     /// # Errors
     /// If a cast fails, the camera fails to attach, the currently attached node is invalid, or writing/reading from the canvas fails, this will error.
     pub fn frame_raw(&mut self) -> Result<Cow<[u8]>, NokhwaError> {
@@ -2495,6 +2595,157 @@ impl JSCamera {
         Ok(Cow::from(image_data))
     }
 
+    fn frame_reader(&mut self) -> Result<JsValue, NokhwaError> {
+        if let Some(reader) = &self.frame_reader {
+            return Ok(reader.clone());
+        }
+
+        let track = self
+            .media_stream()
+            .get_video_tracks()
+            .iter()
+            .next()
+            .unwrap_or_else(JsValue::undefined);
+        if track.is_undefined() {
+            return Err(NokhwaError::ReadFrameError("Null Stream".to_string()));
+        }
+
+        let processor_class = js_get(&js_sys::global(), "MediaStreamTrackProcessor")?;
+        let processor_class = match processor_class.dyn_into::<Function>() {
+            Ok(class) => class,
+            Err(_) => {
+                return Err(NokhwaError::NotImplementedError(
+                    "MediaStreamTrackProcessor is not supported by this browser".to_string(),
+                ))
+            }
+        };
+        let init = Object::new();
+        js_set(&init, "track", &track)?;
+        let processor = match Reflect::construct(&processor_class, &Array::of1(&init)) {
+            Ok(processor) => processor,
+            Err(why) => {
+                return Err(NokhwaError::StructureError {
+                    structure: "MediaStreamTrackProcessor".to_string(),
+                    error: format!("{:?}", why),
+                })
+            }
+        };
+        let readable = js_get(&processor, "readable")?;
+        let reader = js_call(&readable, "getReader", &Array::new())?;
+
+        self.frame_reader = Some(reader.clone());
+        Ok(reader)
+    }
+
+    /// Gets the next frame of the camera as a WebCodecs [`VideoFrame`](https://developer.mozilla.org/en-US/docs/Web/API/VideoFrame),
+    /// read from a [`MediaStreamTrackProcessor`](https://developer.mozilla.org/en-US/docs/Web/API/MediaStreamTrackProcessor) of the video track.
+    ///
+    /// The frame is where the browser captured it (usually on the GPU), nothing is read back. Draw it, import it with
+    /// [`import_external_texture()`](crate::js_camera::JSCamera::import_external_texture), or copy it yourself, and **call `close()` on it**
+    /// once you are done, the camera runs out of buffers otherwise.
+    /// # Errors
+    /// If the browser does not support `MediaStreamTrackProcessor`, the stream has no video track or the track ended, this will error.
+    pub async fn video_frame(&mut self) -> Result<JsValue, NokhwaError> {
+        let reader = self.frame_reader()?;
+        let result = js_await(
+            js_call(&reader, "read", &Array::new())?,
+            "ReadableStreamDefaultReaderRead",
+        )
+        .await?;
+        if js_get(&result, "done")?.as_bool().unwrap_or(false) {
+            self.frame_reader = None;
+            return Err(NokhwaError::ReadFrameError(
+                "The video track ended".to_string(),
+            ));
+        }
+        js_get(&result, "value")
+    }
+
+    /// Gets the next frame of the camera in the layout the browser captured it in (`NV12` or `I420`), copied with
+    /// [`VideoFrame.copyTo()`](https://developer.mozilla.org/en-US/docs/Web/API/VideoFrame/copyTo) straight into a buffer in wasm memory
+    /// that is reused between frames. There is no canvas, no RGBA conversion and no copy out of a JS `ArrayBuffer`.
+    ///
+    /// The planes are packed tightly one after the other. The timestamp of the [`FrameMetadata`] is the timestamp of the `VideoFrame`.
+    /// # Errors
+    /// If getting the frame fails (see [`video_frame()`](crate::js_camera::JSCamera::video_frame)), the frame is in another format
+    /// (use [`frame_raw()`](crate::js_camera::JSCamera::frame_raw) then) or copying it fails, this will error.
+    pub async fn frame_video(&mut self) -> Result<FrameRef<'_>, NokhwaError> {
+        let video_frame = self.video_frame().await?;
+        let copied = self.copy_video_frame(&video_frame).await;
+        let _close = js_call(&video_frame, "close", &Array::new());
+        let (resolution, frame_format, metadata) = copied?;
+
+        Ok(
+            FrameRef::new(resolution, Cow::Borrowed(&self.frame_buffer), frame_format)
+                .with_metadata(metadata),
+        )
+    }
+
+    #[allow(clippy::cast_sign_loss, clippy::cast_possible_truncation)]
+    async fn copy_video_frame(
+        &mut self,
+        video_frame: &JsValue,
+    ) -> Result<(Resolution, FrameFormat, FrameMetadata), NokhwaError> {
+        let frame_format = match js_get(video_frame, "format")?.as_string().as_deref() {
+            Some("NV12") => FrameFormat::NV12,
+            Some("I420") => FrameFormat::I420,
+            other => {
+                return Err(NokhwaError::ReadFrameError(format!(
+                    "VideoFrame format {:?} is not NV12 or I420",
+                    other
+                )))
+            }
+        };
+        let visible_rect = js_get(video_frame, "visibleRect")?;
+        let resolution = Resolution::new(
+            js_get(&visible_rect, "width")?.as_f64().unwrap_or(0_f64) as u32,
+            js_get(&visible_rect, "height")?.as_f64().unwrap_or(0_f64) as u32,
+        );
+        let size = js_call(video_frame, "allocationSize", &Array::new())?
+            .as_f64()
+            .unwrap_or(0_f64) as usize;
+        self.frame_buffer.resize(size, 0);
+
+        // SAFETY: the view is only handed to `copyTo`, nothing else touches `frame_buffer` until it resolves as `self` is borrowed mutably.
+        // If the wasm memory grows before the copy is done, the view is detached and `copyTo` rejects instead of writing anywhere else.
+        let view = unsafe {
+            Uint8Array::view_mut_raw(self.frame_buffer.as_mut_ptr(), self.frame_buffer.len())
+        };
+        js_await(
+            js_call(video_frame, "copyTo", &Array::of1(&view))?,
+            "VideoFrameCopyTo",
+        )
+        .await?;
+
+        // microseconds, and may be negative
+        let timestamp = js_get(video_frame, "timestamp")?
+            .as_f64()
+            .filter(|timestamp| *timestamp >= 0_f64)
+            .map(|timestamp| Duration::from_micros(timestamp as u64));
+        let metadata = self
+            .frame_counter
+            .timed(timestamp, self.constraints.frame_rate(), None);
+        Ok((resolution, frame_format, metadata))
+    }
+
+    /// Imports a `VideoFrame` from [`video_frame()`](crate::js_camera::JSCamera::video_frame) as a `GPUExternalTexture` of `gpu_device` (a WebGPU `GPUDevice`)
+    /// using [`importExternalTexture()`](https://developer.mozilla.org/en-US/docs/Web/API/GPUDevice/importExternalTexture), so the GPU samples the frame where it
+    /// already is. The texture can only be used until the frame is closed.
+    /// # Errors
+    /// If the browser does not support WebGPU or importing fails, this will error.
+    pub fn import_external_texture(
+        gpu_device: &JsValue,
+        video_frame: &JsValue,
+    ) -> Result<JsValue, NokhwaError> {
+        let descriptor = Object::new();
+        js_set(&descriptor, "source", video_frame)?;
+        js_call(
+            gpu_device,
+            "importExternalTexture",
+            &Array::of1(&descriptor),
+        )
+    }
+
     /// This takes the output from [`frame_raw()`](crate::js_camera::JSCamera::frame_raw) and turns it into an `ImageBuffer<Rgb<u8>, Vec<u8>>`.
     /// # Errors
     /// This will error if the frame vec is too small(this is probably a bug, please report it!) or if the frame fails to capture. See [`frame_raw()`](crate::js_camera::JSCamera::frame_raw).
@@ -2688,6 +2939,9 @@ impl JSCamera {
             }
         };
 
+        // the reader belongs to the old video track
+        self.frame_reader = None;
+        self.frame_counter.reset();
         self.media_stream = stream;
         Ok(())
     }
@@ -2697,6 +2951,9 @@ impl JSCamera {
     /// There may be an error while detaching the camera. Please see [`detach()`](crate::js_camera::JSCamera::detach) for more details.
     pub fn stop_all(&mut self) -> Result<(), NokhwaError> {
         self.detach()?;
+        if let Some(reader) = self.frame_reader.take() {
+            let _cancel = js_call(&reader, "cancel", &Array::new());
+        }
         self.media_stream.get_tracks().iter().for_each(|track| {
             let media_track = MediaStreamTrack::from(track);
             media_track.stop();
@@ -30,39 +30,95 @@
 pub mod backends;
 pub mod buffer;
 mod camera;
+mod camera_group;
 mod camera_traits;
+mod capabilities;
+mod decoder;
+#[cfg(target_os = "linux")]
+#[cfg_attr(feature = "docs-features", doc(cfg(target_os = "linux")))]
+mod dmabuf;
 mod error;
+#[cfg(feature = "output-async")]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "output-async")))]
+mod frame_stream;
+/// Streaming frames into persistent `wgpu` textures, converting them on the GPU.
+#[cfg(feature = "output-wgpu")]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "output-wgpu")))]
+mod gpu;
 mod init;
 /// A camera that uses native browser APIs meant for WASM applications.
 #[cfg(feature = "input-jscam")]
 #[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-jscam")))]
 pub mod js_camera;
+mod metadata;
+mod metrics;
 /// A camera that uses `OpenCV` to access IP (rtsp/http) on the local network
 #[cfg(feature = "input-ipcam")]
 #[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-ipcam")))]
 pub mod network_camera;
+mod parallel;
 mod pixel_format;
-pub use pixel_format::PixelFormat;
+mod pool;
+pub use pixel_format::{BgraFormat, LumaFormat, PixelFormat, RgbFormat, RgbaFormat};
+pub use pool::{BufferPool, DEFAULT_POOL_CAPACITY};
 mod query;
+#[cfg(feature = "recording")]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "recording")))]
+pub mod recording;
+mod region;
+mod registry;
+#[cfg(feature = "output-threaded")]
+mod ring;
+mod simd;
+mod stream_config;
 /// A camera that runs in a different thread and can call your code based on callbacks.
 #[cfg(feature = "output-threaded")]
 #[cfg_attr(feature = "docs-features", doc(cfg(feature = "output-threaded")))]
 mod threaded;
 mod utils;
 
-pub use buffer::Buffer;
+pub use buffer::{Buffer, FrameRef, FrameState, Plane, MAX_PLANES};
 pub use camera::Camera;
+pub use camera_group::{CameraGroup, FrameSet};
 pub use camera_traits::*;
+pub use capabilities::{CapabilityCache, DeviceCapabilities, DeviceIdentity};
+pub use decoder::{AutoMjpegDecoder, DecodeScale, FrameDecoder, MjpegDecoder};
+#[cfg(target_os = "linux")]
+#[cfg_attr(feature = "docs-features", doc(cfg(target_os = "linux")))]
+pub use dmabuf::{DmaBuf, DRM_FORMAT_MOD_LINEAR};
 pub use error::NokhwaError;
+#[cfg(feature = "output-async")]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "output-async")))]
+pub use frame_stream::FrameStream;
+#[cfg(feature = "output-wgpu")]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "output-wgpu")))]
+pub use gpu::{StreamedTexture, TextureStreamer, DEFAULT_TEXTURE_RING};
 pub use init::*;
 #[cfg(feature = "input-jscam")]
 #[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-jscam")))]
 pub use js_camera::JSCamera;
+pub(crate) use metadata::FrameCounter;
+pub use metadata::FrameMetadata;
+#[cfg(feature = "metrics")]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "metrics")))]
+pub use metrics::{MetricsSnapshot, Stage, StageStats};
 #[cfg(feature = "input-ipcam")]
 #[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-ipcam")))]
 pub use network_camera::NetworkCamera;
+#[cfg(feature = "parallel")]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "parallel")))]
+pub use parallel::PARALLEL_THRESHOLD;
 pub use query::*;
+#[cfg(feature = "recording")]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "recording")))]
+pub use recording::FrameRecorder;
+pub use region::Region;
+pub use registry::{DeviceEvent, DeviceRegistry};
+#[cfg(feature = "output-threaded")]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "output-threaded")))]
+pub use ring::{FrameRing, RingPolicy, DEFAULT_RING_DEPTH};
+pub use stream_config::{DequeueMode, IoMode, StreamConfig, DEFAULT_BUFFER_COUNT};
 #[cfg(feature = "output-threaded")]
 #[cfg_attr(feature = "docs-features", doc(cfg(feature = "output-threaded")))]
-pub use threaded::CallbackCamera;
+pub use threaded::{CallbackCamera, CallbackCameraSettings, FrameOutputs, FrameSubscription};
 pub use utils::*;
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#[cfg(feature = "serde")]
+use serde::{Deserialize, Serialize};
+use std::time::Duration;
+
+/// What the driver said about a captured frame: when it was captured, its sequence number and how many frames were dropped before it.
+///
+/// Backends fill this in for every frame they capture, see [`Buffer::metadata()`](crate::Buffer::metadata).
+///
+/// # Timestamps
+/// The timestamp is monotonic and on the clock of the backend, so it can be used to measure the time between two frames of a camera
+/// and to match up frames of cameras using the same backend:
+/// - `V4L2`: The `v4l2_buffer` timestamp, usually `CLOCK_MONOTONIC`.
+/// - `AVFoundation`: The presentation time of the `CMSampleBuffer`, on the host time clock (`mach_absolute_time()`).
+/// - `MSMF`: The sample time of the `IMFSample`, in the clock of the source reader.
+/// - `GStreamer`: The presentation time of the buffer plus the base time of the pipeline, in the clock of the pipeline (the system monotonic clock for live sources).
+/// - `OpenCV`: The position of the stream (`CAP_PROP_POS_MSEC`), which is only as precise as `OpenCV`'s backend makes it.
+///
+/// It is `None` if the backend does not know when the frame was captured.
+///
+/// # Drop Detection
+/// If the driver numbers its frames (`V4L2`, `GStreamer` with `v4l2src`), [`dropped_frames()`](FrameMetadata::dropped_frames) is the gap between
+/// the sequence numbers. `AVFoundation` tells us about every frame it drops. Otherwise, drops are estimated from gaps between the timestamps
+/// that are longer than the frame interval, so a camera that lowers its frame rate on its own (e.g. auto exposure in the dark) will look like it drops frames.
+#[derive(Copy, Clone, Debug, Default, Hash, PartialEq, Eq, PartialOrd, Ord)]
+#[cfg_attr(feature = "serde", derive(Serialize, Deserialize))]
+pub struct FrameMetadata {
+    timestamp: Option<Duration>,
+    driver_sequence: u64,
+    dropped_frames: u64,
+}
+
+impl FrameMetadata {
+    /// Creates a new [`FrameMetadata`].
+    #[must_use]
+    pub fn new(timestamp: Option<Duration>, driver_sequence: u64, dropped_frames: u64) -> Self {
+        FrameMetadata {
+            timestamp,
+            driver_sequence,
+            dropped_frames,
+        }
+    }
+
+    /// When the frame was captured, on the monotonic clock of the backend. See the [type level documentation](FrameMetadata#timestamps).
+    #[must_use]
+    pub fn timestamp(&self) -> Option<Duration> {
+        self.timestamp
+    }
+
+    /// The sequence number the driver gave the frame. If the driver does not number its frames, this counts up from 0,
+    /// skipping the frames that were detected as dropped.
+    #[must_use]
+    pub fn driver_sequence(&self) -> u64 {
+        self.driver_sequence
+    }
+
+    /// The amount of frames the driver dropped between the last frame and this one.
+    #[must_use]
+    pub fn dropped_frames(&self) -> u64 {
+        self.dropped_frames
+    }
+}
+
+/// Turns what a backend knows about the frames it captures into [`FrameMetadata`], tracking drops between them.
+#[derive(Copy, Clone, Debug, Default)]
+pub(crate) struct FrameCounter {
+    last_sequence: Option<u64>,
+    last_timestamp: Option<Duration>,
+}
+
+impl FrameCounter {
+    /// Forgets the last frame, e.g. because the stream was restarted and the driver starts counting again.
+    pub(crate) fn reset(&mut self) {
+        *self = FrameCounter::default();
+    }
+
+    /// For drivers that number their frames. Drops are the gaps between the sequence numbers.
+    pub(crate) fn sequenced(
+        &mut self,
+        sequence: u64,
+        timestamp: Option<Duration>,
+    ) -> FrameMetadata {
+        let dropped = match self.last_sequence {
+            // if it went backwards, the driver restarted counting
+            Some(last) if sequence > last => sequence - last - 1,
+            _ => 0,
+        };
+        self.last_sequence = Some(sequence);
+        self.last_timestamp = timestamp;
+        FrameMetadata::new(timestamp, sequence, dropped)
+    }
+
+    /// For drivers that do not number their frames. If the driver does not say how many frames it `dropped`, they are estimated
+    /// from the gap between the timestamps of this frame and the last, with frames `frame_rate` per second apart.
+    pub(crate) fn timed(
+        &mut self,
+        timestamp: Option<Duration>,
+        frame_rate: u32,
+        dropped: Option<u64>,
+    ) -> FrameMetadata {
+        let dropped = dropped.unwrap_or_else(|| match (self.last_timestamp, timestamp) {
+            (Some(last), Some(now)) if frame_rate != 0 && now > last => {
+                let interval = Duration::from_secs(1) / frame_rate;
+                // frames that come in up to half an interval late are not counted as dropped
+                let elapsed = (now - last + interval / 2).as_nanos() / interval.as_nanos();
+                u64::try_from(elapsed).unwrap_or(u64::MAX).saturating_sub(1)
+            }
+            _ => 0,
+        });
+        let sequence = match self.last_sequence {
+            Some(last) => last.wrapping_add(dropped).wrapping_add(1),
+            None => 0,
+        };
+        self.last_sequence = Some(sequence);
+        self.last_timestamp = timestamp;
+        FrameMetadata::new(timestamp, sequence, dropped)
+    }
+}
@@ -0,0 +1,526 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! Per-camera timings of the capture pipeline, see [`MetricsSnapshot`].
+//!
+//! Every [`Camera`](crate::Camera) owns a [`MetricsHandle`]. While the camera captures a frame, its handle is made the
+//! current one of the thread ([`MetricsHandle::enter()`]), and the stages deeper down (e.g. the driver call of a backend,
+//! or a MJPEG decode) time themselves with [`time()`] against whatever handle is current. This way the decoders and backends
+//! do not need to know which camera they are working for.
+//!
+//! Without the `metrics` feature, all of this compiles down to nothing.
+
+use crate::FrameMetadata;
+#[cfg(feature = "metrics")]
+use std::{
+    cell::Cell,
+    marker::PhantomData,
+    ptr,
+    sync::{
+        atomic::{AtomicU64, AtomicUsize, Ordering},
+        Arc,
+    },
+    time::{Duration, Instant},
+};
+
+/// A stage of the capture pipeline that is timed, see [`MetricsSnapshot::stage()`].
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "metrics")))]
+#[derive(Copy, Clone, Debug, Hash, PartialEq, Eq, PartialOrd, Ord)]
+pub enum Stage {
+    /// Waiting for the driver to hand out a frame (e.g. `MmapStream::next()` for `V4L2`, `ReadSample()` for `MSMF`, `frame_to_slice()` for `AVFoundation`).
+    Dequeue,
+    /// Decoding a frame to RGB (e.g. [`mjpeg_to_rgb()`](crate::mjpeg_to_rgb), [`yuyv422_to_rgb()`](crate::yuyv422_to_rgb), hardware decoders).
+    Decode,
+    /// Waiting on the locks of a [`CallbackCamera`](crate::CallbackCamera) (the camera, the callback and the subscriber list).
+    LockWait,
+    /// Running the callback of a [`CallbackCamera`](crate::CallbackCamera).
+    Callback,
+}
+
+#[cfg_attr(not(feature = "metrics"), allow(dead_code))]
+impl Stage {
+    /// Every [`Stage`], in order.
+    pub const ALL: [Stage; 4] = [
+        Stage::Dequeue,
+        Stage::Decode,
+        Stage::LockWait,
+        Stage::Callback,
+    ];
+
+    /// The name of the stage, as used for its `tracing` span.
+    #[must_use]
+    pub fn name(self) -> &'static str {
+        match self {
+            Stage::Dequeue => "dequeue",
+            Stage::Decode => "decode",
+            Stage::LockWait => "lock_wait",
+            Stage::Callback => "callback",
+        }
+    }
+
+    #[cfg(feature = "metrics")]
+    fn bit(self) -> u8 {
+        1 << (self as u8)
+    }
+}
+
+/// Amount of histogram buckets. Bucket `n` holds durations of less than `2^n` nanoseconds (and at least `2^(n - 1)`).
+#[cfg(feature = "metrics")]
+const BUCKETS: usize = 64;
+
+#[cfg(feature = "metrics")]
+struct Histogram {
+    buckets: [AtomicU64; BUCKETS],
+    count: AtomicU64,
+    total_nanos: AtomicU64,
+    max_nanos: AtomicU64,
+}
+
+#[cfg(feature = "metrics")]
+impl Histogram {
+    fn new() -> Self {
+        Histogram {
+            buckets: [(); BUCKETS].map(|_| AtomicU64::new(0)),
+            count: AtomicU64::new(0),
+            total_nanos: AtomicU64::new(0),
+            max_nanos: AtomicU64::new(0),
+        }
+    }
+
+    fn record(&self, elapsed: Duration) {
+        let nanos = u64::try_from(elapsed.as_nanos()).unwrap_or(u64::MAX);
+        let bucket = (u64::BITS - nanos.leading_zeros()) as usize;
+        self.buckets[bucket.min(BUCKETS - 1)].fetch_add(1, Ordering::Relaxed);
+        self.count.fetch_add(1, Ordering::Relaxed);
+        self.total_nanos.fetch_add(nanos, Ordering::Relaxed);
+        self.max_nanos.fetch_max(nanos, Ordering::Relaxed);
+    }
+
+    fn reset(&self) {
+        for bucket in &self.buckets {
+            bucket.store(0, Ordering::Relaxed);
+        }
+        self.count.store(0, Ordering::Relaxed);
+        self.total_nanos.store(0, Ordering::Relaxed);
+        self.max_nanos.store(0, Ordering::Relaxed);
+    }
+
+    fn snapshot(&self) -> StageStats {
+        let mut buckets = [0; BUCKETS];
+        for (count, bucket) in buckets.iter_mut().zip(&self.buckets) {
+            *count = bucket.load(Ordering::Relaxed);
+        }
+        StageStats {
+            count: self.count.load(Ordering::Relaxed),
+            total: Duration::from_nanos(self.total_nanos.load(Ordering::Relaxed)),
+            max: Duration::from_nanos(self.max_nanos.load(Ordering::Relaxed)),
+            buckets,
+        }
+    }
+}
+
+/// The timings of one [`Stage`].
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "metrics")))]
+#[cfg(feature = "metrics")]
+#[derive(Clone, Debug, Hash, PartialEq, Eq)]
+pub struct StageStats {
+    count: u64,
+    total: Duration,
+    max: Duration,
+    buckets: [u64; BUCKETS],
+}
+
+#[cfg(feature = "metrics")]
+impl StageStats {
+    /// How often the stage was timed.
+    #[must_use]
+    pub fn count(&self) -> u64 {
+        self.count
+    }
+
+    /// The time spent in the stage in total.
+    #[must_use]
+    pub fn total(&self) -> Duration {
+        self.total
+    }
+
+    /// The average time spent in the stage.
+    #[must_use]
+    pub fn mean(&self) -> Duration {
+        match u32::try_from(self.count) {
+            Ok(0) => Duration::ZERO,
+            Ok(count) => self.total / count,
+            Err(_) => Duration::from_nanos(
+                u64::try_from(self.total.as_nanos() / u128::from(self.count)).unwrap_or(u64::MAX),
+            ),
+        }
+    }
+
+    /// The longest time spent in the stage.
+    #[must_use]
+    pub fn max(&self) -> Duration {
+        self.max
+    }
+
+    /// The time that `percentile` (`0.0` to `1.0`) of all timings were below. Timings are kept in power of two buckets,
+    /// so this is rounded up to the next power of two nanoseconds (but never more than [`max()`](StageStats::max)).
+    #[must_use]
+    pub fn percentile(&self, percentile: f64) -> Duration {
+        if self.count == 0 {
+            return Duration::ZERO;
+        }
+        #[allow(
+            clippy::cast_precision_loss,
+            clippy::cast_possible_truncation,
+            clippy::cast_sign_loss
+        )]
+        let target = ((self.count as f64 * percentile.clamp(0.0, 1.0)).ceil() as u64).max(1);
+        let mut seen = 0;
+        for (bucket, count) in self.buckets.iter().enumerate() {
+            seen += count;
+            if seen >= target {
+                #[allow(clippy::cast_possible_truncation)]
+                let upper_bound = 1_u64
+                    .checked_shl(bucket as u32)
+                    .map_or(u64::MAX, |bound| bound - 1);
+                return Duration::from_nanos(upper_bound).min(self.max);
+            }
+        }
+        self.max
+    }
+}
+
+/// A snapshot of the metrics of a [`Camera`](crate::Camera), from [`Camera::metrics()`](crate::Camera::metrics)
+/// or [`CallbackCamera::metrics()`](crate::CallbackCamera::metrics).
+///
+/// Everything is counted from when the camera was created or [`reset_metrics()`](crate::Camera::reset_metrics) was last called.
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "metrics")))]
+#[cfg(feature = "metrics")]
+#[derive(Clone, Debug, PartialEq)]
+pub struct MetricsSnapshot {
+    elapsed: Duration,
+    frames: u64,
+    frame_span: Duration,
+    driver_dropped_frames: u64,
+    queue_dropped_frames: u64,
+    queue_depth: usize,
+    max_queue_depth: usize,
+    stages: [StageStats; 4],
+}
+
+#[cfg(feature = "metrics")]
+impl MetricsSnapshot {
+    /// The time the metrics were collected over.
+    #[must_use]
+    pub fn elapsed(&self) -> Duration {
+        self.elapsed
+    }
+
+    /// The amount of frames captured.
+    #[must_use]
+    pub fn frames(&self) -> u64 {
+        self.frames
+    }
+
+    /// The frame rate the camera is actually delivering, measured between the first and the last frame.
+    #[must_use]
+    pub fn fps(&self) -> f64 {
+        if self.frames < 2 || self.frame_span.is_zero() {
+            return 0.0;
+        }
+        #[allow(clippy::cast_precision_loss)]
+        let frames = (self.frames - 1) as f64;
+        frames / self.frame_span.as_secs_f64()
+    }
+
+    /// The amount of frames the driver dropped, see [`FrameMetadata::dropped_frames()`].
+    #[must_use]
+    pub fn driver_dropped_frames(&self) -> u64 {
+        self.driver_dropped_frames
+    }
+
+    /// The amount of frames a [`CallbackCamera`](crate::CallbackCamera) dropped because its [`FrameRing`](crate::FrameRing) or a
+    /// [`FrameSubscription`](crate::FrameSubscription) was full.
+    #[must_use]
+    pub fn queue_dropped_frames(&self) -> u64 {
+        self.queue_dropped_frames
+    }
+
+    /// The amount of frames in the [`FrameRing`](crate::FrameRing) of a [`CallbackCamera`](crate::CallbackCamera) after the last frame was delivered.
+    #[must_use]
+    pub fn queue_depth(&self) -> usize {
+        self.queue_depth
+    }
+
+    /// The most frames the [`FrameRing`](crate::FrameRing) of a [`CallbackCamera`](crate::CallbackCamera) held.
+    #[must_use]
+    pub fn max_queue_depth(&self) -> usize {
+        self.max_queue_depth
+    }
+
+    /// The timings of `stage`.
+    #[must_use]
+    pub fn stage(&self, stage: Stage) -> &StageStats {
+        &self.stages[stage as usize]
+    }
+}
+
+#[cfg(feature = "metrics")]
+struct CameraMetrics {
+    index: usize,
+    created: Instant,
+    // nanoseconds since `created`
+    reset_at: AtomicU64,
+    first_frame: AtomicU64,
+    last_frame: AtomicU64,
+    frames: AtomicU64,
+    driver_dropped: AtomicU64,
+    queue_dropped: AtomicU64,
+    queue_depth: AtomicUsize,
+    max_queue_depth: AtomicUsize,
+    stages: [Histogram; 4],
+}
+
+#[cfg(feature = "metrics")]
+impl CameraMetrics {
+    fn now(&self) -> u64 {
+        u64::try_from(self.created.elapsed().as_nanos()).unwrap_or(u64::MAX)
+    }
+}
+
+#[cfg(feature = "metrics")]
+thread_local! {
+    // the metrics that are being recorded into on this thread, and which stages are being timed right now
+    static CURRENT: Cell<(*const CameraMetrics, u8)> = Cell::new((ptr::null(), 0));
+}
+
+/// The metrics of one camera. Cheap to [`Clone`], clones record into the same metrics.
+#[cfg(feature = "metrics")]
+#[derive(Clone)]
+pub(crate) struct MetricsHandle {
+    inner: Arc<CameraMetrics>,
+}
+
+/// The metrics of one camera. Without the `metrics` feature this records nothing.
+#[cfg(not(feature = "metrics"))]
+#[derive(Clone, Default)]
+pub(crate) struct MetricsHandle;
+
+#[cfg(feature = "metrics")]
+impl MetricsHandle {
+    pub(crate) fn new(index: usize) -> Self {
+        MetricsHandle {
+            inner: Arc::new(CameraMetrics {
+                index,
+                created: Instant::now(),
+                reset_at: AtomicU64::new(0),
+                first_frame: AtomicU64::new(u64::MAX),
+                last_frame: AtomicU64::new(0),
+                frames: AtomicU64::new(0),
+                driver_dropped: AtomicU64::new(0),
+                queue_dropped: AtomicU64::new(0),
+                queue_depth: AtomicUsize::new(0),
+                max_queue_depth: AtomicUsize::new(0),
+                stages: [(); 4].map(|_| Histogram::new()),
+            }),
+        }
+    }
+
+    /// Makes these the metrics that [`time()`] and friends record into on this thread, until the [`MetricsScope`] is dropped.
+    pub(crate) fn enter(&self) -> MetricsScope<'_> {
+        let metrics: *const CameraMetrics = &*self.inner;
+        let previous = CURRENT.with(|current| {
+            let previous = current.get();
+            // keep the active stages when re-entering the same metrics, so nested timers of a stage are not counted twice
+            let active = if previous.0 == metrics { previous.1 } else { 0 };
+            current.set((metrics, active));
+            previous
+        });
+        MetricsScope {
+            previous,
+            _metrics: PhantomData,
+        }
+    }
+
+    /// Counts a captured frame.
+    pub(crate) fn record_frame(&self, metadata: Option<FrameMetadata>) {
+        let inner = &self.inner;
+        let now = inner.now();
+        inner.frames.fetch_add(1, Ordering::Relaxed);
+        inner.first_frame.fetch_min(now, Ordering::Relaxed);
+        inner.last_frame.fetch_max(now, Ordering::Relaxed);
+        if let Some(metadata) = metadata {
+            inner
+                .driver_dropped
+                .fetch_add(metadata.dropped_frames(), Ordering::Relaxed);
+        }
+    }
+
+    pub(crate) fn snapshot(&self) -> MetricsSnapshot {
+        let inner = &self.inner;
+        let reset_at = inner.reset_at.load(Ordering::Relaxed);
+        let first_frame = inner.first_frame.load(Ordering::Relaxed);
+        let last_frame = inner.last_frame.load(Ordering::Relaxed);
+        MetricsSnapshot {
+            elapsed: Duration::from_nanos(inner.now().saturating_sub(reset_at)),
+            frames: inner.frames.load(Ordering::Relaxed),
+            frame_span: Duration::from_nanos(last_frame.saturating_sub(first_frame)),
+            driver_dropped_frames: inner.driver_dropped.load(Ordering::Relaxed),
+            queue_dropped_frames: inner.queue_dropped.load(Ordering::Relaxed),
+            queue_depth: inner.queue_depth.load(Ordering::Relaxed),
+            max_queue_depth: inner.max_queue_depth.load(Ordering::Relaxed),
+            stages: [
+                inner.stages[0].snapshot(),
+                inner.stages[1].snapshot(),
+                inner.stages[2].snapshot(),
+                inner.stages[3].snapshot(),
+            ],
+        }
+    }
+
+    pub(crate) fn reset(&self) {
+        let inner = &self.inner;
+        inner.reset_at.store(inner.now(), Ordering::Relaxed);
+        inner.first_frame.store(u64::MAX, Ordering::Relaxed);
+        inner.last_frame.store(0, Ordering::Relaxed);
+        inner.frames.store(0, Ordering::Relaxed);
+        inner.driver_dropped.store(0, Ordering::Relaxed);
+        inner.queue_dropped.store(0, Ordering::Relaxed);
+        inner.queue_depth.store(0, Ordering::Relaxed);
+        inner.max_queue_depth.store(0, Ordering::Relaxed);
+        for stage in &inner.stages {
+            stage.reset();
+        }
+    }
+}
+
+#[cfg(not(feature = "metrics"))]
+impl MetricsHandle {
+    #[inline(always)]
+    pub(crate) fn new(_index: usize) -> Self {
+        MetricsHandle
+    }
+
+    #[inline(always)]
+    pub(crate) fn enter(&self) -> MetricsScope<'_> {
+        MetricsScope {
+            _metrics: std::marker::PhantomData,
+        }
+    }
+
+    #[inline(always)]
+    pub(crate) fn record_frame(&self, _metadata: Option<FrameMetadata>) {}
+}
+
+/// Restores the metrics that were current on this thread before [`MetricsHandle::enter()`] when dropped.
+pub(crate) struct MetricsScope<'a> {
+    #[cfg(feature = "metrics")]
+    previous: (*const CameraMetrics, u8),
+    _metrics: std::marker::PhantomData<&'a MetricsHandle>,
+}
+
+#[cfg(feature = "metrics")]
+impl<'a> Drop for MetricsScope<'a> {
+    fn drop(&mut self) {
+        CURRENT.with(|current| current.set(self.previous));
+    }
+}
+
+/// Times a [`Stage`] until it is dropped, recording into the current metrics of the thread (if there are any) and entering a `tracing` span.
+#[must_use]
+pub(crate) struct StageTimer {
+    #[cfg(feature = "metrics")]
+    active: Option<(*const CameraMetrics, Stage, Instant)>,
+    #[cfg(feature = "metrics")]
+    _span: tracing::span::EnteredSpan,
+}
+
+/// Starts timing `stage`. A stage that is already being timed on this thread (e.g. a decoder calling another decoder) is only counted once.
+#[inline(always)]
+pub(crate) fn time(stage: Stage) -> StageTimer {
+    #[cfg(feature = "metrics")]
+    {
+        let (metrics, active) = CURRENT.with(Cell::get);
+        let counted = !metrics.is_null() && active & stage.bit() == 0;
+        if counted {
+            CURRENT.with(|current| current.set((metrics, active | stage.bit())));
+        }
+        // SAFETY: `metrics` is only non-null while the `MetricsScope` that set it is alive, which borrows the metrics.
+        let camera = unsafe { metrics.as_ref() }.map(|metrics| metrics.index);
+        let span = match stage {
+            Stage::Dequeue => tracing::trace_span!("dequeue", camera = ?camera),
+            Stage::Decode => tracing::trace_span!("decode", camera = ?camera),
+            Stage::LockWait => tracing::trace_span!("lock_wait", camera = ?camera),
+            Stage::Callback => tracing::trace_span!("callback", camera = ?camera),
+        };
+        StageTimer {
+            active: counted.then(|| (metrics, stage, Instant::now())),
+            _span: span.entered(),
+        }
+    }
+    #[cfg(not(feature = "metrics"))]
+    {
+        let _ = stage;
+        StageTimer {}
+    }
+}
+
+#[cfg(feature = "metrics")]
+impl Drop for StageTimer {
+    fn drop(&mut self) {
+        if let Some((metrics, stage, start)) = self.active {
+            // SAFETY: timers are local variables dropped before the `MetricsScope` they were started in, see `time()`.
+            let metrics = unsafe { &*metrics };
+            metrics.stages[stage as usize].record(start.elapsed());
+            CURRENT.with(|current| {
+                let (current_metrics, active) = current.get();
+                if current_metrics == metrics as *const CameraMetrics {
+                    current.set((current_metrics, active & !stage.bit()));
+                }
+            });
+        }
+    }
+}
+
+/// Records the depth of the [`FrameRing`](crate::FrameRing) of a [`CallbackCamera`](crate::CallbackCamera) into the current metrics of the thread.
+#[inline(always)]
+pub(crate) fn record_queue_depth(depth: usize) {
+    #[cfg(feature = "metrics")]
+    with_current(|metrics| {
+        metrics.queue_depth.store(depth, Ordering::Relaxed);
+        metrics.max_queue_depth.fetch_max(depth, Ordering::Relaxed);
+    });
+    #[cfg(not(feature = "metrics"))]
+    let _ = depth;
+}
+
+/// Counts a frame a [`CallbackCamera`](crate::CallbackCamera) dropped into the current metrics of the thread.
+#[inline(always)]
+pub(crate) fn record_queue_drop() {
+    #[cfg(feature = "metrics")]
+    with_current(|metrics| {
+        metrics.queue_dropped.fetch_add(1, Ordering::Relaxed);
+    });
+}
+
+#[cfg(feature = "metrics")]
+fn with_current(f: impl FnOnce(&CameraMetrics)) {
+    let (metrics, _) = CURRENT.with(Cell::get);
+    // SAFETY: see `time()`
+    if let Some(metrics) = unsafe { metrics.as_ref() } {
+        f(metrics);
+    }
+}
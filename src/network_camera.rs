@@ -16,6 +16,7 @@
 
 use crate::{backends::capture::OpenCvCaptureDevice, CaptureBackendTrait, NokhwaError};
 use image::{buffer::ConvertBuffer, ImageBuffer, Rgb, RgbaImage};
+use opencv::core::Mat;
 use std::cell::RefCell;
 #[cfg(feature = "output-wgpu")]
 use wgpu::{
@@ -25,6 +26,8 @@ use wgpu::{
 };
 
 /// A struct that supports IP Cameras via the `OpenCV` backend.
+///
+/// For MJPEG over HTTP and RTSP (RTP/JPEG) streams without `OpenCV`, see [`NetworkCaptureDevice`](crate::backends::capture::NetworkCaptureDevice) (`input-network`).
 #[cfg_attr(feature = "docs-features", doc(cfg(feature = "input-ipcam")))]
 pub struct NetworkCamera {
     ip: String,
@@ -87,17 +90,28 @@ impl NetworkCamera {
         buffer: &mut [u8],
         convert_rgba: bool,
     ) -> Result<usize, NokhwaError> {
-        let frame = self.frame()?;
-        let mut frame_data = frame.to_vec();
         if convert_rgba {
-            let rgba_image: RgbaImage = frame.convert();
-            frame_data = rgba_image.to_vec();
+            let rgba_image: RgbaImage = self.frame()?.convert();
+            let bytes = rgba_image.len();
+            buffer.copy_from_slice(&rgba_image);
+            return Ok(bytes);
         }
+        // copy straight out of the backend's converted frame
+        let mut backend = self.opencv_backend.borrow_mut();
+        let frame_data = backend.raw_frame_vec()?;
         let bytes = frame_data.len();
         buffer.copy_from_slice(&frame_data);
         Ok(bytes)
     }
 
+    /// Gets the frame as the `Mat` `OpenCV` captured it into (usually BGR), without any copy or conversion.
+    /// See [`OpenCvCaptureDevice::take_frame_mat()`].
+    /// # Errors
+    /// If the backend fails to capture the frame, this will error.
+    pub fn frame_mat(&self) -> Result<Mat, NokhwaError> {
+        self.opencv_backend.borrow_mut().take_frame_mat()
+    }
+
     #[cfg(feature = "output-wgpu")]
     /// Directly copies a frame to a Wgpu texture. This will automatically convert the frame into a RGBA frame.
     /// # Errors
@@ -145,7 +159,7 @@ impl NetworkCamera {
                 origin: wgpu::Origin3d::ZERO,
                 aspect: TextureAspect::All,
             },
-            &rgba_frame.to_vec(),
+            rgba_frame.as_raw(),
             ImageDataLayout {
                 offset: 0,
                 bytes_per_row: width_nonzero,
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Splits frame conversions into stripes that are converted on rayon's global thread pool.
+//
+// A stripe is a run of whole units (rows, or YUYV macropixels when the width is not known) whose converted form is
+// about `STRIPE_SIZE` bytes, so the source and destination of a stripe stay in the cache of the core converting it.
+// Without the `parallel` feature, or for frames below `PARALLEL_THRESHOLD`, the whole frame is one stripe converted
+// on the calling thread.
+
+#[cfg(feature = "parallel")]
+use rayon::prelude::*;
+
+/// Frames with fewer pixels than this are converted on the calling thread, as handing them to the thread pool costs more than it saves.
+#[cfg(feature = "parallel")]
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "parallel")))]
+pub const PARALLEL_THRESHOLD: usize = 1920 * 1080;
+
+// the converted size of a stripe, half of a typical L2
+#[cfg(feature = "parallel")]
+const STRIPE_SIZE: usize = 256 * 1024;
+
+// calls `convert` with the index of the first unit of every stripe of `dest` and the stripe itself.
+// `unit_size` is the converted size of a unit, `pixels` the amount of pixels in the frame.
+#[cfg(feature = "parallel")]
+#[inline]
+pub(crate) fn for_each_stripe(
+    dest: &mut [u8],
+    unit_size: usize,
+    pixels: usize,
+    convert: impl Fn(usize, &mut [u8]) + Send + Sync,
+) {
+    if unit_size == 0 || pixels < PARALLEL_THRESHOLD {
+        convert(0, dest);
+        return;
+    }
+
+    let units = (STRIPE_SIZE / unit_size).max(1);
+    dest.par_chunks_mut(units * unit_size)
+        .enumerate()
+        .for_each(|(stripe, dest)| convert(stripe * units, dest));
+}
+
+#[cfg(not(feature = "parallel"))]
+#[inline]
+pub(crate) fn for_each_stripe(
+    dest: &mut [u8],
+    _unit_size: usize,
+    _pixels: usize,
+    convert: impl Fn(usize, &mut [u8]) + Send + Sync,
+) {
+    convert(0, dest);
+}
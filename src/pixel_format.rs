@@ -14,12 +14,452 @@
  * limitations under the License.
  */
 
-use crate::FrameFormat;
-use image::Pixel;
+use crate::{
+    buf_mjpeg_to_rgb, buf_yuyv422_to_rgb, mjpeg_to_rgb,
+    utils::{buf_i420_planes_to_rgb, buf_nv12_planes_to_rgb, expand_gray8, plane_data},
+    FrameFormat, NokhwaError, Plane, Resolution,
+};
+use image::{Luma, Pixel, Rgb, Rgba};
 use std::{fmt::Debug, hash::Hash};
 
+/// A pixel format that frames can be converted into, e.g. with [`Buffer::decode_image()`](crate::Buffer::decode_image).
+///
+/// The conversion is chosen at compile time: every implementor has its own [`convert()`](PixelFormat::convert), so
+/// `frame_typed::<RgbFormat>()` compiles down to the conversion loop for the frame's source format, and nothing else.
 pub trait PixelFormat: Copy + Clone + Debug + Default + Hash + Send + Sync {
-    type Output: Pixel;
+    /// The pixel type of the converted image.
+    type Output: Pixel<Subpixel = u8>;
 
+    /// The name of this format, used in errors.
+    const NAME: &'static str;
+
+    /// The source [`FrameFormat`]s this can convert from.
     const SUPPORTED_CODES: &'static [FrameFormat];
+
+    /// The size of a converted frame of `resolution`, in bytes.
+    #[must_use]
+    fn output_size(resolution: Resolution) -> usize {
+        resolution.width() as usize
+            * resolution.height() as usize
+            * usize::from(<Self::Output as Pixel>::CHANNEL_COUNT)
+    }
+
+    /// Converts `data`, a frame of `resolution` in the `src` format laid out in `planes` (see [`Buffer::planes()`](crate::Buffer::planes)),
+    /// into `dest`, which must be exactly [`output_size()`](PixelFormat::output_size) bytes.
+    /// Rows padded past their pixels (e.g. by the driver) are skipped.
+    /// # Errors
+    /// If `src` is not one of the [`SUPPORTED_CODES`](PixelFormat::SUPPORTED_CODES), the frame is malformed, or `dest` is the wrong size, this will error.
+    fn convert(
+        src: FrameFormat,
+        resolution: Resolution,
+        data: &[u8],
+        planes: &[Plane],
+        dest: &mut [u8],
+    ) -> Result<(), NokhwaError>;
+
+    /// Converts `data`, a frame of `resolution` that was already decoded from `src` to RGB888 (or RGBA if `rgba` is true, see
+    /// [`FrameState`](crate::FrameState)), into `dest`, which must be exactly [`output_size()`](PixelFormat::output_size) bytes.
+    ///
+    /// The default implementation does not support this and errors.
+    /// # Errors
+    /// If this format cannot convert from decoded frames, the frame is malformed, or `dest` is the wrong size, this will error.
+    fn convert_decoded(
+        src: FrameFormat,
+        rgba: bool,
+        resolution: Resolution,
+        data: &[u8],
+        dest: &mut [u8],
+    ) -> Result<(), NokhwaError> {
+        let _ = (rgba, resolution, data, dest);
+        Err(NokhwaError::ProcessFrameError {
+            src,
+            destination: Self::NAME.to_string(),
+            error: "Converting already decoded frames is not supported".to_string(),
+        })
+    }
+}
+
+fn check_sizes<F: PixelFormat>(
+    src: FrameFormat,
+    resolution: Resolution,
+    data: &[u8],
+    src_size: usize,
+    dest: &[u8],
+) -> Result<(), NokhwaError> {
+    let dest_size = F::output_size(resolution);
+    if data.len() < src_size || dest.len() != dest_size {
+        return Err(NokhwaError::ProcessFrameError {
+            src,
+            destination: F::NAME.to_string(),
+            error: format!("Assertion failure, bad source or destination buffer size! [source: {}, expected at least: {src_size}, destination: {}, expected: {dest_size}]", data.len(), dest.len()),
+        });
+    }
+    Ok(())
+}
+
+// Calls `convert` with the rows of the plane at `index` of a packed format (or the luma plane), `row_size` bytes each, and `dest`.
+// A plane without padding is handed over in one go, a padded one row by row, with `dest` split into as many rows.
+#[allow(clippy::too_many_arguments)]
+fn convert_rows<F: PixelFormat>(
+    src: FrameFormat,
+    resolution: Resolution,
+    data: &[u8],
+    planes: &[Plane],
+    index: usize,
+    row_size: usize,
+    dest: &mut [u8],
+    mut convert: impl FnMut(&[u8], &mut [u8]) -> Result<(), NokhwaError>,
+) -> Result<(), NokhwaError> {
+    let height = resolution.height() as usize;
+    if dest.len() != F::output_size(resolution) {
+        return check_sizes::<F>(src, resolution, data, 0, dest);
+    }
+    match planes.get(index) {
+        Some(plane) if plane.stride() != row_size && height != 0 => {
+            let (plane, stride) = plane_data(src, data, planes, index, row_size, height)?;
+            let dest_row_size = dest.len() / height;
+            for (row, dest_row) in plane
+                .chunks(stride)
+                .zip(dest.chunks_exact_mut(dest_row_size))
+            {
+                convert(&row[..row_size], dest_row)?;
+            }
+            Ok(())
+        }
+        plane => {
+            let offset = plane.map_or(0, Plane::offset);
+            let size = row_size * height;
+            match data.get(offset..offset + size) {
+                Some(rows) => convert(rows, dest),
+                None => check_sizes::<F>(src, resolution, &[], size, dest),
+            }
+        }
+    }
+}
+
+// converts a decoded RGB888 (or RGBA) frame pixel by pixel
+fn convert_pixels<F: PixelFormat>(
+    src: FrameFormat,
+    rgba: bool,
+    resolution: Resolution,
+    data: &[u8],
+    dest: &mut [u8],
+    mut convert: impl FnMut(&[u8], &mut [u8]),
+) -> Result<(), NokhwaError> {
+    let pixel_size = if rgba { 4 } else { 3 };
+    let pixels = resolution.width() as usize * resolution.height() as usize;
+    check_sizes::<F>(src, resolution, data, pixels * pixel_size, dest)?;
+    let output_size = usize::from(<F::Output as Pixel>::CHANNEL_COUNT);
+    for (pixel, output) in data
+        .chunks_exact(pixel_size)
+        .zip(dest.chunks_exact_mut(output_size))
+    {
+        convert(pixel, output);
+    }
+    Ok(())
+}
+
+// BT.601 luma of a RGB pixel
+#[allow(clippy::cast_possible_truncation)]
+#[inline]
+fn rgb_luma(pixel: &[u8]) -> u8 {
+    let (r, g, b) = (
+        u32::from(pixel[0]),
+        u32::from(pixel[1]),
+        u32::from(pixel[2]),
+    );
+    ((r * 77 + g * 150 + b * 29 + 128) >> 8) as u8
+}
+
+// video range luma (16-235) to full range, same as the luma part of `yuyv444_to_rgb`
+#[allow(clippy::cast_possible_truncation)]
+#[allow(clippy::cast_sign_loss)]
+#[inline]
+fn expand_luma(y: u8) -> u8 {
+    (((i32::from(y) - 16) * 298 + 128) >> 8).clamp(0, 255) as u8
+}
+
+/// RGB888: R, G, B.
+#[derive(Copy, Clone, Debug, Default, Hash, PartialEq, Eq, PartialOrd, Ord)]
+pub struct RgbFormat;
+
+impl PixelFormat for RgbFormat {
+    type Output = Rgb<u8>;
+
+    const NAME: &'static str = "RGB888";
+
+    const SUPPORTED_CODES: &'static [FrameFormat] = &[
+        FrameFormat::MJPEG,
+        FrameFormat::YUYV,
+        FrameFormat::GRAY8,
+        FrameFormat::NV12,
+        FrameFormat::I420,
+    ];
+
+    fn convert(
+        src: FrameFormat,
+        resolution: Resolution,
+        data: &[u8],
+        planes: &[Plane],
+        dest: &mut [u8],
+    ) -> Result<(), NokhwaError> {
+        let width = resolution.width() as usize;
+        match src {
+            FrameFormat::MJPEG => buf_mjpeg_to_rgb(data, dest, false),
+            FrameFormat::YUYV => {
+                let row_size = (width + 1) / 2 * 4;
+                convert_rows::<Self>(
+                    src,
+                    resolution,
+                    data,
+                    planes,
+                    0,
+                    row_size,
+                    dest,
+                    |row, dest| buf_yuyv422_to_rgb(row, dest, false),
+                )
+            }
+            FrameFormat::NV12 => buf_nv12_planes_to_rgb(resolution, data, planes, dest, false),
+            FrameFormat::I420 => buf_i420_planes_to_rgb(resolution, data, planes, dest, false),
+            FrameFormat::GRAY8 => convert_rows::<Self>(
+                src,
+                resolution,
+                data,
+                planes,
+                0,
+                width,
+                dest,
+                |row, dest| {
+                    expand_gray8(row, dest, 3, false);
+                    Ok(())
+                },
+            ),
+        }
+    }
+
+    fn convert_decoded(
+        src: FrameFormat,
+        rgba: bool,
+        resolution: Resolution,
+        data: &[u8],
+        dest: &mut [u8],
+    ) -> Result<(), NokhwaError> {
+        if !rgba {
+            check_sizes::<Self>(src, resolution, data, dest.len(), dest)?;
+            dest.copy_from_slice(&data[..dest.len()]);
+            return Ok(());
+        }
+        convert_pixels::<Self>(src, rgba, resolution, data, dest, |pixel, output| {
+            output.copy_from_slice(&pixel[..3]);
+        })
+    }
+}
+
+/// RGBA8888: R, G, B, A. The alpha is always `255`.
+#[derive(Copy, Clone, Debug, Default, Hash, PartialEq, Eq, PartialOrd, Ord)]
+pub struct RgbaFormat;
+
+impl PixelFormat for RgbaFormat {
+    type Output = Rgba<u8>;
+
+    const NAME: &'static str = "RGBA8888";
+
+    const SUPPORTED_CODES: &'static [FrameFormat] = RgbFormat::SUPPORTED_CODES;
+
+    fn convert(
+        src: FrameFormat,
+        resolution: Resolution,
+        data: &[u8],
+        planes: &[Plane],
+        dest: &mut [u8],
+    ) -> Result<(), NokhwaError> {
+        let width = resolution.width() as usize;
+        match src {
+            FrameFormat::MJPEG => buf_mjpeg_to_rgb(data, dest, true),
+            FrameFormat::YUYV => {
+                let row_size = (width + 1) / 2 * 4;
+                convert_rows::<Self>(
+                    src,
+                    resolution,
+                    data,
+                    planes,
+                    0,
+                    row_size,
+                    dest,
+                    |row, dest| buf_yuyv422_to_rgb(row, dest, true),
+                )
+            }
+            FrameFormat::NV12 => buf_nv12_planes_to_rgb(resolution, data, planes, dest, true),
+            FrameFormat::I420 => buf_i420_planes_to_rgb(resolution, data, planes, dest, true),
+            FrameFormat::GRAY8 => convert_rows::<Self>(
+                src,
+                resolution,
+                data,
+                planes,
+                0,
+                width,
+                dest,
+                |row, dest| {
+                    expand_gray8(row, dest, 3, true);
+                    Ok(())
+                },
+            ),
+        }
+    }
+
+    fn convert_decoded(
+        src: FrameFormat,
+        rgba: bool,
+        resolution: Resolution,
+        data: &[u8],
+        dest: &mut [u8],
+    ) -> Result<(), NokhwaError> {
+        if rgba {
+            check_sizes::<Self>(src, resolution, data, dest.len(), dest)?;
+            dest.copy_from_slice(&data[..dest.len()]);
+            return Ok(());
+        }
+        convert_pixels::<Self>(src, rgba, resolution, data, dest, |pixel, output| {
+            output[..3].copy_from_slice(pixel);
+            output[3] = u8::MAX;
+        })
+    }
+}
+
+/// BGRA8888: B, G, R, A, the native layout of many GPU textures and OS surfaces. The alpha is always `255`.
+///
+/// `image` has no BGRA pixel type, so the [`Output`](PixelFormat::Output) is [`Rgba`] with the red and blue channels swapped.
+#[derive(Copy, Clone, Debug, Default, Hash, PartialEq, Eq, PartialOrd, Ord)]
+pub struct BgraFormat;
+
+impl PixelFormat for BgraFormat {
+    type Output = Rgba<u8>;
+
+    const NAME: &'static str = "BGRA8888";
+
+    const SUPPORTED_CODES: &'static [FrameFormat] = RgbFormat::SUPPORTED_CODES;
+
+    fn convert(
+        src: FrameFormat,
+        resolution: Resolution,
+        data: &[u8],
+        planes: &[Plane],
+        dest: &mut [u8],
+    ) -> Result<(), NokhwaError> {
+        RgbaFormat::convert(src, resolution, data, planes, dest)?;
+        for pixel in dest.chunks_exact_mut(4) {
+            pixel.swap(0, 2);
+        }
+        Ok(())
+    }
+
+    fn convert_decoded(
+        src: FrameFormat,
+        rgba: bool,
+        resolution: Resolution,
+        data: &[u8],
+        dest: &mut [u8],
+    ) -> Result<(), NokhwaError> {
+        RgbaFormat::convert_decoded(src, rgba, resolution, data, dest)?;
+        for pixel in dest.chunks_exact_mut(4) {
+            pixel.swap(0, 2);
+        }
+        Ok(())
+    }
+}
+
+/// Luma (8 bit grayscale).
+/// # Quirks
+/// - `MJPEG` frames are decoded to RGB first, which allocates.
+#[derive(Copy, Clone, Debug, Default, Hash, PartialEq, Eq, PartialOrd, Ord)]
+pub struct LumaFormat;
+
+impl PixelFormat for LumaFormat {
+    type Output = Luma<u8>;
+
+    const NAME: &'static str = "Luma8";
+
+    const SUPPORTED_CODES: &'static [FrameFormat] = RgbFormat::SUPPORTED_CODES;
+
+    fn convert(
+        src: FrameFormat,
+        resolution: Resolution,
+        data: &[u8],
+        planes: &[Plane],
+        dest: &mut [u8],
+    ) -> Result<(), NokhwaError> {
+        let width = resolution.width() as usize;
+        match src {
+            FrameFormat::GRAY8 => {
+                convert_rows::<Self>(
+                    src,
+                    resolution,
+                    data,
+                    planes,
+                    0,
+                    width,
+                    dest,
+                    |row, dest| {
+                        dest.copy_from_slice(row);
+                        Ok(())
+                    },
+                )?;
+            }
+            FrameFormat::YUYV => {
+                convert_rows::<Self>(
+                    src,
+                    resolution,
+                    data,
+                    planes,
+                    0,
+                    width * 2,
+                    dest,
+                    |row, dest| {
+                        for (yuyv, luma) in row.chunks_exact(2).zip(dest.iter_mut()) {
+                            *luma = expand_luma(yuyv[0]);
+                        }
+                        Ok(())
+                    },
+                )?;
+            }
+            // the Y plane comes first
+            FrameFormat::NV12 | FrameFormat::I420 => {
+                convert_rows::<Self>(
+                    src,
+                    resolution,
+                    data,
+                    planes,
+                    0,
+                    width,
+                    dest,
+                    |row, dest| {
+                        for (y, luma) in row.iter().zip(dest.iter_mut()) {
+                            *luma = expand_luma(*y);
+                        }
+                        Ok(())
+                    },
+                )?;
+            }
+            FrameFormat::MJPEG => {
+                let rgb = mjpeg_to_rgb(data, false)?;
+                check_sizes::<Self>(src, resolution, &rgb, dest.len() * 3, dest)?;
+                for (pixel, luma) in rgb.chunks_exact(3).zip(dest.iter_mut()) {
+                    *luma = rgb_luma(pixel);
+                }
+            }
+        }
+        Ok(())
+    }
+
+    fn convert_decoded(
+        src: FrameFormat,
+        rgba: bool,
+        resolution: Resolution,
+        data: &[u8],
+        dest: &mut [u8],
+    ) -> Result<(), NokhwaError> {
+        convert_pixels::<Self>(src, rgba, resolution, data, dest, |pixel, output| {
+            output[0] = rgb_luma(pixel);
+        })
+    }
 }
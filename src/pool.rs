@@ -0,0 +1,146 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+use crate::Buffer;
+use std::sync::{
+    atomic::{AtomicUsize, Ordering},
+    Arc, Mutex,
+};
+
+/// The default amount of buffers a [`BufferPool`] will hold on to.
+pub const DEFAULT_POOL_CAPACITY: usize = 8;
+
+#[derive(Debug)]
+struct PoolInner {
+    free: Mutex<Vec<Vec<u8>>>,
+    capacity: usize,
+    allocations: AtomicUsize,
+}
+
+/// A pool of reusable frame buffers.
+///
+/// Instead of allocating a new [`Vec`] for every frame, buffers are taken out of the pool with [`take()`](BufferPool::take)
+/// and given back with [`recycle()`](BufferPool::recycle)/[`recycle_buffer()`](BufferPool::recycle_buffer) once they are no longer needed.
+/// After the pool has warmed up, capturing at a constant resolution does no heap allocations per frame.
+///
+/// Every time the pool has to allocate, a counter is incremented. Use [`allocations()`](BufferPool::allocations) to check that
+/// the steady state is actually allocation free.
+///
+/// This is cheap to [`Clone`], all clones share the same buffers.
+#[derive(Clone, Debug)]
+pub struct BufferPool {
+    inner: Arc<PoolInner>,
+}
+
+impl BufferPool {
+    /// Creates a new, empty [`BufferPool`] that will hold on to at most `capacity` free buffers.
+    #[must_use]
+    pub fn new(capacity: usize) -> Self {
+        BufferPool {
+            inner: Arc::new(PoolInner {
+                free: Mutex::new(Vec::with_capacity(capacity)),
+                capacity,
+                allocations: AtomicUsize::new(0),
+            }),
+        }
+    }
+
+    /// Takes a buffer of exactly `len` bytes out of the pool. If there is no free buffer that is large enough, a new one is allocated.
+    ///
+    /// The contents of the buffer are unspecified (but initialized), callers are expected to overwrite it.
+    #[must_use]
+    pub fn take(&self, len: usize) -> Vec<u8> {
+        let reused = {
+            let mut free = match self.inner.free.lock() {
+                Ok(free) => free,
+                Err(poisoned) => poisoned.into_inner(),
+            };
+            free.iter()
+                .position(|buf| buf.capacity() >= len)
+                .map(|idx| free.swap_remove(idx))
+        };
+
+        if let Some(mut buf) = reused {
+            // does not reallocate, capacity is already large enough
+            buf.resize(len, 0);
+            buf
+        } else {
+            self.inner.allocations.fetch_add(1, Ordering::Relaxed);
+            vec![0; len]
+        }
+    }
+
+    /// Allocates up to `count` buffers of `len` bytes right away (as long as the pool has room for them),
+    /// so the first frames taken out of the pool do not have to. These count towards [`allocations()`](BufferPool::allocations).
+    pub fn preallocate(&self, count: usize, len: usize) {
+        let mut free = match self.inner.free.lock() {
+            Ok(free) => free,
+            Err(poisoned) => poisoned.into_inner(),
+        };
+        let count = count.min(self.inner.capacity.saturating_sub(free.len()));
+        for _ in 0..count {
+            self.inner.allocations.fetch_add(1, Ordering::Relaxed);
+            free.push(Vec::with_capacity(len));
+        }
+    }
+
+    /// Gives a buffer back to the pool. If the pool is already full, the buffer is dropped.
+    pub fn recycle(&self, mut buffer: Vec<u8>) {
+        if buffer.capacity() == 0 {
+            return;
+        }
+        let mut free = match self.inner.free.lock() {
+            Ok(free) => free,
+            Err(poisoned) => poisoned.into_inner(),
+        };
+        if free.len() < self.inner.capacity {
+            buffer.clear();
+            free.push(buffer);
+        }
+    }
+
+    /// Gives the data of a [`Buffer`] back to the pool. See [`recycle()`](BufferPool::recycle).
+    pub fn recycle_buffer(&self, buffer: Buffer) {
+        self.recycle(buffer.into_vec());
+    }
+
+    /// The amount of times this pool had to allocate a new buffer.
+    #[must_use]
+    pub fn allocations(&self) -> usize {
+        self.inner.allocations.load(Ordering::Relaxed)
+    }
+
+    /// The amount of free buffers currently in the pool.
+    #[must_use]
+    pub fn available(&self) -> usize {
+        match self.inner.free.lock() {
+            Ok(free) => free.len(),
+            Err(poisoned) => poisoned.into_inner().len(),
+        }
+    }
+
+    /// The maximum amount of free buffers this pool will hold on to.
+    #[must_use]
+    pub fn capacity(&self) -> usize {
+        self.inner.capacity
+    }
+}
+
+impl Default for BufferPool {
+    fn default() -> Self {
+        BufferPool::new(DEFAULT_POOL_CAPACITY)
+    }
+}
@@ -108,7 +108,7 @@ pub fn query_devices(api: CaptureAPIBackend) -> Result<Vec<CameraInfo>, NokhwaEr
         CaptureAPIBackend::UniversalVideoClass => query_uvc(),
         CaptureAPIBackend::MediaFoundation => query_msmf(),
         CaptureAPIBackend::GStreamer => query_gstreamer(),
-        CaptureAPIBackend::OpenCv | CaptureAPIBackend::Network => {
+        CaptureAPIBackend::OpenCv | CaptureAPIBackend::Network | CaptureAPIBackend::Replay => {
             Err(NokhwaError::UnsupportedOperationError(api))
         }
         CaptureAPIBackend::Browser => query_wasm(),
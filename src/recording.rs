@@ -0,0 +1,390 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! An append-only container for raw frames, written by [`FrameRecorder`] and replayed by
+//! [`ReplayCaptureDevice`](crate::backends::capture::ReplayCaptureDevice).
+//!
+//! # Layout
+//! All integers are little endian. The file starts with a 64 byte header:
+//! - `0..8`: The magic, `NOKHWARC`.
+//! - `8..12`: The version of the layout, currently `1`.
+//! - `12..16`: The [`FrameFormat`] of the frames, as its fourcc (`MJPG`, `YUYV`, `GREY`, `NV12` or `I420`).
+//! - `16..28`: The width, height and frame rate of the [`CameraFormat`] the frames were captured at.
+//!
+//! Every frame is a 64 byte record header followed by the frame's data, padded to a multiple of 64 bytes so the
+//! data of every frame is 64 byte aligned once the file is memory mapped:
+//! - `0..4`: The magic, `FRME`.
+//! - `4..12`: The width and height of the frame.
+//! - `12..24`: The stride of each of the (up to 3) planes of the frame, `0` for compressed frames.
+//! - `24..32`: The length of the data.
+//! - `32..40`: The sequence number nokhwa gave the frame (see [`Buffer::sequence()`]).
+//! - `40..64`: The [`FrameMetadata`]: the driver's sequence number, the dropped frames, and the timestamp in nanoseconds (`u64::MAX` if there is none).
+//!
+//! A recording that was cut off (e.g. the process was killed while recording) ends at its last complete frame.
+
+use crate::{
+    Buffer, CameraFormat, FrameFormat, FrameMetadata, FrameRef, FrameState, NokhwaError, Resolution,
+};
+use memmap2::Mmap;
+use std::{
+    fs::{File, OpenOptions},
+    io::{ErrorKind, Seek, SeekFrom, Write},
+    path::Path,
+    time::Duration,
+};
+
+const MAGIC: &[u8; 8] = b"NOKHWARC";
+const VERSION: u32 = 1;
+const RECORD_MAGIC: &[u8; 4] = b"FRME";
+const HEADER_SIZE: usize = 64;
+const ALIGNMENT: usize = 64;
+const NO_TIMESTAMP: u64 = u64::MAX;
+
+fn format_code(format: FrameFormat) -> [u8; 4] {
+    match format {
+        FrameFormat::MJPEG => *b"MJPG",
+        FrameFormat::YUYV => *b"YUYV",
+        FrameFormat::GRAY8 => *b"GREY",
+        FrameFormat::NV12 => *b"NV12",
+        FrameFormat::I420 => *b"I420",
+    }
+}
+
+fn format_from_code(code: [u8; 4]) -> Option<FrameFormat> {
+    match &code {
+        b"MJPG" => Some(FrameFormat::MJPEG),
+        b"YUYV" => Some(FrameFormat::YUYV),
+        b"GREY" => Some(FrameFormat::GRAY8),
+        b"NV12" => Some(FrameFormat::NV12),
+        b"I420" => Some(FrameFormat::I420),
+        _ => None,
+    }
+}
+
+fn padded(len: usize) -> usize {
+    (len + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT
+}
+
+fn read_u32(data: &[u8], at: usize) -> u32 {
+    let mut bytes = [0; 4];
+    bytes.copy_from_slice(&data[at..at + 4]);
+    u32::from_le_bytes(bytes)
+}
+
+fn read_u64(data: &[u8], at: usize) -> u64 {
+    let mut bytes = [0; 8];
+    bytes.copy_from_slice(&data[at..at + 8]);
+    u64::from_le_bytes(bytes)
+}
+
+fn io_error(path: &Path, why: &std::io::Error) -> NokhwaError {
+    NokhwaError::OpenDeviceError(path.display().to_string(), why.to_string())
+}
+
+/// Where a frame is in a recording, and what was recorded about it.
+#[derive(Copy, Clone, Debug, Default, Hash, PartialEq, Eq)]
+pub(crate) struct RecordEntry {
+    pub(crate) offset: usize,
+    pub(crate) len: usize,
+    pub(crate) resolution: Resolution,
+    pub(crate) strides: [u32; 3],
+    pub(crate) sequence: u64,
+    pub(crate) metadata: FrameMetadata,
+}
+
+impl RecordEntry {
+    pub(crate) fn data<'a>(&self, recording: &'a [u8]) -> &'a [u8] {
+        &recording[self.offset..self.offset + self.len]
+    }
+}
+
+fn parse_header(data: &[u8]) -> Result<CameraFormat, NokhwaError> {
+    let bad_header = |error: &str| NokhwaError::StructureError {
+        structure: "Recording Header".to_string(),
+        error: error.to_string(),
+    };
+    if data.len() < HEADER_SIZE || &data[..8] != MAGIC {
+        return Err(bad_header("Not a nokhwa recording"));
+    }
+    let version = read_u32(data, 8);
+    if version != VERSION {
+        return Err(bad_header(&format!("Unsupported version {version}")));
+    }
+    let mut code = [0; 4];
+    code.copy_from_slice(&data[12..16]);
+    let format = format_from_code(code).ok_or_else(|| bad_header("Unknown frame format"))?;
+    Ok(CameraFormat::new(
+        Resolution::new(read_u32(data, 16), read_u32(data, 20)),
+        format,
+        read_u32(data, 24),
+    ))
+}
+
+/// Reads the header and the index of every complete frame of a recording. This only touches the record headers, not the frame data.
+pub(crate) fn read_index(data: &[u8]) -> Result<(CameraFormat, Vec<RecordEntry>), NokhwaError> {
+    let camera_format = parse_header(data)?;
+    let mut entries = Vec::new();
+    let mut offset = HEADER_SIZE;
+    while offset + HEADER_SIZE <= data.len() {
+        let record = &data[offset..offset + HEADER_SIZE];
+        if &record[..4] != RECORD_MAGIC {
+            break;
+        }
+        let len = usize::try_from(read_u64(record, 24)).unwrap_or(usize::MAX);
+        let start = offset + HEADER_SIZE;
+        // cut off while it was being written
+        if len > data.len() - start {
+            break;
+        }
+        let timestamp = match read_u64(record, 56) {
+            NO_TIMESTAMP => None,
+            nanos => Some(Duration::from_nanos(nanos)),
+        };
+        entries.push(RecordEntry {
+            offset: start,
+            len,
+            resolution: Resolution::new(read_u32(record, 4), read_u32(record, 8)),
+            strides: [
+                read_u32(record, 12),
+                read_u32(record, 16),
+                read_u32(record, 20),
+            ],
+            sequence: read_u64(record, 32),
+            metadata: FrameMetadata::new(timestamp, read_u64(record, 40), read_u64(record, 48)),
+        });
+        offset = start + padded(len);
+    }
+    Ok((camera_format, entries))
+}
+
+/// Memory maps the recording at `path`.
+pub(crate) fn map_recording(path: &Path) -> Result<Mmap, NokhwaError> {
+    let file = File::open(path).map_err(|why| io_error(path, &why))?;
+    // SAFETY: the frames of a recording are never changed in place: `FrameRecorder::create()` replaces the file with a new one (the
+    // mapping keeps the old one), and `FrameRecorder::append()` only cuts off a frame that was never in the index, then appends.
+    // Truncating it some other way while it is mapped is UB, like with any memory mapped file.
+    unsafe { Mmap::map(&file) }.map_err(|why| io_error(path, &why))
+}
+
+/// Records raw frames (as they came out of the backend, e.g. from [`Camera::frame_ref()`](crate::Camera::frame_ref)) into an append-only file,
+/// along with their [`CameraFormat`], sequence numbers and [`FrameMetadata`]. See the [module level documentation](crate::recording) for the layout.
+///
+/// Replay it with [`Camera::from_recording()`](crate::Camera::from_recording), which hands out the recorded frames straight from the memory mapped file.
+///
+/// Frames are written straight into the file, without being buffered. Call [`flush()`](FrameRecorder::flush) to make sure they are on disk.
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "recording")))]
+pub struct FrameRecorder {
+    file: File,
+    camera_format: CameraFormat,
+    frames: usize,
+}
+
+// a recording holds frames as the camera gave them, a decoded frame could not be told apart from them when replayed
+fn check_raw(format: FrameFormat, state: FrameState) -> Result<(), NokhwaError> {
+    if state.is_decoded() {
+        return Err(NokhwaError::ProcessFrameError {
+            src: format,
+            destination: "Recording".to_string(),
+            error: "Assertion failure, only raw frames can be recorded!".to_string(),
+        });
+    }
+    Ok(())
+}
+
+impl FrameRecorder {
+    /// Creates a new recording of frames in `camera_format` at `path`, replacing any file that is already there.
+    ///
+    /// The old file is removed and a new one created, instead of truncating it, so a [`ReplayCaptureDevice`](crate::backends::capture::ReplayCaptureDevice)
+    /// that still has the old recording mapped keeps reading it.
+    /// # Errors
+    /// If the file cannot be created or written to, this will error.
+    pub fn create(
+        path: impl AsRef<Path>,
+        camera_format: CameraFormat,
+    ) -> Result<Self, NokhwaError> {
+        let path = path.as_ref();
+        // on windows, this fails while the old recording is mapped, which is what we want
+        match std::fs::remove_file(path) {
+            Ok(()) => {}
+            Err(why) if why.kind() == ErrorKind::NotFound => {}
+            Err(why) => return Err(io_error(path, &why)),
+        }
+        let mut file = OpenOptions::new()
+            .write(true)
+            .create_new(true)
+            .open(path)
+            .map_err(|why| io_error(path, &why))?;
+
+        let mut header = [0_u8; HEADER_SIZE];
+        header[..8].copy_from_slice(MAGIC);
+        header[8..12].copy_from_slice(&VERSION.to_le_bytes());
+        header[12..16].copy_from_slice(&format_code(camera_format.format()));
+        header[16..20].copy_from_slice(&camera_format.width().to_le_bytes());
+        header[20..24].copy_from_slice(&camera_format.height().to_le_bytes());
+        header[24..28].copy_from_slice(&camera_format.frame_rate().to_le_bytes());
+        file.write_all(&header)
+            .map_err(|why| io_error(path, &why))?;
+
+        Ok(FrameRecorder {
+            file,
+            camera_format,
+            frames: 0,
+        })
+    }
+
+    /// Opens the recording at `path` to add more frames to it. A frame that was cut off at the end of the recording is dropped.
+    /// # Errors
+    /// If the file cannot be opened or is not a recording, this will error.
+    pub fn append(path: impl AsRef<Path>) -> Result<Self, NokhwaError> {
+        let path = path.as_ref();
+        let (camera_format, frames, end) = {
+            let map = map_recording(path)?;
+            let (camera_format, entries) = read_index(&map)?;
+            let end = entries
+                .last()
+                .map_or(HEADER_SIZE, |entry| entry.offset + padded(entry.len));
+            (camera_format, entries.len(), end)
+        };
+
+        let mut file = OpenOptions::new()
+            .write(true)
+            .open(path)
+            .map_err(|why| io_error(path, &why))?;
+        file.set_len(end as u64)
+            .and_then(|_| file.seek(SeekFrom::End(0)))
+            .map_err(|why| io_error(path, &why))?;
+
+        Ok(FrameRecorder {
+            file,
+            camera_format,
+            frames,
+        })
+    }
+
+    /// The [`CameraFormat`] of the recording.
+    #[must_use]
+    pub fn camera_format(&self) -> CameraFormat {
+        self.camera_format
+    }
+
+    /// The amount of frames in the recording.
+    #[must_use]
+    pub fn frames(&self) -> usize {
+        self.frames
+    }
+
+    /// Appends `buffer`, which must be a raw frame (e.g. from [`Camera::frame_pooled()`](crate::Camera::frame_pooled)) in the [`FrameFormat`] of the recording.
+    /// The strides of its planes are kept.
+    /// # Errors
+    /// If the frame is in the wrong format, already decoded (see [`Buffer::state()`]) or writing fails, this will error.
+    pub fn record(&mut self, buffer: &Buffer) -> Result<(), NokhwaError> {
+        check_raw(buffer.source_frame_format(), buffer.state())?;
+        let mut strides = [0; 3];
+        if buffer.source_frame_format() != FrameFormat::MJPEG {
+            for (stride, plane) in strides.iter_mut().zip(buffer.planes()) {
+                *stride = plane.stride();
+            }
+        }
+        self.write_frame(
+            buffer.source_frame_format(),
+            buffer.resolution(),
+            strides,
+            buffer.buffer(),
+            buffer.sequence(),
+            buffer.metadata(),
+        )
+    }
+
+    /// Appends `frame` (e.g. from [`Camera::frame_ref()`](crate::Camera::frame_ref)), giving it the sequence number `sequence`.
+    /// The strides of its planes are kept.
+    /// # Errors
+    /// If the frame is in the wrong format, already decoded (see [`FrameRef::state()`]) or writing fails, this will error.
+    pub fn record_frame(&mut self, frame: &FrameRef, sequence: u64) -> Result<(), NokhwaError> {
+        check_raw(frame.source_frame_format(), frame.state())?;
+        let mut strides = [0; 3];
+        if frame.source_frame_format() != FrameFormat::MJPEG {
+            for (stride, plane) in strides.iter_mut().zip(frame.planes()) {
+                *stride = plane.stride();
+            }
+        }
+        self.write_frame(
+            frame.source_frame_format(),
+            frame.resolution(),
+            strides,
+            frame.buffer(),
+            sequence,
+            frame.metadata(),
+        )
+    }
+
+    /// Flushes the recording to disk.
+    /// # Errors
+    /// If the recording fails to be written, this will error.
+    pub fn flush(&mut self) -> Result<(), NokhwaError> {
+        self.file
+            .sync_data()
+            .map_err(|why| NokhwaError::GeneralError(why.to_string()))
+    }
+
+    #[allow(clippy::cast_possible_truncation)]
+    fn write_frame(
+        &mut self,
+        format: FrameFormat,
+        resolution: Resolution,
+        strides: [usize; 3],
+        data: &[u8],
+        sequence: u64,
+        metadata: FrameMetadata,
+    ) -> Result<(), NokhwaError> {
+        if format != self.camera_format.format() {
+            return Err(NokhwaError::ProcessFrameError {
+                src: format,
+                destination: "Recording".to_string(),
+                error: format!(
+                    "Assertion failure, the recording is of {} frames!",
+                    self.camera_format.format()
+                ),
+            });
+        }
+
+        let mut header = [0_u8; HEADER_SIZE];
+        header[..4].copy_from_slice(RECORD_MAGIC);
+        header[4..8].copy_from_slice(&resolution.width().to_le_bytes());
+        header[8..12].copy_from_slice(&resolution.height().to_le_bytes());
+        for (idx, stride) in strides.iter().enumerate() {
+            let at = 12 + idx * 4;
+            header[at..at + 4].copy_from_slice(&(*stride as u32).to_le_bytes());
+        }
+        header[24..32].copy_from_slice(&(data.len() as u64).to_le_bytes());
+        header[32..40].copy_from_slice(&sequence.to_le_bytes());
+        header[40..48].copy_from_slice(&metadata.driver_sequence().to_le_bytes());
+        header[48..56].copy_from_slice(&metadata.dropped_frames().to_le_bytes());
+        let timestamp = metadata.timestamp().map_or(NO_TIMESTAMP, |timestamp| {
+            u64::try_from(timestamp.as_nanos()).unwrap_or(NO_TIMESTAMP - 1)
+        });
+        header[56..64].copy_from_slice(&timestamp.to_le_bytes());
+
+        let padding = [0_u8; ALIGNMENT];
+        let write_error = |why: std::io::Error| NokhwaError::GeneralError(why.to_string());
+        self.file.write_all(&header).map_err(write_error)?;
+        self.file.write_all(data).map_err(write_error)?;
+        self.file
+            .write_all(&padding[..padded(data.len()) - data.len()])
+            .map_err(write_error)?;
+        self.frames += 1;
+        Ok(())
+    }
+}
@@ -0,0 +1,316 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+use crate::{
+    buf_yuyv422_to_rgb,
+    buffer::{FrameState, Plane},
+    decoder::with_shared_decoder,
+    metrics::{self, Stage},
+    utils::plane_data,
+    yuyv444_to_rgb, yuyv444_to_rgba, FrameFormat, NokhwaError, Resolution,
+};
+#[cfg(feature = "serde")]
+use serde::{Deserialize, Serialize};
+
+/// A rectangle of a frame, in pixels of the frame. The origin is the top left corner.
+///
+/// Used by [`Buffer::write_region_to_buffer()`](crate::Buffer::write_region_to_buffer) to convert only the part of a frame
+/// that is needed (e.g. what a detector looks at), optionally downscaled.
+#[derive(Copy, Clone, Debug, Default, Hash, PartialEq, Eq, PartialOrd, Ord)]
+#[cfg_attr(feature = "serde", derive(Serialize, Deserialize))]
+pub struct Region {
+    x: u32,
+    y: u32,
+    width: u32,
+    height: u32,
+}
+
+impl Region {
+    /// Creates a new [`Region`] of `width` by `height` pixels, whose top left corner is at `x`, `y`.
+    #[must_use]
+    pub fn new(x: u32, y: u32, width: u32, height: u32) -> Self {
+        Region {
+            x,
+            y,
+            width,
+            height,
+        }
+    }
+
+    /// A [`Region`] covering an entire frame of `resolution`.
+    #[must_use]
+    pub fn full(resolution: Resolution) -> Self {
+        Region::new(0, 0, resolution.width(), resolution.height())
+    }
+
+    /// The column of the left edge of the region.
+    #[must_use]
+    pub fn x(self) -> u32 {
+        self.x
+    }
+
+    /// The row of the top edge of the region.
+    #[must_use]
+    pub fn y(self) -> u32 {
+        self.y
+    }
+
+    /// The width of the region.
+    #[must_use]
+    pub fn width(self) -> u32 {
+        self.width
+    }
+
+    /// The height of the region.
+    #[must_use]
+    pub fn height(self) -> u32 {
+        self.height
+    }
+
+    /// The size of the region.
+    #[must_use]
+    pub fn resolution(self) -> Resolution {
+        Resolution::new(self.width, self.height)
+    }
+
+    /// Checks if the region is not empty and lies entirely within a frame of `resolution`.
+    #[must_use]
+    pub fn fits(self, resolution: Resolution) -> bool {
+        self.width != 0
+            && self.height != 0
+            && u64::from(self.x) + u64::from(self.width) <= u64::from(resolution.width())
+            && u64::from(self.y) + u64::from(self.height) <= u64::from(resolution.height())
+    }
+
+    /// The resolution of the region once only every `downscale`th pixel of every `downscale`th row is kept. This rounds up.
+    #[must_use]
+    pub fn scaled_resolution(self, downscale: u32) -> Resolution {
+        let downscale = downscale.max(1);
+        Resolution::new(
+            (self.width + downscale - 1) / downscale,
+            (self.height + downscale - 1) / downscale,
+        )
+    }
+
+    /// The size in bytes of the region converted to RGB888 (or RGBA if `rgba` is true) at `downscale`.
+    #[must_use]
+    pub fn output_size(self, downscale: u32, rgba: bool) -> usize {
+        let resolution = self.scaled_resolution(downscale);
+        let pixel_size = if rgba { 4 } else { 3 };
+        resolution.width() as usize * resolution.height() as usize * pixel_size
+    }
+}
+
+pub(crate) fn check_region(
+    format: FrameFormat,
+    resolution: Resolution,
+    region: Region,
+    downscale: u32,
+    dest: &[u8],
+    rgba: bool,
+) -> Result<(), NokhwaError> {
+    let destination = if rgba { "RGBA8888" } else { "RGB888" };
+    if downscale == 0 {
+        return Err(NokhwaError::ProcessFrameError {
+            src: format,
+            destination: destination.to_string(),
+            error: "Assertion failure, the downscale factor is 0!".to_string(),
+        });
+    }
+    if !region.fits(resolution) {
+        return Err(NokhwaError::ProcessFrameError {
+            src: format,
+            destination: destination.to_string(),
+            error: format!(
+                "Assertion failure, the region {region:?} does not fit in a {resolution} frame!"
+            ),
+        });
+    }
+    let output_size = region.output_size(downscale, rgba);
+    if dest.len() != output_size {
+        return Err(NokhwaError::ProcessFrameError {
+            src: format,
+            destination: destination.to_string(),
+            error: format!("Assertion failure, the destination RGB buffer is of the wrong size! [expected: {output_size}, actual: {}]", dest.len()),
+        });
+    }
+    Ok(())
+}
+
+#[inline]
+fn write_pixel(pixel: &mut [u8], y: u8, u: u8, v: u8, rgba: bool) {
+    let (y, u, v) = (i32::from(y), i32::from(u), i32::from(v));
+    if rgba {
+        pixel.copy_from_slice(&yuyv444_to_rgba(y, u, v));
+    } else {
+        pixel.copy_from_slice(&yuyv444_to_rgb(y, u, v));
+    }
+}
+
+// calls `sample` with the source row and column of every pixel of `dest`, so only the rows and columns that are kept are ever read.
+#[inline]
+fn sample_region(
+    region: Region,
+    downscale: u32,
+    dest: &mut [u8],
+    rgba: bool,
+    mut sample: impl FnMut(usize, usize, &mut [u8]),
+) {
+    let output = region.scaled_resolution(downscale);
+    let pixel_size = if rgba { 4 } else { 3 };
+    let (x, y, step) = (region.x as usize, region.y as usize, downscale as usize);
+    for (out_row, dest_row) in dest
+        .chunks_exact_mut(output.width() as usize * pixel_size)
+        .enumerate()
+    {
+        let row = y + out_row * step;
+        for (out_col, pixel) in dest_row.chunks_exact_mut(pixel_size).enumerate() {
+            sample(row, x + out_col * step, pixel);
+        }
+    }
+}
+
+/// Converts `region` of `data`, a frame of `resolution` in `format` laid out in `planes`, into `dest`, keeping every
+/// `downscale`th pixel of every `downscale`th row.
+#[allow(clippy::too_many_arguments)]
+pub(crate) fn write_region(
+    format: FrameFormat,
+    resolution: Resolution,
+    data: &[u8],
+    planes: &[Plane],
+    region: Region,
+    downscale: u32,
+    dest: &mut [u8],
+    rgba: bool,
+) -> Result<Resolution, NokhwaError> {
+    // the decoder checks the region against the size in the JPEG header instead
+    if format != FrameFormat::MJPEG {
+        check_region(format, resolution, region, downscale, dest, rgba)?;
+    }
+    let width = resolution.width() as usize;
+    let height = resolution.height() as usize;
+    let chroma_width = (width + 1) / 2;
+    let chroma_height = (height + 1) / 2;
+
+    let _timer = metrics::time(Stage::Decode);
+    match format {
+        FrameFormat::MJPEG => {
+            return with_shared_decoder(rgba, |decoder| {
+                decoder.decode_region_into(data, region, downscale, dest)
+            });
+        }
+        FrameFormat::YUYV => {
+            let (luma, stride) = plane_data(format, data, planes, 0, chroma_width * 4, height)?;
+            if downscale == 1 && region.x % 2 == 0 && region.width % 2 == 0 {
+                // whole macropixels, so every row can go through the vectorized converter
+                let row_size = region.width as usize * if rgba { 4 } else { 3 };
+                let start = region.x as usize * 2;
+                for (row, dest_row) in dest.chunks_exact_mut(row_size).enumerate() {
+                    let offset = (region.y as usize + row) * stride + start;
+                    buf_yuyv422_to_rgb(
+                        &luma[offset..offset + region.width as usize * 2],
+                        dest_row,
+                        rgba,
+                    )?;
+                }
+            } else {
+                sample_region(region, downscale, dest, rgba, |row, col, pixel| {
+                    let macropixel = &luma[row * stride + (col / 2) * 4..][..4];
+                    write_pixel(
+                        pixel,
+                        macropixel[(col % 2) * 2],
+                        macropixel[1],
+                        macropixel[3],
+                        rgba,
+                    );
+                });
+            }
+        }
+        FrameFormat::NV12 => {
+            let (luma, luma_stride) = plane_data(format, data, planes, 0, width, height)?;
+            let (chroma, chroma_stride) =
+                plane_data(format, data, planes, 1, chroma_width * 2, chroma_height)?;
+            sample_region(region, downscale, dest, rgba, |row, col, pixel| {
+                let idx = (row / 2) * chroma_stride + (col / 2) * 2;
+                write_pixel(
+                    pixel,
+                    luma[row * luma_stride + col],
+                    chroma[idx],
+                    chroma[idx + 1],
+                    rgba,
+                );
+            });
+        }
+        FrameFormat::I420 => {
+            let (luma, luma_stride) = plane_data(format, data, planes, 0, width, height)?;
+            let (u_plane, u_stride) =
+                plane_data(format, data, planes, 1, chroma_width, chroma_height)?;
+            let (v_plane, v_stride) =
+                plane_data(format, data, planes, 2, chroma_width, chroma_height)?;
+            sample_region(region, downscale, dest, rgba, |row, col, pixel| {
+                let (u, v) = (
+                    u_plane[(row / 2) * u_stride + col / 2],
+                    v_plane[(row / 2) * v_stride + col / 2],
+                );
+                write_pixel(pixel, luma[row * luma_stride + col], u, v, rgba);
+            });
+        }
+        FrameFormat::GRAY8 => {
+            let (luma, stride) = plane_data(format, data, planes, 0, width, height)?;
+            sample_region(region, downscale, dest, rgba, |row, col, pixel| {
+                pixel.fill(luma[row * stride + col]);
+                if rgba {
+                    pixel[3] = u8::MAX;
+                }
+            });
+        }
+    }
+    Ok(region.scaled_resolution(downscale))
+}
+
+/// Crops and scales `region` of `data`, a frame of `resolution` that was already decoded to RGB888 or RGBA (see [`FrameState`]),
+/// into `dest`, keeping every `downscale`th pixel of every `downscale`th row.
+#[allow(clippy::too_many_arguments)]
+pub(crate) fn write_decoded_region(
+    format: FrameFormat,
+    state: FrameState,
+    resolution: Resolution,
+    data: &[u8],
+    region: Region,
+    downscale: u32,
+    dest: &mut [u8],
+    rgba: bool,
+) -> Result<Resolution, NokhwaError> {
+    check_region(format, resolution, region, downscale, dest, rgba)?;
+    let pixel_size = state.pixel_size().unwrap_or(3);
+    let stride = resolution.width() as usize * pixel_size;
+    if data.len() < stride * resolution.height() as usize {
+        return Err(NokhwaError::ProcessFrameError {
+            src: format,
+            destination: if rgba { "RGBA8888" } else { "RGB888" }.to_string(),
+            error: format!("Assertion failure, the decoded frame is of the wrong size! [expected: {}, actual: {}]", stride * resolution.height() as usize, data.len()),
+        });
+    }
+
+    sample_region(region, downscale, dest, rgba, |row, col, pixel| {
+        let source = &data[row * stride + col * pixel_size..][..pixel_size];
+        pixel[..3].copy_from_slice(&source[..3]);
+        if rgba {
+            pixel[3] = source.get(3).copied().unwrap_or(u8::MAX);
+        }
+    });
+    Ok(region.scaled_resolution(downscale))
+}
@@ -0,0 +1,408 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+use crate::{
+    camera::figure_out_auto, query_devices, Camera, CameraFormat, CameraInfo, CapabilityCache,
+    CaptureAPIBackend, NokhwaError,
+};
+use std::{
+    collections::HashMap,
+    sync::{
+        atomic::{AtomicBool, Ordering},
+        mpsc::{channel, Receiver, Sender},
+        Arc, Mutex, MutexGuard, Weak,
+    },
+};
+
+/// A change to the devices of a [`DeviceRegistry`], see [`DeviceRegistry::subscribe()`].
+#[derive(Clone, Debug, PartialEq)]
+pub enum DeviceEvent {
+    /// The platform said a device was connected or disconnected. The registry forgot its devices, call [`DeviceRegistry::devices()`] to find out what changed.
+    Changed,
+    /// A device showed up when the registry enumerated the devices.
+    Connected(CameraInfo),
+    /// A device was gone when the registry enumerated the devices. Its cached formats are forgotten.
+    Disconnected(CameraInfo),
+}
+
+// `CameraInfo` is not `Eq`, so the cache is keyed by everything that identifies a device instead
+type DeviceKey = (u32, String, String);
+
+fn device_key(info: &CameraInfo) -> DeviceKey {
+    (info.index(), info.human_name(), info.misc())
+}
+
+fn lock<T>(mutex: &Mutex<T>) -> MutexGuard<'_, T> {
+    match mutex.lock() {
+        Ok(guard) => guard,
+        Err(poisoned) => poisoned.into_inner(),
+    }
+}
+
+struct RegistryInner {
+    api: CaptureAPIBackend,
+    devices: Mutex<Vec<CameraInfo>>,
+    // if `devices` is outdated (or was never enumerated)
+    stale: AtomicBool,
+    formats: Mutex<HashMap<DeviceKey, Vec<CameraFormat>>>,
+    subscribers: Mutex<Vec<Sender<DeviceEvent>>>,
+}
+
+impl RegistryInner {
+    fn invalidate(&self) {
+        self.stale.store(true, Ordering::Release);
+        self.notify(&DeviceEvent::Changed);
+    }
+
+    fn notify(&self, event: &DeviceEvent) {
+        // subscribers that went away are dropped
+        lock(&self.subscribers).retain(|subscriber| subscriber.send(event.clone()).is_ok());
+    }
+}
+
+/// A cache of the devices of a backend and their compatible [`CameraFormat`]s, kept up to date by the platform's hotplug notifications.
+///
+/// Enumerating devices, and especially querying every format of a device (which opens it and asks the driver about every fourcc and resolution),
+/// can take hundreds of milliseconds. The registry only does it once, and again once the platform says a device was connected or disconnected:
+/// - `V4L2`: `inotify` on `/dev`, which `udev` creates and removes the `video*` nodes in.
+/// - `MSMF`: `CM_Register_Notification` for the video camera device interface class.
+/// - `AVFoundation`: `AVCaptureDeviceWasConnectedNotification`/`AVCaptureDeviceWasDisconnectedNotification`.
+///
+/// For other backends (see [`has_hotplug()`](DeviceRegistry::has_hotplug)), call [`refresh()`](DeviceRegistry::refresh) yourself.
+///
+/// Use [`subscribe()`](DeviceRegistry::subscribe) to hear about changes instead of polling.
+pub struct DeviceRegistry {
+    inner: Arc<RegistryInner>,
+    hotplug: Option<HotplugSource>,
+}
+
+impl DeviceRegistry {
+    /// Creates a new [`DeviceRegistry`] for the devices of `api`, starting to listen for hotplug notifications if the backend has them.
+    /// Nothing is enumerated until it is asked for.
+    #[must_use]
+    pub fn new(api: CaptureAPIBackend) -> Self {
+        let api = match api {
+            CaptureAPIBackend::Auto => figure_out_auto().unwrap_or(CaptureAPIBackend::Auto),
+            api => api,
+        };
+        let inner = Arc::new(RegistryInner {
+            api,
+            devices: Mutex::new(Vec::new()),
+            stale: AtomicBool::new(true),
+            formats: Mutex::new(HashMap::new()),
+            subscribers: Mutex::new(Vec::new()),
+        });
+
+        let weak = Arc::downgrade(&inner);
+        let hotplug = HotplugSource::new(api, move || {
+            if let Some(inner) = Weak::upgrade(&weak) {
+                inner.invalidate();
+            }
+        });
+
+        DeviceRegistry { inner, hotplug }
+    }
+
+    /// The backend whose devices this registry holds.
+    #[must_use]
+    pub fn api(&self) -> CaptureAPIBackend {
+        self.inner.api
+    }
+
+    /// Checks if the registry gets the platform's hotplug notifications. If not, it only enumerates again on [`refresh()`](DeviceRegistry::refresh).
+    #[must_use]
+    pub fn has_hotplug(&self) -> bool {
+        self.hotplug.is_some()
+    }
+
+    /// The devices of the backend, see [`query_devices()`]. They are only enumerated again after a device was connected or disconnected.
+    /// # Errors
+    /// If the devices have to be enumerated and that fails, this will error.
+    pub fn devices(&self) -> Result<Vec<CameraInfo>, NokhwaError> {
+        if self.inner.stale.load(Ordering::Acquire) {
+            self.refresh()?;
+        }
+        Ok(lock(&self.inner.devices).clone())
+    }
+
+    /// Enumerates the devices again, sending a [`DeviceEvent::Connected`] or [`DeviceEvent::Disconnected`] for every device that changed.
+    /// # Errors
+    /// If enumerating the devices fails, this will error.
+    pub fn refresh(&self) -> Result<(), NokhwaError> {
+        // a notification coming in while this enumerates makes it stale again
+        self.inner.stale.store(false, Ordering::Release);
+        let devices = match query_devices(self.inner.api) {
+            Ok(devices) => devices,
+            Err(why) => {
+                self.inner.stale.store(true, Ordering::Release);
+                return Err(why);
+            }
+        };
+
+        let mut events = Vec::new();
+        {
+            let mut cached = lock(&self.inner.devices);
+            let mut formats = lock(&self.inner.formats);
+            for gone in cached.iter().filter(|old| !devices.contains(*old)) {
+                formats.remove(&device_key(gone));
+                events.push(DeviceEvent::Disconnected(gone.clone()));
+            }
+            for new in devices.iter().filter(|new| !cached.contains(*new)) {
+                events.push(DeviceEvent::Connected(new.clone()));
+            }
+            *cached = devices;
+        }
+        for event in &events {
+            self.inner.notify(event);
+        }
+        Ok(())
+    }
+
+    /// Forgets the devices and all cached formats, so they are enumerated again the next time they are asked for.
+    pub fn invalidate(&self) {
+        lock(&self.inner.formats).clear();
+        self.inner.invalidate();
+    }
+
+    /// The compatible [`CameraFormat`]s of the device `info`, see [`Camera::compatible_camera_formats()`].
+    /// The first time, this opens the device to query them.
+    /// # Errors
+    /// If the device fails to open or to query its formats, this will error.
+    pub fn compatible_camera_formats(
+        &self,
+        info: &CameraInfo,
+    ) -> Result<Vec<CameraFormat>, NokhwaError> {
+        if let Some(formats) = lock(&self.inner.formats).get(&device_key(info)) {
+            return Ok(formats.clone());
+        }
+        let mut camera = Camera::with_backend(info.index() as usize, None, self.inner.api)?;
+        self.query_formats(info, &mut camera)
+    }
+
+    /// The compatible [`CameraFormat`]s of an already opened `camera`, see [`compatible_camera_formats()`](DeviceRegistry::compatible_camera_formats).
+    /// # Errors
+    /// If the camera fails to query its formats, this will error.
+    pub fn compatible_camera_formats_of(
+        &self,
+        camera: &mut Camera,
+    ) -> Result<Vec<CameraFormat>, NokhwaError> {
+        let info = camera.info().clone();
+        if let Some(formats) = lock(&self.inner.formats).get(&device_key(&info)) {
+            return Ok(formats.clone());
+        }
+        self.query_formats(&info, camera)
+    }
+
+    /// Fills the format cache of the registry with the formats `cache` has for the devices of this registry's backend,
+    /// so [`compatible_camera_formats()`](DeviceRegistry::compatible_camera_formats) does not query them from the driver.
+    /// Formats the registry already has are kept.
+    pub fn preload(&self, cache: &CapabilityCache) {
+        let mut formats = lock(&self.inner.formats);
+        for device in cache.devices() {
+            let identity = device.identity();
+            if identity.backend() != self.inner.api || device.formats().is_empty() {
+                continue;
+            }
+            formats
+                .entry((
+                    identity.index(),
+                    identity.human_name().to_string(),
+                    identity.misc().to_string(),
+                ))
+                .or_insert_with(|| device.formats().to_vec());
+        }
+    }
+
+    /// Subscribes to the changes to the devices, see [`DeviceEvent`]. Dropping the [`Receiver`] unsubscribes.
+    #[must_use]
+    pub fn subscribe(&self) -> Receiver<DeviceEvent> {
+        let (sender, receiver) = channel();
+        lock(&self.inner.subscribers).push(sender);
+        receiver
+    }
+
+    fn query_formats(
+        &self,
+        info: &CameraInfo,
+        camera: &mut Camera,
+    ) -> Result<Vec<CameraFormat>, NokhwaError> {
+        let formats = camera.compatible_camera_formats()?;
+        lock(&self.inner.formats).insert(device_key(info), formats.clone());
+        Ok(formats)
+    }
+}
+
+// What tells a `DeviceRegistry` that a device was connected or disconnected. Stops listening once dropped,
+// which is all the value is there for.
+#[allow(dead_code)]
+enum HotplugSource {
+    #[cfg(all(feature = "input-v4l", target_os = "linux"))]
+    Inotify(inotify::DevWatcher),
+    #[cfg(all(feature = "input-msmf", target_os = "windows"))]
+    MediaFoundation(nokhwa_bindings_windows::wmf::DeviceNotification),
+    #[cfg(all(
+        feature = "input-avfoundation",
+        any(target_os = "macos", target_os = "ios")
+    ))]
+    AVFoundation(nokhwa_bindings_macos::avfoundation::AVCaptureDeviceObserver),
+}
+
+impl HotplugSource {
+    #[allow(unused_variables)]
+    fn new(
+        api: CaptureAPIBackend,
+        on_change: impl Fn() + Send + Sync + 'static,
+    ) -> Option<HotplugSource> {
+        match api {
+            #[cfg(all(feature = "input-v4l", target_os = "linux"))]
+            CaptureAPIBackend::Video4Linux => inotify::DevWatcher::new(Box::new(on_change))
+                .ok()
+                .map(HotplugSource::Inotify),
+            #[cfg(all(feature = "input-msmf", target_os = "windows"))]
+            CaptureAPIBackend::MediaFoundation => {
+                nokhwa_bindings_windows::wmf::DeviceNotification::register(Box::new(on_change))
+                    .ok()
+                    .map(HotplugSource::MediaFoundation)
+            }
+            #[cfg(all(
+                feature = "input-avfoundation",
+                any(target_os = "macos", target_os = "ios")
+            ))]
+            CaptureAPIBackend::AVFoundation => Some(HotplugSource::AVFoundation(
+                nokhwa_bindings_macos::avfoundation::AVCaptureDeviceObserver::new(Arc::new(
+                    on_change,
+                )),
+            )),
+            _ => None,
+        }
+    }
+}
+
+#[cfg(all(feature = "input-v4l", target_os = "linux"))]
+mod inotify {
+    use std::{
+        io,
+        os::unix::io::{AsRawFd, FromRawFd, OwnedFd},
+        thread::JoinHandle,
+    };
+
+    // Watches `/dev` for `video*` nodes being created, removed or getting their permissions set (which `udev` does after creating them).
+    pub(super) struct DevWatcher {
+        // written to when dropped, to stop the thread
+        stop: OwnedFd,
+        thread: Option<JoinHandle<()>>,
+    }
+
+    fn check(result: libc::c_int) -> io::Result<libc::c_int> {
+        if result < 0 {
+            Err(io::Error::last_os_error())
+        } else {
+            Ok(result)
+        }
+    }
+
+    impl DevWatcher {
+        pub(super) fn new(on_change: Box<dyn Fn() + Send + Sync + 'static>) -> io::Result<Self> {
+            // SAFETY: plain syscalls, every file descriptor they return is owned by an `OwnedFd` straight away.
+            let inotify =
+                unsafe { OwnedFd::from_raw_fd(check(libc::inotify_init1(libc::IN_CLOEXEC))?) };
+            check(unsafe {
+                libc::inotify_add_watch(
+                    inotify.as_raw_fd(),
+                    b"/dev\0".as_ptr().cast(),
+                    libc::IN_CREATE | libc::IN_DELETE | libc::IN_ATTRIB,
+                )
+            })?;
+            let mut pipe = [0; 2];
+            check(unsafe { libc::pipe2(pipe.as_mut_ptr(), libc::O_CLOEXEC) })?;
+            let (stop_receiver, stop) =
+                unsafe { (OwnedFd::from_raw_fd(pipe[0]), OwnedFd::from_raw_fd(pipe[1])) };
+
+            let thread = std::thread::Builder::new()
+                .name("DeviceRegistryHotplugThread".to_string())
+                .spawn(move || watch(&inotify, &stop_receiver, &*on_change))?;
+            Ok(DevWatcher {
+                stop,
+                thread: Some(thread),
+            })
+        }
+    }
+
+    fn watch(inotify: &OwnedFd, stop: &OwnedFd, on_change: &(dyn Fn() + Send + Sync)) {
+        const HEADER: usize = std::mem::size_of::<libc::inotify_event>();
+        let mut events = [0_u8; 4096];
+
+        loop {
+            let mut fds = [
+                libc::pollfd {
+                    fd: inotify.as_raw_fd(),
+                    events: libc::POLLIN,
+                    revents: 0,
+                },
+                libc::pollfd {
+                    fd: stop.as_raw_fd(),
+                    events: libc::POLLIN,
+                    revents: 0,
+                },
+            ];
+            if let Err(why) = check(unsafe { libc::poll(fds.as_mut_ptr(), 2, -1) }) {
+                if why.kind() == io::ErrorKind::Interrupted {
+                    continue;
+                }
+                return;
+            }
+            if fds[1].revents != 0 {
+                return;
+            }
+
+            let read = unsafe {
+                libc::read(
+                    inotify.as_raw_fd(),
+                    events.as_mut_ptr().cast(),
+                    events.len(),
+                )
+            };
+            let read = match usize::try_from(read) {
+                Ok(read) => read,
+                Err(_) => continue,
+            };
+
+            // the events are packed one after the other, each followed by its (padded) file name
+            let mut offset = 0;
+            let mut changed = false;
+            while offset + HEADER <= read {
+                let mut name_len = [0_u8; 4];
+                name_len.copy_from_slice(&events[offset + 12..offset + 16]);
+                let name_len = u32::from_ne_bytes(name_len) as usize;
+                let name = &events[offset + HEADER..(offset + HEADER + name_len).min(read)];
+                changed |= name.starts_with(b"video");
+                offset += HEADER + name_len;
+            }
+            if changed {
+                on_change();
+            }
+        }
+    }
+
+    impl Drop for DevWatcher {
+        fn drop(&mut self) {
+            let _stop = unsafe { libc::write(self.stop.as_raw_fd(), [1_u8].as_ptr().cast(), 1) };
+            if let Some(thread) = self.thread.take() {
+                let _join = thread.join();
+            }
+        }
+    }
+}
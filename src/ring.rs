@@ -0,0 +1,337 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#[cfg(feature = "serde")]
+use serde::{Deserialize, Serialize};
+use std::{
+    cell::UnsafeCell,
+    cmp::Ordering as CmpOrdering,
+    fmt::{Debug, Formatter},
+    mem::MaybeUninit,
+    sync::{
+        atomic::{self, AtomicBool, AtomicU64, AtomicUsize, Ordering},
+        Condvar, Mutex, PoisonError,
+    },
+};
+
+/// The default depth of a [`FrameRing`].
+pub const DEFAULT_RING_DEPTH: usize = 4;
+
+/// What a [`FrameRing`] does when a frame is pushed while it is full.
+#[derive(Copy, Clone, Debug, Hash, PartialEq, Eq, PartialOrd, Ord)]
+#[cfg_attr(feature = "serde", derive(Serialize, Deserialize))]
+pub enum RingPolicy {
+    /// Throw away the oldest frame to make room for the new one. Lowest latency, frames may be lost.
+    DropOldest,
+    /// Wait until a consumer has taken a frame out. No frames are lost, but the producer (the capture thread) stalls.
+    Block,
+}
+
+impl Default for RingPolicy {
+    fn default() -> Self {
+        RingPolicy::DropOldest
+    }
+}
+
+struct Slot<T> {
+    sequence: AtomicUsize,
+    value: UnsafeCell<MaybeUninit<T>>,
+}
+
+// Lets threads sleep until the ring changes. The lock is only taken if somebody is actually waiting, so the
+// ring stays lock-free for everybody else.
+#[derive(Default)]
+struct Signal {
+    waiters: AtomicUsize,
+    lock: Mutex<()>,
+    condvar: Condvar,
+}
+
+impl Signal {
+    // Sleeps until `ready` returns true. `ready` is checked again every time the signal is notified.
+    fn wait_until(&self, mut ready: impl FnMut() -> bool) {
+        let mut guard = self.lock.lock().unwrap_or_else(PoisonError::into_inner);
+        self.waiters.fetch_add(1, Ordering::SeqCst);
+        // pairs with the fence in `notify()`: either the notifier sees us waiting, or we see its change
+        atomic::fence(Ordering::SeqCst);
+        while !ready() {
+            guard = self
+                .condvar
+                .wait(guard)
+                .unwrap_or_else(PoisonError::into_inner);
+        }
+        self.waiters.fetch_sub(1, Ordering::SeqCst);
+    }
+
+    // Wakes up every thread waiting in `wait_until()`. Call this after changing the ring.
+    fn notify(&self) {
+        atomic::fence(Ordering::SeqCst);
+        if self.waiters.load(Ordering::SeqCst) != 0 {
+            // taking the lock makes sure a waiter is either asleep already, or has not checked `ready` yet
+            drop(self.lock.lock().unwrap_or_else(PoisonError::into_inner));
+            self.condvar.notify_all();
+        }
+    }
+}
+
+/// A bounded, lock-free ring of frames.
+///
+/// Producers and consumers never take a lock: each slot carries a sequence number that says whether it is
+/// ready to be written or read, so a slow consumer can never block the capture thread (unless [`RingPolicy::Block`] is used).
+/// A producer blocked by [`RingPolicy::Block`] sleeps until a frame is taken out, and [`pop_wait()`](FrameRing::pop_wait)
+/// sleeps until a frame is pushed, instead of spinning.
+///
+/// The depth is at least 2.
+pub struct FrameRing<T> {
+    slots: Box<[Slot<T>]>,
+    // next position to read
+    head: AtomicUsize,
+    // next position to write
+    tail: AtomicUsize,
+    policy: RingPolicy,
+    dropped: AtomicU64,
+    closed: AtomicBool,
+    // producers blocked by `RingPolicy::Block` wait on this for a frame to be taken out
+    not_full: Signal,
+    // consumers in `pop_wait()` wait on this for a frame to be pushed
+    not_empty: Signal,
+}
+
+// SAFETY: Access to a slot's value is handed out exclusively through its sequence number (only the thread that won
+// the CAS on `head`/`tail` for that position touches it), so this is as thread safe as `T` itself.
+unsafe impl<T: Send> Send for FrameRing<T> {}
+unsafe impl<T: Send> Sync for FrameRing<T> {}
+
+#[allow(clippy::cast_possible_wrap)]
+impl<T> FrameRing<T> {
+    /// Creates a new [`FrameRing`] that holds up to `depth` frames.
+    #[must_use]
+    pub fn new(depth: usize, policy: RingPolicy) -> Self {
+        let depth = depth.max(2);
+        let slots = (0..depth)
+            .map(|idx| Slot {
+                sequence: AtomicUsize::new(idx),
+                value: UnsafeCell::new(MaybeUninit::uninit()),
+            })
+            .collect::<Vec<Slot<T>>>()
+            .into_boxed_slice();
+
+        FrameRing {
+            slots,
+            head: AtomicUsize::new(0),
+            tail: AtomicUsize::new(0),
+            policy,
+            dropped: AtomicU64::new(0),
+            closed: AtomicBool::new(false),
+            not_full: Signal::default(),
+            not_empty: Signal::default(),
+        }
+    }
+
+    /// Tries to push `value` into the ring. If the ring is full, the value is given back.
+    /// # Errors
+    /// If the ring is full, this will return `value`.
+    pub fn try_push(&self, value: T) -> Result<(), T> {
+        let mut pos = self.tail.load(Ordering::Relaxed);
+        loop {
+            let slot = &self.slots[pos % self.slots.len()];
+            let sequence = slot.sequence.load(Ordering::Acquire);
+            let diff = (sequence as isize).wrapping_sub(pos as isize);
+
+            match diff.cmp(&0) {
+                CmpOrdering::Equal => {
+                    match self.tail.compare_exchange_weak(
+                        pos,
+                        pos.wrapping_add(1),
+                        Ordering::Relaxed,
+                        Ordering::Relaxed,
+                    ) {
+                        Ok(_) => {
+                            // SAFETY: We won the CAS, nobody else can touch this slot until the sequence is published.
+                            unsafe { (*slot.value.get()).write(value) };
+                            slot.sequence.store(pos.wrapping_add(1), Ordering::Release);
+                            self.not_empty.notify();
+                            return Ok(());
+                        }
+                        Err(current) => pos = current,
+                    }
+                }
+                CmpOrdering::Less => return Err(value),
+                CmpOrdering::Greater => {
+                    pos = self.tail.load(Ordering::Relaxed);
+                }
+            }
+        }
+    }
+
+    /// Pushes `value` into the ring, following the [`RingPolicy`] if the ring is full.
+    ///
+    /// Returns a frame that did not end up in the ring: the evicted oldest frame for [`RingPolicy::DropOldest`], or
+    /// `value` itself for [`RingPolicy::Block`] if the ring was [`close()`](FrameRing::close)d while waiting. Either counts as dropped.
+    pub fn push(&self, value: T) -> Option<T> {
+        let mut value = value;
+        let mut evicted = None;
+        loop {
+            match self.try_push(value) {
+                Ok(()) => return evicted,
+                Err(returned) => value = returned,
+            }
+
+            match self.policy {
+                RingPolicy::DropOldest => {
+                    if let Some(oldest) = self.pop() {
+                        self.dropped.fetch_add(1, Ordering::Relaxed);
+                        evicted = Some(oldest);
+                    }
+                }
+                RingPolicy::Block => {
+                    if self.is_closed() {
+                        self.dropped.fetch_add(1, Ordering::Relaxed);
+                        return Some(value);
+                    }
+                    self.not_full
+                        .wait_until(|| self.len() < self.depth() || self.is_closed());
+                }
+            }
+        }
+    }
+
+    /// Takes the oldest frame out of the ring, if there is one.
+    #[must_use]
+    pub fn pop(&self) -> Option<T> {
+        let mut pos = self.head.load(Ordering::Relaxed);
+        loop {
+            let slot = &self.slots[pos % self.slots.len()];
+            let sequence = slot.sequence.load(Ordering::Acquire);
+            let diff = (sequence as isize).wrapping_sub(pos.wrapping_add(1) as isize);
+
+            match diff.cmp(&0) {
+                CmpOrdering::Equal => {
+                    match self.head.compare_exchange_weak(
+                        pos,
+                        pos.wrapping_add(1),
+                        Ordering::Relaxed,
+                        Ordering::Relaxed,
+                    ) {
+                        Ok(_) => {
+                            // SAFETY: We won the CAS and the sequence says this slot was written.
+                            let value = unsafe { (*slot.value.get()).assume_init_read() };
+                            slot.sequence
+                                .store(pos.wrapping_add(self.slots.len()), Ordering::Release);
+                            self.not_full.notify();
+                            return Some(value);
+                        }
+                        Err(current) => pos = current,
+                    }
+                }
+                CmpOrdering::Less => return None,
+                CmpOrdering::Greater => {
+                    pos = self.head.load(Ordering::Relaxed);
+                }
+            }
+        }
+    }
+
+    /// Takes the oldest frame out of the ring, sleeping until one is pushed if it is empty.
+    ///
+    /// Returns `None` once the ring is [`close()`](FrameRing::close)d and empty.
+    #[must_use]
+    pub fn pop_wait(&self) -> Option<T> {
+        loop {
+            if let Some(value) = self.pop() {
+                return Some(value);
+            }
+            if self.is_closed() {
+                return None;
+            }
+            self.not_empty
+                .wait_until(|| !self.is_empty() || self.is_closed());
+        }
+    }
+
+    /// Takes every frame out of the ring, returning only the newest one.
+    #[must_use]
+    pub fn pop_newest(&self) -> Option<T> {
+        let mut newest = None;
+        while let Some(frame) = self.pop() {
+            newest = Some(frame);
+        }
+        newest
+    }
+
+    /// The amount of frames currently in the ring. This is only a snapshot, it may be outdated as soon as it returns.
+    #[must_use]
+    pub fn len(&self) -> usize {
+        let tail = self.tail.load(Ordering::Acquire);
+        let head = self.head.load(Ordering::Acquire);
+        tail.wrapping_sub(head).min(self.slots.len())
+    }
+
+    /// Checks if the ring is empty. See [`len()`](FrameRing::len).
+    #[must_use]
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// The maximum amount of frames this ring can hold.
+    #[must_use]
+    pub fn depth(&self) -> usize {
+        self.slots.len()
+    }
+
+    /// The [`RingPolicy`] of this ring.
+    #[must_use]
+    pub fn policy(&self) -> RingPolicy {
+        self.policy
+    }
+
+    /// The amount of frames that were dropped (see [`push()`](FrameRing::push)).
+    #[must_use]
+    pub fn dropped(&self) -> u64 {
+        self.dropped.load(Ordering::Relaxed)
+    }
+
+    /// Closes the ring. Producers blocked by [`RingPolicy::Block`] and consumers in [`pop_wait()`](FrameRing::pop_wait) give up.
+    pub fn close(&self) {
+        self.closed.store(true, Ordering::Release);
+        self.not_full.notify();
+        self.not_empty.notify();
+    }
+
+    /// Checks if the ring was closed.
+    #[must_use]
+    pub fn is_closed(&self) -> bool {
+        self.closed.load(Ordering::Acquire)
+    }
+}
+
+impl<T> Drop for FrameRing<T> {
+    fn drop(&mut self) {
+        while self.pop().is_some() {}
+    }
+}
+
+impl<T> Debug for FrameRing<T> {
+    fn fmt(&self, f: &mut Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("FrameRing")
+            .field("len", &self.len())
+            .field("depth", &self.depth())
+            .field("policy", &self.policy)
+            .field("dropped", &self.dropped())
+            .field("closed", &self.is_closed())
+            .finish_non_exhaustive()
+    }
+}
@@ -0,0 +1,70 @@
+// Converts a raw camera frame (uploaded as-is into `frame`) into a RGBA texture.
+// Colour conversion uses BT.601 limited range, the same as `yuyv444_to_rgb`.
+
+struct Frame {
+    data: array<u32>;
+};
+
+struct Params {
+    width: u32;
+    height: u32;
+    // 0: YUYV, 1: NV12, 2: I420, 3: GRAY8
+    format: u32;
+    luma_stride: u32;
+    chroma_offset: u32;
+    chroma_stride: u32;
+    // I420 only: the offset of the V plane
+    v_offset: u32;
+    padding: u32;
+};
+
+[[group(0), binding(0)]]
+var<storage, read> frame: Frame;
+
+[[group(0), binding(1)]]
+var<uniform> params: Params;
+
+[[group(0), binding(2)]]
+var output: texture_storage_2d<rgba8unorm, write>;
+
+fn byte_at(index: u32) -> f32 {
+    return f32((frame.data[index / 4u] >> ((index % 4u) * 8u)) & 0xFFu);
+}
+
+fn yuv_to_rgba(y: f32, u: f32, v: f32) -> vec4<f32> {
+    let c = 1.164 * (y - 16.0);
+    let d = u - 128.0;
+    let e = v - 128.0;
+    let rgb = vec3<f32>(c + 1.596 * e, c - 0.392 * d - 0.813 * e, c + 2.017 * d) / 255.0;
+    return vec4<f32>(clamp(rgb, vec3<f32>(0.0, 0.0, 0.0), vec3<f32>(1.0, 1.0, 1.0)), 1.0);
+}
+
+[[stage(compute), workgroup_size(8, 8, 1)]]
+fn main([[builtin(global_invocation_id)]] id: vec3<u32>) {
+    let x = id.x;
+    let y = id.y;
+    if (x >= params.width || y >= params.height) {
+        return;
+    }
+
+    var color: vec4<f32>;
+    if (params.format == 0u) {
+        let base = y * params.luma_stride + (x / 2u) * 4u;
+        color = yuv_to_rgba(byte_at(base + (x % 2u) * 2u), byte_at(base + 1u), byte_at(base + 3u));
+    } else if (params.format == 1u) {
+        let chroma = params.chroma_offset + (y / 2u) * params.chroma_stride + (x / 2u) * 2u;
+        color = yuv_to_rgba(byte_at(y * params.luma_stride + x), byte_at(chroma), byte_at(chroma + 1u));
+    } else if (params.format == 2u) {
+        let chroma = (y / 2u) * params.chroma_stride + x / 2u;
+        color = yuv_to_rgba(
+            byte_at(y * params.luma_stride + x),
+            byte_at(params.chroma_offset + chroma),
+            byte_at(params.v_offset + chroma)
+        );
+    } else {
+        let luma = byte_at(y * params.luma_stride + x) / 255.0;
+        color = vec4<f32>(luma, luma, luma, 1.0);
+    }
+
+    textureStore(output, vec2<i32>(i32(x), i32(y)), color);
+}
@@ -0,0 +1,586 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Vectorized YUYV 4:2:2 -> RGB888/RGBA8888 kernels.
+//
+// Every kernel here does *exactly* the same integer math as `yuyv444_to_rgb` in `utils.rs`:
+//   c298 = (y - 16) * 298, d = u - 128, e = v - 128
+//   r = (c298 + 409 * e + 128) >> 8
+//   g = (c298 - 100 * d - 208 * e + 128) >> 8
+//   b = (c298 + 516 * d + 128) >> 8
+// in 32 bit lanes, and then keeps the *low 8 bits* of the result (the scalar version does `as u8`, which
+// truncates instead of clamping). The output is therefore bit-identical to the scalar path.
+//
+// The kernels only process whole blocks. They return how many bytes of `data` they consumed, and the
+// caller finishes the remainder with the scalar path.
+
+/// Converts as much of `data` as possible with the best kernel available on this machine.
+/// Returns the amount of bytes of `data` that were converted. `dest` must be large enough to hold the
+/// converted form of all of `data`.
+#[cfg(target_arch = "x86_64")]
+#[inline]
+pub(crate) fn yuyv422_to_rgb_simd(data: &[u8], dest: &mut [u8], rgba: bool) -> usize {
+    if is_x86_feature_detected!("avx2") {
+        // SAFETY: we just checked that the CPU supports AVX2.
+        return unsafe { x86::yuyv422_to_rgb_avx2(data, dest, rgba) };
+    }
+    // SAFETY: SSE2 is part of the x86_64 baseline.
+    unsafe { x86::yuyv422_to_rgb_sse2(data, dest, rgba) }
+}
+
+/// Converts as much of `data` as possible with the best kernel available on this machine.
+/// Returns the amount of bytes of `data` that were converted. `dest` must be large enough to hold the
+/// converted form of all of `data`.
+#[cfg(target_arch = "aarch64")]
+#[inline]
+pub(crate) fn yuyv422_to_rgb_simd(data: &[u8], dest: &mut [u8], rgba: bool) -> usize {
+    // SAFETY: NEON is part of the aarch64 baseline.
+    unsafe { neon::yuyv422_to_rgb_neon(data, dest, rgba) }
+}
+
+/// Converts as much of `data` as possible with the best kernel available on this machine.
+/// Returns the amount of bytes of `data` that were converted. `dest` must be large enough to hold the
+/// converted form of all of `data`.
+///
+/// wasm has no runtime feature detection, so this is only used when compiled with `+simd128`.
+#[cfg(all(target_arch = "wasm32", target_feature = "simd128"))]
+#[inline]
+pub(crate) fn yuyv422_to_rgb_simd(data: &[u8], dest: &mut [u8], rgba: bool) -> usize {
+    wasm::yuyv422_to_rgb_simd128(data, dest, rgba)
+}
+
+/// No kernels for this platform, everything goes through the scalar path.
+#[cfg(not(any(
+    target_arch = "x86_64",
+    target_arch = "aarch64",
+    all(target_arch = "wasm32", target_feature = "simd128")
+)))]
+#[inline]
+pub(crate) fn yuyv422_to_rgb_simd(_data: &[u8], _dest: &mut [u8], _rgba: bool) -> usize {
+    0
+}
+
+#[cfg(target_arch = "x86_64")]
+#[allow(clippy::cast_possible_wrap)]
+mod x86 {
+    use std::arch::x86_64::{
+        __m128i, __m256i, _mm256_add_epi32, _mm256_and_si256, _mm256_loadu_si256,
+        _mm256_madd_epi16, _mm256_or_si256, _mm256_permute2x128_si256, _mm256_set1_epi32,
+        _mm256_set_epi16, _mm256_setr_epi8, _mm256_setzero_si256, _mm256_shuffle_epi8,
+        _mm256_shufflehi_epi16, _mm256_shufflelo_epi16, _mm256_slli_epi32, _mm256_srai_epi32,
+        _mm256_storeu_si256, _mm256_sub_epi16, _mm256_unpackhi_epi8, _mm256_unpacklo_epi8,
+        _mm_add_epi32, _mm_and_si128, _mm_loadu_si128, _mm_madd_epi16, _mm_or_si128,
+        _mm_set1_epi32, _mm_set_epi16, _mm_setzero_si128, _mm_shufflehi_epi16, _mm_shufflelo_epi16,
+        _mm_slli_epi32, _mm_srai_epi32, _mm_storeu_si128, _mm_sub_epi16, _mm_unpackhi_epi8,
+        _mm_unpacklo_epi8,
+    };
+
+    // (y, d) pairs: [Y0 U Y1 V] -> [Y0 U Y1 U]
+    const SHUF_YD: i32 = 0b01_10_01_00;
+    // (y, e) pairs: [Y0 U Y1 V] -> [Y0 V Y1 V]
+    const SHUF_YE: i32 = 0b11_10_11_00;
+    // (d, e) pairs: [Y0 U Y1 V] -> [U V U V]
+    const SHUF_DE: i32 = 0b11_01_11_01;
+
+    /// Takes 4 pixels worth of widened, bias-subtracted YUYV (`[y0 d y1 e y2 d y3 e]` as `i16`) and
+    /// returns the 4 pixels packed as little endian `RGBA` `u32`s.
+    #[inline]
+    #[target_feature(enable = "sse2")]
+    unsafe fn rgba_from_yuyv16_sse2(yuyv: __m128i) -> __m128i {
+        let yd = _mm_shufflehi_epi16::<SHUF_YD>(_mm_shufflelo_epi16::<SHUF_YD>(yuyv));
+        let ye = _mm_shufflehi_epi16::<SHUF_YE>(_mm_shufflelo_epi16::<SHUF_YE>(yuyv));
+        let de = _mm_shufflehi_epi16::<SHUF_DE>(_mm_shufflelo_epi16::<SHUF_DE>(yuyv));
+
+        let round = _mm_set1_epi32(128);
+        let low_byte = _mm_set1_epi32(0xFF);
+
+        let y298 = _mm_madd_epi16(yd, _mm_set_epi16(0, 298, 0, 298, 0, 298, 0, 298));
+        let r = _mm_add_epi32(
+            _mm_madd_epi16(ye, _mm_set_epi16(409, 298, 409, 298, 409, 298, 409, 298)),
+            round,
+        );
+        let g = _mm_add_epi32(
+            _mm_add_epi32(
+                y298,
+                _mm_madd_epi16(
+                    de,
+                    _mm_set_epi16(-208, -100, -208, -100, -208, -100, -208, -100),
+                ),
+            ),
+            round,
+        );
+        let b = _mm_add_epi32(
+            _mm_madd_epi16(yd, _mm_set_epi16(516, 298, 516, 298, 516, 298, 516, 298)),
+            round,
+        );
+
+        let r = _mm_and_si128(_mm_srai_epi32::<8>(r), low_byte);
+        let g = _mm_and_si128(_mm_srai_epi32::<8>(g), low_byte);
+        let b = _mm_and_si128(_mm_srai_epi32::<8>(b), low_byte);
+
+        _mm_or_si128(
+            _mm_or_si128(r, _mm_slli_epi32::<8>(g)),
+            _mm_or_si128(
+                _mm_slli_epi32::<16>(b),
+                _mm_set1_epi32(0xFF00_0000_u32 as i32),
+            ),
+        )
+    }
+
+    /// Writes 4 `RGBA` pixels out as 12 bytes of `RGB`.
+    #[inline]
+    #[target_feature(enable = "sse2")]
+    unsafe fn store_rgb_from_rgba_sse2(rgba: __m128i, dest: &mut [u8]) {
+        let mut tmp = [0_u8; 16];
+        _mm_storeu_si128(tmp.as_mut_ptr().cast(), rgba);
+        for (px_out, px_in) in dest[..12].chunks_exact_mut(3).zip(tmp.chunks_exact(4)) {
+            px_out.copy_from_slice(&px_in[..3]);
+        }
+    }
+
+    /// SSE2 kernel. Converts 8 pixels (16 bytes of YUYV) per iteration.
+    #[target_feature(enable = "sse2")]
+    pub(super) unsafe fn yuyv422_to_rgb_sse2(data: &[u8], dest: &mut [u8], rgba: bool) -> usize {
+        let pixel_size = if rgba { 4 } else { 3 };
+        let zero = _mm_setzero_si128();
+        let bias = _mm_set_epi16(128, 16, 128, 16, 128, 16, 128, 16);
+
+        let mut consumed = 0;
+        for (yuyv, out) in data
+            .chunks_exact(16)
+            .zip(dest.chunks_exact_mut(8 * pixel_size))
+        {
+            let raw = _mm_loadu_si128(yuyv.as_ptr().cast());
+            let lo = _mm_sub_epi16(_mm_unpacklo_epi8(raw, zero), bias);
+            let hi = _mm_sub_epi16(_mm_unpackhi_epi8(raw, zero), bias);
+            let px_lo = rgba_from_yuyv16_sse2(lo);
+            let px_hi = rgba_from_yuyv16_sse2(hi);
+
+            if rgba {
+                _mm_storeu_si128(out.as_mut_ptr().cast(), px_lo);
+                _mm_storeu_si128(out[16..].as_mut_ptr().cast(), px_hi);
+            } else {
+                store_rgb_from_rgba_sse2(px_lo, out);
+                store_rgb_from_rgba_sse2(px_hi, &mut out[12..]);
+            }
+            consumed += 16;
+        }
+        consumed
+    }
+
+    /// Same as [`rgba_from_yuyv16_sse2`], but on both 128 bit lanes at once.
+    #[inline]
+    #[target_feature(enable = "avx2")]
+    unsafe fn rgba_from_yuyv16_avx2(yuyv: __m256i) -> __m256i {
+        let yd = _mm256_shufflehi_epi16::<SHUF_YD>(_mm256_shufflelo_epi16::<SHUF_YD>(yuyv));
+        let ye = _mm256_shufflehi_epi16::<SHUF_YE>(_mm256_shufflelo_epi16::<SHUF_YE>(yuyv));
+        let de = _mm256_shufflehi_epi16::<SHUF_DE>(_mm256_shufflelo_epi16::<SHUF_DE>(yuyv));
+
+        let round = _mm256_set1_epi32(128);
+        let low_byte = _mm256_set1_epi32(0xFF);
+
+        let y298 = _mm256_madd_epi16(
+            yd,
+            _mm256_set_epi16(
+                0, 298, 0, 298, 0, 298, 0, 298, 0, 298, 0, 298, 0, 298, 0, 298,
+            ),
+        );
+        let r = _mm256_add_epi32(
+            _mm256_madd_epi16(
+                ye,
+                _mm256_set_epi16(
+                    409, 298, 409, 298, 409, 298, 409, 298, 409, 298, 409, 298, 409, 298, 409, 298,
+                ),
+            ),
+            round,
+        );
+        let g = _mm256_add_epi32(
+            _mm256_add_epi32(
+                y298,
+                _mm256_madd_epi16(
+                    de,
+                    _mm256_set_epi16(
+                        -208, -100, -208, -100, -208, -100, -208, -100, -208, -100, -208, -100,
+                        -208, -100, -208, -100,
+                    ),
+                ),
+            ),
+            round,
+        );
+        let b = _mm256_add_epi32(
+            _mm256_madd_epi16(
+                yd,
+                _mm256_set_epi16(
+                    516, 298, 516, 298, 516, 298, 516, 298, 516, 298, 516, 298, 516, 298, 516, 298,
+                ),
+            ),
+            round,
+        );
+
+        let r = _mm256_and_si256(_mm256_srai_epi32::<8>(r), low_byte);
+        let g = _mm256_and_si256(_mm256_srai_epi32::<8>(g), low_byte);
+        let b = _mm256_and_si256(_mm256_srai_epi32::<8>(b), low_byte);
+
+        _mm256_or_si256(
+            _mm256_or_si256(r, _mm256_slli_epi32::<8>(g)),
+            _mm256_or_si256(
+                _mm256_slli_epi32::<16>(b),
+                _mm256_set1_epi32(0xFF00_0000_u32 as i32),
+            ),
+        )
+    }
+
+    /// AVX2 kernel. Converts 16 pixels (32 bytes of YUYV) per iteration.
+    #[target_feature(enable = "avx2")]
+    pub(super) unsafe fn yuyv422_to_rgb_avx2(data: &[u8], dest: &mut [u8], rgba: bool) -> usize {
+        let pixel_size = if rgba { 4 } else { 3 };
+        let zero = _mm256_setzero_si256();
+        let bias = _mm256_set_epi16(
+            128, 16, 128, 16, 128, 16, 128, 16, 128, 16, 128, 16, 128, 16, 128, 16,
+        );
+        // per 128 bit lane: RGBA RGBA RGBA RGBA -> RGB RGB RGB RGB xxxx
+        let compact = rgb_compact_mask_avx2();
+
+        let mut consumed = 0;
+        for (yuyv, out) in data
+            .chunks_exact(32)
+            .zip(dest.chunks_exact_mut(16 * pixel_size))
+        {
+            let raw = _mm256_loadu_si256(yuyv.as_ptr().cast());
+            // unpack works per 128 bit lane, so `lo` holds pixels 0-3 and 8-11, `hi` holds 4-7 and 12-15
+            let lo = _mm256_sub_epi16(_mm256_unpacklo_epi8(raw, zero), bias);
+            let hi = _mm256_sub_epi16(_mm256_unpackhi_epi8(raw, zero), bias);
+            let px_lo = rgba_from_yuyv16_avx2(lo);
+            let px_hi = rgba_from_yuyv16_avx2(hi);
+            let first = _mm256_permute2x128_si256::<0x20>(px_lo, px_hi);
+            let second = _mm256_permute2x128_si256::<0x31>(px_lo, px_hi);
+
+            if rgba {
+                _mm256_storeu_si256(out.as_mut_ptr().cast(), first);
+                _mm256_storeu_si256(out[32..].as_mut_ptr().cast(), second);
+            } else {
+                let mut tmp = [0_u8; 64];
+                _mm256_storeu_si256(tmp.as_mut_ptr().cast(), _mm256_shuffle_epi8(first, compact));
+                _mm256_storeu_si256(
+                    tmp[32..].as_mut_ptr().cast(),
+                    _mm256_shuffle_epi8(second, compact),
+                );
+                for (rgb_out, rgb_in) in out.chunks_exact_mut(12).zip(tmp.chunks_exact(16)) {
+                    rgb_out.copy_from_slice(&rgb_in[..12]);
+                }
+            }
+            consumed += 32;
+        }
+        consumed
+    }
+
+    #[inline]
+    #[target_feature(enable = "avx2")]
+    unsafe fn rgb_compact_mask_avx2() -> __m256i {
+        _mm256_setr_epi8(
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, 0, 1, 2, 4, 5, 6, 8, 9, 10, 12,
+            13, 14, -1, -1, -1, -1,
+        )
+    }
+}
+
+#[cfg(target_arch = "aarch64")]
+mod neon {
+    use std::arch::aarch64::{
+        int16x4_t, int16x8_t, uint8x16x3_t, uint8x16x4_t, uint8x8_t, vcombine_s16, vcombine_u8,
+        vdupq_n_s16, vdupq_n_s32, vdupq_n_u8, vget_high_s16, vget_low_s16, vld4_u8, vmlal_n_s16,
+        vmovl_u8, vmovn_s16, vreinterpret_u8_s8, vreinterpretq_s16_u16, vshrn_n_s32, vst3q_u8,
+        vst4q_u8, vsubq_s16, vzip1_u8, vzip2_u8,
+    };
+
+    /// Computes `(r, g, b)` for 4 pixels, narrowed (and truncated) to `i16`.
+    #[inline]
+    #[target_feature(enable = "neon")]
+    unsafe fn rgb_from_yde(y: int16x4_t, d: int16x4_t, e: int16x4_t) -> [int16x4_t; 3] {
+        let round = vdupq_n_s32(128);
+        let c298 = vmlal_n_s16(round, y, 298);
+        let r = vmlal_n_s16(c298, e, 409);
+        let g = vmlal_n_s16(vmlal_n_s16(c298, d, -100), e, -208);
+        let b = vmlal_n_s16(c298, d, 516);
+        [
+            vshrn_n_s32::<8>(r),
+            vshrn_n_s32::<8>(g),
+            vshrn_n_s32::<8>(b),
+        ]
+    }
+
+    /// Computes `(r, g, b)` for 8 pixels, truncated to the low 8 bits (same as `as u8`).
+    #[inline]
+    #[target_feature(enable = "neon")]
+    unsafe fn rgb_from_yde8(y: int16x8_t, d: int16x8_t, e: int16x8_t) -> [uint8x8_t; 3] {
+        let [r_lo, g_lo, b_lo] = rgb_from_yde(vget_low_s16(y), vget_low_s16(d), vget_low_s16(e));
+        let [r_hi, g_hi, b_hi] = rgb_from_yde(vget_high_s16(y), vget_high_s16(d), vget_high_s16(e));
+        [
+            vreinterpret_u8_s8(vmovn_s16(vcombine_s16(r_lo, r_hi))),
+            vreinterpret_u8_s8(vmovn_s16(vcombine_s16(g_lo, g_hi))),
+            vreinterpret_u8_s8(vmovn_s16(vcombine_s16(b_lo, b_hi))),
+        ]
+    }
+
+    /// NEON kernel. Converts 16 pixels (32 bytes of YUYV) per iteration.
+    #[target_feature(enable = "neon")]
+    pub(super) unsafe fn yuyv422_to_rgb_neon(data: &[u8], dest: &mut [u8], rgba: bool) -> usize {
+        let pixel_size = if rgba { 4 } else { 3 };
+        let y_bias = vdupq_n_s16(16);
+        let uv_bias = vdupq_n_s16(128);
+
+        let mut consumed = 0;
+        for (yuyv, out) in data
+            .chunks_exact(32)
+            .zip(dest.chunks_exact_mut(16 * pixel_size))
+        {
+            // de-interleaves into [Y0 x8] [U x8] [Y1 x8] [V x8]
+            let planes = vld4_u8(yuyv.as_ptr());
+            let y_even = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(planes.0)), y_bias);
+            let d = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(planes.1)), uv_bias);
+            let y_odd = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(planes.2)), y_bias);
+            let e = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(planes.3)), uv_bias);
+
+            let [r_even, g_even, b_even] = rgb_from_yde8(y_even, d, e);
+            let [r_odd, g_odd, b_odd] = rgb_from_yde8(y_odd, d, e);
+
+            let r = vcombine_u8(vzip1_u8(r_even, r_odd), vzip2_u8(r_even, r_odd));
+            let g = vcombine_u8(vzip1_u8(g_even, g_odd), vzip2_u8(g_even, g_odd));
+            let b = vcombine_u8(vzip1_u8(b_even, b_odd), vzip2_u8(b_even, b_odd));
+
+            if rgba {
+                vst4q_u8(out.as_mut_ptr(), uint8x16x4_t(r, g, b, vdupq_n_u8(u8::MAX)));
+            } else {
+                vst3q_u8(out.as_mut_ptr(), uint8x16x3_t(r, g, b));
+            }
+            consumed += 32;
+        }
+        consumed
+    }
+}
+
+#[cfg(all(target_arch = "wasm32", target_feature = "simd128"))]
+#[allow(clippy::cast_possible_wrap)]
+mod wasm {
+    use std::arch::wasm32::{
+        i16x8, i16x8_shuffle, i16x8_sub, i32x4_add, i32x4_dot_i16x8, i32x4_shl, i32x4_shr,
+        i32x4_splat, i8x16_shuffle, u16x8_extend_high_u8x16, u16x8_extend_low_u8x16, v128,
+        v128_and, v128_load, v128_or, v128_store,
+    };
+
+    /// Takes 4 pixels worth of widened, bias-subtracted YUYV (`[y0 d y1 e y2 d y3 e]` as `i16`) and
+    /// returns the 4 pixels packed as little endian `RGBA` `u32`s.
+    #[inline]
+    fn rgba_from_yuyv16(yuyv: v128) -> v128 {
+        let yd = i16x8_shuffle::<0, 1, 2, 1, 4, 5, 6, 5>(yuyv, yuyv);
+        let ye = i16x8_shuffle::<0, 3, 2, 3, 4, 7, 6, 7>(yuyv, yuyv);
+        let de = i16x8_shuffle::<1, 3, 1, 3, 5, 7, 5, 7>(yuyv, yuyv);
+
+        let round = i32x4_splat(128);
+        let low_byte = i32x4_splat(0xFF);
+
+        let y298 = i32x4_dot_i16x8(yd, i16x8(298, 0, 298, 0, 298, 0, 298, 0));
+        let r = i32x4_add(
+            i32x4_dot_i16x8(ye, i16x8(298, 409, 298, 409, 298, 409, 298, 409)),
+            round,
+        );
+        let g = i32x4_add(
+            i32x4_add(
+                y298,
+                i32x4_dot_i16x8(de, i16x8(-100, -208, -100, -208, -100, -208, -100, -208)),
+            ),
+            round,
+        );
+        let b = i32x4_add(
+            i32x4_dot_i16x8(yd, i16x8(298, 516, 298, 516, 298, 516, 298, 516)),
+            round,
+        );
+
+        let r = v128_and(i32x4_shr(r, 8), low_byte);
+        let g = v128_and(i32x4_shr(g, 8), low_byte);
+        let b = v128_and(i32x4_shr(b, 8), low_byte);
+
+        v128_or(
+            v128_or(r, i32x4_shl(g, 8)),
+            v128_or(i32x4_shl(b, 16), i32x4_splat(0xFF00_0000_u32 as i32)),
+        )
+    }
+
+    /// simd128 kernel. Converts 8 pixels (16 bytes of YUYV) per iteration.
+    pub(super) fn yuyv422_to_rgb_simd128(data: &[u8], dest: &mut [u8], rgba: bool) -> usize {
+        let pixel_size = if rgba { 4 } else { 3 };
+        let bias = i16x8(16, 128, 16, 128, 16, 128, 16, 128);
+
+        let mut consumed = 0;
+        for (yuyv, out) in data
+            .chunks_exact(16)
+            .zip(dest.chunks_exact_mut(8 * pixel_size))
+        {
+            // SAFETY: `yuyv` is exactly 16 bytes long, and `v128_load` has no alignment requirement.
+            let raw = unsafe { v128_load(yuyv.as_ptr().cast()) };
+            let px_lo = rgba_from_yuyv16(i16x8_sub(u16x8_extend_low_u8x16(raw), bias));
+            let px_hi = rgba_from_yuyv16(i16x8_sub(u16x8_extend_high_u8x16(raw), bias));
+
+            if rgba {
+                // SAFETY: `out` is exactly 32 bytes long.
+                unsafe {
+                    v128_store(out.as_mut_ptr().cast(), px_lo);
+                    v128_store(out[16..].as_mut_ptr().cast(), px_hi);
+                }
+            } else {
+                // RGBA x4 | RGBA x4 -> RGB x8 (24 bytes) as 16 + 8
+                let first = i8x16_shuffle::<0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 16, 17, 18, 20>(
+                    px_lo, px_hi,
+                );
+                let second = i8x16_shuffle::<21, 22, 24, 25, 26, 28, 29, 30, 0, 0, 0, 0, 0, 0, 0, 0>(
+                    px_lo, px_hi,
+                );
+                let mut tmp = [0_u8; 16];
+                // SAFETY: `out` is exactly 24 bytes long, `tmp` is 16 bytes long.
+                unsafe {
+                    v128_store(out.as_mut_ptr().cast(), first);
+                    v128_store(tmp.as_mut_ptr().cast(), second);
+                }
+                out[16..24].copy_from_slice(&tmp[..8]);
+            }
+            consumed += 16;
+        }
+        consumed
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use crate::{buf_yuyv422_to_rgb, yuyv444_to_rgb, yuyv444_to_rgba};
+
+    // widths in pixels: tails shorter than every kernel's block, and around multiples of 8, 16 and 32
+    const WIDTHS: &[usize] = &[
+        0, 2, 4, 6, 8, 10, 14, 16, 18, 24, 30, 32, 34, 46, 62, 64, 66, 100, 126, 130, 640,
+    ];
+
+    // xorshift, so the rows are random but the same on every run
+    fn random_row(width: usize, seed: u64) -> Vec<u8> {
+        let mut state = seed.wrapping_mul(0x9E37_79B9_7F4A_7C15) | 1;
+        (0..width * 2)
+            .map(|_| {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                state.to_le_bytes()[0]
+            })
+            .collect()
+    }
+
+    fn scalar(data: &[u8], rgba: bool) -> Vec<u8> {
+        let mut dest = Vec::with_capacity(data.len() * 2);
+        for yuyv in data.chunks_exact(4) {
+            let (y1, u, y2, v) = (
+                i32::from(yuyv[0]),
+                i32::from(yuyv[1]),
+                i32::from(yuyv[2]),
+                i32::from(yuyv[3]),
+            );
+            for y in [y1, y2] {
+                if rgba {
+                    dest.extend_from_slice(&yuyv444_to_rgba(y, u, v));
+                } else {
+                    dest.extend_from_slice(&yuyv444_to_rgb(y, u, v));
+                }
+            }
+        }
+        dest
+    }
+
+    // runs `kernel` on every width and checks the part it converted against the scalar path
+    fn check_kernel(name: &str, block: usize, kernel: impl Fn(&[u8], &mut [u8], bool) -> usize) {
+        for rgba in [false, true] {
+            let pixel_size = if rgba { 4 } else { 3 };
+            for (seed, &width) in WIDTHS.iter().enumerate() {
+                let data = random_row(width, seed as u64);
+                let expected = scalar(&data, rgba);
+                let mut dest = vec![0; expected.len()];
+                let consumed = kernel(&data, &mut dest, rgba);
+                assert_eq!(
+                    consumed % block,
+                    0,
+                    "{name}: partial block at width {width}"
+                );
+                assert!(
+                    consumed <= data.len() && data.len() - consumed < block,
+                    "{name}: left {} bytes of {} at width {width}",
+                    data.len() - consumed,
+                    data.len()
+                );
+                let converted = consumed / 2 * pixel_size;
+                assert_eq!(
+                    dest[..converted],
+                    expected[..converted],
+                    "{name}: rgba {rgba}, width {width}"
+                );
+            }
+        }
+    }
+
+    #[cfg(target_arch = "x86_64")]
+    #[test]
+    fn sse2_matches_scalar() {
+        // SAFETY: SSE2 is part of the x86_64 baseline.
+        check_kernel("sse2", 16, |data, dest, rgba| unsafe {
+            super::x86::yuyv422_to_rgb_sse2(data, dest, rgba)
+        });
+    }
+
+    #[cfg(target_arch = "x86_64")]
+    #[test]
+    fn avx2_matches_scalar() {
+        if !is_x86_feature_detected!("avx2") {
+            return;
+        }
+        // SAFETY: we just checked that the CPU supports AVX2.
+        check_kernel("avx2", 32, |data, dest, rgba| unsafe {
+            super::x86::yuyv422_to_rgb_avx2(data, dest, rgba)
+        });
+    }
+
+    #[cfg(target_arch = "aarch64")]
+    #[test]
+    fn neon_matches_scalar() {
+        // SAFETY: NEON is part of the aarch64 baseline.
+        check_kernel("neon", 32, |data, dest, rgba| unsafe {
+            super::neon::yuyv422_to_rgb_neon(data, dest, rgba)
+        });
+    }
+
+    #[cfg(all(target_arch = "wasm32", target_feature = "simd128"))]
+    #[test]
+    fn simd128_matches_scalar() {
+        check_kernel("simd128", 16, super::wasm::yuyv422_to_rgb_simd128);
+    }
+
+    // the kernel the dispatcher picks, followed by the scalar tail, as `buf_yuyv422_to_rgb()` does it
+    #[test]
+    fn conversion_matches_scalar() {
+        for rgba in [false, true] {
+            for (seed, &width) in WIDTHS.iter().enumerate() {
+                let data = random_row(width, seed as u64 + 100);
+                let expected = scalar(&data, rgba);
+                let mut dest = vec![0; expected.len()];
+                buf_yuyv422_to_rgb(&data, &mut dest, rgba).unwrap();
+                assert_eq!(dest, expected, "rgba {rgba}, width {width}");
+            }
+        }
+    }
+}
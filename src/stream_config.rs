@@ -0,0 +1,138 @@
+/*
+ * Copyright 2022 l1npengtul <l1npengtul@protonmail.com> / The Nokhwa Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#[cfg(feature = "serde")]
+use serde::{Deserialize, Serialize};
+
+/// The default amount of buffers the driver captures into, see [`StreamConfig::buffer_count()`].
+pub const DEFAULT_BUFFER_COUNT: u32 = 4;
+
+/// How frame memory is shared between the driver and `nokhwa`, see [`StreamConfig::io_mode()`].
+///
+/// Only `V4L2` lets you choose. Every other backend manages its own memory, which is what [`IoMode::Mmap`] stands for there.
+#[derive(Copy, Clone, Debug, Hash, PartialEq, Eq, PartialOrd, Ord)]
+#[cfg_attr(feature = "serde", derive(Serialize, Deserialize))]
+pub enum IoMode {
+    /// The driver allocates the buffers and they are memory mapped into the process (`V4L2_MEMORY_MMAP`). Frames can be borrowed without a copy.
+    Mmap,
+    /// The buffers are allocated by `nokhwa` and handed to the driver (`V4L2_MEMORY_USERPTR`).
+    /// Some drivers (e.g. `uvcvideo`) copy every frame into them, which costs a copy but never pins driver memory.
+    UserPtr,
+    /// The driver allocates the buffers and exports them as `DMABUF` file descriptors (`VIDIOC_EXPBUF`), so frames can be handed to a GPU or encoder
+    /// without the CPU touching them. Get them with [`frame_dmabuf()`](crate::CaptureBackendTrait::frame_dmabuf), the other frame functions do not work in this mode.
+    DmaBuf,
+}
+
+impl Default for IoMode {
+    fn default() -> Self {
+        IoMode::Mmap
+    }
+}
+
+/// Which frame the backend hands out when more than one is waiting, see [`StreamConfig::dequeue_mode()`].
+#[derive(Copy, Clone, Debug, Hash, PartialEq, Eq, PartialOrd, Ord)]
+#[cfg_attr(feature = "serde", derive(Serialize, Deserialize))]
+pub enum DequeueMode {
+    /// Hand out every frame, oldest first. If frames are not taken fast enough, latency builds up until the driver runs out of buffers and drops frames.
+    Lossless,
+    /// Drain the driver's queue and hand out only the newest frame. The skipped frames show up in [`FrameMetadata::dropped_frames()`](crate::FrameMetadata::dropped_frames).
+    LowLatency,
+}
+
+impl Default for DequeueMode {
+    fn default() -> Self {
+        DequeueMode::Lossless
+    }
+}
+
+/// How a camera stream is set up, passed to [`open_stream_with()`](crate::CaptureBackendTrait::open_stream_with).
+///
+/// More buffers absorb CPU spikes without dropping frames, but every full buffer is a frame of latency in [`DequeueMode::Lossless`].
+///
+/// What each backend does with this:
+/// - `V4L2`: Everything.
+/// - `MSMF`: [`DequeueMode::LowLatency`] sets `MF_LOW_LATENCY` on the source reader and keeps a sample request in flight, so the newest sample is handed out.
+///   The buffer count is up to Media Foundation.
+/// - `GStreamer`: The buffer count is the `max-buffers` of the `appsink`, [`DequeueMode::LowLatency`] turns on its `drop`.
+/// - Other backends only take the default [`StreamConfig`].
+#[derive(Copy, Clone, Debug, Hash, PartialEq, Eq, PartialOrd, Ord)]
+#[cfg_attr(feature = "serde", derive(Serialize, Deserialize))]
+pub struct StreamConfig {
+    buffer_count: u32,
+    io_mode: IoMode,
+    dequeue_mode: DequeueMode,
+}
+
+impl StreamConfig {
+    /// Creates a new [`StreamConfig`]. `buffer_count` is at least 1.
+    #[must_use]
+    pub fn new(buffer_count: u32, io_mode: IoMode, dequeue_mode: DequeueMode) -> Self {
+        StreamConfig {
+            buffer_count: buffer_count.max(1),
+            io_mode,
+            dequeue_mode,
+        }
+    }
+
+    /// A [`StreamConfig`] for the lowest latency: 2 buffers (one being filled, one being read) and [`DequeueMode::LowLatency`].
+    #[must_use]
+    pub fn low_latency() -> Self {
+        StreamConfig::new(2, IoMode::default(), DequeueMode::LowLatency)
+    }
+
+    /// The amount of buffers the driver captures into.
+    #[must_use]
+    pub fn buffer_count(&self) -> u32 {
+        self.buffer_count
+    }
+
+    /// Sets the amount of buffers the driver captures into. This is at least 1.
+    pub fn set_buffer_count(&mut self, buffer_count: u32) {
+        self.buffer_count = buffer_count.max(1);
+    }
+
+    /// How frame memory is shared with the driver.
+    #[must_use]
+    pub fn io_mode(&self) -> IoMode {
+        self.io_mode
+    }
+
+    /// Sets how frame memory is shared with the driver.
+    pub fn set_io_mode(&mut self, io_mode: IoMode) {
+        self.io_mode = io_mode;
+    }
+
+    /// Which frame is handed out when more than one is waiting.
+    #[must_use]
+    pub fn dequeue_mode(&self) -> DequeueMode {
+        self.dequeue_mode
+    }
+
+    /// Sets which frame is handed out when more than one is waiting.
+    pub fn set_dequeue_mode(&mut self, dequeue_mode: DequeueMode) {
+        self.dequeue_mode = dequeue_mode;
+    }
+}
+
+impl Default for StreamConfig {
+    fn default() -> Self {
+        StreamConfig::new(
+            DEFAULT_BUFFER_COUNT,
+            IoMode::default(),
+            DequeueMode::default(),
+        )
+    }
+}
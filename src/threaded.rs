@@ -14,29 +14,95 @@
  * limitations under the License.
  */
 
+#[cfg(feature = "metrics")]
+use crate::MetricsSnapshot;
 use crate::{
-    Buffer, Camera, CameraControl, CameraFormat, CameraInfo, CaptureAPIBackend,
-    CaptureBackendTrait, FrameFormat, KnownCameraControl, NokhwaError, Resolution,
+    camera_group::ThreadWaker,
+    metrics::{self, MetricsHandle, Stage},
+    AutoMjpegDecoder, Buffer, BufferPool, Camera, CameraControl, CameraFormat, CameraInfo,
+    CaptureAPIBackend, DecodeScale, FrameFormat, FrameRing, FrameState, KnownCameraControl,
+    MjpegDecoder, NokhwaError, PixelFormat, Resolution, RgbFormat, RingPolicy, StreamConfig,
+    DEFAULT_RING_DEPTH,
 };
-use image::{ImageBuffer, Rgb};
-use parking_lot::Mutex;
+use flume::{Receiver, Sender};
+use parking_lot::{Mutex, MutexGuard};
 use std::{
     any::Any,
-    collections::HashMap,
+    collections::{BTreeMap, HashMap},
+    panic::{self, AssertUnwindSafe},
     sync::{
-        atomic::{AtomicBool, Ordering},
+        atomic::{AtomicBool, AtomicU32, AtomicU64, Ordering},
         Arc,
     },
+    task::{Context, Poll, Waker},
+    thread::Thread,
+    time::{Duration, Instant},
 };
 
 type AtomicLock<T> = Arc<Mutex<T>>;
-pub type CallbackFn = fn(
-    _camera: &Arc<Mutex<Camera>>,
-    _frame_callback: &Arc<Mutex<Option<Box<dyn FnMut(Buffer) + Send + 'static>>>>,
-    _last_frame_captured: &Arc<Mutex<Buffer>>,
-    _die_bool: &Arc<AtomicBool>,
-);
-type HeldCallbackType = Arc<Mutex<Option<Box<dyn FnMut(Buffer) + Send + 'static>>>>;
+pub type CallbackFn =
+    fn(_camera: &Arc<Mutex<Camera>>, _outputs: &Arc<FrameOutputs>, _die_bool: &Arc<AtomicBool>);
+type HeldCallbackType = Arc<Mutex<Option<FrameCallback>>>;
+type HeldFrameRing = Arc<FrameRing<Arc<Buffer>>>;
+type CameraCommand = Box<dyn FnOnce(&mut Camera) + Send + 'static>;
+
+// how long the capture thread sleeps while there is no stream (or a frame to wait for), unless it is woken
+const IDLE_WAIT: Duration = Duration::from_millis(50);
+// how long the capture thread backs off after the camera failed to give it a frame, doubling every time it fails again
+const MIN_ERROR_BACKOFF: Duration = Duration::from_millis(5);
+const MAX_ERROR_BACKOFF: Duration = Duration::from_millis(500);
+// how long a command waits for the capture thread to run it, before it takes the camera's lock itself. The capture thread
+// can be stuck handing out a frame (e.g. a full `RingPolicy::Block` ring that the caller would drain).
+const COMMAND_WAIT: Duration = Duration::from_millis(100);
+
+// the callback of a `CallbackCamera`
+enum FrameCallback {
+    // owns its frames, so every frame is copied for it
+    Owned(Box<dyn FnMut(Buffer) + Send + 'static>),
+    // gets the same `Arc` as the rings and subscribers, without a copy
+    Shared(Box<dyn FnMut(Arc<Buffer>) + Send + 'static>),
+}
+
+/// Settings for a [`CallbackCamera`].
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "output-threaded")))]
+#[derive(Copy, Clone, Debug, Hash, PartialEq, Eq)]
+pub struct CallbackCameraSettings {
+    /// The depth of the [`FrameRing`] that [`poll_frame()`](CallbackCamera::poll_frame) reads from.
+    pub ring_depth: usize,
+    /// What the [`FrameRing`] does when it is full.
+    pub ring_policy: RingPolicy,
+    /// If this is not `0`, `MJPEG` frames are decoded to RGB24 on this many worker threads instead of on the
+    /// capture thread. The capture thread then only dequeues compressed frames, so a slow decode does not make it miss the next frame.
+    /// Frames still come out in order.
+    pub decode_workers: usize,
+    /// The scale the decode workers decode `MJPEG` frames at. Decoding at a reduced scale is much cheaper than decoding
+    /// the full frame and resizing it. Does nothing if `decode_workers` is `0`.
+    pub decode_scale: DecodeScale,
+    /// If the decode workers should use the hardware JPEG decoder of the platform, if there is one (see [`AutoMjpegDecoder`]).
+    /// They fall back to `mozjpeg` if it fails. Does nothing if `decode_workers` is `0`.
+    pub hardware_decode: bool,
+    /// If this is not `0`, at most this many frames per second are handed out, the frames in between are given back to the [`BufferPool`] right away.
+    /// The camera still captures at its own frame rate, so the frames that are handed out are never stale. See [`set_target_fps()`](CallbackCamera::set_target_fps).
+    pub target_fps: u32,
+    /// If this is true, frames are handed out as the camera gave them (e.g. compressed `MJPEG`), marked as [`FrameState::Raw`].
+    /// Otherwise they are decoded like [`Camera::frame()`] does: `MJPEG` and `YUYV` frames to RGB888, planar and `GRAY8` frames are passed through.
+    /// `decode_workers` does nothing if this is true.
+    pub raw_frames: bool,
+}
+
+impl Default for CallbackCameraSettings {
+    fn default() -> Self {
+        CallbackCameraSettings {
+            ring_depth: DEFAULT_RING_DEPTH,
+            ring_policy: RingPolicy::default(),
+            decode_workers: 0,
+            decode_scale: DecodeScale::Full,
+            hardware_decode: true,
+            target_fps: 0,
+            raw_frames: false,
+        }
+    }
+}
 
 /// Creates a camera that runs in a different thread that you can use a callback to access the frames of.
 /// It uses a `Arc` and a `Mutex` to ensure that this feels like a normal camera, but callback based.
@@ -46,6 +112,26 @@ type HeldCallbackType = Arc<Mutex<Option<Box<dyn FnMut(Buffer) + Send + 'static>
 /// complete before a new frame is available. If you need to do heavy image processing, it may be
 /// beneficial to directly pipe the data to a new thread to process it there.
 ///
+/// Captured frames are put into a lock-free [`FrameRing`] that [`poll_frame()`](CallbackCamera::poll_frame) and
+/// [`last_frame()`](CallbackCamera::last_frame) read from, so reading frames never blocks the capture thread or copies the frame.
+/// The depth of the ring and what happens when it is full can be set with [`with_frame_ring()`](CallbackCamera::with_frame_ring).
+///
+/// Frames are decoded on the capture thread, like [`Camera::frame()`] does, unless [`CallbackCameraSettings::raw_frames`] is set.
+/// For `MJPEG` cameras, decoding can be moved off the capture thread onto a pool of workers with [`with_decode_workers()`](CallbackCamera::with_decode_workers).
+///
+/// Any amount of consumers can [`subscribe()`](CallbackCamera::subscribe) to the camera. Each gets the same `Arc`-shared frames
+/// (the pixel data is never copied) in its own queue with its own depth and [`RingPolicy`].
+///
+/// Frames are captured into buffers taken out of a [`BufferPool`] (see [`buffer_pool()`](CallbackCamera::buffer_pool)).
+/// Give the [`Buffer`]s your callback receives back to the pool once you are done with them, and capturing will not allocate
+/// per frame. A callback that takes a [`Buffer`] owns it, so it gets a copy of every frame. One set with
+/// [`set_shared_callback()`](CallbackCamera::set_shared_callback) gets the same `Arc` as the ring and the subscribers instead, and nothing is copied.
+///
+/// The capture thread only holds the camera's lock while it gets a frame, never while your callback runs. If the backend can tell when
+/// the next frame is ready (see [`poll_frame_ready()`](crate::CaptureBackendTrait::poll_frame_ready)), it sleeps until then without holding the lock at all.
+/// Changes to the camera's controls and format are handed to the capture thread and applied between two frames, so they never wait
+/// for a frame to be captured. If the camera fails to give it a frame, the capture thread backs off instead of retrying straight away.
+///
 /// Note that this does not have `WGPU` capabilities. However, it should be easy to implement.
 /// # SAFETY
 /// The `Mutex` guarantees exclusive access to the underlying camera struct. They should be safe to
@@ -53,9 +139,11 @@ type HeldCallbackType = Arc<Mutex<Option<Box<dyn FnMut(Buffer) + Send + 'static>
 #[cfg_attr(feature = "docs-features", doc(cfg(feature = "output-threaded")))]
 pub struct CallbackCamera {
     camera: AtomicLock<Camera>,
-    frame_callback: HeldCallbackType,
-    last_frame_captured: AtomicLock<Buffer>,
+    outputs: Arc<FrameOutputs>,
+    last_frame: Mutex<Arc<Buffer>>,
     die_bool: Arc<AtomicBool>,
+    // only there for the default capture function, which applies the commands between frames
+    commands: Option<CommandSender>,
 }
 
 impl CallbackCamera {
@@ -77,6 +165,52 @@ impl CallbackCamera {
         Self::customized_all(index, format, backend, None)
     }
 
+    /// Create a new camera from an `index`, `format`, and `backend`, with a [`FrameRing`] of `depth` frames that follows `policy` when it is full.
+    /// `format` can be `None`.
+    /// # Errors
+    /// This will error if you either have a bad platform configuration (e.g. `input-v4l` but not on linux) or the backend cannot create the camera (e.g. permission denied).
+    pub fn with_frame_ring(
+        index: usize,
+        format: Option<CameraFormat>,
+        backend: CaptureAPIBackend,
+        depth: usize,
+        policy: RingPolicy,
+    ) -> Result<Self, NokhwaError> {
+        Self::customized_with_settings(
+            index,
+            format,
+            backend,
+            None,
+            CallbackCameraSettings {
+                ring_depth: depth,
+                ring_policy: policy,
+                ..CallbackCameraSettings::default()
+            },
+        )
+    }
+
+    /// Create a new camera from an `index`, `format`, and `backend` that decodes `MJPEG` frames on `workers` worker threads.
+    /// `format` can be `None`. See [`CallbackCameraSettings::decode_workers`].
+    /// # Errors
+    /// This will error if you either have a bad platform configuration (e.g. `input-v4l` but not on linux) or the backend cannot create the camera (e.g. permission denied).
+    pub fn with_decode_workers(
+        index: usize,
+        format: Option<CameraFormat>,
+        backend: CaptureAPIBackend,
+        workers: usize,
+    ) -> Result<Self, NokhwaError> {
+        Self::customized_with_settings(
+            index,
+            format,
+            backend,
+            None,
+            CallbackCameraSettings {
+                decode_workers: workers,
+                ..CallbackCameraSettings::default()
+            },
+        )
+    }
+
     /// Create a new `ThreadedCamera` from raw values.
     /// # Errors
     /// This will error if you either have a bad platform configuration (e.g. `input-v4l` but not on linux) or the backend cannot create the camera (e.g. permission denied).
@@ -104,6 +238,29 @@ impl CallbackCamera {
         format: Option<CameraFormat>,
         backend: CaptureAPIBackend,
         func: Option<CallbackFn>,
+    ) -> Result<Self, NokhwaError> {
+        Self::customized_with_settings(
+            index,
+            format,
+            backend,
+            func,
+            CallbackCameraSettings::default(),
+        )
+    }
+
+    /// Create a new `ThreadedCamera` from raw values, including the raw capture function and the [`CallbackCameraSettings`].
+    ///
+    /// **This is meant for advanced users only.**
+    ///
+    /// See [`customized_all()`](CallbackCamera::customized_all).
+    /// # Errors
+    /// This will error if you either have a bad platform configuration (e.g. `input-v4l` but not on linux) or the backend cannot create the camera (e.g. permission denied).
+    pub fn customized_with_settings(
+        index: usize,
+        format: Option<CameraFormat>,
+        backend: CaptureAPIBackend,
+        func: Option<CallbackFn>,
+        settings: CallbackCameraSettings,
     ) -> Result<Self, NokhwaError> {
         let format = match format {
             Some(fmt) => fmt,
@@ -114,29 +271,29 @@ impl CallbackCamera {
             Some(format),
             backend,
         )?));
-        let frame_callback = Arc::new(Mutex::new(None));
-        let last_frame_captured = Arc::new(Mutex::new(Buffer::default()));
+        let metrics = camera.lock().metrics_handle().clone();
+        let outputs = Arc::new(FrameOutputs::new(index, settings, metrics)?);
         let die_bool = Arc::new(AtomicBool::new(false));
 
         let camera_clone = camera.clone();
-        let frame_callback_clone = frame_callback.clone();
-        let last_frame_captured_clone = last_frame_captured.clone();
+        let outputs_clone = outputs.clone();
         let die_bool_clone = die_bool.clone();
 
-        let thread_callback = match func {
-            Some(cb) => cb,
-            None => camera_frame_thread_loop,
+        let (thread_callback, command_sender) = match func {
+            Some(cb) => (cb, None),
+            None => {
+                let (sender, receiver) = flume::unbounded();
+                *outputs.commands.lock() = Some(receiver);
+                (camera_frame_thread_loop as CallbackFn, Some(sender))
+            }
         };
 
-        match std::thread::Builder::new()
+        let handle = match std::thread::Builder::new()
             .name(format!("CaptureProcessThreadofCamera {}", index))
             .spawn(move || {
-                thread_callback(
-                    &camera_clone,
-                    &frame_callback_clone,
-                    &last_frame_captured_clone,
-                    &die_bool_clone,
-                );
+                thread_callback(&camera_clone, &outputs_clone, &die_bool_clone);
+                // nothing is going to be captured any more, so nobody should wait for it
+                outputs_clone.sinks.close();
             }) {
             Ok(handle) => handle,
             Err(why) => {
@@ -146,15 +303,166 @@ impl CallbackCamera {
                 ))
             }
         };
+        let commands = command_sender.map(|sender| CommandSender {
+            sender,
+            capture_thread: handle.thread().clone(),
+        });
 
         Ok(CallbackCamera {
             camera,
-            frame_callback,
-            last_frame_captured,
+            outputs,
+            last_frame: Mutex::new(Arc::new(Buffer::default())),
             die_bool,
+            commands,
         })
     }
 
+    // Runs `command` on the capture thread between two frames and waits for it, so it does not have to wait for the camera's lock
+    // while a frame is being captured. Runs it right here if it is the capture thread itself calling (e.g. from the callback),
+    // if there is no capture thread to hand it to, or if the capture thread has not got to it within `COMMAND_WAIT`.
+    fn between_frames<T, F>(&self, command: F) -> Result<T, NokhwaError>
+    where
+        T: Send + 'static,
+        F: FnOnce(&mut Camera) -> Result<T, NokhwaError> + Send + 'static,
+    {
+        let commands = match &self.commands {
+            Some(commands) if commands.capture_thread.id() != std::thread::current().id() => {
+                commands
+            }
+            _ => return command(&mut *self.camera.lock()),
+        };
+
+        // whoever takes the command out of the slot first runs it, the capture thread or this one
+        let slot = Arc::new(Mutex::new(Some(command)));
+        let capture_slot = slot.clone();
+        let (reply_sender, reply) = flume::bounded(1);
+        let camera_command: CameraCommand = Box::new(move |camera| {
+            if let Some(command) = capture_slot.lock().take() {
+                let _reply_err = reply_sender.send(command(camera));
+            }
+        });
+        match commands.sender.send(camera_command) {
+            Ok(()) => commands.capture_thread.unpark(),
+            // the capture thread is gone, nobody else is using the camera
+            Err(flume::SendError(camera_command)) => camera_command(&mut *self.camera.lock()),
+        }
+        match reply.recv_timeout(COMMAND_WAIT) {
+            Ok(result) => result,
+            Err(_) => {
+                let command = slot.lock().take();
+                match command {
+                    Some(command) => command(&mut *self.camera.lock()),
+                    // the capture thread is running it right now
+                    None => reply.recv().unwrap_or_else(|_| {
+                        Err(NokhwaError::GeneralError(
+                            "Capture thread has stopped!".to_string(),
+                        ))
+                    }),
+                }
+            }
+        }
+    }
+
+    // wakes the capture thread up if it is waiting for the stream to be opened
+    fn wake_capture_thread(&self) {
+        if let Some(commands) = &self.commands {
+            commands.capture_thread.unpark();
+        }
+    }
+
+    /// Gets the [`BufferPool`] frames are captured into. Give [`Buffer`]s back to it with [`BufferPool::recycle_buffer()`] once you are done with them.
+    #[must_use]
+    pub fn buffer_pool(&self) -> BufferPool {
+        self.outputs.sinks.buffer_pool.clone()
+    }
+
+    /// Gets the depth of the [`FrameRing`].
+    #[must_use]
+    pub fn frame_ring_depth(&self) -> usize {
+        self.outputs.sinks.frame_ring.depth()
+    }
+
+    /// Gets the [`RingPolicy`] of the [`FrameRing`].
+    #[must_use]
+    pub fn frame_ring_policy(&self) -> RingPolicy {
+        self.outputs.sinks.frame_ring.policy()
+    }
+
+    /// Gets the amount of frames that were dropped because the [`FrameRing`] was full.
+    #[must_use]
+    pub fn dropped_frames(&self) -> u64 {
+        self.outputs.sinks.frame_ring.dropped()
+    }
+
+    /// Gets the amount of frames the driver dropped before they reached the capture thread, see [`FrameMetadata::dropped_frames()`](crate::FrameMetadata::dropped_frames).
+    #[must_use]
+    pub fn driver_dropped_frames(&self) -> u64 {
+        self.outputs.driver_dropped.load(Ordering::Relaxed)
+    }
+
+    /// Gets the amount of `MJPEG` decode worker threads. `0` means frames are not decoded.
+    #[must_use]
+    pub fn decode_workers(&self) -> usize {
+        self.outputs.decode_workers()
+    }
+
+    /// Gets the maximum amount of frames handed out per second. `0` means every frame is. See [`CallbackCameraSettings::target_fps`].
+    #[must_use]
+    pub fn target_fps(&self) -> u32 {
+        self.outputs.target_fps()
+    }
+
+    /// Sets the maximum amount of frames handed out per second, throttling the frames that come in faster. `0` hands out every frame.
+    /// This does not change the frame rate of the camera, see [`set_frame_rate()`](CallbackCamera::set_frame_rate) for that.
+    pub fn set_target_fps(&self, target_fps: u32) {
+        self.outputs.target_fps.store(target_fps, Ordering::Relaxed);
+    }
+
+    /// Gets the amount of frames that were not handed out because of the [`target_fps()`](CallbackCamera::target_fps).
+    #[must_use]
+    pub fn throttled_frames(&self) -> u64 {
+        self.outputs.throttled.load(Ordering::Relaxed)
+    }
+
+    #[cfg(feature = "metrics")]
+    #[cfg_attr(feature = "docs-features", doc(cfg(feature = "metrics")))]
+    /// Gets the capture metrics of this camera, including the time spent waiting on locks, decoding on the decode workers and in the callback.
+    /// This does not lock the camera. See [`MetricsSnapshot`].
+    #[must_use]
+    pub fn metrics(&self) -> MetricsSnapshot {
+        self.outputs.sinks.metrics.snapshot()
+    }
+
+    #[cfg(feature = "metrics")]
+    #[cfg_attr(feature = "docs-features", doc(cfg(feature = "metrics")))]
+    /// Resets the capture metrics of this camera, see [`metrics()`](CallbackCamera::metrics).
+    pub fn reset_metrics(&self) {
+        self.outputs.sinks.metrics.reset();
+    }
+
+    /// Subscribes to the frames of this camera. The returned [`FrameSubscription`] has its own queue of `depth` frames,
+    /// which follows `policy` when it is full. Frames are shared with an `Arc`, they are never copied.
+    ///
+    /// Note that a subscriber using [`RingPolicy::Block`] that does not keep up will stall the capture thread, and with it every other consumer.
+    #[must_use]
+    pub fn subscribe(&self, depth: usize, policy: RingPolicy) -> FrameSubscription {
+        let queue = Arc::new(FrameRing::new(depth, policy));
+        self.outputs.sinks.subscribers.lock().push(queue.clone());
+        FrameSubscription { queue }
+    }
+
+    /// Gets the amount of active [`FrameSubscription`]s.
+    #[must_use]
+    pub fn subscriber_count(&self) -> usize {
+        self.outputs
+            .sinks
+            .subscribers
+            .lock()
+            .iter()
+            .filter(|queue| !queue.is_closed())
+            .count()
+    }
+
     /// Gets the current Camera's index.
     #[must_use]
     pub fn index(&self) -> usize {
@@ -198,9 +506,12 @@ impl CallbackCamera {
     /// # Errors
     /// If you started the stream and the camera rejects the new camera format, this will return an error.
     pub fn set_camera_format(&mut self, new_fmt: CameraFormat) -> Result<(), NokhwaError> {
-        *self.last_frame_captured.lock() =
-            Buffer::new(new_res, Vec::default(), self.camera_format()?.format());
-        self.camera.lock().set_camera_format(new_fmt)
+        *self.last_frame.lock() = Arc::new(Buffer::new(
+            new_fmt.resolution(),
+            Vec::default(),
+            new_fmt.format(),
+        ));
+        self.between_frames(move |camera| camera.set_camera_format(new_fmt))
     }
 
     /// A hashmap of [`Resolution`]s mapped to framerates
@@ -231,9 +542,12 @@ impl CallbackCamera {
     /// # Errors
     /// If you started the stream and the camera rejects the new resolution, this will return an error.
     pub fn set_resolution(&mut self, new_res: Resolution) -> Result<(), NokhwaError> {
-        *self.last_frame_captured.lock() =
-            Buffer::new(new_res, Vec::default(), self.camera_format()?.format());
-        self.camera.lock().set_resolution(new_res)
+        *self.last_frame.lock() = Arc::new(Buffer::new(
+            new_res,
+            Vec::default(),
+            self.camera_format()?.format(),
+        ));
+        self.between_frames(move |camera| camera.set_resolution(new_res))
     }
 
     /// Gets the current camera framerate (See: [`CameraFormat`]).
@@ -247,7 +561,7 @@ impl CallbackCamera {
     /// # Errors
     /// If you started the stream and the camera rejects the new framerate, this will return an error.
     pub fn set_frame_rate(&mut self, new_fps: u32) -> Result<(), NokhwaError> {
-        self.camera.lock().set_frame_rate(new_fps)
+        self.between_frames(move |camera| camera.set_frame_rate(new_fps))
     }
 
     /// Gets the current camera's frame format (See: [`FrameFormat`], [`CameraFormat`]).
@@ -261,7 +575,7 @@ impl CallbackCamera {
     /// # Errors
     /// If you started the stream and the camera rejects the new frame format, this will return an error.
     pub fn set_frame_format(&mut self, fourcc: FrameFormat) -> Result<(), NokhwaError> {
-        self.camera.lock().set_frame_format(fourcc)
+        self.between_frames(move |camera| camera.set_frame_format(fourcc))
     }
 
     /// Gets the current supported list of [`KnownCameraControls`]
@@ -339,14 +653,14 @@ impl CallbackCamera {
         self.camera.lock().camera_control(control)
     }
 
-    /// Sets the control to `control` in the camera.
+    /// Sets the control to `control` in the camera. It is applied between two frames.
     /// Usually, the pipeline is calling [`camera_control()`](crate::CaptureBackendTrait::camera_control()), getting a camera control that way
     /// then calling one of the methods to set the value: [`set_value()`](CameraControl::set_value()) or [`with_value()`](CameraControl::with_value()).
     /// # Errors
     /// If the `control` is not supported, the value is invalid (less than min, greater than max, not in step), or there was an error setting the control,
     /// this will error.
     pub fn set_camera_control(&mut self, control: CameraControl) -> Result<(), NokhwaError> {
-        self.camera.lock().set_camera_control(control)
+        self.between_frames(move |camera| camera.set_camera_control(control))
     }
 
     /// Gets the current supported list of Controls as an `Any` from the backend.
@@ -386,35 +700,94 @@ impl CallbackCamera {
     /// The callback will be called every frame.
     /// # Errors
     /// If the specific backend fails to open the camera (e.g. already taken, busy, doesn't exist anymore) this will error.
-    pub fn open_stream<F>(&mut self, mut callback: F) -> Result<(), NokhwaError>
+    pub fn open_stream<F>(&mut self, callback: F) -> Result<(), NokhwaError>
     where
         F: (FnMut(Buffer)) + Send + 'static,
     {
-        *self.frame_callback.lock() = Some(Box::new(move |image: Buffer| callback(image)));
-        self.camera.lock().open_stream()
+        *self.outputs.sinks.frame_callback.lock() = Some(FrameCallback::Owned(Box::new(callback)));
+        self.camera.lock().open_stream()?;
+        self.wake_capture_thread();
+        Ok(())
+    }
+
+    /// Will open the camera stream like [`open_stream()`](CallbackCamera::open_stream()), with the driver buffers and dequeue behaviour set by `config`.
+    /// See [`StreamConfig`] for what each backend supports.
+    /// # Errors
+    /// If the backend does not support `config`, or fails to open the camera (e.g. already taken, busy, doesn't exist anymore) this will error.
+    pub fn open_stream_with<F>(
+        &mut self,
+        config: StreamConfig,
+        callback: F,
+    ) -> Result<(), NokhwaError>
+    where
+        F: (FnMut(Buffer)) + Send + 'static,
+    {
+        *self.outputs.sinks.frame_callback.lock() = Some(FrameCallback::Owned(Box::new(callback)));
+        self.camera.lock().open_stream_with(config)?;
+        self.wake_capture_thread();
+        Ok(())
+    }
+
+    /// Gets the [`StreamConfig`] the stream is opened with.
+    #[must_use]
+    pub fn stream_config(&self) -> StreamConfig {
+        self.camera.lock().stream_config()
     }
 
     /// Sets the frame callback to the new specified function. This function will be called instead of the previous one(s).
-    pub fn set_callback<F>(&mut self, mut callback: F)
+    pub fn set_callback<F>(&mut self, callback: F)
     where
         F: (FnMut(Buffer)) + Send + 'static,
     {
-        *self.frame_callback.lock() = Some(Box::new(move |image: Buffer| callback(image)));
+        *self.outputs.sinks.frame_callback.lock() = Some(FrameCallback::Owned(Box::new(callback)));
     }
 
-    /// Polls the camera for a frame, analogous to [`Camera::frame`](crate::Camera::frame)
+    /// Sets the frame callback to `callback`, which gets every frame as the same `Arc` that [`poll_frame()`](CallbackCamera::poll_frame),
+    /// [`last_frame()`](CallbackCamera::last_frame) and the subscribers get, so the frame is not copied for it.
+    /// This function will be called instead of the previous one(s).
+    pub fn set_shared_callback<F>(&mut self, callback: F)
+    where
+        F: (FnMut(Arc<Buffer>)) + Send + 'static,
+    {
+        *self.outputs.sinks.frame_callback.lock() = Some(FrameCallback::Shared(Box::new(callback)));
+    }
+
+    /// Polls the camera for a frame, analogous to [`Camera::frame`](crate::Camera::frame).
+    ///
+    /// This takes the oldest frame out of the [`FrameRing`], waiting for the capture thread if it is empty. The frame is not copied.
     /// # Errors
-    /// This will error if the camera fails to capture a frame.
-    pub fn poll_frame(&mut self) -> Result<Buffer, NokhwaError> {
-        let frame = self.camera.lock().frame()?;
-        *self.last_frame_captured.lock() = frame.clone();
-        Ok(frame)
+    /// This will error if the stream is not open or the camera was dropped.
+    pub fn poll_frame(&mut self) -> Result<Arc<Buffer>, NokhwaError> {
+        if !self.is_stream_open() {
+            return Err(NokhwaError::ReadFrameError(
+                "Stream not initialized! Please call \"open_stream()\" first!".to_string(),
+            ));
+        }
+
+        // the ring is closed when the camera is dropped
+        self.outputs
+            .sinks
+            .frame_ring
+            .pop_wait()
+            .ok_or_else(|| NokhwaError::ReadFrameError("Capture thread has stopped!".to_string()))
     }
 
-    /// Gets the last frame captured by the camera.
+    /// Takes the oldest frame out of the [`FrameRing`] if there is one, without waiting. The frame is not copied.
     #[must_use]
-    pub fn last_frame(&self) -> ImageBuffer<Rgb<u8>, Vec<u8>> {
-        self.last_frame_captured.lock().clone()
+    pub fn try_poll_frame(&mut self) -> Option<Arc<Buffer>> {
+        self.outputs.sinks.frame_ring.pop()
+    }
+
+    /// Gets the last frame captured by the camera. This does not wait for or block the capture thread, and does not copy the frame.
+    ///
+    /// If no frame has been captured yet, the [`Buffer`] will be empty.
+    #[must_use]
+    pub fn last_frame(&self) -> Arc<Buffer> {
+        let mut last_frame = self.last_frame.lock();
+        if let Some(newest) = self.outputs.sinks.newest_frame.pop_newest() {
+            *last_frame = newest;
+        }
+        last_frame.clone()
     }
 
     /// Checks if stream if open. If it is, it will return true.
@@ -431,31 +804,479 @@ impl CallbackCamera {
     }
 }
 
-impl<C> Drop for CallbackCamera<C>
-where
-    C: CaptureBackendTrait,
-{
+impl Drop for CallbackCamera {
     fn drop(&mut self) {
         let _stop_stream_err = self.stop_stream();
         self.die_bool.store(true, Ordering::SeqCst);
+        // wake up the capture thread if it is blocked on a full ring, or sleeping
+        self.outputs.sinks.close();
+        self.wake_capture_thread();
+    }
+}
+
+/// A subscription to the frames of a [`CallbackCamera`], see [`CallbackCamera::subscribe()`].
+///
+/// Dropping this unsubscribes.
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "output-threaded")))]
+#[derive(Debug)]
+pub struct FrameSubscription {
+    queue: HeldFrameRing,
+}
+
+impl FrameSubscription {
+    /// Takes the oldest frame out of this subscription's queue, waiting for one if it is empty.
+    ///
+    /// Returns `None` if the camera was dropped.
+    #[must_use]
+    pub fn recv(&self) -> Option<Arc<Buffer>> {
+        self.queue.pop_wait()
+    }
+
+    /// Takes the oldest frame out of this subscription's queue, if there is one.
+    #[must_use]
+    pub fn try_recv(&self) -> Option<Arc<Buffer>> {
+        self.queue.pop()
+    }
+
+    /// The amount of frames waiting in this subscription's queue.
+    #[must_use]
+    pub fn len(&self) -> usize {
+        self.queue.len()
+    }
+
+    /// Checks if there are no frames waiting in this subscription's queue.
+    #[must_use]
+    pub fn is_empty(&self) -> bool {
+        self.queue.is_empty()
+    }
+
+    /// The depth of this subscription's queue.
+    #[must_use]
+    pub fn depth(&self) -> usize {
+        self.queue.depth()
+    }
+
+    /// The [`RingPolicy`] of this subscription's queue.
+    #[must_use]
+    pub fn policy(&self) -> RingPolicy {
+        self.queue.policy()
+    }
+
+    /// The amount of frames this subscriber missed because its queue was full.
+    #[must_use]
+    pub fn dropped(&self) -> u64 {
+        self.queue.dropped()
     }
 }
 
-fn camera_frame_thread_loop<C: CaptureBackendTrait>(
-    camera: &AtomicLock<Camera<C>>,
-    frame_callback: &HeldCallbackType,
-    last_frame_captured: &AtomicLock<ImageBuffer<Rgb<u8>, Vec<u8>>>,
+impl Drop for FrameSubscription {
+    fn drop(&mut self) {
+        // the capture thread removes closed queues, and stops waiting on this one if it is blocked
+        self.queue.close();
+    }
+}
+
+// Gives the frame's storage back to the pool, if nobody else is holding on to it.
+fn recycle_frame(frame: Option<Arc<Buffer>>, buffer_pool: &BufferPool) {
+    if let Some(frame) = frame {
+        if let Ok(buffer) = Arc::try_unwrap(frame) {
+            buffer_pool.recycle_buffer(buffer);
+        }
+    }
+}
+
+// Hands commands to the default capture function, see `CallbackCamera::between_frames()`.
+struct CommandSender {
+    sender: Sender<CameraCommand>,
+    capture_thread: Thread,
+}
+
+/// Where a capture function puts the frames it captured, see [`CallbackCamera::customized_all()`].
+#[cfg_attr(feature = "docs-features", doc(cfg(feature = "output-threaded")))]
+pub struct FrameOutputs {
+    sinks: Arc<FrameSinks>,
+    decoder: Option<DecodePool>,
+    sequence: AtomicU64,
+    driver_dropped: AtomicU64,
+    target_fps: AtomicU32,
+    throttled: AtomicU64,
+    raw_frames: bool,
+    // decodes the frames on the thread that submits them, if there are no decode workers
+    inline_decoder: Mutex<MjpegDecoder>,
+    // taken by the default capture function. Dropped with it, so nobody waits on a command that is never run
+    commands: Mutex<Option<Receiver<CameraCommand>>>,
+}
+
+impl FrameOutputs {
+    fn new(
+        index: usize,
+        settings: CallbackCameraSettings,
+        metrics: MetricsHandle,
+    ) -> Result<Self, NokhwaError> {
+        let sinks = Arc::new(FrameSinks {
+            frame_callback: Arc::new(Mutex::new(None)),
+            frame_ring: Arc::new(FrameRing::new(settings.ring_depth, settings.ring_policy)),
+            // only ever holds the newest frame(s) for `last_frame()`
+            newest_frame: Arc::new(FrameRing::new(2, RingPolicy::DropOldest)),
+            subscribers: Mutex::new(Vec::new()),
+            subscriber_queues: Mutex::new(Vec::new()),
+            buffer_pool: BufferPool::default(),
+            metrics,
+        });
+        let decoder = if settings.decode_workers == 0 || settings.raw_frames {
+            None
+        } else {
+            Some(DecodePool::new(index, settings, &sinks)?)
+        };
+
+        Ok(FrameOutputs {
+            sinks,
+            decoder,
+            sequence: AtomicU64::new(0),
+            driver_dropped: AtomicU64::new(0),
+            target_fps: AtomicU32::new(settings.target_fps),
+            throttled: AtomicU64::new(0),
+            raw_frames: settings.raw_frames,
+            inline_decoder: Mutex::new(MjpegDecoder::new(false)),
+            commands: Mutex::new(None),
+        })
+    }
+
+    /// The [`BufferPool`] frames should be captured into.
+    #[must_use]
+    pub fn buffer_pool(&self) -> &BufferPool {
+        &self.sinks.buffer_pool
+    }
+
+    /// The amount of `MJPEG` decode worker threads. `0` means frames are not decoded.
+    #[must_use]
+    pub fn decode_workers(&self) -> usize {
+        self.decoder.as_ref().map_or(0, |decoder| decoder.workers)
+    }
+
+    /// The maximum amount of frames per second that should be submitted. `0` means every frame should be.
+    #[must_use]
+    pub fn target_fps(&self) -> u32 {
+        self.target_fps.load(Ordering::Relaxed)
+    }
+
+    /// Hands a captured frame to the callback, [`FrameRing`] and subscribers, giving it the next sequence number.
+    ///
+    /// Raw frames are decoded first, unless [`CallbackCameraSettings::raw_frames`] is set. If decode workers are used,
+    /// this does not wait for `MJPEG` frames to be decoded. Frames that fail to decode are dropped.
+    pub fn submit(&self, frame: Buffer) {
+        let _scope = self.sinks.metrics.enter();
+        self.driver_dropped
+            .fetch_add(frame.metadata().dropped_frames(), Ordering::Relaxed);
+        let frame = frame.with_sequence(self.sequence.fetch_add(1, Ordering::Relaxed));
+        match &self.decoder {
+            Some(decoder)
+                if !frame.is_decoded() && frame.source_frame_format() == FrameFormat::MJPEG =>
+            {
+                decoder.submit(frame);
+            }
+            _ => {
+                if let Some(frame) = self.decode(frame) {
+                    self.sinks.deliver(frame);
+                }
+            }
+        }
+    }
+
+    // decodes `frame` on this thread the way `Camera::frame()` would, into a buffer out of the pool
+    fn decode(&self, frame: Buffer) -> Option<Buffer> {
+        if self.raw_frames || frame.is_decoded() {
+            return Some(frame);
+        }
+        let buffer_pool = self.buffer_pool();
+        let decoded = match frame.source_frame_format() {
+            FrameFormat::MJPEG => frame.decode_with(&mut *self.inline_decoder.lock(), buffer_pool),
+            FrameFormat::YUYV => {
+                let resolution = frame.resolution();
+                let mut rgb = buffer_pool.take(RgbFormat::output_size(resolution));
+                let converted = RgbFormat::convert(
+                    FrameFormat::YUYV,
+                    resolution,
+                    frame.buffer(),
+                    frame.planes(),
+                    &mut rgb,
+                );
+                match converted {
+                    Ok(()) => Ok(Buffer::new(resolution, rgb, FrameFormat::YUYV)
+                        .with_state(FrameState::Rgb)
+                        .with_sequence(frame.sequence())
+                        .with_metadata(frame.metadata())),
+                    Err(why) => {
+                        buffer_pool.recycle(rgb);
+                        Err(why)
+                    }
+                }
+            }
+            // passed through as they are, see `Buffer::planes()`
+            FrameFormat::NV12 | FrameFormat::I420 | FrameFormat::GRAY8 => return Some(frame),
+        };
+        buffer_pool.recycle_buffer(frame);
+        decoded.ok()
+    }
+}
+
+struct FrameSinks {
+    frame_callback: HeldCallbackType,
+    frame_ring: HeldFrameRing,
+    newest_frame: HeldFrameRing,
+    subscribers: Mutex<Vec<HeldFrameRing>>,
+    // copy of the subscriber list, so the lock is not held while pushing (which may block)
+    subscriber_queues: Mutex<Vec<HeldFrameRing>>,
+    buffer_pool: BufferPool,
+    metrics: MetricsHandle,
+}
+
+impl FrameSinks {
+    fn deliver(&self, frame: Buffer) {
+        let _scope = self.metrics.enter();
+        let mut frame_callback = {
+            let _timer = metrics::time(Stage::LockWait);
+            self.frame_callback.lock()
+        };
+        let frame = Arc::new(frame);
+        match (*frame_callback).as_mut() {
+            Some(FrameCallback::Owned(cb)) => {
+                // the callback owns its frame while the rings share theirs, give it a pooled copy
+                let frame = frame.to_pooled_buffer(&self.buffer_pool);
+                let _timer = metrics::time(Stage::Callback);
+                cb(frame);
+            }
+            Some(FrameCallback::Shared(cb)) => {
+                let _timer = metrics::time(Stage::Callback);
+                cb(frame.clone());
+            }
+            None => {}
+        }
+        drop(frame_callback);
+        recycle_frame(self.newest_frame.push(frame.clone()), &self.buffer_pool);
+
+        let mut subscriber_queues = {
+            let _timer = metrics::time(Stage::LockWait);
+            self.subscriber_queues.lock()
+        };
+        {
+            let mut subscribers = {
+                let _timer = metrics::time(Stage::LockWait);
+                self.subscribers.lock()
+            };
+            subscribers.retain(|queue| !queue.is_closed());
+            subscriber_queues.clone_from(&subscribers);
+        }
+        for queue in subscriber_queues.iter() {
+            self.recycle_dropped(queue.push(frame.clone()));
+        }
+        // with `RingPolicy::Block` this waits for a consumer
+        self.recycle_dropped(self.frame_ring.push(frame));
+        metrics::record_queue_depth(self.frame_ring.len());
+    }
+
+    // like `recycle_frame()`, but also counts the frame as dropped by a queue
+    fn recycle_dropped(&self, frame: Option<Arc<Buffer>>) {
+        if frame.is_some() {
+            metrics::record_queue_drop();
+        }
+        recycle_frame(frame, &self.buffer_pool);
+    }
+
+    fn close(&self) {
+        self.frame_ring.close();
+        self.newest_frame.close();
+        for queue in self.subscribers.lock().iter() {
+            queue.close();
+        }
+    }
+}
+
+// Decodes MJPEG frames on a pool of worker threads. Every frame gets a job number, a reorder thread delivers
+// the decoded frames in job order, no matter which worker finishes first.
+struct DecodePool {
+    jobs: Sender<(u64, Buffer)>,
+    next_job: AtomicU64,
+    workers: usize,
+}
+
+impl DecodePool {
+    fn new(
+        index: usize,
+        settings: CallbackCameraSettings,
+        sinks: &Arc<FrameSinks>,
+    ) -> Result<Self, NokhwaError> {
+        let workers = settings.decode_workers;
+        // a couple of frames of slack per worker, after that the capture thread waits
+        let (job_sender, job_receiver) = flume::bounded::<(u64, Buffer)>(workers * 2);
+        let (done_sender, done_receiver) = flume::unbounded::<(u64, Option<Buffer>)>();
+        let thread_error = |why: std::io::Error| {
+            NokhwaError::OpenDeviceError(index.to_string(), format!("ThreadError: {}", why))
+        };
+
+        for worker in 0..workers {
+            let job_receiver = job_receiver.clone();
+            let done_sender = done_sender.clone();
+            let buffer_pool = sinks.buffer_pool.clone();
+            let metrics = sinks.metrics.clone();
+            std::thread::Builder::new()
+                .name(format!("DecodeThread {} ofCamera {}", worker, index))
+                .spawn(move || {
+                    // every worker keeps its own decoder, so its settings and buffers are reused between frames
+                    let new_decoder = || {
+                        if settings.hardware_decode {
+                            AutoMjpegDecoder::with_scale(false, settings.decode_scale)
+                        } else {
+                            AutoMjpegDecoder::software(false, settings.decode_scale)
+                        }
+                    };
+                    let mut decoder = new_decoder();
+                    let _scope = metrics.enter();
+                    for (job, raw) in job_receiver.iter() {
+                        // a panicking decoder must still hand in its job number, or the reorder thread waits for it forever
+                        let decoded = match panic::catch_unwind(AssertUnwindSafe(|| {
+                            raw.decode_with(&mut decoder, &buffer_pool)
+                        })) {
+                            Ok(decoded) => decoded.ok(),
+                            Err(_) => {
+                                decoder = new_decoder();
+                                None
+                            }
+                        };
+                        buffer_pool.recycle_buffer(raw);
+                        if done_sender.send((job, decoded)).is_err() {
+                            break;
+                        }
+                    }
+                })
+                .map_err(thread_error)?;
+        }
+
+        let sinks = sinks.clone();
+        std::thread::Builder::new()
+            .name(format!("DecodeReorderThreadofCamera {}", index))
+            .spawn(move || {
+                // every job reports back (even a panicking one), so waiting for the next job in order always ends
+                let mut pending = BTreeMap::new();
+                let mut next_job = 0;
+                for (job, decoded) in done_receiver.iter() {
+                    pending.insert(job, decoded);
+                    while let Some(decoded) = pending.remove(&next_job) {
+                        // frames that failed to decode are skipped, but still take up their job number
+                        if let Some(frame) = decoded {
+                            sinks.deliver(frame);
+                        }
+                        next_job += 1;
+                    }
+                }
+            })
+            .map_err(thread_error)?;
+
+        Ok(DecodePool {
+            jobs: job_sender,
+            next_job: AtomicU64::new(0),
+            workers,
+        })
+    }
+
+    fn submit(&self, frame: Buffer) {
+        let job = self.next_job.fetch_add(1, Ordering::Relaxed);
+        // only fails if every worker is gone, in which case there is nobody to hand the frame to anyway
+        let _send_err = self.jobs.send((job, frame));
+    }
+}
+
+// Lets through at most `target_fps` frames per second.
+#[derive(Default)]
+struct Throttle {
+    next_frame: Option<Instant>,
+}
+
+impl Throttle {
+    fn admit(&mut self, target_fps: u32, now: Instant) -> bool {
+        if target_fps == 0 {
+            self.next_frame = None;
+            return true;
+        }
+        let interval = Duration::from_secs(1) / target_fps;
+        // frames never come in exactly on time, let through the ones that are a bit early
+        let slack = interval / 4;
+        match self.next_frame {
+            Some(next_frame) if now + slack < next_frame => false,
+            Some(next_frame) if now < next_frame + interval => {
+                self.next_frame = Some(next_frame + interval);
+                true
+            }
+            // first frame, or we fell behind: start counting from here instead of letting a burst through
+            _ => {
+                self.next_frame = Some(now + interval);
+                true
+            }
+        }
+    }
+}
+
+fn camera_frame_thread_loop(
+    camera: &AtomicLock<Camera>,
+    outputs: &Arc<FrameOutputs>,
     die_bool: &Arc<AtomicBool>,
 ) {
-    loop {
-        if let Ok(img) = camera.lock().fr {
-            *last_frame_captured.lock() = img.clone();
-            if let Some(cb) = (*frame_callback.lock()).as_mut() {
-                cb(img);
+    let _scope = outputs.sinks.metrics.enter();
+    let commands = outputs.commands.lock().take();
+    let waker = Waker::from(Arc::new(ThreadWaker(std::thread::current())));
+    let mut cx = Context::from_waker(&waker);
+    let mut throttle = Throttle::default();
+    let mut backoff = MIN_ERROR_BACKOFF;
+
+    while !die_bool.load(Ordering::SeqCst) {
+        let mut locked = {
+            let _timer = metrics::time(Stage::LockWait);
+            camera.lock()
+        };
+        // control and format changes go in between frames
+        if let Some(commands) = &commands {
+            for command in commands.try_iter() {
+                command(&mut *locked);
             }
         }
-        if die_bool.load(Ordering::SeqCst) {
-            break;
+        if !locked.is_stream_open() {
+            drop(locked);
+            std::thread::park_timeout(IDLE_WAIT);
+            continue;
+        }
+        // if the backend can tell, sleep until the frame is there without holding the lock
+        match locked.poll_frame_ready(&mut cx) {
+            Poll::Ready(Ok(())) => {}
+            Poll::Ready(Err(_)) => {
+                drop(locked);
+                std::thread::park_timeout(backoff);
+                backoff = (backoff * 2).min(MAX_ERROR_BACKOFF);
+                continue;
+            }
+            Poll::Pending => {
+                drop(locked);
+                std::thread::park_timeout(IDLE_WAIT);
+                continue;
+            }
+        }
+
+        let captured = locked.frame_pooled(outputs.buffer_pool());
+        // hand the lock to whoever is waiting for it, instead of taking it right back
+        MutexGuard::unlock_fair(locked);
+        match captured {
+            Ok(frame) => {
+                backoff = MIN_ERROR_BACKOFF;
+                if throttle.admit(outputs.target_fps(), Instant::now()) {
+                    outputs.submit(frame);
+                } else {
+                    outputs.throttled.fetch_add(1, Ordering::Relaxed);
+                    outputs.buffer_pool().recycle_buffer(frame);
+                }
+            }
+            Err(_) => {
+                std::thread::park_timeout(backoff);
+                backoff = (backoff * 2).min(MAX_ERROR_BACKOFF);
+            }
         }
     }
 }
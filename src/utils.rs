@@ -14,7 +14,13 @@
  * limitations under the License.
  */
 
-use crate::{pixel_format::PixelFormat, NokhwaError};
+use crate::{
+    buffer::tight_layout,
+    decoder::with_shared_decoder,
+    metrics::{self, Stage},
+    parallel::for_each_stripe,
+    NokhwaError, Plane,
+};
 #[cfg(any(
     all(
         feature = "input-avfoundation",
@@ -54,6 +60,10 @@ use wasm_bindgen::prelude::wasm_bindgen;
 /// Describes a frame format (i.e. how the bytes themselves are encoded). Often called `FourCC`.
 /// - YUYV is a mathematical color space. You can read more [here.](https://en.wikipedia.org/wiki/YCbCr)
 /// - MJPEG is a motion-jpeg compressed frame, it allows for high frame rates.
+/// - NV12 is a planar YUV 4:2:0 format: a full size luma (Y) plane, followed by one half size plane of interleaved chroma (U, V).
+/// - I420 (also called YUV420P or YU12) is a planar YUV 4:2:0 format: a full size luma (Y) plane, followed by a half size U plane and a half size V plane.
+///
+/// Planar formats are kept as they are (see [`Buffer::planes()`](crate::Buffer::planes)), so they can be handed to a GPU or an encoder without converting to RGB first.
 /// # JS-WASM
 /// This is exported as `FrameFormat`
 #[derive(Copy, Clone, Debug, Hash, Ord, PartialOrd, Eq, PartialEq)]
@@ -62,6 +72,42 @@ pub enum FrameFormat {
     MJPEG,
     YUYV,
     GRAY8,
+    NV12,
+    I420,
+}
+
+impl FrameFormat {
+    /// The amount of planes a frame of this format has. This is `1` for every packed (or compressed) format.
+    #[must_use]
+    pub const fn plane_count(self) -> usize {
+        match self {
+            FrameFormat::MJPEG | FrameFormat::YUYV | FrameFormat::GRAY8 => 1,
+            FrameFormat::NV12 => 2,
+            FrameFormat::I420 => 3,
+        }
+    }
+
+    /// Checks if the frame format is planar (i.e. has more than one plane).
+    #[must_use]
+    pub const fn is_planar(self) -> bool {
+        self.plane_count() > 1
+    }
+
+    /// The `DRM` fourcc (from `drm_fourcc.h`) of the format, used to import a [`DmaBuf`](crate::DmaBuf) into a GPU or encoder.
+    /// `None` for compressed formats.
+    #[must_use]
+    pub const fn drm_fourcc(self) -> Option<u32> {
+        const fn fourcc(code: &[u8; 4]) -> u32 {
+            u32::from_le_bytes(*code)
+        }
+        match self {
+            FrameFormat::MJPEG => None,
+            FrameFormat::YUYV => Some(fourcc(b"YUYV")),
+            FrameFormat::GRAY8 => Some(fourcc(b"R8  ")),
+            FrameFormat::NV12 => Some(fourcc(b"NV12")),
+            FrameFormat::I420 => Some(fourcc(b"YU12")),
+        }
+    }
 }
 
 impl Display for FrameFormat {
@@ -76,19 +122,16 @@ impl Display for FrameFormat {
             FrameFormat::GRAY8 => {
                 write!(f, "GRAY8")
             }
+            FrameFormat::NV12 => {
+                write!(f, "NV12")
+            }
+            FrameFormat::I420 => {
+                write!(f, "I420")
+            }
         }
     }
 }
 
-impl<P> From<P> for FrameFormat
-where
-    P: PixelFormat,
-{
-    fn from(_: P) -> Self {
-        P::CODE
-    }
-}
-
 #[cfg(feature = "input-uvc")]
 impl From<FrameFormat> for uvc::FrameFormat {
     fn from(ff: FrameFormat) -> Self {
@@ -109,6 +152,8 @@ impl From<MFFrameFormat> for FrameFormat {
             MFFrameFormat::MJPEG => FrameFormat::MJPEG,
             MFFrameFormat::YUYV => FrameFormat::YUYV,
             MFFrameFormat::GRAY8 => FrameFormat::GRAY8,
+            MFFrameFormat::NV12 => FrameFormat::NV12,
+            MFFrameFormat::I420 => FrameFormat::I420,
         }
     }
 }
@@ -123,6 +168,8 @@ impl From<FrameFormat> for MFFrameFormat {
             FrameFormat::MJPEG => MFFrameFormat::MJPEG,
             FrameFormat::YUYV => MFFrameFormat::YUYV,
             FrameFormat::GRAY8 => MFFrameFormat::GRAY8, //FIXME
+            FrameFormat::NV12 => MFFrameFormat::NV12,
+            FrameFormat::I420 => MFFrameFormat::I420,
         }
     }
 }
@@ -144,6 +191,8 @@ impl From<AVFourCC> for FrameFormat {
             AVFourCC::YUV2 => FrameFormat::YUYV,
             AVFourCC::MJPEG => FrameFormat::MJPEG,
             AVFourCC::GRAY8 => FrameFormat::GRAY8,
+            AVFourCC::NV12 => FrameFormat::NV12,
+            AVFourCC::I420 => FrameFormat::I420,
         }
     }
 }
@@ -165,12 +214,20 @@ impl From<FrameFormat> for AVFourCC {
             FrameFormat::MJPEG => AVFourCC::MJPEG,
             FrameFormat::YUYV => AVFourCC::YUV2,
             FrameFormat::GRAY8 => AVFourCC::GRAY8,
+            FrameFormat::NV12 => AVFourCC::NV12,
+            FrameFormat::I420 => AVFourCC::I420,
         }
     }
 }
 
-pub const fn frame_formats() -> [FrameFormat; 3] {
-    [FrameFormat::MJPEG, FrameFormat::YUYV, FrameFormat::GRAY8]
+pub const fn frame_formats() -> [FrameFormat; 5] {
+    [
+        FrameFormat::MJPEG,
+        FrameFormat::YUYV,
+        FrameFormat::GRAY8,
+        FrameFormat::NV12,
+        FrameFormat::I420,
+    ]
 }
 
 /// Describes a Resolution.
@@ -445,6 +502,8 @@ impl From<CameraFormat> for Format {
             FrameFormat::MJPEG => FourCC::new(b"MJPG"),
             FrameFormat::YUYV => FourCC::new(b"YUYV"),
             FrameFormat::GRAY8 => FourCC::new(b"GREY"),
+            FrameFormat::NV12 => FourCC::new(b"NV12"),
+            FrameFormat::I420 => FourCC::new(b"YU12"),
         };
 
         Format::new(cam_fmt.width(), cam_fmt.height(), pxfmt)
@@ -1098,8 +1157,9 @@ impl Display for ControlValueSetter {
 /// - `MediaFoundation` - Microsoft Media Foundation, Windows only,
 /// - `OpenCV` - Uses `OpenCV` to capture. Platform agnostic.
 /// - `GStreamer` - Uses `GStreamer` RTP to capture. Platform agnostic.
-/// - `Network` - Uses `OpenCV` to capture from an IP.
+/// - `Network` - Uses `OpenCV` (`input-ipcam`) or the native [`NetworkCaptureDevice`](crate::backends::capture::NetworkCaptureDevice) (`input-network`) to capture from an IP camera.
 /// - `Browser` - Uses browser APIs to capture from a webcam.
+/// - `Replay` - Replays a recording made with `FrameRecorder`. Platform agnostic.
 #[derive(Copy, Clone, Debug, Hash, Ord, PartialOrd, Eq, PartialEq)]
 #[cfg_attr(feature = "serde", derive(Serialize, Deserialize))]
 pub enum CaptureAPIBackend {
@@ -1114,6 +1174,7 @@ pub enum CaptureAPIBackend {
     GStreamer,
     Network,
     Browser,
+    Replay,
 }
 
 impl Display for CaptureAPIBackend {
@@ -1189,110 +1250,26 @@ impl Display for CaptureAPIBackend {
 // }
 
 /// Converts a MJPEG stream of [u8] into a Vec<u8> of RGB888. (R,G,B,R,G,B,...)
+///
+/// A decoder is kept per thread, but the returned frame is always a new allocation.
+/// If you are decoding a stream, use a [`MjpegDecoder`](crate::MjpegDecoder) instead, which reuses its buffer between frames.
 /// # Errors
-/// If `mozjpeg` fails to read scanlines or setup the decompressor, this will error.
-/// # Safety
-/// This function uses `unsafe`. The caller must ensure that:
-/// - The input data is of the right size, does not exceed bounds, and/or the final size matches with the initial size.
-#[cfg(all(feature = "decoding", not(target_arch = "wasm")))]
-#[cfg_attr(feature = "docs-features", doc(cfg(feature = "decoding")))]
+/// If `mozjpeg` fails to read scanlines or setup the decompressor, or `decoding` is not enabled, this will error.
 pub fn mjpeg_to_rgb(data: &[u8], rgba: bool) -> Result<Vec<u8>, NokhwaError> {
-    use mozjpeg::Decompress;
-
-    let mut jpeg_decompress = match Decompress::new_mem(data) {
-        Ok(decompress) => {
-            let decompressor_res = if rgba {
-                decompress.rgba()
-            } else {
-                decompress.rgb()
-            };
-            match decompressor_res {
-                Ok(decompressor) => decompressor,
-                Err(why) => {
-                    return Err(NokhwaError::ProcessFrameError {
-                        src: FrameFormat::MJPEG,
-                        destination: "RGB888".to_string(),
-                        error: why.to_string(),
-                    })
-                }
-            }
-        }
-        Err(why) => {
-            return Err(NokhwaError::ProcessFrameError {
-                src: FrameFormat::MJPEG,
-                destination: "RGB888".to_string(),
-                error: why.to_string(),
-            })
-        }
-    };
-
-    let scanlines_res: Option<Vec<u8>> = jpeg_decompress.read_scanlines_flat();
-    assert!(jpeg_decompress.finish_decompress());
-
-    match scanlines_res {
-        Some(pixels) => Ok(pixels),
-        None => Err(NokhwaError::ProcessFrameError {
-            src: FrameFormat::MJPEG,
-            destination: "RGB888".to_string(),
-            error: "Failed to get read readlines into RGB888 pixels!".to_string(),
-        }),
-    }
-}
-
-#[cfg(not(all(feature = "decoding", not(target_arch = "wasm"))))]
-pub fn mjpeg_to_rgb(data: &[u8], rgba: bool) -> Result<Vec<u8>, NokhwaError> {
-    Err(NokhwaError::NotImplementedError(
-        "Not available on WASM".to_string(),
-    ))
+    with_shared_decoder(rgba, |decoder| {
+        decoder.decode(data)?;
+        Ok(decoder.take_buffer())
+    })
 }
 
-#[cfg(all(feature = "decoding", not(target_arch = "wasm")))]
-#[cfg_attr(feature = "docs-features", doc(cfg(feature = "decoding")))]
+/// Same as [`mjpeg_to_rgb`] but with a destination buffer, which must be exactly the size of the decoded frame.
+/// # Errors
+/// If `mozjpeg` fails to read scanlines or setup the decompressor, the destination buffer is of the wrong size, or `decoding` is not enabled, this will error.
 pub fn buf_mjpeg_to_rgb(data: &[u8], dest: &mut [u8], rgba: bool) -> Result<(), NokhwaError> {
-    use mozjpeg::Decompress;
-
-    let mut jpeg_decompress = match Decompress::new_mem(data) {
-        Ok(decompress) => {
-            let decompressor_res = if rgba {
-                decompress.rgba()
-            } else {
-                decompress.rgb()
-            };
-            match decompressor_res {
-                Ok(decompressor) => decompressor,
-                Err(why) => {
-                    return Err(NokhwaError::ProcessFrameError {
-                        src: FrameFormat::MJPEG,
-                        destination: "RGB888".to_string(),
-                        error: why.to_string(),
-                    })
-                }
-            }
-        }
-        Err(why) => {
-            return Err(NokhwaError::ProcessFrameError {
-                src: FrameFormat::MJPEG,
-                destination: "RGB888".to_string(),
-                error: why.to_string(),
-            })
-        }
-    };
-
-    assert_eq!(dest.len(), jpeg_decompress.min_flat_buffer_size());
-
-    jpeg_decompress.read_scanlines_flat_into(dest);
-    assert!(jpeg_decompress.finish_decompress());
-
+    with_shared_decoder(rgba, |decoder| decoder.decode_into(data, dest))?;
     Ok(())
 }
 
-#[cfg(not(all(feature = "decoding", not(target_arch = "wasm"))))]
-pub fn buf_mjpeg_to_rgb(data: &[u8], dest: &mut [u8], rgba: bool) -> Result<(), NokhwaError> {
-    Err(NokhwaError::NotImplementedError(
-        "Not available on WASM".to_string(),
-    ))
-}
-
 // For those maintaining this, I recommend you read: https://docs.microsoft.com/en-us/windows/win32/medfound/recommended-8-bit-yuv-formats-for-video-rendering#yuy2
 // https://en.wikipedia.org/wiki/YUV#Converting_between_Y%E2%80%B2UV_and_RGB
 // and this too: https://stackoverflow.com/questions/16107165/convert-from-yuv-420-to-imagebgr-byte
@@ -1323,7 +1300,13 @@ pub fn yuyv422_to_rgb(data: &[u8], rgba: bool) -> Result<Vec<u8>, NokhwaError> {
     Ok(dest)
 }
 
-/// Same as yuyv422_to_rgb(&data) but with a destination buffer
+/// Same as [`yuyv422_to_rgb`] but with a destination buffer.
+///
+/// Uses SIMD (SSE2/AVX2 on `x86_64`, NEON on `aarch64`, `simd128` on wasm if enabled at compile time) where available,
+/// picked at runtime. The output is bit-identical to [`yuyv444_to_rgb`]. With the `parallel` feature, large frames are split
+/// into stripes that are converted on `rayon`'s thread pool.
+/// # Errors
+/// This may error when the data stream size is not divisible by 4, or the destination buffer is of the wrong size.
 pub fn buf_yuyv422_to_rgb(data: &[u8], dest: &mut [u8], rgba: bool) -> Result<(), NokhwaError> {
     if data.len() % 4 != 0 {
         return Err(NokhwaError::ProcessFrameError {
@@ -1346,44 +1329,276 @@ pub fn buf_yuyv422_to_rgb(data: &[u8], dest: &mut [u8], rgba: bool) -> Result<()
         });
     }
 
-    let iter = data.chunks_exact(4);
-
-    if rgba {
-        let mut iter = iter
-            .flat_map(|yuyv| {
-                let y1 = yuyv[0] as i32;
-                let u = yuyv[1] as i32;
-                let y2 = yuyv[2] as i32;
-                let v = yuyv[3] as i32;
-                let pixel1 = yuyv444_to_rgba(y1, u, v);
-                let pixel2 = yuyv444_to_rgba(y2, u, v);
-                [pixel1, pixel2]
-            })
-            .flatten();
-        for i in 0..rgb_buf_size {
-            dest[i] = iter.next().unwrap();
+    let _timer = metrics::time(Stage::Decode);
+    // a unit is one macropixel, 4 bytes of YUYV and 2 pixels
+    let unit_size = 2 * pixel_size;
+    for_each_stripe(dest, unit_size, data.len() / 2, |first, dest| {
+        let start = first * 4;
+        yuyv422_stripe_to_rgb(
+            &data[start..start + (dest.len() / unit_size) * 4],
+            dest,
+            rgba,
+        );
+    });
+
+    Ok(())
+}
+
+#[inline]
+fn yuyv422_stripe_to_rgb(data: &[u8], dest: &mut [u8], rgba: bool) {
+    let pixel_size = if rgba { 4 } else { 3 };
+    // vectorized kernels (SSE2/AVX2, NEON, simd128) do the bulk of the stripe, the scalar path does the rest.
+    let simd_consumed = crate::simd::yuyv422_to_rgb_simd(data, dest, rgba);
+    let (data, dest) = (
+        &data[simd_consumed..],
+        &mut dest[(simd_consumed / 4) * (2 * pixel_size)..],
+    );
+
+    for (yuyv, px) in data
+        .chunks_exact(4)
+        .zip(dest.chunks_exact_mut(2 * pixel_size))
+    {
+        let y1 = i32::from(yuyv[0]);
+        let u = i32::from(yuyv[1]);
+        let y2 = i32::from(yuyv[2]);
+        let v = i32::from(yuyv[3]);
+        if rgba {
+            px[..4].copy_from_slice(&yuyv444_to_rgba(y1, u, v));
+            px[4..].copy_from_slice(&yuyv444_to_rgba(y2, u, v));
+        } else {
+            px[..3].copy_from_slice(&yuyv444_to_rgb(y1, u, v));
+            px[3..].copy_from_slice(&yuyv444_to_rgb(y2, u, v));
         }
-    } else {
-        let mut iter = iter
-            .flat_map(|yuyv| {
-                let y1 = yuyv[0] as i32;
-                let u = yuyv[1] as i32;
-                let y2 = yuyv[2] as i32;
-                let v = yuyv[3] as i32;
-                let pixel1 = yuyv444_to_rgb(y1, u, v);
-                let pixel2 = yuyv444_to_rgb(y2, u, v);
-                [pixel1, pixel2]
-            })
-            .flatten();
-
-        for i in 0..rgb_buf_size {
-            dest[i] = iter.next().unwrap();
+    }
+}
+
+// Expands a GRAY8 frame into `dest`, with the luma copied into the first `color_channels` bytes of every pixel, followed
+// by an opaque alpha if `alpha` is true. `dest` must hold exactly as many pixels as `data`.
+pub(crate) fn expand_gray8(data: &[u8], dest: &mut [u8], color_channels: usize, alpha: bool) {
+    let pixel_size = color_channels + usize::from(alpha);
+    if pixel_size == 1 {
+        dest.copy_from_slice(data);
+        return;
+    }
+
+    let _timer = metrics::time(Stage::Decode);
+    for_each_stripe(dest, pixel_size, data.len(), |first, dest| {
+        for (luma, pixel) in data[first..].iter().zip(dest.chunks_exact_mut(pixel_size)) {
+            pixel[..color_channels].fill(*luma);
+            if alpha {
+                pixel[color_channels] = u8::MAX;
+            }
         }
+    });
+}
+
+// NV12 and I420 are both 4:2:0: every 2x2 block of luma shares one chroma sample. They only differ in how the
+// chroma is laid out (NV12: one interleaved U, V plane, I420: a U plane followed by a V plane).
+// Odd widths/heights round the chroma planes up.
+fn yuv420_plane_sizes(resolution: Resolution) -> (usize, usize, usize) {
+    let width = resolution.width() as usize;
+    let height = resolution.height() as usize;
+    let chroma_width = (width + 1) / 2;
+    let chroma_height = (height + 1) / 2;
+    (width * height, chroma_width, chroma_height)
+}
+
+fn check_yuv420_sizes(
+    format: FrameFormat,
+    resolution: Resolution,
+    data: &[u8],
+    dest: &[u8],
+    rgba: bool,
+) -> Result<(), NokhwaError> {
+    let (luma_size, chroma_width, chroma_height) = yuv420_plane_sizes(resolution);
+    let frame_size = luma_size + 2 * chroma_width * chroma_height;
+
+    if data.len() != frame_size {
+        return Err(NokhwaError::ProcessFrameError {
+            src: format,
+            destination: "RGB888".to_string(),
+            error: format!("Assertion failure, the {format} frame is of the wrong size! [expected: {frame_size}, actual: {}]", data.len()),
+        });
     }
+    check_yuv420_dest(format, resolution, dest, rgba)
+}
 
+fn check_yuv420_dest(
+    format: FrameFormat,
+    resolution: Resolution,
+    dest: &[u8],
+    rgba: bool,
+) -> Result<(), NokhwaError> {
+    let (luma_size, _, _) = yuv420_plane_sizes(resolution);
+    let pixel_size = if rgba { 4 } else { 3 };
+    let rgb_buf_size = luma_size * pixel_size;
+    if dest.len() != rgb_buf_size {
+        return Err(NokhwaError::ProcessFrameError {
+            src: format,
+            destination: "RGB888".to_string(),
+            error: format!("Assertion failure, the destination RGB buffer is of the wrong size! [expected: {rgb_buf_size}, actual: {}]", dest.len()),
+        });
+    }
     Ok(())
 }
 
+// the plane at `index`, checked to hold `row_size` bytes on each of `rows` rows
+pub(crate) fn plane_data<'a>(
+    format: FrameFormat,
+    data: &'a [u8],
+    planes: &[Plane],
+    index: usize,
+    row_size: usize,
+    rows: usize,
+) -> Result<(&'a [u8], usize), NokhwaError> {
+    let plane = planes
+        .get(index)
+        .filter(|plane| plane.stride() >= row_size && plane.rows() >= rows)
+        .and_then(|plane| {
+            data.get(plane.offset()..plane.offset() + plane.len())
+                .map(|data| (data, plane.stride()))
+        });
+    plane.ok_or_else(|| NokhwaError::ProcessFrameError {
+        src: format,
+        destination: "RGB888".to_string(),
+        error: format!("Assertion failure, the {format} frame is of the wrong size! (plane {index} is missing or too small)"),
+    })
+}
+
+/// Converts a NV12 (Y plane, then an interleaved U, V plane) frame of `resolution` to a RGB888 Stream.
+/// # Errors
+/// This will error if the frame is not the size a NV12 frame of `resolution` should be.
+pub fn nv12_to_rgb(
+    resolution: Resolution,
+    data: &[u8],
+    rgba: bool,
+) -> Result<Vec<u8>, NokhwaError> {
+    let pixel_size = if rgba { 4 } else { 3 };
+    let mut dest = vec![0; resolution.width() as usize * resolution.height() as usize * pixel_size];
+    buf_nv12_to_rgb(resolution, data, &mut dest, rgba)?;
+    Ok(dest)
+}
+
+/// Same as [`nv12_to_rgb`] but with a destination buffer.
+/// # Errors
+/// This will error if the frame is not the size a NV12 frame of `resolution` should be, or the destination buffer is of the wrong size.
+pub fn buf_nv12_to_rgb(
+    resolution: Resolution,
+    data: &[u8],
+    dest: &mut [u8],
+    rgba: bool,
+) -> Result<(), NokhwaError> {
+    check_yuv420_sizes(FrameFormat::NV12, resolution, data, dest, rgba)?;
+    let (planes, plane_count) = tight_layout(FrameFormat::NV12, resolution, data.len());
+    buf_nv12_planes_to_rgb(resolution, data, &planes[..plane_count], dest, rgba)
+}
+
+// same as `buf_nv12_to_rgb()`, with the planes where `planes` says (e.g. rows padded by the driver)
+pub(crate) fn buf_nv12_planes_to_rgb(
+    resolution: Resolution,
+    data: &[u8],
+    planes: &[Plane],
+    dest: &mut [u8],
+    rgba: bool,
+) -> Result<(), NokhwaError> {
+    let format = FrameFormat::NV12;
+    check_yuv420_dest(format, resolution, dest, rgba)?;
+    let (_, chroma_width, chroma_height) = yuv420_plane_sizes(resolution);
+    let (width, height) = (resolution.width() as usize, resolution.height() as usize);
+    let (luma, luma_stride) = plane_data(format, data, planes, 0, width, height)?;
+    let (chroma, chroma_stride) =
+        plane_data(format, data, planes, 1, chroma_width * 2, chroma_height)?;
+    yuv420_to_rgb(resolution, dest, rgba, |row, col| {
+        let idx = (row / 2) * chroma_stride + (col / 2) * 2;
+        (luma[row * luma_stride + col], chroma[idx], chroma[idx + 1])
+    });
+    Ok(())
+}
+
+/// Converts a I420 (Y plane, then a U plane, then a V plane) frame of `resolution` to a RGB888 Stream.
+/// # Errors
+/// This will error if the frame is not the size a I420 frame of `resolution` should be.
+pub fn i420_to_rgb(
+    resolution: Resolution,
+    data: &[u8],
+    rgba: bool,
+) -> Result<Vec<u8>, NokhwaError> {
+    let pixel_size = if rgba { 4 } else { 3 };
+    let mut dest = vec![0; resolution.width() as usize * resolution.height() as usize * pixel_size];
+    buf_i420_to_rgb(resolution, data, &mut dest, rgba)?;
+    Ok(dest)
+}
+
+/// Same as [`i420_to_rgb`] but with a destination buffer.
+/// # Errors
+/// This will error if the frame is not the size a I420 frame of `resolution` should be, or the destination buffer is of the wrong size.
+pub fn buf_i420_to_rgb(
+    resolution: Resolution,
+    data: &[u8],
+    dest: &mut [u8],
+    rgba: bool,
+) -> Result<(), NokhwaError> {
+    check_yuv420_sizes(FrameFormat::I420, resolution, data, dest, rgba)?;
+    let (planes, plane_count) = tight_layout(FrameFormat::I420, resolution, data.len());
+    buf_i420_planes_to_rgb(resolution, data, &planes[..plane_count], dest, rgba)
+}
+
+// same as `buf_i420_to_rgb()`, with the planes where `planes` says (e.g. rows padded by the driver)
+pub(crate) fn buf_i420_planes_to_rgb(
+    resolution: Resolution,
+    data: &[u8],
+    planes: &[Plane],
+    dest: &mut [u8],
+    rgba: bool,
+) -> Result<(), NokhwaError> {
+    let format = FrameFormat::I420;
+    check_yuv420_dest(format, resolution, dest, rgba)?;
+    let (_, chroma_width, chroma_height) = yuv420_plane_sizes(resolution);
+    let (width, height) = (resolution.width() as usize, resolution.height() as usize);
+    let (luma, luma_stride) = plane_data(format, data, planes, 0, width, height)?;
+    let (u_plane, u_stride) = plane_data(format, data, planes, 1, chroma_width, chroma_height)?;
+    let (v_plane, v_stride) = plane_data(format, data, planes, 2, chroma_width, chroma_height)?;
+    yuv420_to_rgb(resolution, dest, rgba, |row, col| {
+        let (u, v) = (
+            u_plane[(row / 2) * u_stride + col / 2],
+            v_plane[(row / 2) * v_stride + col / 2],
+        );
+        (luma[row * luma_stride + col], u, v)
+    });
+    Ok(())
+}
+
+#[inline]
+fn yuv420_to_rgb(
+    resolution: Resolution,
+    dest: &mut [u8],
+    rgba: bool,
+    sample: impl Fn(usize, usize) -> (u8, u8, u8) + Sync,
+) {
+    let width = resolution.width() as usize;
+    if width == 0 {
+        return;
+    }
+    let _timer = metrics::time(Stage::Decode);
+    let pixel_size = if rgba { 4 } else { 3 };
+    let row_size = width * pixel_size;
+    let pixels = width * resolution.height() as usize;
+    // stripes are whole rows, `sample` takes the row of the whole frame
+    for_each_stripe(dest, row_size, pixels, |first_row, dest| {
+        for (row, dest_row) in dest.chunks_exact_mut(row_size).enumerate() {
+            for (col, pixel) in dest_row.chunks_exact_mut(pixel_size).enumerate() {
+                let (y, u, v) = sample(first_row + row, col);
+                let (y, u, v) = (i32::from(y), i32::from(u), i32::from(v));
+                if rgba {
+                    pixel.copy_from_slice(&yuyv444_to_rgba(y, u, v));
+                } else {
+                    pixel.copy_from_slice(&yuyv444_to_rgb(y, u, v));
+                }
+            }
+        }
+    });
+}
+
 // equation from https://en.wikipedia.org/wiki/YUV#Converting_between_Y%E2%80%B2UV_and_RGB
 /// Convert `YCbCr` 4:4:4 to a RGB888. [For further reading](https://en.wikipedia.org/wiki/YUV#Converting_between_Y%E2%80%B2UV_and_RGB)
 #[allow(clippy::many_single_char_names)]